@@ -0,0 +1,210 @@
+/*
+ * Copyright © 2026 The Mesa Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Compares the disk cache backends: time to store a number of entries, and
+ * to load all of them again from a freshly created cache object ("cold",
+ * as an application starting up would) and from the same object ("warm").
+ *
+ * Note that "cold" only means cold for the cache, the OS page cache is
+ * still hot unless it's dropped between the runs, e.g. with
+ *
+ *    cache-bench store && echo 3 > /proc/sys/vm/drop_caches && cache-bench load
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "util/disk_cache.h"
+#include "util/os_time.h"
+
+#ifdef ENABLE_SHADER_CACHE
+
+#define NUM_ENTRIES 10000
+#define ENTRY_SIZE  4096
+
+/* Entries prefetched ahead of the ones being loaded */
+#define PREFETCH_BATCH 32
+
+static const char *type_names[] = {
+   [DISK_CACHE_MULTI_FILE] = "multi-file",
+   [DISK_CACHE_PACK_FILE] = "pack-file",
+};
+
+/* Something that compresses roughly like a shader binary would. */
+static void
+fill_entry(uint8_t *data, unsigned index)
+{
+   uint32_t seed = index * 2654435761u + 1;
+   unsigned i;
+
+   for (i = 0; i < ENTRY_SIZE; i += 4) {
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+      data[i] = seed;
+      data[i + 1] = seed & 0x3;
+      data[i + 2] = 0;
+      data[i + 3] = index;
+   }
+}
+
+static struct disk_cache *
+create_cache(enum disk_cache_type type)
+{
+   return disk_cache_type_create("bench", type_names[type], 0, type);
+}
+
+static void
+compute_key(struct disk_cache *cache, unsigned index, cache_key key)
+{
+   disk_cache_compute_key(cache, &index, sizeof(index), key);
+}
+
+static void
+bench_store(enum disk_cache_type type)
+{
+   struct disk_cache *cache = create_cache(type);
+   uint8_t data[ENTRY_SIZE];
+   cache_key key;
+   int64_t start;
+   unsigned i;
+
+   start = os_time_get_nano();
+
+   for (i = 0; i < NUM_ENTRIES; i++) {
+      fill_entry(data, i);
+      compute_key(cache, i, key);
+      disk_cache_put(cache, key, data, sizeof(data), NULL);
+   }
+
+   disk_cache_wait_for_idle(cache);
+   disk_cache_destroy(cache);
+
+   printf("%-10s store: %8.2f ms\n", type_names[type],
+          (os_time_get_nano() - start) / 1e6);
+}
+
+static void
+prefetch_batch(struct disk_cache *cache, unsigned first)
+{
+   cache_key keys[PREFETCH_BATCH];
+   unsigned i, n = 0;
+
+   for (i = first; i < first + PREFETCH_BATCH && i < NUM_ENTRIES; i++)
+      compute_key(cache, i, keys[n++]);
+
+   disk_cache_prefetch(cache, keys, n);
+}
+
+static unsigned
+load_all(struct disk_cache *cache, bool prefetch)
+{
+   uint8_t data[ENTRY_SIZE];
+   unsigned i, found = 0;
+   cache_key key;
+
+   if (prefetch)
+      prefetch_batch(cache, 0);
+
+   for (i = 0; i < NUM_ENTRIES; i++) {
+      size_t size;
+      void *result;
+
+      if (prefetch && i % PREFETCH_BATCH == 0)
+         prefetch_batch(cache, i + PREFETCH_BATCH);
+
+      compute_key(cache, i, key);
+      result = disk_cache_get(cache, key, &size);
+      if (result) {
+         fill_entry(data, i);
+         if (size == sizeof(data) && memcmp(result, data, size) == 0)
+            found++;
+         free(result);
+      }
+   }
+
+   return found;
+}
+
+static void
+bench_load(enum disk_cache_type type)
+{
+   struct disk_cache *cache;
+   int64_t start, cold, warm, prefetched;
+   unsigned found;
+
+   start = os_time_get_nano();
+   cache = create_cache(type);
+   found = load_all(cache, false);
+   cold = os_time_get_nano() - start;
+
+   start = os_time_get_nano();
+   load_all(cache, false);
+   warm = os_time_get_nano() - start;
+
+   start = os_time_get_nano();
+   load_all(cache, true);
+   prefetched = os_time_get_nano() - start;
+
+   disk_cache_destroy(cache);
+
+   printf("%-10s load:  %8.2f ms cold, %8.2f ms warm, %8.2f ms prefetched "
+          "(%u/%u entries)\n", type_names[type], cold / 1e6, warm / 1e6,
+          prefetched / 1e6, found, NUM_ENTRIES);
+}
+
+int
+main(int argc, char **argv)
+{
+   const char *mode = argc > 1 ? argv[1] : "all";
+   bool store = strcmp(mode, "load") != 0;
+   bool load = strcmp(mode, "store") != 0;
+
+   if (!getenv("MESA_GLSL_CACHE_DIR"))
+      setenv("MESA_GLSL_CACHE_DIR", ".", 1);
+
+   if (store) {
+      bench_store(DISK_CACHE_MULTI_FILE);
+      bench_store(DISK_CACHE_PACK_FILE);
+   }
+
+   if (load) {
+      bench_load(DISK_CACHE_MULTI_FILE);
+      bench_load(DISK_CACHE_PACK_FILE);
+   }
+
+   return 0;
+}
+
+#else
+
+int
+main(void)
+{
+   fprintf(stderr, "Built without shader cache support.\n");
+   return 1;
+}
+
+#endif /* ENABLE_SHADER_CACHE */
@@ -493,6 +493,209 @@ test_put_key_and_get_key(void)
 
    disk_cache_destroy(cache);
 }
+
+/* Fill \data with incompressible bytes, so that sizes in the cache are
+ * predictable.
+ */
+static void *
+random_data(size_t size, uint32_t seed)
+{
+   uint32_t *data = malloc(size);
+   size_t i;
+
+   for (i = 0; i < size / sizeof(uint32_t); i++) {
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+      data[i] = seed;
+   }
+
+   return data;
+}
+
+static void
+put_random_item(struct disk_cache *cache, size_t size, uint32_t seed,
+                cache_key key)
+{
+   void *data = random_data(size, seed);
+
+   disk_cache_compute_key(cache, data, size, key);
+   disk_cache_put(cache, key, data, size, NULL);
+   free(data);
+
+   wait_until_file_written(cache, key);
+}
+
+static void
+test_pack_file(void)
+{
+   struct disk_cache *cache;
+   char blob[] = "This is a blob of thirty-seven bytes";
+   uint8_t blob_key[20];
+   char string[] = "While this string has thirty-four";
+   uint8_t string_key[20];
+   uint8_t keys[8][20];
+   char *result;
+   size_t size;
+   int i, count;
+
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "64K", 1);
+   cache = disk_cache_type_create("test", "make_check", 0,
+                                  DISK_CACHE_PACK_FILE);
+
+   disk_cache_compute_key(cache, blob, sizeof(blob), blob_key);
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_null(result, "pack: disk_cache_get with non-existent item");
+
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+   wait_until_file_written(cache, blob_key);
+
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_equal_str(blob, result, "pack: disk_cache_get of existing item");
+   expect_equal(size, sizeof(blob), "pack: disk_cache_get size");
+   free(result);
+
+   disk_cache_compute_key(cache, string, sizeof(string), string_key);
+   disk_cache_put(cache, string_key, string, sizeof(string), NULL);
+   wait_until_file_written(cache, string_key);
+
+   disk_cache_remove(cache, blob_key);
+   expect_true(!does_cache_contain(cache, blob_key),
+               "pack: disk_cache_remove");
+
+   /* Entries survive re-opening the cache. */
+   disk_cache_destroy(cache);
+   cache = disk_cache_type_create("test", "make_check", 0,
+                                  DISK_CACHE_PACK_FILE);
+
+   result = disk_cache_get(cache, string_key, &size);
+   expect_equal_str(string, result, "pack: disk_cache_get after reopen");
+   free(result);
+
+   /* Add two 24K items, use the first one again and add a third. Only the
+    * least recently used one should get evicted.
+    */
+   put_random_item(cache, 24 * 1024, 1, keys[0]);
+   put_random_item(cache, 24 * 1024, 2, keys[1]);
+   expect_true(does_cache_contain(cache, keys[0]), "pack: LRU use 1st item");
+   put_random_item(cache, 24 * 1024, 3, keys[2]);
+
+   expect_true(does_cache_contain(cache, keys[0]),
+               "pack: recently used item isn't evicted");
+   expect_true(!does_cache_contain(cache, keys[1]),
+               "pack: least recently used item is evicted");
+   expect_true(does_cache_contain(cache, keys[2]),
+               "pack: new item is in the cache");
+
+   /* Fill the pack file with mostly dead records and check that the live
+    * ones are still there once it has been compacted.
+    */
+   disk_cache_destroy(cache);
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "16M", 1);
+   cache = disk_cache_type_create("test", "make_check", 0,
+                                  DISK_CACHE_PACK_FILE);
+
+   for (i = 0; i < 6; i++)
+      put_random_item(cache, 1024 * 1024, 10 + i, keys[i]);
+   for (i = 1; i < 6; i++)
+      disk_cache_remove(cache, keys[i]);
+   put_random_item(cache, 1024 * 1024, 16, keys[6]);
+
+   count = 0;
+   for (i = 0; i < 7; i++) {
+      if (does_cache_contain(cache, keys[i]))
+         count++;
+   }
+   expect_true(does_cache_contain(cache, keys[0]) &&
+               does_cache_contain(cache, keys[6]),
+               "pack: live items survive compaction");
+   expect_equal(count, 2, "pack: removed items stay removed");
+
+   disk_cache_destroy(cache);
+}
+
+static void
+test_prefetch(void)
+{
+   struct disk_cache *cache;
+   uint8_t keys[3][20];
+   uint8_t missing_key[20];
+   char *result;
+   size_t size;
+
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "1M", 1);
+   cache = disk_cache_create("test", "make_check", 0);
+
+   put_random_item(cache, 1000, 20, keys[0]);
+   put_random_item(cache, 2000, 21, keys[1]);
+   put_random_item(cache, 3000, 22, keys[2]);
+   memset(missing_key, 0xff, sizeof(missing_key));
+
+   disk_cache_prefetch(cache, (const cache_key *) keys, 3);
+   disk_cache_prefetch(cache, (const cache_key *) &missing_key, 1);
+
+   result = disk_cache_get(cache, keys[1], &size);
+   expect_non_null(result, "disk_cache_get of a prefetched item");
+   expect_equal(size, 2000, "disk_cache_get of a prefetched item (size)");
+   free(result);
+
+   /* The prefetched copy is handed out only once, after that it's a
+    * regular lookup.
+    */
+   result = disk_cache_get(cache, keys[1], &size);
+   expect_non_null(result, "disk_cache_get of a prefetched item again");
+   free(result);
+
+   result = disk_cache_get(cache, missing_key, &size);
+   expect_null(result, "disk_cache_get of a prefetched missing item");
+
+   disk_cache_remove(cache, keys[2]);
+   expect_true(!does_cache_contain(cache, keys[2]),
+               "disk_cache_remove of a prefetched item");
+
+   /* keys[0] was never asked for, destroy has to clean it up. */
+   disk_cache_destroy(cache);
+}
+
+static void
+test_prefetch_reclaim(void)
+{
+   struct disk_cache *cache;
+   uint8_t unused_keys[300][20];
+   uint8_t key[20];
+   char *result;
+   size_t size;
+   int i;
+
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "1M", 1);
+   cache = disk_cache_type_create("test", "make_check", 0,
+                                  DISK_CACHE_MULTI_FILE);
+
+   put_random_item(cache, 1000, 30, key);
+
+   /* More prefetches than can be outstanding, which nobody asks for. */
+   for (i = 0; i < 300; i++) {
+      memset(unused_keys[i], 0xee, sizeof(unused_keys[i]));
+      unused_keys[i][0] = i & 0xff;
+      unused_keys[i][1] = i >> 8;
+   }
+   disk_cache_prefetch(cache, (const cache_key *) unused_keys, 300);
+   disk_cache_wait_for_idle(cache);
+
+   disk_cache_prefetch(cache, (const cache_key *) &key, 1);
+   disk_cache_wait_for_idle(cache);
+
+   /* Only a prefetched copy can be found once the files are gone. */
+   rmrf_local(CACHE_TEST_TMP "/mesa-glsl-cache-dir");
+
+   result = disk_cache_get(cache, key, &size);
+   expect_non_null(result, "disk_cache_prefetch after unused prefetches");
+   expect_equal(size, 1000,
+                "disk_cache_prefetch after unused prefetches (size)");
+   free(result);
+
+   disk_cache_destroy(cache);
+}
 #endif /* ENABLE_SHADER_CACHE */
 
 int
@@ -507,6 +710,12 @@ main(void)
 
    test_put_key_and_get_key();
 
+   test_pack_file();
+
+   test_prefetch();
+
+   test_prefetch_reclaim();
+
    err = rmrf_local(CACHE_TEST_TMP);
    expect_equal(err, 0, "Removing " CACHE_TEST_TMP " again");
 #endif /* ENABLE_SHADER_CACHE */
@@ -2002,6 +2002,12 @@ typedef struct nir_shader {
     * access plus one
     */
    unsigned num_inputs, num_uniforms, num_outputs, num_shared;
+
+   /**
+    * ralloc arena the control flow and instructions of the shader come out
+    * of.  It's a child of the shader, replaced by a fresh one by nir_sweep().
+    */
+   void *arena;
 } nir_shader;
 
 static inline nir_function_impl *
@@ -2430,6 +2436,15 @@ void nir_print_instr(const nir_instr *instr, FILE *fp);
 
 nir_shader *nir_shader_clone(void *mem_ctx, const nir_shader *s);
 nir_function_impl *nir_function_impl_clone(const nir_function_impl *fi);
+
+/**
+ * Clones the control flow and instructions of \p fi into a new bare impl.
+ *
+ * The clone refers to the variables and registers of \p fi, which must have
+ * been dropped from their use/def lists, and keeps the indices and
+ * pass_flags of the instructions and SSA defs.  Used by nir_sweep().
+ */
+nir_function_impl *nir_function_impl_clone_body(const nir_function_impl *fi);
 nir_constant *nir_constant_clone(const nir_constant *c, nir_variable *var);
 nir_variable *nir_variable_clone(const nir_variable *c, nir_shader *shader);
 nir_deref *nir_deref_clone(const nir_deref *deref, void *mem_ctx);
@@ -25,6 +25,7 @@
 
 from __future__ import print_function
 import ast
+from collections import defaultdict
 import itertools
 import struct
 import sys
@@ -495,6 +496,193 @@ class SearchAndReplace(object):
 
       BitSizeValidator(varset).validate(self.search, self.replace)
 
+class IndexMap(object):
+   """A dictionary giving a stable index to every object added to it, in
+   insertion order.  Indices of equal objects are shared.
+   """
+   def __init__(self, iterable=()):
+      self.objects = []
+      self.indices = {}
+      for obj in iterable:
+         self.add(obj)
+
+   def add(self, obj):
+      if obj in self.indices:
+         return self.indices[obj]
+
+      index = len(self.objects)
+      self.objects.append(obj)
+      self.indices[obj] = index
+      return index
+
+   def __getitem__(self, obj):
+      return self.indices[obj]
+
+   def __contains__(self, obj):
+      return obj in self.indices
+
+   def __len__(self):
+      return len(self.objects)
+
+   def __iter__(self):
+      return iter(self.objects)
+
+class TreeAutomaton(object):
+   """A bottom-up tree automaton matching all the search patterns at once.
+
+   Every pattern and subpattern is made an item, identified by its opcode
+   and the items of its sources.  Variables are the __wildcard item, which
+   matches any value, and constants and constant variables are the __const
+   item, which only matches load_const.  The state of an SSA value is the
+   set of items that may match it, which only depends on its opcode and the
+   states of its sources, so it can be computed ahead of time for every
+   opcode and every combination of source states.
+
+   Only opcodes and constants are looked at, so the state of a value is a
+   superset of the patterns that actually match it: nir_replace_instr()
+   still runs the full match, but only for the transforms listed in the
+   state of the instruction instead of all the ones of its opcode.
+
+   To keep the tables small, the states of the sources are first mapped to
+   the set of items in them that appear as a source of the opcode at hand,
+   which is what the per-opcode filter arrays do.
+   """
+   def __init__(self, transforms):
+      self.patterns = [t.search for t in transforms]
+      self._compute_items()
+      self._build_table()
+
+   class Item(object):
+      """An item of the automaton.  The wildcard and constant items have
+      the made up __wildcard and __const opcodes and no children.
+      """
+      def __init__(self, opcode, children):
+         self.opcode = opcode
+         self.children = children
+         # Indices of the patterns this is the whole of.
+         self.patterns = []
+         # Opcodes this is a source of in some pattern.
+         self.parent_ops = set()
+
+      def __str__(self):
+         return '(' + ', '.join([self.opcode] + [str(c) for c in self.children]) + ')'
+
+      def __repr__(self):
+         return str(self)
+
+   def _compute_items(self):
+      self.items = {}
+      self.opcodes = IndexMap()
+
+      def get_item(opcode, children):
+         if (opcode, children) in self.items:
+            return self.items[opcode, children]
+
+         item = self.Item(opcode, children)
+         self.items[opcode, children] = item
+         # nir_search tries both orders of the sources of commutative
+         # opcodes, so the swapped sources are the same item.
+         if len(children) == 2 and \
+            "commutative" in opcodes[opcode].algebraic_properties:
+            self.items[opcode, children[::-1]] = item
+         for child in children:
+            child.parent_ops.add(opcode)
+         return item
+
+      self.wildcard = get_item("__wildcard", ())
+      self.const = get_item("__const", ())
+
+      def process_subpattern(src, patterns=()):
+         if isinstance(src, Constant):
+            return self.const
+         elif isinstance(src, Variable):
+            return self.const if src.is_constant else self.wildcard
+         else:
+            assert isinstance(src, Expression)
+            self.opcodes.add(src.opcode)
+            children = tuple(process_subpattern(c) for c in src.sources)
+            item = get_item(src.opcode, children)
+            item.patterns.extend(patterns)
+            return item
+
+      for i, pattern in enumerate(self.patterns):
+         process_subpattern(pattern, (i,))
+
+   def _build_table(self):
+      """Builds the transition tables with the usual worklist algorithm:
+      whenever a new state is found, the tables of the opcodes it may be a
+      source of get extended with the combinations involving it.
+      """
+      # Per opcode, the filtered source states and the transition table
+      # indexed by a tuple of filtered source state indices.
+      self.filter = defaultdict(list)
+      self.rep = defaultdict(IndexMap)
+      self.table = defaultdict(dict)
+
+      self.states = IndexMap()
+      # These two are the WILDCARD_STATE and CONST_STATE of the C code.
+      self.states.add(frozenset((self.wildcard,)))
+      self.states.add(frozenset((self.wildcard, self.const)))
+
+      worklist = list(range(len(self.states)))
+      while worklist:
+         state_index = worklist.pop(0)
+         state = self.states.objects[state_index]
+
+         # Map the new state through the filter of every opcode.
+         changed_ops = IndexMap()
+         for op in self.opcodes:
+            filt = self.filter[op]
+            filtered = frozenset(item for item in state
+                                 if op in item.parent_ops)
+            rep = self.rep[op]
+            if filtered not in rep:
+               changed_ops.add(op)
+            assert len(filt) == state_index
+            filt.append(rep.add(filtered))
+
+         # Extend the tables of the opcodes that got a new filtered state.
+         for op in changed_ops:
+            rep = self.rep[op]
+            num_srcs = opcodes[op].num_inputs
+            new_index = len(rep) - 1
+            for srcs in itertools.product(range(len(rep)), repeat=num_srcs):
+               if new_index not in srcs:
+                  continue
+
+               src_items = [rep.objects[s] for s in srcs]
+               parent = frozenset(
+                  self.items[op, children]
+                  for children in itertools.product(*src_items)
+                  if (op, children) in self.items)
+               # The wildcard matches anything.
+               parent |= frozenset((self.wildcard,))
+               if parent not in self.states:
+                  worklist.append(len(self.states))
+               self.table[op][srcs] = self.states.add(parent)
+
+      assert len(self.states) < 65536, "too many automaton states"
+
+      # Indices of the patterns that may match each state.
+      self.state_patterns = [
+         sorted(set(i for item in state for i in item.patterns))
+         for state in self.states]
+
+   def op_table(self, op):
+      """The transition table of op, flattened in the order
+      itertools.product() enumerates the filtered source states, the first
+      source varying the slowest.
+      """
+      num_srcs = opcodes[op].num_inputs
+      return [self.table[op][srcs] for srcs in
+              itertools.product(range(len(self.rep[op])), repeat=num_srcs)]
+
+def _c_array(values, indent=3, per_line=16):
+   """Formats the values as the lines of a C initializer."""
+   return '\n'.join(' ' * indent + ', '.join(str(v) for v in
+                                             values[i:i + per_line]) + ','
+                    for i in range(0, len(values), per_line))
+
 _algebraic_pass_template = mako.template.Template("""
 #include "nir.h"
 #include "nir_search.h"
@@ -509,27 +697,124 @@ struct transform {
    unsigned condition_offset;
 };
 
+struct transform_list {
+   const struct transform *xforms;
+   unsigned num_xforms;
+};
+
+/* Transitions of the matching automaton for one opcode.  The states of the
+ * sources are first mapped through filter, giving num_filtered_states
+ * possible values for each source, which index table.
+ */
+struct per_op_table {
+   const uint16_t *filter;
+   unsigned num_filtered_states;
+   const uint16_t *table;
+};
+
+/* The states every value not computed by a known opcode starts in, see
+ * TreeAutomaton in nir_algebraic.py.  WILDCARD_STATE has to be 0 so that
+ * zeroed states are valid.
+ */
+#define WILDCARD_STATE 0
+#define CONST_STATE 1
+
 #endif
 
-% for (opcode, xform_list) in xform_dict.iteritems():
-% for xform in xform_list:
+% for xform in xforms:
    ${xform.search.render()}
    ${xform.replace.render()}
 % endfor
 
-static const struct transform ${pass_name}_${opcode}_xforms[] = {
-% for xform in xform_list:
-   { &${xform.search.name}, ${xform.replace.c_ptr}, ${xform.condition_index} },
+% for state_id, state_xforms in enumerate(automaton.state_patterns):
+% if state_xforms:
+static const struct transform ${pass_name}_state${state_id}_xforms[] = {
+% for i in state_xforms:
+   { &${xforms[i].search.name}, ${xforms[i].replace.c_ptr}, ${xforms[i].condition_index} },
 % endfor
 };
+% endif
 % endfor
 
+static const struct transform_list ${pass_name}_state_xforms[] = {
+% for state_id, state_xforms in enumerate(automaton.state_patterns):
+% if state_xforms:
+   { ${pass_name}_state${state_id}_xforms, ARRAY_SIZE(${pass_name}_state${state_id}_xforms) },
+% else:
+   { NULL, 0 },
+% endif
+% endfor
+};
+
+% for op in automaton.opcodes:
+static const uint16_t ${pass_name}_${op}_filter[] = {
+${c_array(automaton.filter[op])}
+};
+
+static const uint16_t ${pass_name}_${op}_table[] = {
+${c_array(automaton.op_table(op))}
+};
+
+% endfor
+static const struct per_op_table ${pass_name}_table[nir_num_opcodes] = {
+% for op in automaton.opcodes:
+   [nir_op_${op}] = {
+      ${pass_name}_${op}_filter,
+      ${len(automaton.rep[op])},
+      ${pass_name}_${op}_table,
+   },
+% endfor
+};
+
+/* Walks the instructions in order, so that the sources of everything but
+ * phis have their state by the time it is needed.  Phis, like any other
+ * value that is not the result of an opcode of the patterns, stay in
+ * WILDCARD_STATE.
+ */
+static void
+${pass_name}_pre_block(nir_block *block, uint16_t *states)
+{
+   nir_foreach_instr(instr, block) {
+      switch (instr->type) {
+      case nir_instr_type_alu: {
+         nir_alu_instr *alu = nir_instr_as_alu(instr);
+         const struct per_op_table *tbl = &${pass_name}_table[alu->op];
+
+         if (tbl->num_filtered_states == 0 || !alu->dest.dest.is_ssa)
+            break;
+
+         unsigned index = 0;
+         for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+            uint16_t src_state = alu->src[i].src.is_ssa ?
+               states[alu->src[i].src.ssa->index] : WILDCARD_STATE;
+            index = index * tbl->num_filtered_states + tbl->filter[src_state];
+         }
+         states[alu->dest.dest.ssa.index] = tbl->table[index];
+         break;
+      }
+
+      case nir_instr_type_load_const: {
+         nir_load_const_instr *load_const = nir_instr_as_load_const(instr);
+         states[load_const->def.index] = CONST_STATE;
+         break;
+      }
+
+      default:
+         break;
+      }
+   }
+}
+
 static bool
 ${pass_name}_block(nir_block *block, const bool *condition_flags,
-                   void *mem_ctx)
+                   const uint16_t *states, void *mem_ctx)
 {
    bool progress = false;
 
+   /* Replacements only add instructions before the one being replaced,
+    * which are not visited, and never change the sources of the ones left
+    * to visit, so their states stay valid.
+    */
    nir_foreach_instr_reverse_safe(instr, block) {
       if (instr->type != nir_instr_type_alu)
          continue;
@@ -538,22 +823,17 @@ ${pass_name}_block(nir_block *block, const bool *condition_flags,
       if (!alu->dest.dest.is_ssa)
          continue;
 
-      switch (alu->op) {
-      % for opcode in xform_dict.keys():
-      case nir_op_${opcode}:
-         for (unsigned i = 0; i < ARRAY_SIZE(${pass_name}_${opcode}_xforms); i++) {
-            const struct transform *xform = &${pass_name}_${opcode}_xforms[i];
-            if (condition_flags[xform->condition_offset] &&
-                nir_replace_instr(alu, xform->search, xform->replace,
-                                  mem_ctx)) {
-               progress = true;
-               break;
-            }
+      const struct transform_list *list =
+         &${pass_name}_state_xforms[states[alu->dest.dest.ssa.index]];
+
+      for (unsigned i = 0; i < list->num_xforms; i++) {
+         const struct transform *xform = &list->xforms[i];
+         if (condition_flags[xform->condition_offset] &&
+             nir_replace_instr(alu, xform->search, xform->replace,
+                               mem_ctx)) {
+            progress = true;
+            break;
          }
-         break;
-      % endfor
-      default:
-         break;
       }
    }
 
@@ -566,10 +846,20 @@ ${pass_name}_impl(nir_function_impl *impl, const bool *condition_flags)
    void *mem_ctx = ralloc_parent(impl);
    bool progress = false;
 
+   uint16_t *states = calloc(impl->ssa_alloc, sizeof(*states));
+   if (!states)
+      return false;
+
+   nir_foreach_block(block, impl) {
+      ${pass_name}_pre_block(block, states);
+   }
+
    nir_foreach_block_reverse(block, impl) {
-      progress |= ${pass_name}_block(block, condition_flags, mem_ctx);
+      progress |= ${pass_name}_block(block, condition_flags, states, mem_ctx);
    }
 
+   free(states);
+
    if (progress)
       nir_metadata_preserve(impl, nir_metadata_block_index |
                                   nir_metadata_dominance);
@@ -601,7 +891,7 @@ ${pass_name}(nir_shader *shader)
 
 class AlgebraicPass(object):
    def __init__(self, pass_name, transforms):
-      self.xform_dict = {}
+      self.xforms = []
       self.pass_name = pass_name
 
       error = False
@@ -618,15 +908,16 @@ class AlgebraicPass(object):
                error = True
                continue
 
-         if xform.search.opcode not in self.xform_dict:
-            self.xform_dict[xform.search.opcode] = []
-
-         self.xform_dict[xform.search.opcode].append(xform)
+         self.xforms.append(xform)
 
       if error:
          sys.exit(1)
 
+      self.automaton = TreeAutomaton(self.xforms)
+
    def render(self):
       return _algebraic_pass_template.render(pass_name=self.pass_name,
-                                             xform_dict=self.xform_dict,
-                                             condition_list=condition_list)
+                                             xforms=self.xforms,
+                                             automaton=self.automaton,
+                                             condition_list=condition_list,
+                                             c_array=_c_array)
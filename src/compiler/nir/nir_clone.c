@@ -42,6 +42,11 @@ typedef struct {
     */
    bool allow_remap_fallback;
 
+   /* If true, the SSA defs and instructions keep their indices and
+    * pass_flags.
+    */
+   bool keep_indices;
+
    /* maps orig ptr -> cloned ptr: */
    struct hash_table *remap_table;
 
@@ -58,12 +63,12 @@ init_clone_state(clone_state *state, struct hash_table *remap_table,
 {
    state->global_clone = global;
    state->allow_remap_fallback = allow_remap_fallback;
+   state->keep_indices = false;
 
    if (remap_table) {
       state->remap_table = remap_table;
    } else {
-      state->remap_table = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
-                                                   _mesa_key_pointer_equal);
+      state->remap_table = _mesa_pointer_hash_table_create(NULL);
    }
 
    list_inithead(&state->phi_srcs);
@@ -101,6 +106,14 @@ add_remap(clone_state *state, void *nptr, const void *ptr)
    _mesa_hash_table_insert(state->remap_table, ptr, nptr);
 }
 
+static void
+add_ssa_def_remap(clone_state *state, nir_ssa_def *ndef, const nir_ssa_def *def)
+{
+   if (state->keep_indices)
+      ndef->index = def->index;
+   add_remap(state, ndef, def);
+}
+
 static void *
 remap_local(clone_state *state, const void *ptr)
 {
@@ -247,7 +260,7 @@ __clone_dst(clone_state *state, nir_instr *ninstr,
    if (dst->is_ssa) {
       nir_ssa_dest_init(ninstr, ndst, dst->ssa.num_components,
                         dst->ssa.bit_size, dst->ssa.name);
-      add_remap(state, &ndst->ssa, &dst->ssa);
+      add_ssa_def_remap(state, &ndst->ssa, &dst->ssa);
    } else {
       ndst->reg.reg = remap_reg(state, dst->reg.reg);
       if (dst->reg.indirect) {
@@ -380,8 +393,9 @@ clone_load_const(clone_state *state, const nir_load_const_instr *lc)
                                   lc->def.bit_size);
 
    memcpy(&nlc->value, &lc->value, sizeof(nlc->value));
+   nlc->def.name = ralloc_strdup(nlc, lc->def.name);
 
-   add_remap(state, &nlc->def, &lc->def);
+   add_ssa_def_remap(state, &nlc->def, &lc->def);
 
    return nlc;
 }
@@ -392,8 +406,9 @@ clone_ssa_undef(clone_state *state, const nir_ssa_undef_instr *sa)
    nir_ssa_undef_instr *nsa =
       nir_ssa_undef_instr_create(state->ns, sa->def.num_components,
                                  sa->def.bit_size);
+   nsa->def.name = ralloc_strdup(nsa, sa->def.name);
 
-   add_remap(state, &nsa->def, &sa->def);
+   add_ssa_def_remap(state, &nsa->def, &sa->def);
 
    return nsa;
 }
@@ -551,6 +566,12 @@ clone_block(clone_state *state, struct exec_list *cf_list, const nir_block *blk)
          nir_instr *ninstr = clone_instr(state, instr);
          nir_instr_insert_after_block(nblk, ninstr);
       }
+
+      if (state->keep_indices) {
+         nir_instr *ninstr = nir_block_last_instr(nblk);
+         ninstr->index = instr->index;
+         ninstr->pass_flags = instr->pass_flags;
+      }
    }
 
    return nblk;
@@ -707,6 +728,27 @@ nir_function_impl_clone(const nir_function_impl *fi)
    return nfi;
 }
 
+nir_function_impl *
+nir_function_impl_clone_body(const nir_function_impl *fi)
+{
+   clone_state state;
+   init_clone_state(&state, NULL, false, true);
+   state.keep_indices = true;
+
+   /* We use the same shader */
+   state.ns = fi->function->shader;
+
+   nir_function_impl *nfi = nir_function_impl_create_bare(state.ns);
+
+   clone_cf_list(&state, &nfi->body, &fi->body);
+
+   fixup_phi_srcs(&state);
+
+   free_clone_state(&state);
+
+   return nfi;
+}
+
 static nir_function *
 clone_function(clone_state *state, const nir_function *fxn, nir_shader *ns)
 {
@@ -45,6 +45,13 @@
  */
 /*@{*/
 
+/* Blocks and instructions are allocated out of the arena of their shader. */
+static nir_shader *
+block_get_shader(nir_block *block)
+{
+   return ralloc_parent(ralloc_parent(block));
+}
+
 static bool
 block_ends_in_jump(nir_block *block)
 {
@@ -192,7 +199,7 @@ replace_successor(nir_block *block, nir_block *old_succ, nir_block *new_succ)
 static nir_block *
 split_block_beginning(nir_block *block)
 {
-   nir_block *new_block = nir_block_create(ralloc_parent(block));
+   nir_block *new_block = nir_block_create(block_get_shader(block));
    new_block->cf_node.parent = block->cf_node.parent;
    exec_node_insert_node_before(&block->cf_node.node, &new_block->cf_node.node);
 
@@ -245,7 +252,7 @@ insert_phi_undef(nir_block *block, nir_block *pred)
 
       nir_phi_instr *phi = nir_instr_as_phi(instr);
       nir_ssa_undef_instr *undef =
-         nir_ssa_undef_instr_create(ralloc_parent(phi),
+         nir_ssa_undef_instr_create(block_get_shader(block),
                                     phi->dest.ssa.num_components,
                                     phi->dest.ssa.bit_size);
       nir_instr_insert_before_cf_list(&impl->body, &undef->instr);
@@ -335,7 +342,7 @@ block_add_normal_succs(nir_block *block)
 static nir_block *
 split_block_end(nir_block *block)
 {
-   nir_block *new_block = nir_block_create(ralloc_parent(block));
+   nir_block *new_block = nir_block_create(block_get_shader(block));
    new_block->cf_node.parent = block->cf_node.parent;
    exec_node_insert_after(&block->cf_node.node, &new_block->cf_node.node);
 
@@ -33,83 +33,25 @@
  * The expectation is that drivers should call this when finished compiling the shader
  * (after any optimization, lowering, and so on).  However, it's also fine to call it
  * earlier, and even many times, trading CPU cycles for memory savings.
+ *
+ * The control flow and instructions are allocated out of the shader arena,
+ * where the dead ones leave holes that only the same shader can fill.  So
+ * rather than stealing them back, each function body is cloned into a fresh
+ * arena, keeping the indices and pass_flags of the instructions, and the old
+ * arena is freed with the rest of the rubbish.
  */
 
 #define steal_list(mem_ctx, type, list) \
    foreach_list_typed(type, obj, node, list) { ralloc_steal(mem_ctx, obj); }
 
-static void sweep_cf_node(nir_shader *nir, nir_cf_node *cf_node);
-
-static bool
-sweep_src_indirect(nir_src *src, void *nir)
-{
-   if (!src->is_ssa && src->reg.indirect)
-      ralloc_steal(nir, src->reg.indirect);
-
-   return true;
-}
-
-static bool
-sweep_dest_indirect(nir_dest *dest, void *nir)
-{
-   if (!dest->is_ssa && dest->reg.indirect)
-      ralloc_steal(nir, dest->reg.indirect);
-
-   return true;
-}
-
+/* The clone puts the live sources and destinations back. */
 static void
-sweep_block(nir_shader *nir, nir_block *block)
+reset_reg_list(struct exec_list *list)
 {
-   ralloc_steal(nir, block);
-
-   nir_foreach_instr(instr, block) {
-      ralloc_steal(nir, instr);
-
-      nir_foreach_src(instr, sweep_src_indirect, nir);
-      nir_foreach_dest(instr, sweep_dest_indirect, nir);
-   }
-}
-
-static void
-sweep_if(nir_shader *nir, nir_if *iff)
-{
-   ralloc_steal(nir, iff);
-
-   foreach_list_typed(nir_cf_node, cf_node, node, &iff->then_list) {
-      sweep_cf_node(nir, cf_node);
-   }
-
-   foreach_list_typed(nir_cf_node, cf_node, node, &iff->else_list) {
-      sweep_cf_node(nir, cf_node);
-   }
-}
-
-static void
-sweep_loop(nir_shader *nir, nir_loop *loop)
-{
-   ralloc_steal(nir, loop);
-
-   foreach_list_typed(nir_cf_node, cf_node, node, &loop->body) {
-      sweep_cf_node(nir, cf_node);
-   }
-}
-
-static void
-sweep_cf_node(nir_shader *nir, nir_cf_node *cf_node)
-{
-   switch (cf_node->type) {
-   case nir_cf_node_block:
-      sweep_block(nir, nir_cf_node_as_block(cf_node));
-      break;
-   case nir_cf_node_if:
-      sweep_if(nir, nir_cf_node_as_if(cf_node));
-      break;
-   case nir_cf_node_loop:
-      sweep_loop(nir, nir_cf_node_as_loop(cf_node));
-      break;
-   default:
-      unreachable("Invalid CF node type");
+   foreach_list_typed(nir_register, reg, node, list) {
+      list_inithead(&reg->uses);
+      list_inithead(&reg->defs);
+      list_inithead(&reg->if_uses);
    }
 }
 
@@ -124,12 +66,19 @@ sweep_impl(nir_shader *nir, nir_function_impl *impl)
    ralloc_steal(nir, impl->return_var);
    steal_list(nir, nir_variable, &impl->locals);
    steal_list(nir, nir_register, &impl->registers);
+   reset_reg_list(&impl->registers);
 
-   foreach_list_typed(nir_cf_node, cf_node, node, &impl->body) {
-      sweep_cf_node(nir, cf_node);
-   }
+   /* Move the new body over, the old one is part of the rubbish. */
+   nir_function_impl *clone = nir_function_impl_clone_body(impl);
+
+   exec_list_move_nodes_to(&clone->body, &impl->body);
+   foreach_list_typed(nir_cf_node, cf_node, node, &impl->body)
+      cf_node->parent = &impl->cf_node;
 
-   sweep_block(nir, impl->end_block);
+   impl->end_block = clone->end_block;
+   impl->end_block->cf_node.parent = &impl->cf_node;
+
+   ralloc_free(clone);
 
    /* Wipe out all the metadata, if any. */
    nir_metadata_preserve(impl, nir_metadata_none);
@@ -165,6 +114,10 @@ nir_sweep(nir_shader *nir)
    steal_list(nir, nir_variable, &nir->globals);
    steal_list(nir, nir_variable, &nir->system_values);
    steal_list(nir, nir_register, &nir->registers);
+   reset_reg_list(&nir->registers);
+
+   /* The live control flow and instructions move to a new arena. */
+   nir->arena = ralloc_arena_size(nir, 0);
 
    /* Recurse into functions, stealing their contents back. */
    foreach_list_typed(nir_function, func, node, &nir->functions) {
@@ -0,0 +1,322 @@
+/*
+ * Copyright © 2026 The Mesa Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Not a test, measures nir_opt_algebraic on random shaders.
+ *
+ * Each shader is a sequence of random float, integer and boolean ALU
+ * instructions, cut by small if/else blocks.  They mostly use the values
+ * computed just before and constants that the optimizations look for, so
+ * that many of the search patterns come close to matching.
+ *
+ * Usage: algebraic_bench [num_shaders [instructions_per_shader]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "nir.h"
+#include "nir_builder.h"
+#include "util/os_time.h"
+
+enum bench_type {
+   BENCH_FLOAT,
+   BENCH_INT,
+   BENCH_BOOL,
+   BENCH_NUM_TYPES,
+};
+
+#define POOL_SIZE 64
+
+/* Values available as sources, by type and by vector or scalar. */
+struct bench_pools {
+   nir_ssa_def *defs[BENCH_NUM_TYPES][2][POOL_SIZE];
+   unsigned count[BENCH_NUM_TYPES][2];
+};
+
+struct bench_op {
+   nir_op op;
+   enum bench_type dst;
+   enum bench_type src[3];
+};
+
+static const struct bench_op bench_ops[] = {
+   { nir_op_fadd, BENCH_FLOAT, { BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_fadd, BENCH_FLOAT, { BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_fmul, BENCH_FLOAT, { BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_fmul, BENCH_FLOAT, { BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_fsub, BENCH_FLOAT, { BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_fmin, BENCH_FLOAT, { BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_fmax, BENCH_FLOAT, { BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_fdiv, BENCH_FLOAT, { BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_fpow, BENCH_FLOAT, { BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_ffma, BENCH_FLOAT, { BENCH_FLOAT, BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_flrp, BENCH_FLOAT, { BENCH_FLOAT, BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_fneg, BENCH_FLOAT, { BENCH_FLOAT } },
+   { nir_op_fneg, BENCH_FLOAT, { BENCH_FLOAT } },
+   { nir_op_fabs, BENCH_FLOAT, { BENCH_FLOAT } },
+   { nir_op_fsat, BENCH_FLOAT, { BENCH_FLOAT } },
+   { nir_op_frcp, BENCH_FLOAT, { BENCH_FLOAT } },
+   { nir_op_frsq, BENCH_FLOAT, { BENCH_FLOAT } },
+   { nir_op_fsqrt, BENCH_FLOAT, { BENCH_FLOAT } },
+   { nir_op_fexp2, BENCH_FLOAT, { BENCH_FLOAT } },
+   { nir_op_flog2, BENCH_FLOAT, { BENCH_FLOAT } },
+   { nir_op_ffloor, BENCH_FLOAT, { BENCH_FLOAT } },
+   { nir_op_ffract, BENCH_FLOAT, { BENCH_FLOAT } },
+   { nir_op_fsign, BENCH_FLOAT, { BENCH_FLOAT } },
+   { nir_op_b2f, BENCH_FLOAT, { BENCH_BOOL } },
+   { nir_op_i2f32, BENCH_FLOAT, { BENCH_INT } },
+   { nir_op_bcsel, BENCH_FLOAT, { BENCH_BOOL, BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_iadd, BENCH_INT, { BENCH_INT, BENCH_INT } },
+   { nir_op_imul, BENCH_INT, { BENCH_INT, BENCH_INT } },
+   { nir_op_isub, BENCH_INT, { BENCH_INT, BENCH_INT } },
+   { nir_op_iand, BENCH_INT, { BENCH_INT, BENCH_INT } },
+   { nir_op_ior, BENCH_INT, { BENCH_INT, BENCH_INT } },
+   { nir_op_ixor, BENCH_INT, { BENCH_INT, BENCH_INT } },
+   { nir_op_ishl, BENCH_INT, { BENCH_INT, BENCH_INT } },
+   { nir_op_ushr, BENCH_INT, { BENCH_INT, BENCH_INT } },
+   { nir_op_imin, BENCH_INT, { BENCH_INT, BENCH_INT } },
+   { nir_op_imax, BENCH_INT, { BENCH_INT, BENCH_INT } },
+   { nir_op_udiv, BENCH_INT, { BENCH_INT, BENCH_INT } },
+   { nir_op_ineg, BENCH_INT, { BENCH_INT } },
+   { nir_op_iabs, BENCH_INT, { BENCH_INT } },
+   { nir_op_inot, BENCH_INT, { BENCH_INT } },
+   { nir_op_b2i, BENCH_INT, { BENCH_BOOL } },
+   { nir_op_f2i32, BENCH_INT, { BENCH_FLOAT } },
+   { nir_op_bcsel, BENCH_INT, { BENCH_BOOL, BENCH_INT, BENCH_INT } },
+   { nir_op_flt, BENCH_BOOL, { BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_fge, BENCH_BOOL, { BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_feq, BENCH_BOOL, { BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_fne, BENCH_BOOL, { BENCH_FLOAT, BENCH_FLOAT } },
+   { nir_op_ilt, BENCH_BOOL, { BENCH_INT, BENCH_INT } },
+   { nir_op_ige, BENCH_BOOL, { BENCH_INT, BENCH_INT } },
+   { nir_op_ieq, BENCH_BOOL, { BENCH_INT, BENCH_INT } },
+   { nir_op_ine, BENCH_BOOL, { BENCH_INT, BENCH_INT } },
+   { nir_op_iand, BENCH_BOOL, { BENCH_BOOL, BENCH_BOOL } },
+   { nir_op_ior, BENCH_BOOL, { BENCH_BOOL, BENCH_BOOL } },
+   { nir_op_inot, BENCH_BOOL, { BENCH_BOOL } },
+   { nir_op_bcsel, BENCH_BOOL, { BENCH_BOOL, BENCH_BOOL, BENCH_BOOL } },
+};
+
+static const float bench_floats[] = { 0.0f, 1.0f, -1.0f, 2.0f, 0.5f, 3.0f };
+static const int bench_ints[] = { 0, 1, -1, 2, 4, 8, 31, 0xff };
+
+static void
+add_to_pool(struct bench_pools *p, enum bench_type type, nir_ssa_def *def)
+{
+   unsigned vec = def->num_components > 1;
+   unsigned n = p->count[type][vec]++;
+
+   p->defs[type][vec][n % POOL_SIZE] = def;
+}
+
+static nir_ssa_def *
+make_const(nir_builder *b, enum bench_type type, unsigned num_components)
+{
+   nir_const_value v;
+
+   memset(&v, 0, sizeof(v));
+   for (unsigned i = 0; i < num_components; i++) {
+      switch (type) {
+      case BENCH_FLOAT:
+         v.f32[i] = bench_floats[rand() % ARRAY_SIZE(bench_floats)];
+         break;
+      case BENCH_INT:
+         v.i32[i] = bench_ints[rand() % ARRAY_SIZE(bench_ints)];
+         break;
+      default:
+         v.u32[i] = rand() % 2 ? NIR_TRUE : NIR_FALSE;
+         break;
+      }
+   }
+
+   return nir_build_imm(b, num_components, 32, v);
+}
+
+/* Mostly one of the last few values, for deep expression trees. */
+static nir_ssa_def *
+pick_src(nir_builder *b, struct bench_pools *p, enum bench_type type,
+         unsigned num_components)
+{
+   unsigned vec = num_components > 1;
+   unsigned count = p->count[type][vec];
+   unsigned r = rand() % 16;
+
+   if (count == 0 || r < 3)
+      return make_const(b, type, num_components);
+
+   unsigned window = MIN2(count, r < 13 ? 4 : POOL_SIZE);
+   return p->defs[type][vec][(count - 1 - rand() % window) % POOL_SIZE];
+}
+
+static void
+build_block(nir_builder *b, struct bench_pools *p, unsigned num_instrs)
+{
+   for (unsigned i = 0; i < num_instrs; i++) {
+      const struct bench_op *op = &bench_ops[rand() % ARRAY_SIZE(bench_ops)];
+      unsigned num_components = rand() % 4 == 0 ? 4 : 1;
+      nir_ssa_def *srcs[3] = { NULL };
+
+      for (unsigned s = 0; s < nir_op_infos[op->op].num_inputs; s++)
+         srcs[s] = pick_src(b, p, op->src[s], num_components);
+
+      add_to_pool(p, op->dst,
+                  nir_build_alu(b, op->op, srcs[0], srcs[1], srcs[2], NULL));
+
+      /* Some reductions and vector building, for the patterns on them. */
+      if (rand() % 16 == 0 && p->count[BENCH_FLOAT][1]) {
+         nir_ssa_def *a = pick_src(b, p, BENCH_FLOAT, 4);
+         add_to_pool(p, BENCH_FLOAT,
+                     nir_fdot4(b, a, pick_src(b, p, BENCH_FLOAT, 4)));
+      } else if (rand() % 16 == 0) {
+         nir_ssa_def *comps[4];
+         for (unsigned c = 0; c < 4; c++)
+            comps[c] = pick_src(b, p, BENCH_FLOAT, 1);
+         add_to_pool(p, BENCH_FLOAT, nir_vec(b, comps, 4));
+      }
+   }
+}
+
+static nir_shader *
+build_shader(void *mem_ctx, const nir_shader_compiler_options *options,
+             unsigned num_instrs)
+{
+   struct bench_pools p;
+   nir_builder b;
+
+   memset(&p, 0, sizeof(p));
+   nir_builder_init_simple_shader(&b, mem_ctx, MESA_SHADER_FRAGMENT, options);
+
+   for (enum bench_type t = 0; t < BENCH_NUM_TYPES; t++) {
+      for (unsigned i = 0; i < 4; i++) {
+         add_to_pool(&p, t, nir_ssa_undef(&b, 1, 32));
+         add_to_pool(&p, t, nir_ssa_undef(&b, 4, 32));
+      }
+   }
+
+   for (unsigned done = 0; done < num_instrs;) {
+      unsigned block_size = MIN2(num_instrs - done, 16 + rand() % 48);
+      nir_ssa_def *cond, *then_def, *else_def;
+      struct bench_pools p_then, p_else;
+
+      build_block(&b, &p, block_size - block_size / 4 * 2);
+      cond = pick_src(&b, &p, BENCH_BOOL, 1);
+
+      /* Values from inside the branches are only used there and through
+       * the phi after them.
+       */
+      p_then = p_else = p;
+
+      nir_push_if(&b, cond);
+      build_block(&b, &p_then, block_size / 4);
+      then_def = pick_src(&b, &p_then, BENCH_FLOAT, 1);
+      nir_push_else(&b, NULL);
+      build_block(&b, &p_else, block_size / 4);
+      else_def = pick_src(&b, &p_else, BENCH_FLOAT, 1);
+      nir_pop_if(&b, NULL);
+
+      add_to_pool(&p, BENCH_FLOAT, nir_if_phi(&b, then_def, else_def));
+      done += block_size;
+   }
+
+   return b.shader;
+}
+
+static unsigned
+count_instrs(nir_shader *shader)
+{
+   unsigned count = 0;
+
+   nir_foreach_function(function, shader) {
+      if (!function->impl)
+         continue;
+
+      nir_foreach_block(block, function->impl) {
+         nir_foreach_instr(instr, block)
+            count++;
+      }
+   }
+
+   return count;
+}
+
+/* The usual optimization loop, only the algebraic passes being timed.
+ * Some patterns undo each other, like the ones turning ige(imin(a, b), c)
+ * into iand(ige(a, c), ige(b, c)) and back, so the loop may not end by
+ * itself on random code.
+ */
+#define MAX_ROUNDS 16
+
+static int64_t
+run_passes(nir_shader *shader)
+{
+   int64_t elapsed = 0, start;
+   unsigned rounds = 0;
+   bool progress;
+
+   do {
+      progress = nir_copy_prop(shader);
+      progress |= nir_opt_dce(shader);
+
+      start = os_time_get_nano();
+      progress |= nir_opt_algebraic(shader);
+      elapsed += os_time_get_nano() - start;
+   } while (progress && ++rounds < MAX_ROUNDS);
+
+   start = os_time_get_nano();
+   nir_opt_algebraic_late(shader);
+   elapsed += os_time_get_nano() - start;
+
+   return elapsed;
+}
+
+int
+main(int argc, char **argv)
+{
+   static const nir_shader_compiler_options options = {
+      .lower_fdiv = true,
+      .lower_fsat = true,
+      .lower_scmp = true,
+   };
+   unsigned num_shaders = argc > 1 ? atoi(argv[1]) : 200;
+   unsigned num_instrs = argc > 2 ? atoi(argv[2]) : 2000;
+   uint64_t total_instrs = 0;
+   int64_t elapsed = 0;
+
+   srand(1);
+
+   for (unsigned i = 0; i < num_shaders; i++) {
+      void *mem_ctx = ralloc_context(NULL);
+      nir_shader *shader = build_shader(mem_ctx, &options, num_instrs);
+
+      total_instrs += count_instrs(shader);
+      elapsed += run_passes(shader);
+
+      ralloc_free(mem_ctx);
+   }
+
+   printf("%u shaders, %"PRIu64" instructions: %.2f ms, %.2f ns/instr\n",
+          num_shaders, total_instrs, elapsed / 1000000.0,
+          (double)elapsed / total_instrs);
+
+   return EXIT_SUCCESS;
+}
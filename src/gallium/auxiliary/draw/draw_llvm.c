@@ -57,6 +57,7 @@
 #include "util/u_pointer.h"
 #include "util/u_string.h"
 #include "util/simple_list.h"
+#include "util/hash_table.h"
 
 
 #define DEBUG_STORE 0
@@ -1961,6 +1962,38 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant)
 }
 
 
+/**
+ * Size of a key, which is the same for all the variants of a shader
+ * (see llvm_vertex_shader::variant_key_size).
+ */
+static inline size_t
+variant_key_size(const struct draw_llvm_variant_key *key)
+{
+   return draw_llvm_variant_key_size(key->nr_vertex_elements,
+                                     MAX2(key->nr_samplers,
+                                          key->nr_sampler_views));
+}
+
+
+/**
+ * Hash and compare functions for tables of variants indexed by key.
+ */
+uint32_t
+draw_llvm_variant_key_hash(const void *key)
+{
+   return _mesa_hash_data(key, variant_key_size(key));
+}
+
+
+bool
+draw_llvm_variant_key_equal(const void *a, const void *b)
+{
+   size_t size = variant_key_size(a);
+
+   return size == variant_key_size(b) && memcmp(a, b, size) == 0;
+}
+
+
 struct draw_llvm_variant_key *
 draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store)
 {
@@ -2164,6 +2197,9 @@ draw_llvm_destroy_variant(struct draw_llvm_variant *variant)
    gallivm_destroy(variant->gallivm);
 
    remove_from_list(&variant->list_item_local);
+   _mesa_hash_table_remove(variant->shader->variants_ht,
+                           _mesa_hash_table_search(variant->shader->variants_ht,
+                                                   &variant->key));
    variant->shader->variants_cached--;
    remove_from_list(&variant->list_item_global);
    llvm->nr_variants--;
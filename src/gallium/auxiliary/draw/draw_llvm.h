@@ -43,6 +43,7 @@
 struct draw_llvm;
 struct llvm_vertex_shader;
 struct llvm_geometry_shader;
+struct hash_table;
 
 struct draw_jit_texture
 {
@@ -423,6 +424,7 @@ struct llvm_vertex_shader {
 
    unsigned variant_key_size;
    struct draw_llvm_variant_list_item variants;
+   struct hash_table *variants_ht;  /**< same variants, indexed by key */
    unsigned variants_created;
    unsigned variants_cached;
 };
@@ -486,6 +488,12 @@ draw_llvm_destroy_variant(struct draw_llvm_variant *variant);
 struct draw_llvm_variant_key *
 draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store);
 
+uint32_t
+draw_llvm_variant_key_hash(const void *key);
+
+bool
+draw_llvm_variant_key_equal(const void *a, const void *b);
+
 void
 draw_llvm_dump_variant_key(struct draw_llvm_variant_key *key);
 
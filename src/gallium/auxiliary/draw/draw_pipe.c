@@ -34,6 +34,7 @@
 #include "draw/draw_pipe.h"
 #include "util/u_debug.h"
 #include "util/u_math.h"
+#include "util/u_memory.h"
 
 
 
@@ -105,6 +106,8 @@ void draw_pipeline_destroy( struct draw_context *draw )
       draw->pipeline.pstipple->destroy( draw->pipeline.pstipple );
    if (draw->pipeline.rasterize)
       draw->pipeline.rasterize->destroy( draw->pipeline.rasterize );
+
+   FREE( draw->pipeline.cull_elts );
 }
 
 
@@ -210,6 +213,134 @@ static void do_triangle( struct draw_context *draw,
 #include "draw_pt_decompose.h"
 
 
+/**
+ * Number of triangles tested together by cull_triangles().
+ */
+#define CULL_BATCH 8
+
+
+/**
+ * Whether the triangles of a list should go through cull_triangles()
+ * before being handed one by one to the pipeline.
+ */
+static inline boolean
+need_cull_triangles( const struct draw_context *draw, unsigned prim )
+{
+   return prim == PIPE_PRIM_TRIANGLES &&
+          (draw->clip_xy || draw->clip_z || draw->clip_user ||
+           draw->rasterizer->cull_face != PIPE_FACE_NONE);
+}
+
+
+/**
+ * Drop from a list of triangles the ones which the clip and cull stages
+ * would discard: the triangles with all their vertices outside of a same
+ * clip plane, and the unclipped ones facing the culled way.  Those two
+ * stages are always the first ones of the pipeline, so the triangles left
+ * take the same path through it as before.
+ *
+ * The triangles are gathered in batches, then tested with loops over the
+ * batch which the compiler can vectorize, instead of going down the stage
+ * functions one at a time.
+ *
+ * \param elts  element list, or NULL for linear vertices
+ * \param count  number of elements, returns the number of them left
+ * \return elements of the triangles left, or NULL if out of memory
+ */
+static const ushort *
+cull_triangles( struct draw_context *draw,
+                const struct vertex_header *vertices,
+                unsigned stride,
+                const ushort *elts,
+                unsigned *count,
+                unsigned max_index )
+{
+   const char *verts = (const char *) vertices;
+   const unsigned pos = draw_current_shader_position_output(draw);
+   const boolean clip = draw->clip_xy || draw->clip_z || draw->clip_user;
+   const unsigned cull_face = draw->rasterizer->cull_face;
+   const unsigned front_ccw = draw->rasterizer->front_ccw;
+   ushort *out;
+   const unsigned num_elts = *count - *count % 3;
+   unsigned i, j, k, n = 0;
+
+   if (num_elts > draw->pipeline.cull_elts_size) {
+      FREE( draw->pipeline.cull_elts );
+      draw->pipeline.cull_elts = MALLOC( num_elts * sizeof(ushort) );
+      if (!draw->pipeline.cull_elts) {
+         draw->pipeline.cull_elts_size = 0;
+         return NULL;
+      }
+      draw->pipeline.cull_elts_size = num_elts;
+   }
+   out = draw->pipeline.cull_elts;
+
+   for (i = 0; i < num_elts; i += 3 * CULL_BATCH) {
+      const unsigned num = MIN2(CULL_BATCH, (num_elts - i) / 3);
+      ushort idx[CULL_BATCH][3];
+      unsigned or_mask[CULL_BATCH], and_mask[CULL_BATCH];
+      float ex[CULL_BATCH], ey[CULL_BATCH], fx[CULL_BATCH], fy[CULL_BATCH];
+      boolean keep[CULL_BATCH];
+
+      /* Gather, padding the batch with unclipped zero area triangles.
+       */
+      for (j = 0; j < CULL_BATCH; j++) {
+         const struct vertex_header *v[3];
+
+         if (j >= num) {
+            or_mask[j] = and_mask[j] = 0;
+            ex[j] = ey[j] = fx[j] = fy[j] = 0.0f;
+            continue;
+         }
+
+         for (k = 0; k < 3; k++) {
+            idx[j][k] = elts ? MIN2(elts[i + 3 * j + k], max_index) :
+                               i + 3 * j + k;
+            v[k] = (const struct vertex_header *)(verts + stride * idx[j][k]);
+         }
+
+         or_mask[j] = v[0]->clipmask | v[1]->clipmask | v[2]->clipmask;
+         and_mask[j] = v[0]->clipmask & v[1]->clipmask & v[2]->clipmask;
+
+         /* edge vectors as in the cull stage: e = v0 - v2, f = v1 - v2 */
+         ex[j] = v[0]->data[pos][0] - v[2]->data[pos][0];
+         ey[j] = v[0]->data[pos][1] - v[2]->data[pos][1];
+         fx[j] = v[1]->data[pos][0] - v[2]->data[pos][0];
+         fy[j] = v[1]->data[pos][1] - v[2]->data[pos][1];
+      }
+
+      /* Test.  Window coordinates are only valid for unclipped triangles,
+       * the other ones are left to the clip stage.  A zero area triangle
+       * is back facing, like in the cull stage.
+       */
+      for (j = 0; j < CULL_BATCH; j++) {
+         const float det = ex[j] * fy[j] - ey[j] * fx[j];
+         const unsigned face =
+            (det != 0 && (det < 0) == front_ccw) ? PIPE_FACE_FRONT :
+                                                   PIPE_FACE_BACK;
+
+         if (or_mask[j])
+            keep[j] = !clip || and_mask[j] == 0;
+         else
+            keep[j] = (face & cull_face) == 0;
+      }
+
+      /* Compact the triangles left.
+       */
+      for (j = 0; j < num; j++) {
+         if (keep[j]) {
+            out[n + 0] = idx[j][0];
+            out[n + 1] = idx[j][1];
+            out[n + 2] = idx[j][2];
+            n += 3;
+         }
+      }
+   }
+
+   *count = n;
+   return out;
+}
+
 
 /**
  * Code to run the pipeline on a fairly arbitrary collection of vertices.
@@ -258,6 +389,27 @@ void draw_pipeline_run( struct draw_context *draw,
       }
 #endif
 
+      if (need_cull_triangles(draw, prim_info->prim)) {
+         unsigned left = count;
+         const ushort *elts = cull_triangles(draw,
+                                             vert_info->verts,
+                                             vert_info->stride,
+                                             prim_info->elts + start,
+                                             &left,
+                                             vert_info->count - 1);
+         if (elts) {
+            pipe_run_elts(draw,
+                          prim_info->prim,
+                          prim_info->flags,
+                          vert_info->verts,
+                          vert_info->stride,
+                          elts,
+                          left,
+                          vert_info->count - 1);
+            continue;
+         }
+      }
+
       pipe_run_elts(draw,
                     prim_info->prim,
                     prim_info->flags,
@@ -330,6 +482,29 @@ void draw_pipeline_run_linear( struct draw_context *draw,
 
       assert(count <= vert_info->count);
 
+      /* The triangles left are drawn by element, which are 16 bits. */
+      if (need_cull_triangles(draw, prim_info->prim) &&
+          count <= UNDEFINED_VERTEX_ID) {
+         unsigned left = count;
+         const ushort *elts = cull_triangles(draw,
+                                             (struct vertex_header*)verts,
+                                             vert_info->stride,
+                                             NULL,
+                                             &left,
+                                             count - 1);
+         if (elts) {
+            pipe_run_elts(draw,
+                          prim_info->prim,
+                          prim_info->flags,
+                          (struct vertex_header*)verts,
+                          vert_info->stride,
+                          elts,
+                          left,
+                          count - 1);
+            continue;
+         }
+      }
+
       pipe_run_linear(draw,
                       prim_info->prim,
                       prim_info->flags,
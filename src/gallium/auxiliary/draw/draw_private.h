@@ -144,6 +144,10 @@ struct draw_context
       char *verts;
       unsigned vertex_stride;
       unsigned vertex_count;
+
+      /* Elements of the triangles left by draw_pipe.c's batched culling */
+      ushort *cull_elts;
+      unsigned cull_elts_size;
    } pipeline;
 
 
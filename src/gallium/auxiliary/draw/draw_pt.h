@@ -124,6 +124,14 @@ struct draw_pt_middle_end {
 
    int (*get_max_vertex_count)( struct draw_pt_middle_end * );
 
+   /**
+    * Optional.  Called at the end of each draw, for middle ends which
+    * keep processing vertices after the run functions returned: they
+    * have to be done with the vertex and index buffers of the draw and
+    * have sent all its primitives down the pipeline.
+    */
+   void (*flush)( struct draw_pt_middle_end * );
+
    void (*finish)( struct draw_pt_middle_end * );
    void (*destroy)( struct draw_pt_middle_end * );
 };
@@ -25,9 +25,13 @@
  *
  **************************************************************************/
 
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "util/u_queue.h"
+#include "util/hash_table.h"
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
 #include "draw/draw_vbuf.h"
@@ -40,6 +44,50 @@
 #include "gallivm/lp_bld_debug.h"
 
 
+/* Most worker threads fetching and shading vertices, by default. */
+#define LLVM_MAX_THREADS 4
+
+/* Most segments of a draw shaded ahead of the rest of the pipeline. */
+#define LLVM_MAX_SEGMENTS (2 * LLVM_MAX_THREADS + 2)
+
+
+struct llvm_middle_end;
+
+/**
+ * A chunk of a draw, as given to one of the run functions by the frontend.
+ * The vertices are fetched and shaded with the jit function of the vertex
+ * shader, then go through the rest of the pipeline (geometry shader, stream
+ * output, clipping and emit), which has to see the segments in order.
+ */
+struct llvm_segment {
+   struct llvm_middle_end *fpme;
+
+   struct draw_fetch_info fetch_info;
+   struct draw_prim_info prim_info;
+   struct draw_vertex_info vert_info;
+   unsigned primitive_length;
+
+   /* jit function arguments which don't come from the middle end */
+   unsigned start_or_maxelt;
+   unsigned vid_base;
+   unsigned instance_id;
+   unsigned start_instance;
+
+   boolean clipped;
+
+   /* When queued: set once the vertices are shaded. */
+   struct util_queue_fence fence;
+   boolean queued;
+   unsigned fpstate;
+
+   /* Copies of the elements, the frontend reuses its buffers. */
+   unsigned *fetch_elts;
+   unsigned fetch_elts_size;
+   ushort *draw_elts;
+   unsigned draw_elts_size;
+};
+
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -57,6 +105,18 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   /* Segments of the current draw waiting for the rest of the pipeline,
+    * in a ring starting at first_segment.  Only used with worker threads,
+    * created on the first draw made of several segments.
+    */
+   struct llvm_segment segments[LLVM_MAX_SEGMENTS];
+   unsigned first_segment;
+   unsigned num_segments;
+   unsigned max_segments;
+
+   unsigned num_threads;
+   struct util_queue queue;
 };
 
 
@@ -205,22 +265,20 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
    {
       struct draw_llvm_variant_key *key;
       struct draw_llvm_variant *variant = NULL;
-      struct draw_llvm_variant_list_item *li;
       struct llvm_vertex_shader *shader = llvm_vertex_shader(vs);
       char store[DRAW_LLVM_MAX_VARIANT_KEY_SIZE];
+      struct hash_entry *entry;
+      uint32_t key_hash;
       unsigned i;
 
       key = draw_llvm_make_variant_key(llvm, store);
 
-      /* Search shader's list of variants for the key */
-      li = first_elem(&shader->variants);
-      while (!at_end(&shader->variants, li)) {
-         if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
-            variant = li->base;
-            break;
-         }
-         li = next_elem(li);
-      }
+      /* Look up the shader's variant for the key */
+      key_hash = draw_llvm_variant_key_hash(key);
+      entry = _mesa_hash_table_search_pre_hashed(shader->variants_ht,
+                                                 key_hash, key);
+      if (entry)
+         variant = entry->data;
 
       if (variant) {
          /* found the variant, move to head of global list (for LRU) */
@@ -257,6 +315,8 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
 
          if (variant) {
             insert_at_head(&shader->variants, &variant->list_item_local);
+            _mesa_hash_table_insert_pre_hashed(shader->variants_ht, key_hash,
+                                               &variant->key, variant);
             insert_at_head(&llvm->vs_variants_list,
                            &variant->list_item_global);
             llvm->nr_variants++;
@@ -347,37 +407,32 @@ emit(struct pt_emit *emit,
 }
 
 
-static void
-llvm_pipeline_generic(struct draw_pt_middle_end *middle,
-                      const struct draw_fetch_info *fetch_info,
-                      const struct draw_prim_info *in_prim_info)
+/**
+ * Set up the vertex info of a segment and the jit function arguments which
+ * depend on the current draw.
+ */
+static boolean
+llvm_segment_init(struct llvm_middle_end *fpme,
+                  struct llvm_segment *seg,
+                  const struct draw_fetch_info *fetch_info,
+                  const struct draw_prim_info *prim_info)
 {
-   struct llvm_middle_end *fpme = llvm_middle_end(middle);
    struct draw_context *draw = fpme->draw;
-   struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
-   struct draw_prim_info gs_prim_info;
-   struct draw_vertex_info llvm_vert_info;
-   struct draw_vertex_info gs_vert_info;
-   struct draw_vertex_info *vert_info;
-   struct draw_prim_info ia_prim_info;
-   struct draw_vertex_info ia_vert_info;
-   const struct draw_prim_info *prim_info = in_prim_info;
-   boolean free_prim_info = FALSE;
-   unsigned opt = fpme->opt;
-   boolean clipped = 0;
-   unsigned start_or_maxelt, vid_base;
-   const unsigned *elts;
 
    assert(fetch_info->count > 0);
-   llvm_vert_info.count = fetch_info->count;
-   llvm_vert_info.vertex_size = fpme->vertex_size;
-   llvm_vert_info.stride = fpme->vertex_size;
-   llvm_vert_info.verts = (struct vertex_header *)
+   seg->fpme = fpme;
+   seg->fetch_info = *fetch_info;
+   seg->prim_info = *prim_info;
+
+   seg->vert_info.count = fetch_info->count;
+   seg->vert_info.vertex_size = fpme->vertex_size;
+   seg->vert_info.stride = fpme->vertex_size;
+   seg->vert_info.verts = (struct vertex_header *)
       MALLOC(fpme->vertex_size *
              align(fetch_info->count, lp_native_vector_width / 32));
-   if (!llvm_vert_info.verts) {
+   if (!seg->vert_info.verts) {
       assert(0);
-      return;
+      return FALSE;
    }
 
    if (draw->collect_statistics) {
@@ -388,31 +443,65 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
    }
 
    if (fetch_info->linear) {
-      start_or_maxelt = fetch_info->start;
-      vid_base = draw->start_index;
-      elts = NULL;
+      seg->start_or_maxelt = fetch_info->start;
+      seg->vid_base = draw->start_index;
    }
    else {
-      start_or_maxelt = draw->pt.user.eltMax;
-      vid_base = draw->pt.user.eltBias;
-      elts = fetch_info->elts;
+      seg->start_or_maxelt = draw->pt.user.eltMax;
+      seg->vid_base = draw->pt.user.eltBias;
    }
-   clipped = fpme->current_variant->jit_func(&fpme->llvm->jit_context,
-                                             llvm_vert_info.verts,
-                                             draw->pt.user.vbuffer,
-                                             fetch_info->count,
-                                             start_or_maxelt,
-                                             fpme->vertex_size,
-                                             draw->pt.vertex_buffer,
-                                             draw->instance_id,
-                                             vid_base,
-                                             draw->start_instance,
-                                             elts);
-
-   /* Finished with fetch and vs:
-    */
-   fetch_info = NULL;
-   vert_info = &llvm_vert_info;
+   seg->instance_id = draw->instance_id;
+   seg->start_instance = draw->start_instance;
+
+   return TRUE;
+}
+
+
+/**
+ * Fetch the vertices of a segment and run the vertex shader on them.
+ * This only reads state which doesn't change during a draw, so it can run
+ * on a worker thread.
+ */
+static void
+llvm_segment_fetch_shade(struct llvm_segment *seg)
+{
+   struct llvm_middle_end *fpme = seg->fpme;
+   struct draw_context *draw = fpme->draw;
+
+   seg->clipped =
+      fpme->current_variant->jit_func(&fpme->llvm->jit_context,
+                                      seg->vert_info.verts,
+                                      draw->pt.user.vbuffer,
+                                      seg->fetch_info.count,
+                                      seg->start_or_maxelt,
+                                      fpme->vertex_size,
+                                      draw->pt.vertex_buffer,
+                                      seg->instance_id,
+                                      seg->vid_base,
+                                      seg->start_instance,
+                                      seg->fetch_info.elts);
+}
+
+
+/**
+ * Send the shaded vertices of a segment through the rest of the pipeline
+ * and free them.
+ */
+static void
+llvm_segment_run_pipeline(struct llvm_segment *seg)
+{
+   struct llvm_middle_end *fpme = seg->fpme;
+   struct draw_context *draw = fpme->draw;
+   struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
+   struct draw_prim_info gs_prim_info;
+   struct draw_vertex_info gs_vert_info;
+   struct draw_vertex_info *vert_info = &seg->vert_info;
+   struct draw_prim_info ia_prim_info;
+   struct draw_vertex_info ia_vert_info;
+   const struct draw_prim_info *prim_info = &seg->prim_info;
+   boolean free_prim_info = FALSE;
+   unsigned opt = fpme->opt;
+   boolean clipped = seg->clipped;
 
    if ((opt & PT_SHADE) && gshader) {
       struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
@@ -486,6 +575,185 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
 }
 
 
+static void
+llvm_pipeline_generic(struct draw_pt_middle_end *middle,
+                      const struct draw_fetch_info *fetch_info,
+                      const struct draw_prim_info *prim_info)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   struct llvm_segment seg;
+
+   if (!llvm_segment_init(fpme, &seg, fetch_info, prim_info))
+      return;
+
+   llvm_segment_fetch_shade(&seg);
+   llvm_segment_run_pipeline(&seg);
+}
+
+
+static void
+llvm_segment_execute(void *job, int thread_index)
+{
+   struct llvm_segment *seg = (struct llvm_segment *) job;
+   unsigned fpstate = util_fpstate_get();
+
+   /* Same denorm handling as the thread calling draw_vbo(). */
+   util_fpstate_set(seg->fpstate);
+   llvm_segment_fetch_shade(seg);
+   util_fpstate_set(fpstate);
+}
+
+
+static boolean
+llvm_middle_end_init_queue(struct llvm_middle_end *fpme)
+{
+   if (util_queue_is_initialized(&fpme->queue))
+      return TRUE;
+
+   if (!util_queue_init(&fpme->queue, "draw_vs", LLVM_MAX_SEGMENTS,
+                        fpme->num_threads, 0)) {
+      fpme->num_threads = 0;
+      return FALSE;
+   }
+   return TRUE;
+}
+
+
+static void
+llvm_segment_queue(struct llvm_segment *seg)
+{
+   struct llvm_middle_end *fpme = seg->fpme;
+
+   seg->fpstate = util_fpstate_get();
+   seg->queued = TRUE;
+   util_queue_add_job(&fpme->queue, seg, &seg->fence,
+                      llvm_segment_execute, NULL);
+}
+
+
+/**
+ * Wait for the oldest pending segment to be shaded (or shade it if it
+ * wasn't queued) and send it down the pipeline.
+ */
+static void
+llvm_retire_segment(struct llvm_middle_end *fpme)
+{
+   struct llvm_segment *seg = &fpme->segments[fpme->first_segment];
+
+   assert(fpme->num_segments);
+   fpme->first_segment = (fpme->first_segment + 1) % LLVM_MAX_SEGMENTS;
+   fpme->num_segments--;
+
+   if (seg->queued) {
+      util_queue_fence_wait(&seg->fence);
+      seg->queued = FALSE;
+   }
+   else {
+      llvm_segment_fetch_shade(seg);
+   }
+
+   llvm_segment_run_pipeline(seg);
+}
+
+
+/**
+ * Same as llvm_pipeline_generic() but with the fetch and vertex shader
+ * running on the worker threads.  Segments are shaded in parallel and
+ * retired in order by the thread calling draw_vbo(), the last ones by
+ * llvm_middle_end_flush() at the end of the draw.
+ */
+static void
+llvm_pipeline_threaded(struct llvm_middle_end *fpme,
+                       const struct draw_fetch_info *fetch_info,
+                       const struct draw_prim_info *prim_info)
+{
+   struct llvm_segment *seg;
+   unsigned i;
+
+   while (fpme->num_segments == fpme->max_segments)
+      llvm_retire_segment(fpme);
+
+   i = (fpme->first_segment + fpme->num_segments) % LLVM_MAX_SEGMENTS;
+   seg = &fpme->segments[i];
+
+   if (!llvm_segment_init(fpme, seg, fetch_info, prim_info))
+      return;
+
+   if (!fetch_info->linear) {
+      if (seg->fetch_elts_size < fetch_info->count) {
+         FREE(seg->fetch_elts);
+         seg->fetch_elts = MALLOC(fetch_info->count * sizeof(unsigned));
+         seg->fetch_elts_size = seg->fetch_elts ? fetch_info->count : 0;
+      }
+      if (!seg->fetch_elts) {
+         FREE(seg->vert_info.verts);
+         return;
+      }
+      memcpy(seg->fetch_elts, fetch_info->elts,
+             fetch_info->count * sizeof(unsigned));
+      seg->fetch_info.elts = seg->fetch_elts;
+   }
+
+   if (!prim_info->linear) {
+      if (seg->draw_elts_size < prim_info->count) {
+         FREE(seg->draw_elts);
+         seg->draw_elts = MALLOC(prim_info->count * sizeof(ushort));
+         seg->draw_elts_size = seg->draw_elts ? prim_info->count : 0;
+      }
+      if (!seg->draw_elts) {
+         FREE(seg->vert_info.verts);
+         return;
+      }
+      memcpy(seg->draw_elts, prim_info->elts,
+             prim_info->count * sizeof(ushort));
+      seg->prim_info.elts = seg->draw_elts;
+   }
+
+   assert(prim_info->primitive_count == 1);
+   seg->primitive_length = prim_info->primitive_lengths[0];
+   seg->prim_info.primitive_lengths = &seg->primitive_length;
+
+   /* Draws made of a single segment are shaded on this thread when they
+    * are flushed, the first segment is only queued once there is a
+    * second one.
+    */
+   if (fpme->num_segments == 1 && !fpme->segments[fpme->first_segment].queued)
+      llvm_segment_queue(&fpme->segments[fpme->first_segment]);
+   if (fpme->num_segments >= 1)
+      llvm_segment_queue(seg);
+
+   fpme->num_segments++;
+
+   /* Send the segments which are ready down the pipeline while the next
+    * ones are being shaded.
+    */
+   while (fpme->num_segments > 1) {
+      struct llvm_segment *first = &fpme->segments[fpme->first_segment];
+
+      if (!util_queue_fence_is_signalled(&first->fence))
+         break;
+      llvm_retire_segment(fpme);
+   }
+}
+
+
+static void
+llvm_pipeline_run(struct llvm_middle_end *fpme,
+                  const struct draw_fetch_info *fetch_info,
+                  const struct draw_prim_info *prim_info)
+{
+   if (fpme->num_segments && !llvm_middle_end_init_queue(fpme)) {
+      while (fpme->num_segments)
+         llvm_retire_segment(fpme);
+   }
+
+   if (fpme->num_threads)
+      llvm_pipeline_threaded(fpme, fetch_info, prim_info);
+   else
+      llvm_pipeline_generic(&fpme->base, fetch_info, prim_info);
+}
+
+
 static inline unsigned
 prim_type(unsigned prim, unsigned flags)
 {
@@ -522,7 +790,7 @@ llvm_middle_end_run(struct draw_pt_middle_end *middle,
    prim_info.primitive_count = 1;
    prim_info.primitive_lengths = &draw_count;
 
-   llvm_pipeline_generic( middle, &fetch_info, &prim_info );
+   llvm_pipeline_run( fpme, &fetch_info, &prim_info );
 }
 
 
@@ -550,7 +818,7 @@ llvm_middle_end_linear_run(struct draw_pt_middle_end *middle,
    prim_info.primitive_count = 1;
    prim_info.primitive_lengths = &count;
 
-   llvm_pipeline_generic( middle, &fetch_info, &prim_info );
+   llvm_pipeline_run( fpme, &fetch_info, &prim_info );
 }
 
 
@@ -580,16 +848,26 @@ llvm_middle_end_linear_run_elts(struct draw_pt_middle_end *middle,
    prim_info.primitive_count = 1;
    prim_info.primitive_lengths = &draw_count;
 
-   llvm_pipeline_generic( middle, &fetch_info, &prim_info );
+   llvm_pipeline_run( fpme, &fetch_info, &prim_info );
 
    return TRUE;
 }
 
 
+static void
+llvm_middle_end_flush(struct draw_pt_middle_end *middle)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+
+   while (fpme->num_segments)
+      llvm_retire_segment(fpme);
+}
+
+
 static void
 llvm_middle_end_finish(struct draw_pt_middle_end *middle)
 {
-   /* nothing to do */
+   llvm_middle_end_flush(middle);
 }
 
 
@@ -597,6 +875,18 @@ static void
 llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
 {
    struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   unsigned i;
+
+   assert(fpme->num_segments == 0);
+
+   if (util_queue_is_initialized(&fpme->queue))
+      util_queue_destroy(&fpme->queue);
+
+   for (i = 0; i < LLVM_MAX_SEGMENTS; i++) {
+      util_queue_fence_destroy(&fpme->segments[i].fence);
+      FREE(fpme->segments[i].fetch_elts);
+      FREE(fpme->segments[i].draw_elts);
+   }
 
    if (fpme->fetch)
       draw_pt_fetch_destroy( fpme->fetch );
@@ -618,6 +908,7 @@ struct draw_pt_middle_end *
 draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 {
    struct llvm_middle_end *fpme = 0;
+   unsigned i;
 
    if (!draw->llvm)
       return NULL;
@@ -626,11 +917,15 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
    if (!fpme)
       goto fail;
 
+   for (i = 0; i < LLVM_MAX_SEGMENTS; i++)
+      util_queue_fence_init(&fpme->segments[i].fence);
+
    fpme->base.prepare         = llvm_middle_end_prepare;
    fpme->base.bind_parameters = llvm_middle_end_bind_parameters;
    fpme->base.run             = llvm_middle_end_run;
    fpme->base.run_linear      = llvm_middle_end_linear_run;
    fpme->base.run_linear_elts = llvm_middle_end_linear_run_elts;
+   fpme->base.flush           = llvm_middle_end_flush;
    fpme->base.finish          = llvm_middle_end_finish;
    fpme->base.destroy         = llvm_middle_end_destroy;
 
@@ -658,6 +953,15 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 
    fpme->current_variant = NULL;
 
+   /* The vertex shader runs on worker threads, the thread calling
+    * draw_vbo() keeps the rest of the pipeline busy.
+    */
+   fpme->num_threads =
+      debug_get_num_option("DRAW_THREADS",
+                           MIN2(util_cpu_caps.nr_cpus - 1, LLVM_MAX_THREADS));
+   fpme->num_threads = MIN2(fpme->num_threads, LLVM_MAX_THREADS);
+   fpme->max_segments = 2 * fpme->num_threads + 2;
+
    return &fpme->base;
 
  fail:
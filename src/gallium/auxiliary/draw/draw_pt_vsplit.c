@@ -23,19 +23,37 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 
 #include "draw/draw_context.h"
 #include "draw/draw_private.h"
 #include "draw/draw_pt.h"
+#include "draw/draw_vbuf.h"
 
-#define SEGMENT_SIZE 1024
-#define MAP_SIZE     256
+/* Default and largest number of vertices shaded per segment */
+#define SEGMENT_SIZE     1024
+#define MAX_SEGMENT_SIZE 4096
+
+/* Largest number of draw elements per segment */
+#define MAX_DRAW_ELTS    4096
+
+/* Largest cache, twice the largest segment so it's never over half full */
+#define MAX_CACHE_SIZE   (2 * MAX_SEGMENT_SIZE)
 
 /* The largest possible index within an index buffer */
 #define MAX_ELT_IDX 0xffffffff
 
+DEBUG_GET_ONCE_NUM_OPTION(draw_vertex_cache_size, "DRAW_VERTEX_CACHE_SIZE",
+                          SEGMENT_SIZE)
+
+struct vsplit_cache_entry {
+   unsigned fetch;
+   ushort draw;
+   ushort stamp;
+};
+
 struct vsplit_frontend {
    struct draw_pt_front_end base;
    struct draw_context *draw;
@@ -46,17 +64,25 @@ struct vsplit_frontend {
 
    unsigned max_vertices;
    ushort segment_size;
+   ushort max_draw_elts;
 
-   /* buffers for splitting */
-   unsigned fetch_elts[SEGMENT_SIZE];
-   ushort draw_elts[SEGMENT_SIZE];
-   ushort identity_draw_elts[SEGMENT_SIZE];
+   /* number of vertices a segment may shade, DRAW_VERTEX_CACHE_SIZE */
+   ushort cache_size;
 
+   /* buffers for splitting */
+   unsigned fetch_elts[MAX_SEGMENT_SIZE];
+   ushort draw_elts[MAX_DRAW_ELTS];
+   ushort identity_draw_elts[MAX_SEGMENT_SIZE];
+
+   /* Post-transform vertex cache of the current segment: a hash table with
+    * linear probing mapping a fetch element to a draw element.  Entries of
+    * an older segment have an older stamp, so that the cache doesn't need
+    * to be cleared for each segment.
+    */
    struct {
-      /* map a fetch element to a draw element */
-      unsigned fetches[MAP_SIZE];
-      ushort draws[MAP_SIZE];
-      boolean has_max_fetch;
+      struct vsplit_cache_entry entries[MAX_CACHE_SIZE];
+      unsigned mask;
+      ushort stamp;
 
       ushort num_fetch_elts;
       ushort num_draw_elts;
@@ -67,8 +93,10 @@ struct vsplit_frontend {
 static void
 vsplit_clear_cache(struct vsplit_frontend *vsplit)
 {
-   memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
-   vsplit->cache.has_max_fetch = FALSE;
+   if (++vsplit->cache.stamp == 0) {
+      memset(vsplit->cache.entries, 0, sizeof(vsplit->cache.entries));
+      vsplit->cache.stamp = 1;
+   }
    vsplit->cache.num_fetch_elts = 0;
    vsplit->cache.num_draw_elts = 0;
 }
@@ -87,23 +115,31 @@ vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 static inline void
 vsplit_add_cache(struct vsplit_frontend *vsplit, unsigned fetch)
 {
-   unsigned hash;
-
-   hash = fetch % MAP_SIZE;
+   struct vsplit_cache_entry *entry;
+   unsigned hash = fetch & vsplit->cache.mask;
 
-   /* If the value isn't in the cache or it's an overflow due to the
-    * element bias */
-   if (vsplit->cache.fetches[hash] != fetch) {
-      /* update cache */
-      vsplit->cache.fetches[hash] = fetch;
-      vsplit->cache.draws[hash] = vsplit->cache.num_fetch_elts;
-
-      /* add fetch */
-      assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
-      vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
+   /* Indices within a segment are usually close to each other, so they
+    * rarely collide without hashing.
+    */
+   for (;;) {
+      entry = &vsplit->cache.entries[hash];
+      if (entry->stamp != vsplit->cache.stamp)
+         break;
+      if (entry->fetch == fetch) {
+         vsplit->draw_elts[vsplit->cache.num_draw_elts++] = entry->draw;
+         return;
+      }
+      hash = (hash + 1) & vsplit->cache.mask;
    }
 
-   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = vsplit->cache.draws[hash];
+   /* add fetch */
+   assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
+   entry->fetch = fetch;
+   entry->draw = vsplit->cache.num_fetch_elts;
+   entry->stamp = vsplit->cache.stamp;
+   vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
+
+   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = entry->draw;
 }
 
 /**
@@ -125,12 +161,6 @@ vsplit_add_cache_ubyte(struct vsplit_frontend *vsplit, const ubyte *elts,
    unsigned elt_idx;
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* unlike the uint case this can only happen with elt_bias */
-   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -142,12 +172,6 @@ vsplit_add_cache_ushort(struct vsplit_frontend *vsplit, const ushort *elts,
    unsigned elt_idx;
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* unlike the uint case this can only happen with elt_bias */
-   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -167,13 +191,6 @@ vsplit_add_cache_uint(struct vsplit_frontend *vsplit, const uint *elts,
     */
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* Take care for DRAW_MAX_FETCH_IDX (since cache is initialized to -1). */
-   if (elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      /* force update - any value will do except DRAW_MAX_FETCH_IDX */
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -228,7 +245,16 @@ static void vsplit_prepare(struct draw_pt_front_end *frontend,
    vsplit->middle = middle;
    middle->prepare(middle, vsplit->prim, opt, &vsplit->max_vertices);
 
-   vsplit->segment_size = MIN2(SEGMENT_SIZE, vsplit->max_vertices);
+   /* Segments may reference their vertices several times, as long as the
+    * backend can draw that many elements at once.
+    */
+   vsplit->max_draw_elts = MIN2(vsplit->max_vertices, MAX_DRAW_ELTS);
+   if (vsplit->draw->render)
+      vsplit->max_draw_elts = MIN2(vsplit->max_draw_elts,
+                                   vsplit->draw->render->max_indices);
+
+   vsplit->segment_size = MIN2(vsplit->cache_size, vsplit->max_draw_elts);
+   vsplit->cache.mask = util_next_power_of_two(2 * vsplit->segment_size) - 1;
 }
 
 
@@ -263,7 +289,10 @@ struct draw_pt_front_end *draw_pt_vsplit(struct draw_context *draw)
    vsplit->base.destroy = vsplit_destroy;
    vsplit->draw = draw;
 
-   for (i = 0; i < SEGMENT_SIZE; i++)
+   vsplit->cache_size = CLAMP(debug_get_option_draw_vertex_cache_size(),
+                              32, MAX_SEGMENT_SIZE);
+
+   for (i = 0; i < MAX_SEGMENT_SIZE; i++)
       vsplit->identity_draw_elts[i] = i;
 
    return &vsplit->base;
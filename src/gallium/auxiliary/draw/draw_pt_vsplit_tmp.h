@@ -122,6 +122,50 @@ CONCAT(vsplit_primitive_, ELT_TYPE)(struct vsplit_frontend *vsplit,
                                           draw_elts, icount, 0x0);
 }
 
+/**
+ * Split a list of primitives into segments ending when the vertex cache is
+ * full rather than after a fixed number of elements: a mesh whose
+ * triangles share many vertices is split less often, so fewer vertices are
+ * shaded more than once.
+ */
+static boolean
+CONCAT(vsplit_list_, ELT_TYPE)(struct vsplit_frontend *vsplit,
+                               unsigned istart, unsigned icount)
+{
+   struct draw_context *draw = vsplit->draw;
+   const ELT_TYPE *ib = (const ELT_TYPE *) draw->pt.user.elts;
+   const int ibias = draw->pt.user.eltBias;
+   unsigned first, incr, flags = 0x0;
+   unsigned i = 0, j;
+
+   draw_pt_split_prim(vsplit->prim, &first, &incr);
+   if (first != incr)
+      return FALSE;
+
+   while (i < icount) {
+      vsplit_clear_cache(vsplit);
+
+      /* a primitive adds incr vertices at most */
+      do {
+         for (j = 0; j < incr; j++)
+            ADD_CACHE(vsplit, ib, istart, i + j, ibias);
+         i += incr;
+      } while (i < icount &&
+               vsplit->cache.num_fetch_elts + incr <= vsplit->segment_size &&
+               vsplit->cache.num_draw_elts + incr <= vsplit->max_draw_elts);
+
+      if (i < icount)
+         flags |= DRAW_SPLIT_AFTER;
+      else
+         flags &= ~DRAW_SPLIT_AFTER;
+
+      vsplit_flush_cache(vsplit, flags);
+      flags |= DRAW_SPLIT_BEFORE;
+   }
+
+   return TRUE;
+}
+
 /**
  * Use the cache to prepare the fetch and draw elements, and flush.
  *
@@ -213,8 +257,9 @@ CONCAT(vsplit_segment_fan_, ELT_TYPE)(struct vsplit_frontend *vsplit,
    const unsigned max_count_loop = vsplit->segment_size - 1;               \
    const unsigned max_count_fan = vsplit->segment_size;
 
-#define PRIMITIVE(istart, icount)   \
-   CONCAT(vsplit_primitive_, ELT_TYPE)(vsplit, istart, icount)
+#define PRIMITIVE(istart, icount)                                   \
+   (CONCAT(vsplit_primitive_, ELT_TYPE)(vsplit, istart, icount) ||  \
+    CONCAT(vsplit_list_, ELT_TYPE)(vsplit, istart, icount))
 
 #else /* ELT_TYPE */
 
@@ -203,8 +203,5 @@ static inline int draw_vs_variant_key_compare( const struct draw_vs_variant_key
 }
 
 
-#define MAX_TGSI_VERTICES 4
-   
-
 
 #endif
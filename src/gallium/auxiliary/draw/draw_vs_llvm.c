@@ -27,6 +27,7 @@
 
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/hash_table.h"
 #include "pipe/p_shader_tokens.h"
 #include "pipe/p_screen.h"
 
@@ -75,6 +76,7 @@ vs_llvm_delete( struct draw_vertex_shader *dvs )
    }
 
    assert(shader->variants_cached == 0);
+   _mesa_hash_table_destroy(shader->variants_ht, NULL);
    FREE((void*) dvs->state.tokens);
    FREE( dvs );
 }
@@ -89,9 +91,17 @@ draw_create_vs_llvm(struct draw_context *draw,
    if (!vs)
       return NULL;
 
+   vs->variants_ht = _mesa_hash_table_create(NULL, draw_llvm_variant_key_hash,
+                                             draw_llvm_variant_key_equal);
+   if (!vs->variants_ht) {
+      FREE(vs);
+      return NULL;
+   }
+
    /* we make a private copy of the tokens */
    vs->base.state.tokens = tgsi_dup_tokens(state->tokens);
    if (!vs->base.state.tokens) {
+      _mesa_hash_table_destroy(vs->variants_ht, NULL);
       FREE(vs);
       return NULL;
    }
@@ -39,6 +39,23 @@
 extern "C" {
 #endif
 
+/**
+ * Machine code of a module, as stored in or restored from a shader cache.
+ *
+ * If data_size is non-zero when the module is compiled, the code is loaded
+ * from data instead of being optimized and code-generated by LLVM.
+ * Otherwise data/data_size are filled in with the newly generated code
+ * (malloc'ed, to be freed by the owner).
+ */
+struct lp_cached_code
+{
+   void *data;
+   size_t data_size;
+   boolean dont_cache;   /**< code refers to process-specific addresses */
+   void *jit_obj_cache;
+};
+
+
 struct gallivm_state
 {
    char *module_name;
@@ -50,6 +67,7 @@ struct gallivm_state
    LLVMBuilderRef builder;
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
+   struct lp_cached_code *cache;  /**< optional, set before compilation */
    unsigned compiled;
 };
 
@@ -65,6 +65,7 @@
 #include <llvm/ExecutionEngine/JITMemoryManager.h>
 #else
 #include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
 #endif
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/Host.h>
@@ -97,6 +98,8 @@
 
 #include "lp_bld_misc.h"
 #include "lp_bld_debug.h"
+#include "lp_bld_init.h"
+#include "lp_bld_type.h"
 
 namespace {
 
@@ -473,10 +476,50 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
 };
 
 
+#if HAVE_LLVM >= 0x0306
+/**
+ * MC-JIT object cache backed by a lp_cached_code.
+ *
+ * If the lp_cached_code already holds an object, MC-JIT loads it instead
+ * of generating code for the module.  Otherwise the object generated by
+ * MC-JIT is copied into it, so the caller can store it in a shader cache.
+ */
+class LPObjectCache : public llvm::ObjectCache {
+   struct lp_cached_code *cache_out;
+
+   public:
+      LPObjectCache(struct lp_cached_code *cache) {
+         cache_out = cache;
+      }
+
+      virtual void notifyObjectCompiled(const llvm::Module *M,
+                                        llvm::MemoryBufferRef Obj) {
+         assert(!cache_out->data_size);
+         cache_out->data = malloc(Obj.getBufferSize());
+         if (cache_out->data) {
+            memcpy(cache_out->data, Obj.getBufferStart(), Obj.getBufferSize());
+            cache_out->data_size = Obj.getBufferSize();
+         }
+      }
+
+      virtual std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *M) {
+         if (!cache_out->data_size)
+            return NULL;
+
+         return llvm::MemoryBuffer::getMemBuffer(
+                   llvm::StringRef((const char *)cache_out->data,
+                                   cache_out->data_size),
+                   "", false);
+      }
+};
+#endif
+
+
 /**
  * Same as LLVMCreateJITCompilerForModule, but:
  * - allows using MCJIT and enabling AVX feature where available.
  * - set target options
+ * - optionally uses (and fills) an object cache, see lp_cached_code
  *
  * See also:
  * - llvm/lib/ExecutionEngine/ExecutionEngineBindings.cpp
@@ -487,6 +530,7 @@ extern "C"
 LLVMBool
 lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
                                         lp_generated_code **OutCode,
+                                        struct lp_cached_code *cache_out,
                                         LLVMModuleRef M,
                                         LLVMMCJITMemoryManagerRef CMM,
                                         unsigned OptLevel,
@@ -612,17 +656,24 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
       MAttrs.push_back("-fma");
    }
    MAttrs.push_back(util_cpu_caps.has_avx2 ? "+avx2" : "-avx2");
-   /* disable avx512 and all subvariants */
+   /*
+    * Only let LLVM use avx512 when 512-bit vectors were asked for, otherwise
+    * it may pick zmm registers for 256-bit code and downclock the core for
+    * no gain.  The Xeon Phi only subvariants are never used.
+    */
 #if HAVE_LLVM >= 0x0304
-   MAttrs.push_back("-avx512cd");
-   MAttrs.push_back("-avx512er");
-   MAttrs.push_back("-avx512f");
-   MAttrs.push_back("-avx512pf");
-#endif
+   {
+      const bool use_avx512 = lp_native_vector_width >= 512;
+      MAttrs.push_back("-avx512er");
+      MAttrs.push_back("-avx512pf");
+      MAttrs.push_back(use_avx512 && util_cpu_caps.has_avx512f ? "+avx512f" : "-avx512f");
+      MAttrs.push_back(use_avx512 && util_cpu_caps.has_avx512cd ? "+avx512cd" : "-avx512cd");
 #if HAVE_LLVM >= 0x0305
-   MAttrs.push_back("-avx512bw");
-   MAttrs.push_back("-avx512dq");
-   MAttrs.push_back("-avx512vl");
+      MAttrs.push_back(use_avx512 && util_cpu_caps.has_avx512bw ? "+avx512bw" : "-avx512bw");
+      MAttrs.push_back(use_avx512 && util_cpu_caps.has_avx512dq ? "+avx512dq" : "-avx512dq");
+      MAttrs.push_back(use_avx512 && util_cpu_caps.has_avx512vl ? "+avx512vl" : "-avx512vl");
+#endif
+   }
 #endif
 #endif
 #endif
@@ -754,6 +805,13 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    JIT->RegisterJITEventListener(JEL);
 #endif
    if (JIT) {
+#if HAVE_LLVM >= 0x0306
+      if (cache_out && useMCJIT) {
+         LPObjectCache *objcache = new LPObjectCache(cache_out);
+         JIT->setObjectCache(objcache);
+         cache_out->jit_obj_cache = (void *)objcache;
+      }
+#endif
       *OutJIT = wrap(JIT);
       return 0;
    }
@@ -792,6 +850,16 @@ lp_free_memory_manager(LLVMMCJITMemoryManagerRef memorymgr)
    delete reinterpret_cast<BaseMemoryManager*>(memorymgr);
 }
 
+extern "C"
+void
+lp_free_objcache(void *objcache_ptr)
+{
+#if HAVE_LLVM >= 0x0306
+   LPObjectCache *objcache = (LPObjectCache *)objcache_ptr;
+   delete objcache;
+#endif
+}
+
 extern "C" LLVMValueRef
 lp_get_called_value(LLVMValueRef call)
 {
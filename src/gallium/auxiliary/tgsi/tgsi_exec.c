@@ -62,6 +62,7 @@
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "util/rounding.h"
+#include "util/u_sse.h"
 
 
 #define DEBUG_EXECUTION 0
@@ -69,16 +70,62 @@
 
 #define FAST_MATH 0
 
+/*
+ * Number of lanes executed in parallel.  tgsi_exec_wide.c builds this file
+ * a second time with TGSI_EXEC_MAX_LANES of them, for wide machines.
+ */
+#ifndef TGSI_EXEC_LANES
+#define TGSI_EXEC_LANES TGSI_QUAD_SIZE
+#endif
+
+#define TGSI_EXEC_LANE_MASK ((1 << TGSI_EXEC_LANES) - 1)
+
+#if defined(PIPE_ARCH_SSE)
+
+/*
+ * Four lanes of a channel at a time, for the micro ops with SSE versions.
+ * TGSI_EXEC_LANES is a multiple of four.
+ */
+static inline __m128
+load_ps(const union tgsi_exec_channel *chan, uint i)
+{
+   return _mm_loadu_ps(&chan->f[i]);
+}
+
+static inline __m128i
+load_si(const union tgsi_exec_channel *chan, uint i)
+{
+   return _mm_loadu_si128((const __m128i *)&chan->u[i]);
+}
+
+static inline void
+store_ps(union tgsi_exec_channel *chan, uint i, __m128 value)
+{
+   _mm_storeu_ps(&chan->f[i], value);
+}
+
+static inline void
+store_si(union tgsi_exec_channel *chan, uint i, __m128i value)
+{
+   _mm_storeu_si128((__m128i *)&chan->u[i], value);
+}
+
+#endif /* PIPE_ARCH_SSE */
+
+/* Defined by the wide build, run by tgsi_exec_machine_run() */
+uint
+tgsi_exec_wide_machine_run(struct tgsi_exec_machine *mach, int start_pc);
+
 #define TILE_TOP_LEFT     0
 #define TILE_TOP_RIGHT    1
 #define TILE_BOTTOM_LEFT  2
 #define TILE_BOTTOM_RIGHT 3
 
 union tgsi_double_channel {
-   double d[TGSI_QUAD_SIZE];
-   unsigned u[TGSI_QUAD_SIZE][2];
-   uint64_t u64[TGSI_QUAD_SIZE];
-   int64_t i64[TGSI_QUAD_SIZE];
+   double d[TGSI_EXEC_LANES];
+   unsigned u[TGSI_EXEC_LANES][2];
+   uint64_t u64[TGSI_EXEC_LANES];
+   int64_t i64[TGSI_EXEC_LANES];
 };
 
 struct tgsi_double_vector {
@@ -90,40 +137,45 @@ static void
 micro_abs(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = fabsf(src->f[0]);
-   dst->f[1] = fabsf(src->f[1]);
-   dst->f[2] = fabsf(src->f[2]);
-   dst->f[3] = fabsf(src->f[3]);
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_andnot_ps(_mm_set1_ps(-0.0f), load_ps(src, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = fabsf(src->f[i]);
+#endif
 }
 
 static void
 micro_arl(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->i[0] = (int)floorf(src->f[0]);
-   dst->i[1] = (int)floorf(src->f[1]);
-   dst->i[2] = (int)floorf(src->f[2]);
-   dst->i[3] = (int)floorf(src->f[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = (int)floorf(src->f[i]);
 }
 
 static void
 micro_arr(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->i[0] = (int)floorf(src->f[0] + 0.5f);
-   dst->i[1] = (int)floorf(src->f[1] + 0.5f);
-   dst->i[2] = (int)floorf(src->f[2] + 0.5f);
-   dst->i[3] = (int)floorf(src->f[3] + 0.5f);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = (int)floorf(src->f[i] + 0.5f);
 }
 
 static void
 micro_ceil(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->f[0] = ceilf(src->f[0]);
-   dst->f[1] = ceilf(src->f[1]);
-   dst->f[2] = ceilf(src->f[2]);
-   dst->f[3] = ceilf(src->f[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = ceilf(src->f[i]);
 }
 
 static void
@@ -132,229 +184,245 @@ micro_cmp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
-   dst->f[0] = src0->f[0] < 0.0f ? src1->f[0] : src2->f[0];
-   dst->f[1] = src0->f[1] < 0.0f ? src1->f[1] : src2->f[1];
-   dst->f[2] = src0->f[2] < 0.0f ? src1->f[2] : src2->f[2];
-   dst->f[3] = src0->f[3] < 0.0f ? src1->f[3] : src2->f[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4) {
+      __m128 neg = _mm_cmplt_ps(load_ps(src0, i), _mm_setzero_ps());
+      store_ps(dst, i, _mm_or_ps(_mm_and_ps(neg, load_ps(src1, i)),
+                                 _mm_andnot_ps(neg, load_ps(src2, i))));
+   }
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] < 0.0f ? src1->f[i] : src2->f[i];
+#endif
 }
 
 static void
 micro_cos(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = cosf(src->f[0]);
-   dst->f[1] = cosf(src->f[1]);
-   dst->f[2] = cosf(src->f[2]);
-   dst->f[3] = cosf(src->f[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = cosf(src->f[i]);
 }
 
 static void
 micro_d2f(union tgsi_exec_channel *dst,
           const union tgsi_double_channel *src)
 {
-   dst->f[0] = (float)src->d[0];
-   dst->f[1] = (float)src->d[1];
-   dst->f[2] = (float)src->d[2];
-   dst->f[3] = (float)src->d[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = (float)src->d[i];
 }
 
 static void
 micro_d2i(union tgsi_exec_channel *dst,
           const union tgsi_double_channel *src)
 {
-   dst->i[0] = (int)src->d[0];
-   dst->i[1] = (int)src->d[1];
-   dst->i[2] = (int)src->d[2];
-   dst->i[3] = (int)src->d[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = (int)src->d[i];
 }
 
 static void
 micro_d2u(union tgsi_exec_channel *dst,
           const union tgsi_double_channel *src)
 {
-   dst->u[0] = (unsigned)src->d[0];
-   dst->u[1] = (unsigned)src->d[1];
-   dst->u[2] = (unsigned)src->d[2];
-   dst->u[3] = (unsigned)src->d[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = (unsigned)src->d[i];
 }
 static void
 micro_dabs(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = src->d[0] >= 0.0 ? src->d[0] : -src->d[0];
-   dst->d[1] = src->d[1] >= 0.0 ? src->d[1] : -src->d[1];
-   dst->d[2] = src->d[2] >= 0.0 ? src->d[2] : -src->d[2];
-   dst->d[3] = src->d[3] >= 0.0 ? src->d[3] : -src->d[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = src->d[i] >= 0.0 ? src->d[i] : -src->d[i];
 }
 
 static void
 micro_dadd(union tgsi_double_channel *dst,
           const union tgsi_double_channel *src)
 {
-   dst->d[0] = src[0].d[0] + src[1].d[0];
-   dst->d[1] = src[0].d[1] + src[1].d[1];
-   dst->d[2] = src[0].d[2] + src[1].d[2];
-   dst->d[3] = src[0].d[3] + src[1].d[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = src[0].d[i] + src[1].d[i];
 }
 
 static void
 micro_ddiv(union tgsi_double_channel *dst,
           const union tgsi_double_channel *src)
 {
-   dst->d[0] = src[0].d[0] / src[1].d[0];
-   dst->d[1] = src[0].d[1] / src[1].d[1];
-   dst->d[2] = src[0].d[2] / src[1].d[2];
-   dst->d[3] = src[0].d[3] / src[1].d[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = src[0].d[i] / src[1].d[i];
 }
 
 static void
 micro_ddx(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] =
-   dst->f[1] =
-   dst->f[2] =
-   dst->f[3] = src->f[TILE_BOTTOM_RIGHT] - src->f[TILE_BOTTOM_LEFT];
+   uint q;
+
+   for (q = 0; q < TGSI_EXEC_LANES; q += TGSI_QUAD_SIZE) {
+      dst->f[q + 0] =
+      dst->f[q + 1] =
+      dst->f[q + 2] =
+      dst->f[q + 3] = src->f[q + TILE_BOTTOM_RIGHT] - src->f[q + TILE_BOTTOM_LEFT];
+   }
 }
 
 static void
 micro_ddy(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] =
-   dst->f[1] =
-   dst->f[2] =
-   dst->f[3] = src->f[TILE_BOTTOM_LEFT] - src->f[TILE_TOP_LEFT];
+   uint q;
+
+   for (q = 0; q < TGSI_EXEC_LANES; q += TGSI_QUAD_SIZE) {
+      dst->f[q + 0] =
+      dst->f[q + 1] =
+      dst->f[q + 2] =
+      dst->f[q + 3] = src->f[q + TILE_BOTTOM_LEFT] - src->f[q + TILE_TOP_LEFT];
+   }
 }
 
 static void
 micro_dmul(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = src[0].d[0] * src[1].d[0];
-   dst->d[1] = src[0].d[1] * src[1].d[1];
-   dst->d[2] = src[0].d[2] * src[1].d[2];
-   dst->d[3] = src[0].d[3] * src[1].d[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = src[0].d[i] * src[1].d[i];
 }
 
 static void
 micro_dmax(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = src[0].d[0] > src[1].d[0] ? src[0].d[0] : src[1].d[0];
-   dst->d[1] = src[0].d[1] > src[1].d[1] ? src[0].d[1] : src[1].d[1];
-   dst->d[2] = src[0].d[2] > src[1].d[2] ? src[0].d[2] : src[1].d[2];
-   dst->d[3] = src[0].d[3] > src[1].d[3] ? src[0].d[3] : src[1].d[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = src[0].d[i] > src[1].d[i] ? src[0].d[i] : src[1].d[i];
 }
 
 static void
 micro_dmin(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = src[0].d[0] < src[1].d[0] ? src[0].d[0] : src[1].d[0];
-   dst->d[1] = src[0].d[1] < src[1].d[1] ? src[0].d[1] : src[1].d[1];
-   dst->d[2] = src[0].d[2] < src[1].d[2] ? src[0].d[2] : src[1].d[2];
-   dst->d[3] = src[0].d[3] < src[1].d[3] ? src[0].d[3] : src[1].d[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = src[0].d[i] < src[1].d[i] ? src[0].d[i] : src[1].d[i];
 }
 
 static void
 micro_dneg(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = -src->d[0];
-   dst->d[1] = -src->d[1];
-   dst->d[2] = -src->d[2];
-   dst->d[3] = -src->d[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = -src->d[i];
 }
 
 static void
 micro_dslt(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].d[0] < src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] < src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] < src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] < src[1].d[3] ? ~0U : 0U;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i][0] = src[0].d[i] < src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_dsne(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].d[0] != src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] != src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] != src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] != src[1].d[3] ? ~0U : 0U;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i][0] = src[0].d[i] != src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_dsge(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].d[0] >= src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] >= src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] >= src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] >= src[1].d[3] ? ~0U : 0U;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i][0] = src[0].d[i] >= src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_dseq(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].d[0] == src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] == src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] == src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] == src[1].d[3] ? ~0U : 0U;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i][0] = src[0].d[i] == src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_drcp(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = 1.0 / src->d[0];
-   dst->d[1] = 1.0 / src->d[1];
-   dst->d[2] = 1.0 / src->d[2];
-   dst->d[3] = 1.0 / src->d[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = 1.0 / src->d[i];
 }
 
 static void
 micro_dsqrt(union tgsi_double_channel *dst,
             const union tgsi_double_channel *src)
 {
-   dst->d[0] = sqrt(src->d[0]);
-   dst->d[1] = sqrt(src->d[1]);
-   dst->d[2] = sqrt(src->d[2]);
-   dst->d[3] = sqrt(src->d[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = sqrt(src->d[i]);
 }
 
 static void
 micro_drsq(union tgsi_double_channel *dst,
           const union tgsi_double_channel *src)
 {
-   dst->d[0] = 1.0 / sqrt(src->d[0]);
-   dst->d[1] = 1.0 / sqrt(src->d[1]);
-   dst->d[2] = 1.0 / sqrt(src->d[2]);
-   dst->d[3] = 1.0 / sqrt(src->d[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = 1.0 / sqrt(src->d[i]);
 }
 
 static void
 micro_dmad(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = src[0].d[0] * src[1].d[0] + src[2].d[0];
-   dst->d[1] = src[0].d[1] * src[1].d[1] + src[2].d[1];
-   dst->d[2] = src[0].d[2] * src[1].d[2] + src[2].d[2];
-   dst->d[3] = src[0].d[3] * src[1].d[3] + src[2].d[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = src[0].d[i] * src[1].d[i] + src[2].d[i];
 }
 
 static void
 micro_dfrac(union tgsi_double_channel *dst,
             const union tgsi_double_channel *src)
 {
-   dst->d[0] = src->d[0] - floor(src->d[0]);
-   dst->d[1] = src->d[1] - floor(src->d[1]);
-   dst->d[2] = src->d[2] - floor(src->d[2]);
-   dst->d[3] = src->d[3] - floor(src->d[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = src->d[i] - floor(src->d[i]);
 }
 
 static void
@@ -362,10 +430,10 @@ micro_dldexp(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src0,
              union tgsi_exec_channel *src1)
 {
-   dst->d[0] = ldexp(src0->d[0], src1->i[0]);
-   dst->d[1] = ldexp(src0->d[1], src1->i[1]);
-   dst->d[2] = ldexp(src0->d[2], src1->i[2]);
-   dst->d[3] = ldexp(src0->d[3], src1->i[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = ldexp(src0->d[i], src1->i[i]);
 }
 
 static void
@@ -373,28 +441,27 @@ micro_dfracexp(union tgsi_double_channel *dst,
                union tgsi_exec_channel *dst_exp,
                const union tgsi_double_channel *src)
 {
-   dst->d[0] = frexp(src->d[0], &dst_exp->i[0]);
-   dst->d[1] = frexp(src->d[1], &dst_exp->i[1]);
-   dst->d[2] = frexp(src->d[2], &dst_exp->i[2]);
-   dst->d[3] = frexp(src->d[3], &dst_exp->i[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = frexp(src->d[i], &dst_exp->i[i]);
 }
 
 static void
 micro_exp2(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
+   uint i;
+
 #if FAST_MATH
-   dst->f[0] = util_fast_exp2(src->f[0]);
-   dst->f[1] = util_fast_exp2(src->f[1]);
-   dst->f[2] = util_fast_exp2(src->f[2]);
-   dst->f[3] = util_fast_exp2(src->f[3]);
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = util_fast_exp2(src->f[i]);
 #else
 #if DEBUG
    /* Inf is okay for this instruction, so clamp it to silence assertions. */
-   uint i;
    union tgsi_exec_channel clamped;
 
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
       if (src->f[i] > 127.99999f) {
          clamped.f[i] = 127.99999f;
       } else if (src->f[i] < -126.99999f) {
@@ -406,10 +473,8 @@ micro_exp2(union tgsi_exec_channel *dst,
    src = &clamped;
 #endif /* DEBUG */
 
-   dst->f[0] = powf(2.0f, src->f[0]);
-   dst->f[1] = powf(2.0f, src->f[1]);
-   dst->f[2] = powf(2.0f, src->f[2]);
-   dst->f[3] = powf(2.0f, src->f[3]);
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = powf(2.0f, src->f[i]);
 #endif /* FAST_MATH */
 }
 
@@ -417,76 +482,74 @@ static void
 micro_f2d(union tgsi_double_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->d[0] = (double)src->f[0];
-   dst->d[1] = (double)src->f[1];
-   dst->d[2] = (double)src->f[2];
-   dst->d[3] = (double)src->f[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = (double)src->f[i];
 }
 
 static void
 micro_flr(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = floorf(src->f[0]);
-   dst->f[1] = floorf(src->f[1]);
-   dst->f[2] = floorf(src->f[2]);
-   dst->f[3] = floorf(src->f[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = floorf(src->f[i]);
 }
 
 static void
 micro_frc(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = src->f[0] - floorf(src->f[0]);
-   dst->f[1] = src->f[1] - floorf(src->f[1]);
-   dst->f[2] = src->f[2] - floorf(src->f[2]);
-   dst->f[3] = src->f[3] - floorf(src->f[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src->f[i] - floorf(src->f[i]);
 }
 
 static void
 micro_i2d(union tgsi_double_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->d[0] = (double)src->i[0];
-   dst->d[1] = (double)src->i[1];
-   dst->d[2] = (double)src->i[2];
-   dst->d[3] = (double)src->i[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = (double)src->i[i];
 }
 
 static void
 micro_iabs(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->i[0] = src->i[0] >= 0 ? src->i[0] : -src->i[0];
-   dst->i[1] = src->i[1] >= 0 ? src->i[1] : -src->i[1];
-   dst->i[2] = src->i[2] >= 0 ? src->i[2] : -src->i[2];
-   dst->i[3] = src->i[3] >= 0 ? src->i[3] : -src->i[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = src->i[i] >= 0 ? src->i[i] : -src->i[i];
 }
 
 static void
 micro_ineg(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->i[0] = -src->i[0];
-   dst->i[1] = -src->i[1];
-   dst->i[2] = -src->i[2];
-   dst->i[3] = -src->i[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = -src->i[i];
 }
 
 static void
 micro_lg2(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
+   uint i;
+
 #if FAST_MATH
-   dst->f[0] = util_fast_log2(src->f[0]);
-   dst->f[1] = util_fast_log2(src->f[1]);
-   dst->f[2] = util_fast_log2(src->f[2]);
-   dst->f[3] = util_fast_log2(src->f[3]);
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = util_fast_log2(src->f[i]);
 #else
-   dst->f[0] = logf(src->f[0]) * 1.442695f;
-   dst->f[1] = logf(src->f[1]) * 1.442695f;
-   dst->f[2] = logf(src->f[2]) * 1.442695f;
-   dst->f[3] = logf(src->f[3]) * 1.442695f;
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = logf(src->f[i]) * 1.442695f;
 #endif
 }
 
@@ -496,10 +559,10 @@ micro_lrp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
-   dst->f[0] = src0->f[0] * (src1->f[0] - src2->f[0]) + src2->f[0];
-   dst->f[1] = src0->f[1] * (src1->f[1] - src2->f[1]) + src2->f[1];
-   dst->f[2] = src0->f[2] * (src1->f[2] - src2->f[2]) + src2->f[2];
-   dst->f[3] = src0->f[3] * (src1->f[3] - src2->f[3]) + src2->f[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] * (src1->f[i] - src2->f[i]) + src2->f[i];
 }
 
 static void
@@ -508,72 +571,84 @@ micro_mad(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
-   dst->f[0] = src0->f[0] * src1->f[0] + src2->f[0];
-   dst->f[1] = src0->f[1] * src1->f[1] + src2->f[1];
-   dst->f[2] = src0->f[2] * src1->f[2] + src2->f[2];
-   dst->f[3] = src0->f[3] * src1->f[3] + src2->f[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_add_ps(_mm_mul_ps(load_ps(src0, i), load_ps(src1, i)),
+                                  load_ps(src2, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] * src1->f[i] + src2->f[i];
+#endif
 }
 
 static void
 micro_mov(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->u[0] = src->u[0];
-   dst->u[1] = src->u[1];
-   dst->u[2] = src->u[2];
-   dst->u[3] = src->u[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src->u[i];
 }
 
 static void
 micro_rcp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
+   uint i;
+
 #if 0 /* for debugging */
-   assert(src->f[0] != 0.0f);
-   assert(src->f[1] != 0.0f);
-   assert(src->f[2] != 0.0f);
-   assert(src->f[3] != 0.0f);
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      assert(src->f[i] != 0.0f);
 #endif
-   dst->f[0] = 1.0f / src->f[0];
-   dst->f[1] = 1.0f / src->f[1];
-   dst->f[2] = 1.0f / src->f[2];
-   dst->f[3] = 1.0f / src->f[3];
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = 1.0f / src->f[i];
 }
 
 static void
 micro_rnd(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = _mesa_roundevenf(src->f[0]);
-   dst->f[1] = _mesa_roundevenf(src->f[1]);
-   dst->f[2] = _mesa_roundevenf(src->f[2]);
-   dst->f[3] = _mesa_roundevenf(src->f[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = _mesa_roundevenf(src->f[i]);
 }
 
 static void
 micro_rsq(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
+   uint i;
+
 #if 0 /* for debugging */
-   assert(src->f[0] != 0.0f);
-   assert(src->f[1] != 0.0f);
-   assert(src->f[2] != 0.0f);
-   assert(src->f[3] != 0.0f);
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      assert(src->f[i] != 0.0f);
+#endif
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(load_ps(src, i))));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = 1.0f / sqrtf(src->f[i]);
 #endif
-   dst->f[0] = 1.0f / sqrtf(src->f[0]);
-   dst->f[1] = 1.0f / sqrtf(src->f[1]);
-   dst->f[2] = 1.0f / sqrtf(src->f[2]);
-   dst->f[3] = 1.0f / sqrtf(src->f[3]);
 }
 
 static void
 micro_sqrt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->f[0] = sqrtf(src->f[0]);
-   dst->f[1] = sqrtf(src->f[1]);
-   dst->f[2] = sqrtf(src->f[2]);
-   dst->f[3] = sqrtf(src->f[3]);
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_sqrt_ps(load_ps(src, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = sqrtf(src->f[i]);
+#endif
 }
 
 static void
@@ -581,10 +656,16 @@ micro_seq(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] == src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] == src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] == src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] == src1->f[3] ? 1.0f : 0.0f;
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_and_ps(_mm_cmpeq_ps(load_ps(src0, i), load_ps(src1, i)),
+                                  _mm_set1_ps(1.0f)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] == src1->f[i] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -592,30 +673,36 @@ micro_sge(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] >= src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] >= src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] >= src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] >= src1->f[3] ? 1.0f : 0.0f;
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_and_ps(_mm_cmpge_ps(load_ps(src0, i), load_ps(src1, i)),
+                                  _mm_set1_ps(1.0f)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] >= src1->f[i] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
 micro_sgn(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = src->f[0] < 0.0f ? -1.0f : src->f[0] > 0.0f ? 1.0f : 0.0f;
-   dst->f[1] = src->f[1] < 0.0f ? -1.0f : src->f[1] > 0.0f ? 1.0f : 0.0f;
-   dst->f[2] = src->f[2] < 0.0f ? -1.0f : src->f[2] > 0.0f ? 1.0f : 0.0f;
-   dst->f[3] = src->f[3] < 0.0f ? -1.0f : src->f[3] > 0.0f ? 1.0f : 0.0f;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src->f[i] < 0.0f ? -1.0f : src->f[i] > 0.0f ? 1.0f : 0.0f;
 }
 
 static void
 micro_isgn(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->i[0] = src->i[0] < 0 ? -1 : src->i[0] > 0 ? 1 : 0;
-   dst->i[1] = src->i[1] < 0 ? -1 : src->i[1] > 0 ? 1 : 0;
-   dst->i[2] = src->i[2] < 0 ? -1 : src->i[2] > 0 ? 1 : 0;
-   dst->i[3] = src->i[3] < 0 ? -1 : src->i[3] > 0 ? 1 : 0;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = src->i[i] < 0 ? -1 : src->i[i] > 0 ? 1 : 0;
 }
 
 static void
@@ -623,20 +710,26 @@ micro_sgt(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] > src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] > src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] > src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] > src1->f[3] ? 1.0f : 0.0f;
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_and_ps(_mm_cmpgt_ps(load_ps(src0, i), load_ps(src1, i)),
+                                  _mm_set1_ps(1.0f)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] > src1->f[i] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
 micro_sin(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = sinf(src->f[0]);
-   dst->f[1] = sinf(src->f[1]);
-   dst->f[2] = sinf(src->f[2]);
-   dst->f[3] = sinf(src->f[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = sinf(src->f[i]);
 }
 
 static void
@@ -644,10 +737,16 @@ micro_sle(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] <= src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] <= src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] <= src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] <= src1->f[3] ? 1.0f : 0.0f;
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_and_ps(_mm_cmple_ps(load_ps(src0, i), load_ps(src1, i)),
+                                  _mm_set1_ps(1.0f)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] <= src1->f[i] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -655,10 +754,16 @@ micro_slt(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] < src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] < src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] < src1->f[3] ? 1.0f : 0.0f;
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_and_ps(_mm_cmplt_ps(load_ps(src0, i), load_ps(src1, i)),
+                                  _mm_set1_ps(1.0f)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -666,220 +771,226 @@ micro_sne(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] != src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] != src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] != src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] != src1->f[3] ? 1.0f : 0.0f;
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_and_ps(_mm_cmpneq_ps(load_ps(src0, i), load_ps(src1, i)),
+                                  _mm_set1_ps(1.0f)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] != src1->f[i] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
 micro_trunc(union tgsi_exec_channel *dst,
             const union tgsi_exec_channel *src)
 {
-   dst->f[0] = truncf(src->f[0]);
-   dst->f[1] = truncf(src->f[1]);
-   dst->f[2] = truncf(src->f[2]);
-   dst->f[3] = truncf(src->f[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = truncf(src->f[i]);
 }
 
 static void
 micro_u2d(union tgsi_double_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->d[0] = (double)src->u[0];
-   dst->d[1] = (double)src->u[1];
-   dst->d[2] = (double)src->u[2];
-   dst->d[3] = (double)src->u[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = (double)src->u[i];
 }
 
 static void
 micro_i64abs(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->i64[0] = src->i64[0] >= 0.0 ? src->i64[0] : -src->i64[0];
-   dst->i64[1] = src->i64[1] >= 0.0 ? src->i64[1] : -src->i64[1];
-   dst->i64[2] = src->i64[2] >= 0.0 ? src->i64[2] : -src->i64[2];
-   dst->i64[3] = src->i64[3] >= 0.0 ? src->i64[3] : -src->i64[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i64[i] = src->i64[i] >= 0.0 ? src->i64[i] : -src->i64[i];
 }
 
 static void
 micro_i64sgn(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->i64[0] = src->i64[0] < 0 ? -1 : src->i64[0] > 0 ? 1 : 0;
-   dst->i64[1] = src->i64[1] < 0 ? -1 : src->i64[1] > 0 ? 1 : 0;
-   dst->i64[2] = src->i64[2] < 0 ? -1 : src->i64[2] > 0 ? 1 : 0;
-   dst->i64[3] = src->i64[3] < 0 ? -1 : src->i64[3] > 0 ? 1 : 0;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i64[i] = src->i64[i] < 0 ? -1 : src->i64[i] > 0 ? 1 : 0;
 }
 
 static void
 micro_i64neg(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->i64[0] = -src->i64[0];
-   dst->i64[1] = -src->i64[1];
-   dst->i64[2] = -src->i64[2];
-   dst->i64[3] = -src->i64[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i64[i] = -src->i64[i];
 }
 
 static void
 micro_u64seq(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].u64[0] == src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] == src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] == src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] == src[1].u64[3] ? ~0U : 0U;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i][0] = src[0].u64[i] == src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64sne(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].u64[0] != src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] != src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] != src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] != src[1].u64[3] ? ~0U : 0U;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i][0] = src[0].u64[i] != src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_i64slt(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].i64[0] < src[1].i64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].i64[1] < src[1].i64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].i64[2] < src[1].i64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].i64[3] < src[1].i64[3] ? ~0U : 0U;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i][0] = src[0].i64[i] < src[1].i64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64slt(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].u64[0] < src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] < src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] < src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] < src[1].u64[3] ? ~0U : 0U;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i][0] = src[0].u64[i] < src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_i64sge(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].i64[0] >= src[1].i64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].i64[1] >= src[1].i64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].i64[2] >= src[1].i64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].i64[3] >= src[1].i64[3] ? ~0U : 0U;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i][0] = src[0].i64[i] >= src[1].i64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64sge(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u[0][0] = src[0].u64[0] >= src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] >= src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] >= src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] >= src[1].u64[3] ? ~0U : 0U;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i][0] = src[0].u64[i] >= src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64max(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u64[0] = src[0].u64[0] > src[1].u64[0] ? src[0].u64[0] : src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] > src[1].u64[1] ? src[0].u64[1] : src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] > src[1].u64[2] ? src[0].u64[2] : src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] > src[1].u64[3] ? src[0].u64[3] : src[1].u64[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u64[i] = src[0].u64[i] > src[1].u64[i] ? src[0].u64[i] : src[1].u64[i];
 }
 
 static void
 micro_i64max(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->i64[0] = src[0].i64[0] > src[1].i64[0] ? src[0].i64[0] : src[1].i64[0];
-   dst->i64[1] = src[0].i64[1] > src[1].i64[1] ? src[0].i64[1] : src[1].i64[1];
-   dst->i64[2] = src[0].i64[2] > src[1].i64[2] ? src[0].i64[2] : src[1].i64[2];
-   dst->i64[3] = src[0].i64[3] > src[1].i64[3] ? src[0].i64[3] : src[1].i64[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i64[i] = src[0].i64[i] > src[1].i64[i] ? src[0].i64[i] : src[1].i64[i];
 }
 
 static void
 micro_u64min(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u64[0] = src[0].u64[0] < src[1].u64[0] ? src[0].u64[0] : src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] < src[1].u64[1] ? src[0].u64[1] : src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] < src[1].u64[2] ? src[0].u64[2] : src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] < src[1].u64[3] ? src[0].u64[3] : src[1].u64[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u64[i] = src[0].u64[i] < src[1].u64[i] ? src[0].u64[i] : src[1].u64[i];
 }
 
 static void
 micro_i64min(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->i64[0] = src[0].i64[0] < src[1].i64[0] ? src[0].i64[0] : src[1].i64[0];
-   dst->i64[1] = src[0].i64[1] < src[1].i64[1] ? src[0].i64[1] : src[1].i64[1];
-   dst->i64[2] = src[0].i64[2] < src[1].i64[2] ? src[0].i64[2] : src[1].i64[2];
-   dst->i64[3] = src[0].i64[3] < src[1].i64[3] ? src[0].i64[3] : src[1].i64[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i64[i] = src[0].i64[i] < src[1].i64[i] ? src[0].i64[i] : src[1].i64[i];
 }
 
 static void
 micro_u64add(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u64[0] = src[0].u64[0] + src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] + src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] + src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] + src[1].u64[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u64[i] = src[0].u64[i] + src[1].u64[i];
 }
 
 static void
 micro_u64mul(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u64[0] = src[0].u64[0] * src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] * src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] * src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] * src[1].u64[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u64[i] = src[0].u64[i] * src[1].u64[i];
 }
 
 static void
 micro_u64div(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u64[0] = src[1].u64[0] ? src[0].u64[0] / src[1].u64[0] : ~0ull;
-   dst->u64[1] = src[1].u64[1] ? src[0].u64[1] / src[1].u64[1] : ~0ull;
-   dst->u64[2] = src[1].u64[2] ? src[0].u64[2] / src[1].u64[2] : ~0ull;
-   dst->u64[3] = src[1].u64[3] ? src[0].u64[3] / src[1].u64[3] : ~0ull;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u64[i] = src[1].u64[i] ? src[0].u64[i] / src[1].u64[i] : ~0ull;
 }
 
 static void
 micro_i64div(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->i64[0] = src[1].i64[0] ? src[0].i64[0] / src[1].i64[0] : 0;
-   dst->i64[1] = src[1].i64[1] ? src[0].i64[1] / src[1].i64[1] : 0;
-   dst->i64[2] = src[1].i64[2] ? src[0].i64[2] / src[1].i64[2] : 0;
-   dst->i64[3] = src[1].i64[3] ? src[0].i64[3] / src[1].i64[3] : 0;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i64[i] = src[1].i64[i] ? src[0].i64[i] / src[1].i64[i] : 0;
 }
 
 static void
 micro_u64mod(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->u64[0] = src[1].u64[0] ? src[0].u64[0] % src[1].u64[0] : ~0ull;
-   dst->u64[1] = src[1].u64[1] ? src[0].u64[1] % src[1].u64[1] : ~0ull;
-   dst->u64[2] = src[1].u64[2] ? src[0].u64[2] % src[1].u64[2] : ~0ull;
-   dst->u64[3] = src[1].u64[3] ? src[0].u64[3] % src[1].u64[3] : ~0ull;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u64[i] = src[1].u64[i] ? src[0].u64[i] % src[1].u64[i] : ~0ull;
 }
 
 static void
 micro_i64mod(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src)
 {
-   dst->i64[0] = src[1].i64[0] ? src[0].i64[0] % src[1].i64[0] : ~0ll;
-   dst->i64[1] = src[1].i64[1] ? src[0].i64[1] % src[1].i64[1] : ~0ll;
-   dst->i64[2] = src[1].i64[2] ? src[0].i64[2] % src[1].i64[2] : ~0ll;
-   dst->i64[3] = src[1].i64[3] ? src[0].i64[3] % src[1].i64[3] : ~0ll;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i64[i] = src[1].i64[i] ? src[0].i64[i] % src[1].i64[i] : ~0ll;
 }
 
 static void
@@ -888,14 +999,12 @@ micro_u64shl(union tgsi_double_channel *dst,
              union tgsi_exec_channel *src1)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x3f;
-   dst->u64[0] = src0->u64[0] << masked_count;
-   masked_count = src1->u[1] & 0x3f;
-   dst->u64[1] = src0->u64[1] << masked_count;
-   masked_count = src1->u[2] & 0x3f;
-   dst->u64[2] = src0->u64[2] << masked_count;
-   masked_count = src1->u[3] & 0x3f;
-   dst->u64[3] = src0->u64[3] << masked_count;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
+      masked_count = src1->u[i] & 0x3f;
+      dst->u64[i] = src0->u64[i] << masked_count;
+   }
 }
 
 static void
@@ -904,14 +1013,12 @@ micro_i64shr(union tgsi_double_channel *dst,
              union tgsi_exec_channel *src1)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x3f;
-   dst->i64[0] = src0->i64[0] >> masked_count;
-   masked_count = src1->u[1] & 0x3f;
-   dst->i64[1] = src0->i64[1] >> masked_count;
-   masked_count = src1->u[2] & 0x3f;
-   dst->i64[2] = src0->i64[2] >> masked_count;
-   masked_count = src1->u[3] & 0x3f;
-   dst->i64[3] = src0->i64[3] >> masked_count;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
+      masked_count = src1->u[i] & 0x3f;
+      dst->i64[i] = src0->i64[i] >> masked_count;
+   }
 }
 
 static void
@@ -920,14 +1027,12 @@ micro_u64shr(union tgsi_double_channel *dst,
              union tgsi_exec_channel *src1)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x3f;
-   dst->u64[0] = src0->u64[0] >> masked_count;
-   masked_count = src1->u[1] & 0x3f;
-   dst->u64[1] = src0->u64[1] >> masked_count;
-   masked_count = src1->u[2] & 0x3f;
-   dst->u64[2] = src0->u64[2] >> masked_count;
-   masked_count = src1->u[3] & 0x3f;
-   dst->u64[3] = src0->u64[3] >> masked_count;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
+      masked_count = src1->u[i] & 0x3f;
+      dst->u64[i] = src0->u64[i] >> masked_count;
+   }
 }
 
 enum tgsi_exec_datatype {
@@ -958,19 +1063,30 @@ enum tgsi_exec_datatype {
 static const union tgsi_exec_channel ZeroVec =
    { { 0.0, 0.0, 0.0, 0.0 } };
 
+/* The constant vectors below have TGSI_EXEC_MAX_LANES elements */
 static const union tgsi_exec_channel OneVec = {
-   {1.0f, 1.0f, 1.0f, 1.0f}
+   {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f}
 };
 
 static const union tgsi_exec_channel P128Vec = {
-   {128.0f, 128.0f, 128.0f, 128.0f}
+   {128.0f, 128.0f, 128.0f, 128.0f, 128.0f, 128.0f, 128.0f, 128.0f}
 };
 
 static const union tgsi_exec_channel M128Vec = {
-   {-128.0f, -128.0f, -128.0f, -128.0f}
+   {-128.0f, -128.0f, -128.0f, -128.0f, -128.0f, -128.0f, -128.0f, -128.0f}
 };
 
 
+static inline void
+set_channel_int(union tgsi_exec_channel *chan, int value)
+{
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      chan->i[i] = value;
+}
+
+
 /**
  * Assert that none of the float values in 'chan' are infinite or NaN.
  * NaN and Inf may occur normally during program execution and should
@@ -980,13 +1096,19 @@ static const union tgsi_exec_channel M128Vec = {
 static inline void
 check_inf_or_nan(const union tgsi_exec_channel *chan)
 {
-   assert(!util_is_inf_or_nan((chan)->f[0]));
-   assert(!util_is_inf_or_nan((chan)->f[1]));
-   assert(!util_is_inf_or_nan((chan)->f[2]));
-   assert(!util_is_inf_or_nan((chan)->f[3]));
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      assert(!util_is_inf_or_nan((chan)->f[i]));
 }
 
 
+/*
+ * The machine setup code doesn't depend on the number of lanes, and is only
+ * built once.
+ */
+#if TGSI_EXEC_LANES == TGSI_QUAD_SIZE
+
 #ifdef DEBUG
 static void
 print_chan(const char *msg, const union tgsi_exec_channel *chan)
@@ -1289,6 +1411,7 @@ tgsi_exec_machine_create(enum pipe_shader_type shader_type)
    memset(mach, 0, sizeof(*mach));
 
    mach->ShaderType = shader_type;
+   mach->NumLanes = TGSI_QUAD_SIZE;
    mach->Addrs = &mach->Temps[TGSI_EXEC_TEMP_ADDR];
    mach->MaxGeometryShaderOutputs = TGSI_MAX_TOTAL_VERTICES;
 
@@ -1300,7 +1423,7 @@ tgsi_exec_machine_create(enum pipe_shader_type shader_type)
    }
 
    /* Setup constants needed by the SSE2 executor. */
-   for( i = 0; i < 4; i++ ) {
+   for( i = 0; i < TGSI_EXEC_MAX_LANES; i++ ) {
       mach->Temps[TGSI_EXEC_TEMP_00000000_I].xyzw[TGSI_EXEC_TEMP_00000000_C].u[i] = 0x00000000;
       mach->Temps[TGSI_EXEC_TEMP_7FFFFFFF_I].xyzw[TGSI_EXEC_TEMP_7FFFFFFF_C].u[i] = 0x7FFFFFFF;
       mach->Temps[TGSI_EXEC_TEMP_80000000_I].xyzw[TGSI_EXEC_TEMP_80000000_C].u[i] = 0x80000000;
@@ -1345,15 +1468,42 @@ tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach)
    }
 }
 
+
+/**
+ * Create a machine which runs TGSI_EXEC_MAX_LANES vertices or compute
+ * threads at once, instead of a quad.  Fragment shaders need quads, for
+ * derivatives and interpolation.
+ */
+struct tgsi_exec_machine *
+tgsi_exec_machine_create_wide(enum pipe_shader_type shader_type)
+{
+   struct tgsi_exec_machine *mach;
+
+   assert(shader_type != PIPE_SHADER_FRAGMENT);
+
+   mach = tgsi_exec_machine_create(shader_type);
+   if (mach)
+      mach->NumLanes = TGSI_EXEC_MAX_LANES;
+
+   return mach;
+}
+
+#endif /* TGSI_EXEC_LANES == TGSI_QUAD_SIZE */
+
 static void
 micro_add(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] + src1->f[0];
-   dst->f[1] = src0->f[1] + src1->f[1];
-   dst->f[2] = src0->f[2] + src1->f[2];
-   dst->f[3] = src0->f[3] + src1->f[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_add_ps(load_ps(src0, i), load_ps(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] + src1->f[i];
+#endif
 }
 
 static void
@@ -1362,17 +1512,12 @@ micro_div(
    const union tgsi_exec_channel *src0,
    const union tgsi_exec_channel *src1 )
 {
-   if (src1->f[0] != 0) {
-      dst->f[0] = src0->f[0] / src1->f[0];
-   }
-   if (src1->f[1] != 0) {
-      dst->f[1] = src0->f[1] / src1->f[1];
-   }
-   if (src1->f[2] != 0) {
-      dst->f[2] = src0->f[2] / src1->f[2];
-   }
-   if (src1->f[3] != 0) {
-      dst->f[3] = src0->f[3] / src1->f[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
+      if (src1->f[i] != 0) {
+         dst->f[i] = src0->f[i] / src1->f[i];
+      }
    }
 }
 
@@ -1384,10 +1529,10 @@ micro_lt(
    const union tgsi_exec_channel *src2,
    const union tgsi_exec_channel *src3 )
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? src2->f[0] : src3->f[0];
-   dst->f[1] = src0->f[1] < src1->f[1] ? src2->f[1] : src3->f[1];
-   dst->f[2] = src0->f[2] < src1->f[2] ? src2->f[2] : src3->f[2];
-   dst->f[3] = src0->f[3] < src1->f[3] ? src2->f[3] : src3->f[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? src2->f[i] : src3->f[i];
 }
 
 static void
@@ -1395,10 +1540,15 @@ micro_max(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] > src1->f[0] ? src0->f[0] : src1->f[0];
-   dst->f[1] = src0->f[1] > src1->f[1] ? src0->f[1] : src1->f[1];
-   dst->f[2] = src0->f[2] > src1->f[2] ? src0->f[2] : src1->f[2];
-   dst->f[3] = src0->f[3] > src1->f[3] ? src0->f[3] : src1->f[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_max_ps(load_ps(src0, i), load_ps(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] > src1->f[i] ? src0->f[i] : src1->f[i];
+#endif
 }
 
 static void
@@ -1406,10 +1556,15 @@ micro_min(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? src0->f[0] : src1->f[0];
-   dst->f[1] = src0->f[1] < src1->f[1] ? src0->f[1] : src1->f[1];
-   dst->f[2] = src0->f[2] < src1->f[2] ? src0->f[2] : src1->f[2];
-   dst->f[3] = src0->f[3] < src1->f[3] ? src0->f[3] : src1->f[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_min_ps(load_ps(src0, i), load_ps(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? src0->f[i] : src1->f[i];
+#endif
 }
 
 static void
@@ -1417,10 +1572,15 @@ micro_mul(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] * src1->f[0];
-   dst->f[1] = src0->f[1] * src1->f[1];
-   dst->f[2] = src0->f[2] * src1->f[2];
-   dst->f[3] = src0->f[3] * src1->f[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_mul_ps(load_ps(src0, i), load_ps(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] * src1->f[i];
+#endif
 }
 
 static void
@@ -1428,10 +1588,15 @@ micro_neg(
    union tgsi_exec_channel *dst,
    const union tgsi_exec_channel *src )
 {
-   dst->f[0] = -src->f[0];
-   dst->f[1] = -src->f[1];
-   dst->f[2] = -src->f[2];
-   dst->f[3] = -src->f[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_xor_ps(_mm_set1_ps(-0.0f), load_ps(src, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = -src->f[i];
+#endif
 }
 
 static void
@@ -1440,16 +1605,14 @@ micro_pow(
    const union tgsi_exec_channel *src0,
    const union tgsi_exec_channel *src1 )
 {
+   uint i;
+
 #if FAST_MATH
-   dst->f[0] = util_fast_pow( src0->f[0], src1->f[0] );
-   dst->f[1] = util_fast_pow( src0->f[1], src1->f[1] );
-   dst->f[2] = util_fast_pow( src0->f[2], src1->f[2] );
-   dst->f[3] = util_fast_pow( src0->f[3], src1->f[3] );
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = util_fast_pow( src0->f[i], src1->f[i] );
 #else
-   dst->f[0] = powf( src0->f[0], src1->f[0] );
-   dst->f[1] = powf( src0->f[1], src1->f[1] );
-   dst->f[2] = powf( src0->f[2], src1->f[2] );
-   dst->f[3] = powf( src0->f[3], src1->f[3] );
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = powf( src0->f[i], src1->f[i] );
 #endif
 }
 
@@ -1458,10 +1621,10 @@ micro_ldexp(union tgsi_exec_channel *dst,
             const union tgsi_exec_channel *src0,
             const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = ldexpf(src0->f[0], src1->i[0]);
-   dst->f[1] = ldexpf(src0->f[1], src1->i[1]);
-   dst->f[2] = ldexpf(src0->f[2], src1->i[2]);
-   dst->f[3] = ldexpf(src0->f[3], src1->i[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = ldexpf(src0->f[i], src1->i[i]);
 }
 
 static void
@@ -1469,121 +1632,160 @@ micro_sub(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->f[0] = src0->f[0] - src1->f[0];
-   dst->f[1] = src0->f[1] - src1->f[1];
-   dst->f[2] = src0->f[2] - src1->f[2];
-   dst->f[3] = src0->f[3] - src1->f[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_sub_ps(load_ps(src0, i), load_ps(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->f[i] - src1->f[i];
+#endif
 }
 
-static void
-fetch_src_file_channel(const struct tgsi_exec_machine *mach,
-                       const uint chan_index,
-                       const uint file,
-                       const uint swizzle,
-                       const union tgsi_exec_channel *index,
-                       const union tgsi_exec_channel *index2D,
-                       union tgsi_exec_channel *chan)
+/**
+ * Address of the channel \p swizzle of the register \p index (\p index2D)
+ * of \p file.  For the files kept per lane, that is the value of lane 0 and
+ * the other lanes follow it, (*per_lane is set).  Constants and immediates
+ * are the same for all the lanes.  Returns NULL for registers which read as
+ * zero.
+ */
+static inline const uint *
+get_src_file_element(const struct tgsi_exec_machine *mach,
+                     const uint file,
+                     const uint swizzle,
+                     const int index,
+                     const int index2D,
+                     boolean *per_lane)
 {
-   uint i;
-
    assert(swizzle < 4);
 
+   *per_lane = TRUE;
+
    switch (file) {
    case TGSI_FILE_CONSTANT:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
-         assert(index2D->i[i] >= 0 && index2D->i[i] < PIPE_MAX_CONSTANT_BUFFERS);
-         assert(mach->Consts[index2D->i[i]]);
+      assert(index2D >= 0 && index2D < PIPE_MAX_CONSTANT_BUFFERS);
+      assert(mach->Consts[index2D]);
 
-         if (index->i[i] < 0) {
-            chan->u[i] = 0;
-         } else {
-            /* NOTE: copying the const value as a uint instead of float */
-            const uint constbuf = index2D->i[i];
-            const uint *buf = (const uint *)mach->Consts[constbuf];
-            const int pos = index->i[i] * 4 + swizzle;
-            /* const buffer bounds check */
-            if (pos < 0 || pos >= (int) mach->ConstsSize[constbuf]) {
-               if (0) {
-                  /* Debug: print warning */
-                  static int count = 0;
-                  if (count++ < 100)
-                     debug_printf("TGSI Exec: const buffer index %d"
-                                  " out of bounds\n", pos);
-               }
-               chan->u[i] = 0;
+      *per_lane = FALSE;
+
+      if (index < 0) {
+         return NULL;
+      } else {
+         /* NOTE: copying the const value as a uint instead of float */
+         const uint *buf = (const uint *)mach->Consts[index2D];
+         const int pos = index * 4 + swizzle;
+         /* const buffer bounds check */
+         if (pos < 0 || pos >= (int) mach->ConstsSize[index2D]) {
+            if (0) {
+               /* Debug: print warning */
+               static int count = 0;
+               if (count++ < 100)
+                  debug_printf("TGSI Exec: const buffer index %d"
+                               " out of bounds\n", pos);
             }
-            else
-               chan->u[i] = buf[pos];
+            return NULL;
          }
+         return &buf[pos];
       }
-      break;
 
-   case TGSI_FILE_INPUT:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
-         /*
-         if (PIPE_SHADER_GEOMETRY == mach->ShaderType) {
-            debug_printf("Fetching Input[%d] (2d=%d, 1d=%d)\n",
-                         index2D->i[i] * TGSI_EXEC_MAX_INPUT_ATTRIBS + index->i[i],
-                         index2D->i[i], index->i[i]);
-                         }*/
-         int pos = index2D->i[i] * TGSI_EXEC_MAX_INPUT_ATTRIBS + index->i[i];
-         assert(pos >= 0);
-         assert(pos < TGSI_MAX_PRIM_VERTICES * PIPE_MAX_ATTRIBS);
-         chan->u[i] = mach->Inputs[pos].xyzw[swizzle].u[i];
-      }
-      break;
+   case TGSI_FILE_INPUT: {
+      /*
+      if (PIPE_SHADER_GEOMETRY == mach->ShaderType) {
+         debug_printf("Fetching Input[%d] (2d=%d, 1d=%d)\n",
+                      index2D * TGSI_EXEC_MAX_INPUT_ATTRIBS + index,
+                      index2D, index);
+                      }*/
+      int pos = index2D * TGSI_EXEC_MAX_INPUT_ATTRIBS + index;
+      assert(pos >= 0);
+      assert(pos < TGSI_MAX_PRIM_VERTICES * PIPE_MAX_ATTRIBS);
+      return mach->Inputs[pos].xyzw[swizzle].u;
+   }
 
    case TGSI_FILE_SYSTEM_VALUE:
       /* XXX no swizzling at this point.  Will be needed if we put
        * gl_FragCoord, for example, in a sys value register.
        */
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
-         chan->u[i] = mach->SystemValue[index->i[i]].xyzw[swizzle].u[i];
-      }
-      break;
+      return mach->SystemValue[index].xyzw[swizzle].u;
 
    case TGSI_FILE_TEMPORARY:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
-         assert(index->i[i] < TGSI_EXEC_NUM_TEMPS);
-         assert(index2D->i[i] == 0);
-
-         chan->u[i] = mach->Temps[index->i[i]].xyzw[swizzle].u[i];
-      }
-      break;
+      assert(index < TGSI_EXEC_NUM_TEMPS);
+      assert(index2D == 0);
+      return mach->Temps[index].xyzw[swizzle].u;
 
    case TGSI_FILE_IMMEDIATE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
-         assert(index->i[i] >= 0 && index->i[i] < (int)mach->ImmLimit);
-         assert(index2D->i[i] == 0);
-
-         chan->f[i] = mach->Imms[index->i[i]][swizzle];
-      }
-      break;
+      assert(index >= 0 && index < (int)mach->ImmLimit);
+      assert(index2D == 0);
+      *per_lane = FALSE;
+      return (const uint *)&mach->Imms[index][swizzle];
 
    case TGSI_FILE_ADDRESS:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
-         assert(index->i[i] >= 0);
-         assert(index2D->i[i] == 0);
-
-         chan->u[i] = mach->Addrs[index->i[i]].xyzw[swizzle].u[i];
-      }
-      break;
+      assert(index >= 0);
+      assert(index2D == 0);
+      return mach->Addrs[index].xyzw[swizzle].u;
 
    case TGSI_FILE_OUTPUT:
       /* vertex/fragment output vars can be read too */
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
-         assert(index->i[i] >= 0);
-         assert(index2D->i[i] == 0);
-
-         chan->u[i] = mach->Outputs[index->i[i]].xyzw[swizzle].u[i];
-      }
-      break;
+      assert(index >= 0);
+      assert(index2D == 0);
+      return mach->Outputs[index].xyzw[swizzle].u;
 
    default:
       assert(0);
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      return NULL;
+   }
+}
+
+static void
+fetch_src_file_channel(const struct tgsi_exec_machine *mach,
+                       const uint chan_index,
+                       const uint file,
+                       const uint swizzle,
+                       const union tgsi_exec_channel *index,
+                       const union tgsi_exec_channel *index2D,
+                       union tgsi_exec_channel *chan)
+{
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
+      boolean per_lane;
+      const uint *elem = get_src_file_element(mach, file, swizzle,
+                                              index->i[i], index2D->i[i],
+                                              &per_lane);
+
+      if (!elem)
          chan->u[i] = 0;
-      }
+      else
+         chan->u[i] = per_lane ? elem[i] : elem[0];
+   }
+}
+
+/**
+ * Same as fetch_src_file_channel(), for a register which is the same in
+ * all the lanes, so that whole channels can be copied.
+ */
+static inline void
+fetch_src_file_channel_direct(const struct tgsi_exec_machine *mach,
+                              const uint file,
+                              const uint swizzle,
+                              const int index,
+                              const int index2D,
+                              union tgsi_exec_channel *chan)
+{
+   boolean per_lane;
+   const uint *elem = get_src_file_element(mach, file, swizzle,
+                                           index, index2D, &per_lane);
+   uint i;
+
+   if (!elem) {
+      for (i = 0; i < TGSI_EXEC_LANES; i++)
+         chan->u[i] = 0;
+   } else if (per_lane) {
+      for (i = 0; i < TGSI_EXEC_LANES; i++)
+         chan->u[i] = elem[i];
+   } else {
+      for (i = 0; i < TGSI_EXEC_LANES; i++)
+         chan->u[i] = elem[0];
    }
 }
 
@@ -1598,6 +1800,22 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
    union tgsi_exec_channel index2D;
    uint swizzle;
 
+   /* Without indirect addressing, which is the common case, all the lanes
+    * read the same register.
+    */
+   if (!reg->Register.Indirect &&
+       !(reg->Register.Dimension && reg->Dimension.Indirect)) {
+      fetch_src_file_channel_direct(mach,
+                                    reg->Register.File,
+                                    tgsi_util_get_full_src_register_swizzle(
+                                       reg, chan_index),
+                                    reg->Register.Index,
+                                    reg->Register.Dimension ?
+                                       reg->Dimension.Index : 0,
+                                    chan);
+      return;
+   }
+
    /* We start with a direct index into a register file.
     *
     *    file[1],
@@ -1605,10 +1823,7 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
     *       file = Register.File
     *       [1] = Register.Index
     */
-   index.i[0] =
-   index.i[1] =
-   index.i[2] =
-   index.i[3] = reg->Register.Index;
+   set_channel_int(&index, reg->Register.Index);
 
    /* There is an extra source register that indirectly subscripts
     * a register file. The direct index now becomes an offset
@@ -1627,10 +1842,7 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
       uint i;
 
       /* which address register (always zero now) */
-      index2.i[0] =
-      index2.i[1] =
-      index2.i[2] =
-      index2.i[3] = reg->Indirect.Index;
+      set_channel_int(&index2, reg->Indirect.Index);
       /* get current value of address register[swizzle] */
       swizzle = reg->Indirect.Swizzle;
       fetch_src_file_channel(mach,
@@ -1642,15 +1854,13 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
                              &indir_index);
 
       /* add value of address register to the offset */
-      index.i[0] += indir_index.i[0];
-      index.i[1] += indir_index.i[1];
-      index.i[2] += indir_index.i[2];
-      index.i[3] += indir_index.i[3];
+      for (i = 0; i < TGSI_EXEC_LANES; i++)
+         index.i[i] += indir_index.i[i];
 
       /* for disabled execution channels, zero-out the index to
        * avoid using a potential garbage value.
        */
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < TGSI_EXEC_LANES; i++) {
          if ((execmask & (1 << i)) == 0)
             index.i[i] = 0;
       }
@@ -1665,10 +1875,7 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
     *       [3] = Dimension.Index
     */
    if (reg->Register.Dimension) {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = reg->Dimension.Index;
+      set_channel_int(&index2D, reg->Dimension.Index);
 
       /* Again, the second subscript index can be addressed indirectly
        * identically to the first one.
@@ -1687,10 +1894,7 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
          const uint execmask = mach->ExecMask;
          uint i;
 
-         index2.i[0] =
-         index2.i[1] =
-         index2.i[2] =
-         index2.i[3] = reg->DimIndirect.Index;
+         set_channel_int(&index2, reg->DimIndirect.Index);
 
          swizzle = reg->DimIndirect.Swizzle;
          fetch_src_file_channel(mach,
@@ -1701,15 +1905,13 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
                                 &ZeroVec,
                                 &indir_index);
 
-         index2D.i[0] += indir_index.i[0];
-         index2D.i[1] += indir_index.i[1];
-         index2D.i[2] += indir_index.i[2];
-         index2D.i[3] += indir_index.i[3];
+         for (i = 0; i < TGSI_EXEC_LANES; i++)
+            index2D.i[i] += indir_index.i[i];
 
          /* for disabled execution channels, zero-out the index to
           * avoid using a potential garbage value.
           */
-         for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+         for (i = 0; i < TGSI_EXEC_LANES; i++) {
             if ((execmask & (1 << i)) == 0) {
                index2D.i[i] = 0;
             }
@@ -1721,10 +1923,7 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
        * by a dimension register and continue the saga.
        */
    } else {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = 0;
+      set_channel_int(&index2D, 0);
    }
 
    swizzle = tgsi_util_get_full_src_register_swizzle( reg, chan_index );
@@ -1798,10 +1997,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
       uint swizzle;
 
       /* which address register (always zero for now) */
-      index.i[0] =
-      index.i[1] =
-      index.i[2] =
-      index.i[3] = reg->Indirect.Index;
+      set_channel_int(&index, reg->Indirect.Index);
 
       /* get current value of address register[swizzle] */
       swizzle = reg->Indirect.Swizzle;
@@ -1828,10 +2024,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
     *       [3] = Dimension.Index
     */
    if (reg->Register.Dimension) {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = reg->Dimension.Index;
+      set_channel_int(&index2D, reg->Dimension.Index);
 
       /* Again, the second subscript index can be addressed indirectly
        * identically to the first one.
@@ -1851,10 +2044,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
          unsigned swizzle;
          uint i;
 
-         index2.i[0] =
-         index2.i[1] =
-         index2.i[2] =
-         index2.i[3] = reg->DimIndirect.Index;
+         set_channel_int(&index2, reg->DimIndirect.Index);
 
          swizzle = reg->DimIndirect.Swizzle;
          fetch_src_file_channel(mach,
@@ -1865,15 +2055,13 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
                                 &ZeroVec,
                                 &indir_index);
 
-         index2D.i[0] += indir_index.i[0];
-         index2D.i[1] += indir_index.i[1];
-         index2D.i[2] += indir_index.i[2];
-         index2D.i[3] += indir_index.i[3];
+         for (i = 0; i < TGSI_EXEC_LANES; i++)
+            index2D.i[i] += indir_index.i[i];
 
          /* for disabled execution channels, zero-out the index to
           * avoid using a potential garbage value.
           */
-         for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+         for (i = 0; i < TGSI_EXEC_LANES; i++) {
             if ((execmask & (1 << i)) == 0) {
                index2D.i[i] = 0;
             }
@@ -1885,10 +2073,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
        * by a dimension register and continue the saga.
        */
    } else {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = 0;
+      set_channel_int(&index2D, 0);
    }
 
    switch (reg->Register.File) {
@@ -1906,7 +2091,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
                    reg->Register.Index);
       if (PIPE_SHADER_GEOMETRY == mach->ShaderType) {
          debug_printf("STORING OUT[%d] mask(%d), = (", offset + index, execmask);
-         for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         for (i = 0; i < TGSI_EXEC_LANES; i++)
             if (execmask & (1 << i))
                debug_printf("%f, ", chan->f[i]);
          debug_printf(")\n");
@@ -1951,7 +2136,7 @@ store_dest_double(struct tgsi_exec_machine *mach,
       return;
 
    /* doubles path */
-   for (i = 0; i < TGSI_QUAD_SIZE; i++)
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
       if (execmask & (1 << i))
          dst->i[i] = chan->i[i];
 }
@@ -1973,13 +2158,32 @@ store_dest(struct tgsi_exec_machine *mach,
    if (!dst)
       return;
 
+   /* All the lanes enabled is the common case, and needs no per-lane
+    * tests.
+    */
+   if (execmask == TGSI_EXEC_LANE_MASK) {
+      if (!inst->Instruction.Saturate) {
+         *dst = *chan;
+      } else {
+         for (i = 0; i < TGSI_EXEC_LANES; i++) {
+            if (chan->f[i] < 0.0f)
+               dst->f[i] = 0.0f;
+            else if (chan->f[i] > 1.0f)
+               dst->f[i] = 1.0f;
+            else
+               dst->i[i] = chan->i[i];
+         }
+      }
+      return;
+   }
+
    if (!inst->Instruction.Saturate) {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < TGSI_EXEC_LANES; i++)
          if (execmask & (1 << i))
             dst->i[i] = chan->i[i];
    }
    else {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < TGSI_EXEC_LANES; i++)
          if (execmask & (1 << i)) {
             if (chan->f[i] < 0.0f)
                dst->f[i] = 0.0f;
@@ -2030,7 +2234,7 @@ exec_kill_if(struct tgsi_exec_machine *mach,
       uniquemask |= 1 << swizzle;
 
       FETCH(&r[0], 0, chan_index);
-      for (i = 0; i < 4; i++)
+      for (i = 0; i < TGSI_EXEC_LANES; i++)
          if (r[0].f[i] < 0.0f)
             kilmask |= 1 << i;
    }
@@ -2102,7 +2306,8 @@ conditional_emit_primitive(struct tgsi_exec_machine *mach)
 
 
 /*
- * Fetch four texture samples using STR texture coordinates.
+ * Fetch texture samples for all the lanes using STR texture coordinates.
+ * The sampler takes one quad at a time.
  */
 static void
 fetch_texel( struct tgsi_sampler *sampler,
@@ -2113,7 +2318,7 @@ fetch_texel( struct tgsi_sampler *sampler,
              const union tgsi_exec_channel *p,
              const union tgsi_exec_channel *c0,
              const union tgsi_exec_channel *c1,
-             float derivs[3][2][TGSI_QUAD_SIZE],
+             float derivs[3][2][TGSI_EXEC_LANES],
              const int8_t offset[3],
              enum tgsi_sampler_control control,
              union tgsi_exec_channel *r,
@@ -2121,18 +2326,33 @@ fetch_texel( struct tgsi_sampler *sampler,
              union tgsi_exec_channel *b,
              union tgsi_exec_channel *a )
 {
-   uint j;
+   uint j, q;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
+   float quad_derivs[3][2][TGSI_QUAD_SIZE];
+
+   for (q = 0; q < TGSI_EXEC_LANES; q += TGSI_QUAD_SIZE) {
+      if (derivs) {
+         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+            quad_derivs[0][0][j] = derivs[0][0][q + j];
+            quad_derivs[0][1][j] = derivs[0][1][q + j];
+            quad_derivs[1][0][j] = derivs[1][0][q + j];
+            quad_derivs[1][1][j] = derivs[1][1][q + j];
+            quad_derivs[2][0][j] = derivs[2][0][q + j];
+            quad_derivs[2][1][j] = derivs[2][1][q + j];
+         }
+      }
 
-   /* FIXME: handle explicit derivs, offsets */
-   sampler->get_samples(sampler, sview_idx, sampler_idx,
-                        s->f, t->f, p->f, c0->f, c1->f, derivs, offset, control, rgba);
+      /* FIXME: handle explicit derivs, offsets */
+      sampler->get_samples(sampler, sview_idx, sampler_idx,
+                           &s->f[q], &t->f[q], &p->f[q], &c0->f[q], &c1->f[q],
+                           derivs ? quad_derivs : NULL, offset, control, rgba);
 
-   for (j = 0; j < 4; j++) {
-      r->f[j] = rgba[0][j];
-      g->f[j] = rgba[1][j];
-      b->f[j] = rgba[2][j];
-      a->f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r->f[q + j] = rgba[0][j];
+         g->f[q + j] = rgba[1][j];
+         b->f[q + j] = rgba[2][j];
+         a->f[q + j] = rgba[3][j];
+      }
    }
 }
 
@@ -2155,7 +2375,7 @@ fetch_texel_offsets(struct tgsi_exec_machine *mach,
    if (inst->Texture.NumOffsets == 1) {
       union tgsi_exec_channel index;
       union tgsi_exec_channel offset[3];
-      index.i[0] = index.i[1] = index.i[2] = index.i[3] = inst->TexOffsets[0].Index;
+      set_channel_int(&index, inst->TexOffsets[0].Index);
       fetch_src_file_channel(mach, 0, inst->TexOffsets[0].File,
                              inst->TexOffsets[0].SwizzleX, &index, &ZeroVec, &offset[0]);
       fetch_src_file_channel(mach, 0, inst->TexOffsets[0].File,
@@ -2181,19 +2401,17 @@ fetch_assign_deriv_channel(struct tgsi_exec_machine *mach,
                            const struct tgsi_full_instruction *inst,
                            unsigned regdsrcx,
                            unsigned chan,
-                           float derivs[2][TGSI_QUAD_SIZE])
+                           float derivs[2][TGSI_EXEC_LANES])
 {
    union tgsi_exec_channel d;
+   uint i;
+
    FETCH(&d, regdsrcx, chan);
-   derivs[0][0] = d.f[0];
-   derivs[0][1] = d.f[1];
-   derivs[0][2] = d.f[2];
-   derivs[0][3] = d.f[3];
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      derivs[0][i] = d.f[i];
    FETCH(&d, regdsrcx + 1, chan);
-   derivs[1][0] = d.f[0];
-   derivs[1][1] = d.f[1];
-   derivs[1][2] = d.f[2];
-   derivs[1][3] = d.f[3];
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      derivs[1][i] = d.f[i];
 }
 
 static uint
@@ -2207,10 +2425,7 @@ fetch_sampler_unit(struct tgsi_exec_machine *mach,
       const struct tgsi_full_src_register *reg = &inst->Src[sampler];
       union tgsi_exec_channel indir_index, index2;
       const uint execmask = mach->ExecMask;
-      index2.i[0] =
-      index2.i[1] =
-      index2.i[2] =
-      index2.i[3] = reg->Indirect.Index;
+      set_channel_int(&index2, reg->Indirect.Index);
 
       fetch_src_file_channel(mach,
                              0,
@@ -2219,7 +2434,7 @@ fetch_sampler_unit(struct tgsi_exec_machine *mach,
                              &index2,
                              &ZeroVec,
                              &indir_index);
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < TGSI_EXEC_LANES; i++) {
          if (execmask & (1 << i)) {
             unit = inst->Src[sampler].Register.Index + indir_index.i[i];
             break;
@@ -2357,6 +2572,7 @@ exec_lodq(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel coords[4];
    const union tgsi_exec_channel *args[ARRAY_SIZE(coords)];
    union tgsi_exec_channel r[2];
+   uint q;
 
    resource_unit = fetch_sampler_unit(mach, inst, 1);
    if (inst->Instruction.Opcode == TGSI_OPCODE_LOD) {
@@ -2376,14 +2592,16 @@ exec_lodq(struct tgsi_exec_machine *mach,
    for (i = dim; i < ARRAY_SIZE(coords); i++) {
       args[i] = &ZeroVec;
    }
-   mach->Sampler->query_lod(mach->Sampler, resource_unit, sampler_unit,
-                            args[0]->f,
-                            args[1]->f,
-                            args[2]->f,
-                            args[3]->f,
-                            TGSI_SAMPLER_LOD_NONE,
-                            r[0].f,
-                            r[1].f);
+   for (q = 0; q < TGSI_EXEC_LANES; q += TGSI_QUAD_SIZE) {
+      mach->Sampler->query_lod(mach->Sampler, resource_unit, sampler_unit,
+                               &args[0]->f[q],
+                               &args[1]->f[q],
+                               &args[2]->f[q],
+                               &args[3]->f[q],
+                               TGSI_SAMPLER_LOD_NONE,
+                               &r[0].f[q],
+                               &r[1].f[q]);
+   }
 
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
       store_dest(mach, &r[0], &inst->Dst[0], inst, TGSI_CHAN_X,
@@ -2429,7 +2647,7 @@ exec_txd(struct tgsi_exec_machine *mach,
          const struct tgsi_full_instruction *inst)
 {
    union tgsi_exec_channel r[4];
-   float derivs[3][2][TGSI_QUAD_SIZE];
+   float derivs[3][2][TGSI_EXEC_LANES];
    uint chan;
    uint unit;
    int8_t offsets[3];
@@ -2541,6 +2759,7 @@ exec_txf(struct tgsi_exec_machine *mach,
    uint unit;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    int j;
+   uint q;
    int8_t offsets[3];
    unsigned target;
 
@@ -2583,14 +2802,16 @@ exec_txf(struct tgsi_exec_machine *mach,
       break;
    }      
 
-   mach->Sampler->get_texel(mach->Sampler, unit, r[0].i, r[1].i, r[2].i, r[3].i,
-                            offsets, rgba);
+   for (q = 0; q < TGSI_EXEC_LANES; q += TGSI_QUAD_SIZE) {
+      mach->Sampler->get_texel(mach->Sampler, unit, &r[0].i[q], &r[1].i[q],
+                               &r[2].i[q], &r[3].i[q], offsets, rgba);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
 
    if (inst->Instruction.Opcode == TGSI_OPCODE_SAMPLE_I ||
@@ -2634,7 +2855,7 @@ exec_txq(struct tgsi_exec_machine *mach,
    /* XXX: This interface can't return per-pixel values */
    mach->Sampler->get_dims(mach->Sampler, unit, src.i[0], result);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
       for (j = 0; j < 4; j++) {
          r[j].i[i] = result[j];
       }
@@ -2789,7 +3010,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
    const uint resource_unit = inst->Src[1].Register.Index;
    const uint sampler_unit = inst->Src[2].Register.Index;
    union tgsi_exec_channel r[4];
-   float derivs[3][2][TGSI_QUAD_SIZE];
+   float derivs[3][2][TGSI_EXEC_LANES];
    uint chan;
    unsigned char swizzles[4];
    int8_t offsets[3];
@@ -2877,7 +3098,7 @@ eval_constant_coef(
 {
    unsigned i;
 
-   for( i = 0; i < TGSI_QUAD_SIZE; i++ ) {
+   for( i = 0; i < TGSI_EXEC_LANES; i++ ) {
       mach->Inputs[attrib].xyzw[chan].f[i] = mach->InterpCoefs[attrib].a0[chan];
    }
 }
@@ -3265,7 +3486,7 @@ exec_pk2h(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-   for (chan = 0; chan < TGSI_QUAD_SIZE; chan++) {
+   for (chan = 0; chan < TGSI_EXEC_LANES; chan++) {
       dst.u[chan] = util_float_to_half(arg[0].f[chan]) |
          (util_float_to_half(arg[1].f[chan]) << 16);
    }
@@ -3284,7 +3505,7 @@ exec_up2h(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel arg, dst[2];
 
    fetch_source(mach, &arg, &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_UINT);
-   for (chan = 0; chan < TGSI_QUAD_SIZE; chan++) {
+   for (chan = 0; chan < TGSI_EXEC_LANES; chan++) {
       dst[0].f[chan] = util_half_to_float(arg.u[chan] & 0xffff);
       dst[1].f[chan] = util_half_to_float(arg.u[chan] >> 16);
    }
@@ -3301,10 +3522,10 @@ micro_ucmp(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src1,
            const union tgsi_exec_channel *src2)
 {
-   dst->f[0] = src0->u[0] ? src1->f[0] : src2->f[0];
-   dst->f[1] = src0->u[1] ? src1->f[1] : src2->f[1];
-   dst->f[2] = src0->u[2] ? src1->f[2] : src2->f[2];
-   dst->f[3] = src0->u[3] ? src1->f[3] : src2->f[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = src0->u[i] ? src1->f[i] : src2->f[i];
 }
 
 static void
@@ -3495,20 +3716,14 @@ exec_case(struct tgsi_exec_machine *mach,
    uint prevMask = mach->SwitchStack[mach->SwitchStackTop - 1].mask;
    union tgsi_exec_channel src;
    uint mask = 0;
+   uint i;
 
    fetch_source(mach, &src, &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_UINT);
 
-   if (mach->Switch.selector.u[0] == src.u[0]) {
-      mask |= 0x1;
-   }
-   if (mach->Switch.selector.u[1] == src.u[1]) {
-      mask |= 0x2;
-   }
-   if (mach->Switch.selector.u[2] == src.u[2]) {
-      mask |= 0x4;
-   }
-   if (mach->Switch.selector.u[3] == src.u[3]) {
-      mask |= 0x8;
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
+      if (mach->Switch.selector.u[i] == src.u[i]) {
+         mask |= 1 << i;
+      }
    }
 
    mach->Switch.defaultMask |= mask;
@@ -3564,7 +3779,7 @@ fetch_double_channel(struct tgsi_exec_machine *mach,
    fetch_source_d(mach, &src[0], reg, chan_0, TGSI_EXEC_DATA_UINT);
    fetch_source_d(mach, &src[1], reg, chan_1, TGSI_EXEC_DATA_UINT);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
       chan->u[i][0] = src[0].u[i];
       chan->u[i][1] = src[1].u[i];
    }
@@ -3590,14 +3805,14 @@ store_double_channel(struct tgsi_exec_machine *mach,
    const uint execmask = mach->ExecMask;
 
    if (!inst->Instruction.Saturate) {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < TGSI_EXEC_LANES; i++)
          if (execmask & (1 << i)) {
             dst[0].u[i] = chan->u[i][0];
             dst[1].u[i] = chan->u[i][1];
          }
    }
    else {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < TGSI_EXEC_LANES; i++)
          if (execmask & (1 << i)) {
             if (chan->d[i] < 0.0)
                temp.d[i] = 0.0;
@@ -3831,16 +4046,17 @@ exec_load_img(struct tgsi_exec_machine *mach,
    int i, j;
    int dim;
    uint chan;
+   uint q;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    struct tgsi_image_params params;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
+   uint execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
 
    unit = fetch_sampler_unit(mach, inst, 0);
    dim = get_image_coord_dim(inst->Memory.Texture);
    sample = get_image_coord_sample(inst->Memory.Texture);
    assert(dim <= 3);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.tgsi_tex_instr = inst->Memory.Texture;
    params.format = inst->Memory.Format;
@@ -3852,14 +4068,17 @@ exec_load_img(struct tgsi_exec_machine *mach,
    if (sample)
       IFETCH(&sample_r, 1, TGSI_CHAN_X + sample);
 
-   mach->Image->load(mach->Image, &params,
-                     r[0].i, r[1].i, r[2].i, sample_r.i,
-                     rgba);
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+   for (q = 0; q < TGSI_EXEC_LANES; q += TGSI_QUAD_SIZE) {
+      params.execmask = (execmask >> q) & 0xf;
+      mach->Image->load(mach->Image, &params,
+                        &r[0].i[q], &r[1].i[q], &r[2].i[q], &sample_r.i[q],
+                        rgba);
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -3875,24 +4094,28 @@ exec_load_buf(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel r[4];
    uint unit;
    int j;
+   uint q;
    uint chan;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    struct tgsi_buffer_params params;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
+   uint execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
 
    unit = fetch_sampler_unit(mach, inst, 0);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    IFETCH(&r[0], 1, TGSI_CHAN_X);
 
-   mach->Buffer->load(mach->Buffer, &params,
-                      r[0].i, rgba);
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+   for (q = 0; q < TGSI_EXEC_LANES; q += TGSI_QUAD_SIZE) {
+      params.execmask = (execmask >> q) & 0xf;
+      mach->Buffer->load(mach->Buffer, &params,
+                         &r[0].i[q], rgba);
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -3907,22 +4130,21 @@ exec_load_mem(struct tgsi_exec_machine *mach,
 {
    union tgsi_exec_channel r[4];
    uint chan;
-   char *ptr = mach->LocalMem;
+   char *ptr;
    uint32_t offset;
    int j;
 
    IFETCH(&r[0], 1, TGSI_CHAN_X);
-   if (r[0].u[0] >= mach->LocalMemSize)
-      return;
-
-   offset = r[0].u[0];
-   ptr += offset;
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+   /* each lane reads from its own address */
+   for (j = 0; j < TGSI_EXEC_LANES; j++) {
+      offset = r[0].u[j];
+      ptr = (char *)mach->LocalMem + offset;
       for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
-         if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
+         if (offset >= mach->LocalMemSize)
+            r[chan].u[j] = 0;
+         else if (inst->Dst[0].Register.WriteMask & (1 << chan))
             memcpy(&r[chan].u[j], ptr + (4 * chan), 4);
-         }
       }
    }
 
@@ -3956,14 +4178,15 @@ exec_store_img(struct tgsi_exec_machine *mach,
    int dim;
    int sample;
    int i, j;
+   uint q;
    uint unit;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
+   uint execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    unit = inst->Dst[0].Register.Index;
    dim = get_image_coord_dim(inst->Memory.Texture);
    sample = get_image_coord_sample(inst->Memory.Texture);
    assert(dim <= 3);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.tgsi_tex_instr = inst->Memory.Texture;
    params.format = inst->Memory.Format;
@@ -3978,16 +4201,19 @@ exec_store_img(struct tgsi_exec_machine *mach,
    if (sample)
       IFETCH(&sample_r, 0, TGSI_CHAN_X + sample);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
+   for (q = 0; q < TGSI_EXEC_LANES; q += TGSI_QUAD_SIZE) {
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
 
-   mach->Image->store(mach->Image, &params,
-                      r[0].i, r[1].i, r[2].i, sample_r.i,
-                      rgba);
+      params.execmask = (execmask >> q) & 0xf;
+      mach->Image->store(mach->Image, &params,
+                         &r[0].i[q], &r[1].i[q], &r[2].i[q], &sample_r.i[q],
+                         rgba);
+   }
 }
 
 static void
@@ -3999,12 +4225,13 @@ exec_store_buf(struct tgsi_exec_machine *mach,
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    struct tgsi_buffer_params params;
    int i, j;
+   uint q;
    uint unit;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
+   uint execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
 
    unit = inst->Dst[0].Register.Index;
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.writemask = inst->Dst[0].Register.WriteMask;
 
@@ -4013,16 +4240,19 @@ exec_store_buf(struct tgsi_exec_machine *mach,
       FETCH(&value[i], 1, TGSI_CHAN_X + i);
    }
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
+   for (q = 0; q < TGSI_EXEC_LANES; q += TGSI_QUAD_SIZE) {
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
 
-   mach->Buffer->store(mach->Buffer, &params,
-                      r[0].i,
-                      rgba);
+      params.execmask = (execmask >> q) & 0xf;
+      mach->Buffer->store(mach->Buffer, &params,
+                          &r[0].i[q],
+                          rgba);
+   }
 }
 
 static void
@@ -4032,7 +4262,7 @@ exec_store_mem(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel r[3];
    union tgsi_exec_channel value[4];
    uint i, chan;
-   char *ptr = mach->LocalMem;
+   char *ptr;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
    int execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
 
@@ -4042,15 +4272,13 @@ exec_store_mem(struct tgsi_exec_machine *mach,
       FETCH(&value[i], 1, TGSI_CHAN_X + i);
    }
 
-   if (r[0].u[0] >= mach->LocalMemSize)
-      return;
-   ptr += r[0].u[0];
-
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
-      if (execmask & (1 << i)) {
+   /* each lane writes its own value to its own address */
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
+      if (execmask & (1 << i) && r[0].u[i] < mach->LocalMemSize) {
+         ptr = (char *)mach->LocalMem + r[0].u[i];
          for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
             if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
-               memcpy(ptr + (chan * 4), &value[chan].u[0], 4);
+               memcpy(ptr + (chan * 4), &value[chan].u[i], 4);
             }
          }
       }
@@ -4081,14 +4309,15 @@ exec_atomop_img(struct tgsi_exec_machine *mach,
    int dim;
    int sample;
    int i, j;
+   uint q;
    uint unit, chan;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
+   uint execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    unit = fetch_sampler_unit(mach, inst, 0);
    dim = get_image_coord_dim(inst->Memory.Texture);
    sample = get_image_coord_sample(inst->Memory.Texture);
    assert(dim <= 3);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.tgsi_tex_instr = inst->Memory.Texture;
    params.format = inst->Memory.Format;
@@ -4105,30 +4334,33 @@ exec_atomop_img(struct tgsi_exec_machine *mach,
    if (sample)
       IFETCH(&sample_r, 1, TGSI_CHAN_X + sample);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
-   if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+   for (q = 0; q < TGSI_EXEC_LANES; q += TGSI_QUAD_SIZE) {
       for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-         rgba2[0][j] = value2[0].f[j];
-         rgba2[1][j] = value2[1].f[j];
-         rgba2[2][j] = value2[2].f[j];
-         rgba2[3][j] = value2[3].f[j];
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
+      if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+            rgba2[0][j] = value2[0].f[q + j];
+            rgba2[1][j] = value2[1].f[q + j];
+            rgba2[2][j] = value2[2].f[q + j];
+            rgba2[3][j] = value2[3].f[q + j];
+         }
       }
-   }
 
-   mach->Image->op(mach->Image, &params, inst->Instruction.Opcode,
-                   r[0].i, r[1].i, r[2].i, sample_r.i,
-                   rgba, rgba2);
+      params.execmask = (execmask >> q) & 0xf;
+      mach->Image->op(mach->Image, &params, inst->Instruction.Opcode,
+                      &r[0].i[q], &r[1].i[q], &r[2].i[q], &sample_r.i[q],
+                      rgba, rgba2);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -4147,12 +4379,13 @@ exec_atomop_buf(struct tgsi_exec_machine *mach,
    float rgba2[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    struct tgsi_buffer_params params;
    int i, j;
+   uint q;
    uint unit, chan;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
+   uint execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
 
    unit = fetch_sampler_unit(mach, inst, 0);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.writemask = inst->Dst[0].Register.WriteMask;
 
@@ -4164,30 +4397,33 @@ exec_atomop_buf(struct tgsi_exec_machine *mach,
          FETCH(&value2[i], 3, TGSI_CHAN_X + i);
    }
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
-   if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+   for (q = 0; q < TGSI_EXEC_LANES; q += TGSI_QUAD_SIZE) {
       for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-         rgba2[0][j] = value2[0].f[j];
-         rgba2[1][j] = value2[1].f[j];
-         rgba2[2][j] = value2[2].f[j];
-         rgba2[3][j] = value2[3].f[j];
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
+      if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+            rgba2[0][j] = value2[0].f[q + j];
+            rgba2[1][j] = value2[1].f[q + j];
+            rgba2[2][j] = value2[2].f[q + j];
+            rgba2[3][j] = value2[3].f[q + j];
+         }
       }
-   }
 
-   mach->Buffer->op(mach->Buffer, &params, inst->Instruction.Opcode,
-                   r[0].i,
-                   rgba, rgba2);
+      params.execmask = (execmask >> q) & 0xf;
+      mach->Buffer->op(mach->Buffer, &params, inst->Instruction.Opcode,
+                       &r[0].i[q],
+                       rgba, rgba2);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -4202,65 +4438,67 @@ exec_atomop_mem(struct tgsi_exec_machine *mach,
 {
    union tgsi_exec_channel r[4];
    union tgsi_exec_channel value[4], value2[4];
-   char *ptr = mach->LocalMem;
+   char *ptr;
    uint32_t val;
    uint chan, i;
-   uint32_t offset;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
    int execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    IFETCH(&r[0], 1, TGSI_CHAN_X);
 
-   if (r[0].u[0] >= mach->LocalMemSize)
-      return;
-
-   offset = r[0].u[0];
-   ptr += offset;
    for (i = 0; i < 4; i++) {
       FETCH(&value[i], 2, TGSI_CHAN_X + i);
       if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS)
          FETCH(&value2[i], 3, TGSI_CHAN_X + i);
    }
 
-   memcpy(&r[0].u[0], ptr, 4);
-   val = r[0].u[0];
-   switch (inst->Instruction.Opcode) {
-   case TGSI_OPCODE_ATOMUADD:
-      val += value[0].u[0];
-      break;
-   case TGSI_OPCODE_ATOMXOR:
-      val ^= value[0].u[0];
-      break;
-   case TGSI_OPCODE_ATOMOR:
-      val |= value[0].u[0];
-      break;
-   case TGSI_OPCODE_ATOMAND:
-      val &= value[0].u[0];
-      break;
-   case TGSI_OPCODE_ATOMUMIN:
-      val = MIN2(val, value[0].u[0]);
-      break;
-   case TGSI_OPCODE_ATOMUMAX:
-      val = MAX2(val, value[0].u[0]);
-      break;
-   case TGSI_OPCODE_ATOMIMIN:
-      val = MIN2(r[0].i[0], value[0].i[0]);
-      break;
-   case TGSI_OPCODE_ATOMIMAX:
-      val = MAX2(r[0].i[0], value[0].i[0]);
-      break;
-   case TGSI_OPCODE_ATOMXCHG:
-      val = value[0].i[0];
-      break;
-   case TGSI_OPCODE_ATOMCAS:
-      if (val == value[0].u[0])
-         val = value2[0].u[0];
-      break;
-   default:
-      break;
-   }
-   for (i = 0; i < TGSI_QUAD_SIZE; i++)
+   /* the lanes update their addresses one after the other */
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
+      if (r[0].u[i] >= mach->LocalMemSize) {
+         r[0].u[i] = 0;
+         continue;
+      }
+      ptr = (char *)mach->LocalMem + r[0].u[i];
+
+      memcpy(&r[0].u[i], ptr, 4);
+      val = r[0].u[i];
+      switch (inst->Instruction.Opcode) {
+      case TGSI_OPCODE_ATOMUADD:
+         val += value[0].u[i];
+         break;
+      case TGSI_OPCODE_ATOMXOR:
+         val ^= value[0].u[i];
+         break;
+      case TGSI_OPCODE_ATOMOR:
+         val |= value[0].u[i];
+         break;
+      case TGSI_OPCODE_ATOMAND:
+         val &= value[0].u[i];
+         break;
+      case TGSI_OPCODE_ATOMUMIN:
+         val = MIN2(val, value[0].u[i]);
+         break;
+      case TGSI_OPCODE_ATOMUMAX:
+         val = MAX2(val, value[0].u[i]);
+         break;
+      case TGSI_OPCODE_ATOMIMIN:
+         val = MIN2(r[0].i[i], value[0].i[i]);
+         break;
+      case TGSI_OPCODE_ATOMIMAX:
+         val = MAX2(r[0].i[i], value[0].i[i]);
+         break;
+      case TGSI_OPCODE_ATOMXCHG:
+         val = value[0].i[i];
+         break;
+      case TGSI_OPCODE_ATOMCAS:
+         if (val == value[0].u[i])
+            val = value2[0].u[i];
+         break;
+      default:
+         break;
+      }
       if (execmask & (1 << i))
          memcpy(ptr, &val, 4);
+   }
 
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -4301,7 +4539,7 @@ exec_resq_img(struct tgsi_exec_machine *mach,
 
    mach->Image->get_dims(mach->Image, &params, result);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
       for (j = 0; j < 4; j++) {
          r[j].i[i] = result[j];
       }
@@ -4333,7 +4571,7 @@ exec_resq_buf(struct tgsi_exec_machine *mach,
 
    mach->Buffer->get_dims(mach->Buffer, &params, &result);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
       r[0].i[i] = result;
    }
 
@@ -4359,100 +4597,100 @@ static void
 micro_f2u64(union tgsi_double_channel *dst,
             const union tgsi_exec_channel *src)
 {
-   dst->u64[0] = (uint64_t)src->f[0];
-   dst->u64[1] = (uint64_t)src->f[1];
-   dst->u64[2] = (uint64_t)src->f[2];
-   dst->u64[3] = (uint64_t)src->f[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u64[i] = (uint64_t)src->f[i];
 }
 
 static void
 micro_f2i64(union tgsi_double_channel *dst,
             const union tgsi_exec_channel *src)
 {
-   dst->i64[0] = (int64_t)src->f[0];
-   dst->i64[1] = (int64_t)src->f[1];
-   dst->i64[2] = (int64_t)src->f[2];
-   dst->i64[3] = (int64_t)src->f[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i64[i] = (int64_t)src->f[i];
 }
 
 static void
 micro_u2i64(union tgsi_double_channel *dst,
             const union tgsi_exec_channel *src)
 {
-   dst->u64[0] = (uint64_t)src->u[0];
-   dst->u64[1] = (uint64_t)src->u[1];
-   dst->u64[2] = (uint64_t)src->u[2];
-   dst->u64[3] = (uint64_t)src->u[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u64[i] = (uint64_t)src->u[i];
 }
 
 static void
 micro_i2i64(union tgsi_double_channel *dst,
             const union tgsi_exec_channel *src)
 {
-   dst->i64[0] = (int64_t)src->i[0];
-   dst->i64[1] = (int64_t)src->i[1];
-   dst->i64[2] = (int64_t)src->i[2];
-   dst->i64[3] = (int64_t)src->i[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i64[i] = (int64_t)src->i[i];
 }
 
 static void
 micro_d2u64(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->u64[0] = (uint64_t)src->d[0];
-   dst->u64[1] = (uint64_t)src->d[1];
-   dst->u64[2] = (uint64_t)src->d[2];
-   dst->u64[3] = (uint64_t)src->d[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u64[i] = (uint64_t)src->d[i];
 }
 
 static void
 micro_d2i64(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->i64[0] = (int64_t)src->d[0];
-   dst->i64[1] = (int64_t)src->d[1];
-   dst->i64[2] = (int64_t)src->d[2];
-   dst->i64[3] = (int64_t)src->d[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i64[i] = (int64_t)src->d[i];
 }
 
 static void
 micro_u642d(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = (double)src->u64[0];
-   dst->d[1] = (double)src->u64[1];
-   dst->d[2] = (double)src->u64[2];
-   dst->d[3] = (double)src->u64[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = (double)src->u64[i];
 }
 
 static void
 micro_i642d(union tgsi_double_channel *dst,
            const union tgsi_double_channel *src)
 {
-   dst->d[0] = (double)src->i64[0];
-   dst->d[1] = (double)src->i64[1];
-   dst->d[2] = (double)src->i64[2];
-   dst->d[3] = (double)src->i64[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->d[i] = (double)src->i64[i];
 }
 
 static void
 micro_u642f(union tgsi_exec_channel *dst,
             const union tgsi_double_channel *src)
 {
-   dst->f[0] = (float)src->u64[0];
-   dst->f[1] = (float)src->u64[1];
-   dst->f[2] = (float)src->u64[2];
-   dst->f[3] = (float)src->u64[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = (float)src->u64[i];
 }
 
 static void
 micro_i642f(union tgsi_exec_channel *dst,
             const union tgsi_double_channel *src)
 {
-   dst->f[0] = (float)src->i64[0];
-   dst->f[1] = (float)src->i64[1];
-   dst->f[2] = (float)src->i64[2];
-   dst->f[3] = (float)src->i64[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = (float)src->i64[i];
 }
 
 static void
@@ -4505,20 +4743,30 @@ static void
 micro_i2f(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = (float)src->i[0];
-   dst->f[1] = (float)src->i[1];
-   dst->f[2] = (float)src->i[2];
-   dst->f[3] = (float)src->i[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_cvtepi32_ps(load_si(src, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = (float)src->i[i];
+#endif
 }
 
 static void
 micro_not(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->u[0] = ~src->u[0];
-   dst->u[1] = ~src->u[1];
-   dst->u[2] = ~src->u[2];
-   dst->u[3] = ~src->u[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_si(dst, i, _mm_xor_si128(_mm_set1_epi32(~0), load_si(src, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = ~src->u[i];
+#endif
 }
 
 static void
@@ -4527,14 +4775,12 @@ micro_shl(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x1f;
-   dst->u[0] = src0->u[0] << masked_count;
-   masked_count = src1->u[1] & 0x1f;
-   dst->u[1] = src0->u[1] << masked_count;
-   masked_count = src1->u[2] & 0x1f;
-   dst->u[2] = src0->u[2] << masked_count;
-   masked_count = src1->u[3] & 0x1f;
-   dst->u[3] = src0->u[3] << masked_count;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
+      masked_count = src1->u[i] & 0x1f;
+      dst->u[i] = src0->u[i] << masked_count;
+   }
 }
 
 static void
@@ -4542,10 +4788,15 @@ micro_and(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] & src1->u[0];
-   dst->u[1] = src0->u[1] & src1->u[1];
-   dst->u[2] = src0->u[2] & src1->u[2];
-   dst->u[3] = src0->u[3] & src1->u[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_si(dst, i, _mm_and_si128(load_si(src0, i), load_si(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->u[i] & src1->u[i];
+#endif
 }
 
 static void
@@ -4553,10 +4804,15 @@ micro_or(union tgsi_exec_channel *dst,
          const union tgsi_exec_channel *src0,
          const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] | src1->u[0];
-   dst->u[1] = src0->u[1] | src1->u[1];
-   dst->u[2] = src0->u[2] | src1->u[2];
-   dst->u[3] = src0->u[3] | src1->u[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_si(dst, i, _mm_or_si128(load_si(src0, i), load_si(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->u[i] | src1->u[i];
+#endif
 }
 
 static void
@@ -4564,10 +4820,15 @@ micro_xor(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] ^ src1->u[0];
-   dst->u[1] = src0->u[1] ^ src1->u[1];
-   dst->u[2] = src0->u[2] ^ src1->u[2];
-   dst->u[3] = src0->u[3] ^ src1->u[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_si(dst, i, _mm_xor_si128(load_si(src0, i), load_si(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->u[i] ^ src1->u[i];
+#endif
 }
 
 static void
@@ -4575,20 +4836,25 @@ micro_mod(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
-   dst->i[0] = src1->i[0] ? src0->i[0] % src1->i[0] : ~0;
-   dst->i[1] = src1->i[1] ? src0->i[1] % src1->i[1] : ~0;
-   dst->i[2] = src1->i[2] ? src0->i[2] % src1->i[2] : ~0;
-   dst->i[3] = src1->i[3] ? src0->i[3] % src1->i[3] : ~0;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = src1->i[i] ? src0->i[i] % src1->i[i] : ~0;
 }
 
 static void
 micro_f2i(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->i[0] = (int)src->f[0];
-   dst->i[1] = (int)src->f[1];
-   dst->i[2] = (int)src->f[2];
-   dst->i[3] = (int)src->f[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_si(dst, i, _mm_cvttps_epi32(load_ps(src, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = (int)src->f[i];
+#endif
 }
 
 static void
@@ -4596,10 +4862,15 @@ micro_fseq(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->f[0] == src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] == src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] == src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] == src1->f[3] ? ~0 : 0;
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_cmpeq_ps(load_ps(src0, i), load_ps(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->f[i] == src1->f[i] ? ~0 : 0;
+#endif
 }
 
 static void
@@ -4607,10 +4878,15 @@ micro_fsge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->f[0] >= src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] >= src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] >= src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] >= src1->f[3] ? ~0 : 0;
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_cmpge_ps(load_ps(src0, i), load_ps(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->f[i] >= src1->f[i] ? ~0 : 0;
+#endif
 }
 
 static void
@@ -4618,10 +4894,15 @@ micro_fslt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->f[0] < src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] < src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] < src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] < src1->f[3] ? ~0 : 0;
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_cmplt_ps(load_ps(src0, i), load_ps(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->f[i] < src1->f[i] ? ~0 : 0;
+#endif
 }
 
 static void
@@ -4629,10 +4910,15 @@ micro_fsne(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->f[0] != src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] != src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] != src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] != src1->f[3] ? ~0 : 0;
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_ps(dst, i, _mm_cmpneq_ps(load_ps(src0, i), load_ps(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->f[i] != src1->f[i] ? ~0 : 0;
+#endif
 }
 
 static void
@@ -4640,10 +4926,10 @@ micro_idiv(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->i[0] = src1->i[0] ? src0->i[0] / src1->i[0] : 0;
-   dst->i[1] = src1->i[1] ? src0->i[1] / src1->i[1] : 0;
-   dst->i[2] = src1->i[2] ? src0->i[2] / src1->i[2] : 0;
-   dst->i[3] = src1->i[3] ? src0->i[3] / src1->i[3] : 0;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = src1->i[i] ? src0->i[i] / src1->i[i] : 0;
 }
 
 static void
@@ -4651,10 +4937,10 @@ micro_imax(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->i[0] = src0->i[0] > src1->i[0] ? src0->i[0] : src1->i[0];
-   dst->i[1] = src0->i[1] > src1->i[1] ? src0->i[1] : src1->i[1];
-   dst->i[2] = src0->i[2] > src1->i[2] ? src0->i[2] : src1->i[2];
-   dst->i[3] = src0->i[3] > src1->i[3] ? src0->i[3] : src1->i[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = src0->i[i] > src1->i[i] ? src0->i[i] : src1->i[i];
 }
 
 static void
@@ -4662,10 +4948,10 @@ micro_imin(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->i[0] = src0->i[0] < src1->i[0] ? src0->i[0] : src1->i[0];
-   dst->i[1] = src0->i[1] < src1->i[1] ? src0->i[1] : src1->i[1];
-   dst->i[2] = src0->i[2] < src1->i[2] ? src0->i[2] : src1->i[2];
-   dst->i[3] = src0->i[3] < src1->i[3] ? src0->i[3] : src1->i[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = src0->i[i] < src1->i[i] ? src0->i[i] : src1->i[i];
 }
 
 static void
@@ -4673,10 +4959,10 @@ micro_isge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->i[0] = src0->i[0] >= src1->i[0] ? -1 : 0;
-   dst->i[1] = src0->i[1] >= src1->i[1] ? -1 : 0;
-   dst->i[2] = src0->i[2] >= src1->i[2] ? -1 : 0;
-   dst->i[3] = src0->i[3] >= src1->i[3] ? -1 : 0;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = src0->i[i] >= src1->i[i] ? -1 : 0;
 }
 
 static void
@@ -4685,14 +4971,12 @@ micro_ishr(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src1)
 {
    unsigned masked_count;
-   masked_count = src1->i[0] & 0x1f;
-   dst->i[0] = src0->i[0] >> masked_count;
-   masked_count = src1->i[1] & 0x1f;
-   dst->i[1] = src0->i[1] >> masked_count;
-   masked_count = src1->i[2] & 0x1f;
-   dst->i[2] = src0->i[2] >> masked_count;
-   masked_count = src1->i[3] & 0x1f;
-   dst->i[3] = src0->i[3] >> masked_count;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
+      masked_count = src1->i[i] & 0x1f;
+      dst->i[i] = src0->i[i] >> masked_count;
+   }
 }
 
 static void
@@ -4700,30 +4984,35 @@ micro_islt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->i[0] = src0->i[0] < src1->i[0] ? -1 : 0;
-   dst->i[1] = src0->i[1] < src1->i[1] ? -1 : 0;
-   dst->i[2] = src0->i[2] < src1->i[2] ? -1 : 0;
-   dst->i[3] = src0->i[3] < src1->i[3] ? -1 : 0;
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_si(dst, i, _mm_cmplt_epi32(load_si(src0, i), load_si(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = src0->i[i] < src1->i[i] ? -1 : 0;
+#endif
 }
 
 static void
 micro_f2u(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->u[0] = (uint)src->f[0];
-   dst->u[1] = (uint)src->f[1];
-   dst->u[2] = (uint)src->f[2];
-   dst->u[3] = (uint)src->f[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = (uint)src->f[i];
 }
 
 static void
 micro_u2f(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->f[0] = (float)src->u[0];
-   dst->f[1] = (float)src->u[1];
-   dst->f[2] = (float)src->u[2];
-   dst->f[3] = (float)src->u[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->f[i] = (float)src->u[i];
 }
 
 static void
@@ -4731,10 +5020,15 @@ micro_uadd(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] + src1->u[0];
-   dst->u[1] = src0->u[1] + src1->u[1];
-   dst->u[2] = src0->u[2] + src1->u[2];
-   dst->u[3] = src0->u[3] + src1->u[3];
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_si(dst, i, _mm_add_epi32(load_si(src0, i), load_si(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->u[i] + src1->u[i];
+#endif
 }
 
 static void
@@ -4742,10 +5036,10 @@ micro_udiv(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src1->u[0] ? src0->u[0] / src1->u[0] : ~0u;
-   dst->u[1] = src1->u[1] ? src0->u[1] / src1->u[1] : ~0u;
-   dst->u[2] = src1->u[2] ? src0->u[2] / src1->u[2] : ~0u;
-   dst->u[3] = src1->u[3] ? src0->u[3] / src1->u[3] : ~0u;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src1->u[i] ? src0->u[i] / src1->u[i] : ~0u;
 }
 
 static void
@@ -4754,10 +5048,10 @@ micro_umad(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src1,
            const union tgsi_exec_channel *src2)
 {
-   dst->u[0] = src0->u[0] * src1->u[0] + src2->u[0];
-   dst->u[1] = src0->u[1] * src1->u[1] + src2->u[1];
-   dst->u[2] = src0->u[2] * src1->u[2] + src2->u[2];
-   dst->u[3] = src0->u[3] * src1->u[3] + src2->u[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->u[i] * src1->u[i] + src2->u[i];
 }
 
 static void
@@ -4765,10 +5059,10 @@ micro_umax(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] > src1->u[0] ? src0->u[0] : src1->u[0];
-   dst->u[1] = src0->u[1] > src1->u[1] ? src0->u[1] : src1->u[1];
-   dst->u[2] = src0->u[2] > src1->u[2] ? src0->u[2] : src1->u[2];
-   dst->u[3] = src0->u[3] > src1->u[3] ? src0->u[3] : src1->u[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->u[i] > src1->u[i] ? src0->u[i] : src1->u[i];
 }
 
 static void
@@ -4776,10 +5070,10 @@ micro_umin(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] < src1->u[0] ? src0->u[0] : src1->u[0];
-   dst->u[1] = src0->u[1] < src1->u[1] ? src0->u[1] : src1->u[1];
-   dst->u[2] = src0->u[2] < src1->u[2] ? src0->u[2] : src1->u[2];
-   dst->u[3] = src0->u[3] < src1->u[3] ? src0->u[3] : src1->u[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->u[i] < src1->u[i] ? src0->u[i] : src1->u[i];
 }
 
 static void
@@ -4787,10 +5081,10 @@ micro_umod(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src1->u[0] ? src0->u[0] % src1->u[0] : ~0u;
-   dst->u[1] = src1->u[1] ? src0->u[1] % src1->u[1] : ~0u;
-   dst->u[2] = src1->u[2] ? src0->u[2] % src1->u[2] : ~0u;
-   dst->u[3] = src1->u[3] ? src0->u[3] % src1->u[3] : ~0u;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src1->u[i] ? src0->u[i] % src1->u[i] : ~0u;
 }
 
 static void
@@ -4798,10 +5092,10 @@ micro_umul(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] * src1->u[0];
-   dst->u[1] = src0->u[1] * src1->u[1];
-   dst->u[2] = src0->u[2] * src1->u[2];
-   dst->u[3] = src0->u[3] * src1->u[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->u[i] * src1->u[i];
 }
 
 static void
@@ -4809,11 +5103,11 @@ micro_imul_hi(union tgsi_exec_channel *dst,
               const union tgsi_exec_channel *src0,
               const union tgsi_exec_channel *src1)
 {
+   uint i;
+
 #define I64M(x, y) ((((int64_t)x) * ((int64_t)y)) >> 32)
-   dst->i[0] = I64M(src0->i[0], src1->i[0]);
-   dst->i[1] = I64M(src0->i[1], src1->i[1]);
-   dst->i[2] = I64M(src0->i[2], src1->i[2]);
-   dst->i[3] = I64M(src0->i[3], src1->i[3]);
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = I64M(src0->i[i], src1->i[i]);
 #undef I64M
 }
 
@@ -4822,11 +5116,11 @@ micro_umul_hi(union tgsi_exec_channel *dst,
               const union tgsi_exec_channel *src0,
               const union tgsi_exec_channel *src1)
 {
+   uint i;
+
 #define U64M(x, y) ((((uint64_t)x) * ((uint64_t)y)) >> 32)
-   dst->u[0] = U64M(src0->u[0], src1->u[0]);
-   dst->u[1] = U64M(src0->u[1], src1->u[1]);
-   dst->u[2] = U64M(src0->u[2], src1->u[2]);
-   dst->u[3] = U64M(src0->u[3], src1->u[3]);
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = U64M(src0->u[i], src1->u[i]);
 #undef U64M
 }
 
@@ -4835,10 +5129,15 @@ micro_useq(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] == src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] == src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] == src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] == src1->u[3] ? ~0 : 0;
+   uint i;
+
+#if defined(PIPE_ARCH_SSE)
+   for (i = 0; i < TGSI_EXEC_LANES; i += 4)
+      store_si(dst, i, _mm_cmpeq_epi32(load_si(src0, i), load_si(src1, i)));
+#else
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->u[i] == src1->u[i] ? ~0 : 0;
+#endif
 }
 
 static void
@@ -4846,10 +5145,10 @@ micro_usge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] >= src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] >= src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] >= src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] >= src1->u[3] ? ~0 : 0;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->u[i] >= src1->u[i] ? ~0 : 0;
 }
 
 static void
@@ -4858,14 +5157,12 @@ micro_ushr(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src1)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x1f;
-   dst->u[0] = src0->u[0] >> masked_count;
-   masked_count = src1->u[1] & 0x1f;
-   dst->u[1] = src0->u[1] >> masked_count;
-   masked_count = src1->u[2] & 0x1f;
-   dst->u[2] = src0->u[2] >> masked_count;
-   masked_count = src1->u[3] & 0x1f;
-   dst->u[3] = src0->u[3] >> masked_count;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
+      masked_count = src1->u[i] & 0x1f;
+      dst->u[i] = src0->u[i] >> masked_count;
+   }
 }
 
 static void
@@ -4873,10 +5170,10 @@ micro_uslt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] < src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] < src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] < src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] < src1->u[3] ? ~0 : 0;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->u[i] < src1->u[i] ? ~0 : 0;
 }
 
 static void
@@ -4884,20 +5181,20 @@ micro_usne(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1)
 {
-   dst->u[0] = src0->u[0] != src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] != src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] != src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] != src1->u[3] ? ~0 : 0;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = src0->u[i] != src1->u[i] ? ~0 : 0;
 }
 
 static void
 micro_uarl(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->i[0] = src->u[0];
-   dst->i[1] = src->u[1];
-   dst->i[2] = src->u[2];
-   dst->i[3] = src->u[3];
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = src->u[i];
 }
 
 /**
@@ -4910,7 +5207,7 @@ micro_ibfe(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src2)
 {
    int i;
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
       int width = src2->i[i] & 0x1f;
       int offset = src1->i[i] & 0x1f;
       if (width == 0)
@@ -4932,7 +5229,7 @@ micro_ubfe(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src2)
 {
    int i;
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
       int width = src2->u[i] & 0x1f;
       int offset = src1->u[i] & 0x1f;
       if (width == 0)
@@ -4955,7 +5252,7 @@ micro_bfi(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src3)
 {
    int i;
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < TGSI_EXEC_LANES; i++) {
       int width = src3->u[i] & 0x1f;
       int offset = src2->u[i] & 0x1f;
       int bitmask = ((1 << width) - 1) << offset;
@@ -4967,50 +5264,50 @@ static void
 micro_brev(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->u[0] = util_bitreverse(src->u[0]);
-   dst->u[1] = util_bitreverse(src->u[1]);
-   dst->u[2] = util_bitreverse(src->u[2]);
-   dst->u[3] = util_bitreverse(src->u[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = util_bitreverse(src->u[i]);
 }
 
 static void
 micro_popc(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->u[0] = util_bitcount(src->u[0]);
-   dst->u[1] = util_bitcount(src->u[1]);
-   dst->u[2] = util_bitcount(src->u[2]);
-   dst->u[3] = util_bitcount(src->u[3]);
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->u[i] = util_bitcount(src->u[i]);
 }
 
 static void
 micro_lsb(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
-   dst->i[0] = ffs(src->u[0]) - 1;
-   dst->i[1] = ffs(src->u[1]) - 1;
-   dst->i[2] = ffs(src->u[2]) - 1;
-   dst->i[3] = ffs(src->u[3]) - 1;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = ffs(src->u[i]) - 1;
 }
 
 static void
 micro_imsb(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->i[0] = util_last_bit_signed(src->i[0]) - 1;
-   dst->i[1] = util_last_bit_signed(src->i[1]) - 1;
-   dst->i[2] = util_last_bit_signed(src->i[2]) - 1;
-   dst->i[3] = util_last_bit_signed(src->i[3]) - 1;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = util_last_bit_signed(src->i[i]) - 1;
 }
 
 static void
 micro_umsb(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src)
 {
-   dst->i[0] = util_last_bit(src->u[0]) - 1;
-   dst->i[1] = util_last_bit(src->u[1]) - 1;
-   dst->i[2] = util_last_bit(src->u[2]) - 1;
-   dst->i[3] = util_last_bit(src->u[3]) - 1;
+   uint i;
+
+   for (i = 0; i < TGSI_EXEC_LANES; i++)
+      dst->i[i] = util_last_bit(src->u[i]) - 1;
 }
 
 /**
@@ -5025,6 +5322,7 @@ exec_instruction(
    int *pc )
 {
    union tgsi_exec_channel r[10];
+   uint i;
 
    (*pc)++;
 
@@ -5373,17 +5671,10 @@ exec_instruction(
       mach->CondStack[mach->CondStackTop++] = mach->CondMask;
       FETCH( &r[0], 0, TGSI_CHAN_X );
       /* update CondMask */
-      if( ! r[0].f[0] ) {
-         mach->CondMask &= ~0x1;
-      }
-      if( ! r[0].f[1] ) {
-         mach->CondMask &= ~0x2;
-      }
-      if( ! r[0].f[2] ) {
-         mach->CondMask &= ~0x4;
-      }
-      if( ! r[0].f[3] ) {
-         mach->CondMask &= ~0x8;
+      for (i = 0; i < TGSI_EXEC_LANES; i++) {
+         if( ! r[0].f[i] ) {
+            mach->CondMask &= ~(1 << i);
+         }
       }
       UPDATE_EXEC_MASK(mach);
       /* Todo: If CondMask==0, jump to ELSE */
@@ -5395,17 +5686,10 @@ exec_instruction(
       mach->CondStack[mach->CondStackTop++] = mach->CondMask;
       IFETCH( &r[0], 0, TGSI_CHAN_X );
       /* update CondMask */
-      if( ! r[0].u[0] ) {
-         mach->CondMask &= ~0x1;
-      }
-      if( ! r[0].u[1] ) {
-         mach->CondMask &= ~0x2;
-      }
-      if( ! r[0].u[2] ) {
-         mach->CondMask &= ~0x4;
-      }
-      if( ! r[0].u[3] ) {
-         mach->CondMask &= ~0x8;
+      for (i = 0; i < TGSI_EXEC_LANES; i++) {
+         if( ! r[0].u[i] ) {
+            mach->CondMask &= ~(1 << i);
+         }
       }
       UPDATE_EXEC_MASK(mach);
       /* Todo: If CondMask==0, jump to ELSE */
@@ -6066,7 +6350,7 @@ exec_instruction(
 static void
 tgsi_exec_machine_setup_masks(struct tgsi_exec_machine *mach)
 {
-   uint default_mask = 0xf;
+   uint default_mask = TGSI_EXEC_LANE_MASK;
 
    mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0] = 0;
    mach->Temps[TEMP_OUTPUT_I].xyzw[TEMP_OUTPUT_C].u[0] = 0;
@@ -6096,12 +6380,8 @@ tgsi_exec_machine_setup_masks(struct tgsi_exec_machine *mach)
    assert(mach->CallStackTop == 0);
 }
 
-/**
- * Run TGSI interpreter.
- * \return bitmask of "alive" quad components
- */
-uint
-tgsi_exec_machine_run( struct tgsi_exec_machine *mach, int start_pc )
+static uint
+run_machine(struct tgsi_exec_machine *mach, int start_pc)
 {
    uint i;
 
@@ -6154,7 +6434,7 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach, int start_pc )
 
                memcpy(&temps[i], &mach->Temps[i], sizeof(temps[i]));
                debug_printf("TEMP[%2u] = ", i);
-               for (j = 0; j < 4; j++) {
+               for (j = 0; j < TGSI_EXEC_LANES; j++) {
                   if (j > 0) {
                      debug_printf("           ");
                   }
@@ -6173,7 +6453,7 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach, int start_pc )
 
                   memcpy(&outputs[i], &mach->Outputs[i], sizeof(outputs[i]));
                   debug_printf("OUT[%2u] =  ", i);
-                  for (j = 0; j < 4; j++) {
+                  for (j = 0; j < TGSI_EXEC_LANES; j++) {
                      if (j > 0) {
                         debug_printf("           ");
                      }
@@ -6213,3 +6493,28 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach, int start_pc )
 
    return ~mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
 }
+
+#if TGSI_EXEC_LANES == TGSI_QUAD_SIZE
+
+/**
+ * Run TGSI interpreter.
+ * \return bitmask of "alive" quad components
+ */
+uint
+tgsi_exec_machine_run( struct tgsi_exec_machine *mach, int start_pc )
+{
+   if (mach->NumLanes > TGSI_QUAD_SIZE)
+      return tgsi_exec_wide_machine_run(mach, start_pc);
+
+   return run_machine(mach, start_pc);
+}
+
+#else
+
+uint
+tgsi_exec_wide_machine_run(struct tgsi_exec_machine *mach, int start_pc)
+{
+   return run_machine(mach, start_pc);
+}
+
+#endif /* TGSI_EXEC_LANES == TGSI_QUAD_SIZE */
@@ -44,6 +44,7 @@ extern "C" {
 
 #define TGSI_NUM_CHANNELS 4  /* R,G,B,A */
 #define TGSI_QUAD_SIZE    4  /* 4 pixel/quad */
+#define TGSI_EXEC_MAX_LANES 8  /* vertices/threads of a wide machine */
 
 #define TGSI_FOR_EACH_CHANNEL( CHAN )\
    for (CHAN = 0; CHAN < TGSI_NUM_CHANNELS; CHAN++)
@@ -70,16 +71,18 @@ extern "C" {
 
 /**
   * Registers may be treated as float, signed int or unsigned int.
+  * Machines created with tgsi_exec_machine_create() only use the first
+  * TGSI_QUAD_SIZE lanes.
   */
 union tgsi_exec_channel
 {
-   float    f[TGSI_QUAD_SIZE];
-   int      i[TGSI_QUAD_SIZE];
-   unsigned u[TGSI_QUAD_SIZE];
+   float    f[TGSI_EXEC_MAX_LANES];
+   int      i[TGSI_EXEC_MAX_LANES];
+   unsigned u[TGSI_EXEC_MAX_LANES];
 };
 
 /**
-  * A vector[RGBA] of channels[4 pixels]
+  * A vector[RGBA] of channels[lanes]
   */
 struct tgsi_exec_vector
 {
@@ -393,6 +396,9 @@ struct tgsi_exec_machine
    void                          *LocalMem;
    unsigned                      LocalMemSize;
 
+   /** Lanes run at once, TGSI_QUAD_SIZE or TGSI_EXEC_MAX_LANES */
+   uint NumLanes;
+
    /* See GLSL 4.50 specification for definition of helper invocations */
    uint NonHelperMask;  /**< non-helpers */
    /* Conditional execution masks */
@@ -456,6 +462,9 @@ struct tgsi_exec_machine
 struct tgsi_exec_machine *
 tgsi_exec_machine_create(enum pipe_shader_type shader_type);
 
+struct tgsi_exec_machine *
+tgsi_exec_machine_create_wide(enum pipe_shader_type shader_type);
+
 void
 tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach);
 
@@ -39,9 +39,16 @@ struct translate *translate_create( const struct translate_key *key )
    struct translate *translate = NULL;
 
 #if defined(PIPE_ARCH_X86) || defined(PIPE_ARCH_X86_64)
+   /* The SSE2 code generator only takes straight copies, where it is
+    * faster than the AVX2 backend, so try it first.
+    */
    translate = translate_sse2_create( key );
    if (translate)
       return translate;
+
+   translate = translate_avx2_create( key );
+   if (translate)
+      return translate;
 #else
    (void)translate;
 #endif
@@ -0,0 +1,900 @@
+/*
+ * Copyright © 2026 The Mesa Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sub
+ * license, and/or sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.  IN NO EVENT SHALL
+ * VMWARE AND/OR THEIR SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * AVX2 vertex translation.
+ *
+ * Vertices are translated eight at a time: the attributes of eight vertices
+ * are gathered with 64-bit offsets into one register per dword of the
+ * attribute, the channels are converted in SoA form, then transposed back
+ * and stored.  The conversions give the same results as translate_generic,
+ * which uses the u_format fetch functions.
+ *
+ * translate_create() only comes here for keys translate_sse rejects, which
+ * are all but straight copies.  Keys with formats which aren't handled here
+ * return NULL from translate_avx2_create(), and end up in translate_generic.
+ */
+
+
+#include "pipe/p_config.h"
+#include "pipe/p_compiler.h"
+#include "util/u_memory.h"
+#include "util/u_math.h"
+#include "util/u_format.h"
+#include "util/u_cpu_detect.h"
+
+#include "translate.h"
+
+
+#if defined(PIPE_ARCH_SSE) && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+
+#include <immintrin.h>
+
+#define TRANSLATE_AVX2 __attribute__((target("avx2")))
+
+/** Vertices translated per iteration */
+#define AVX2_WIDTH 8
+
+
+enum avx2_chan {
+   AVX2_CHAN_ZERO,
+   AVX2_CHAN_ONE,
+   AVX2_CHAN_ONE_INT,
+   AVX2_CHAN_FLOAT,        /**< 32-bit float */
+   AVX2_CHAN_HALF,
+   AVX2_CHAN_DOUBLE,
+   AVX2_CHAN_UNORM,        /**< up to 23 bits, float math */
+   AVX2_CHAN_SNORM,
+   AVX2_CHAN_UNORM_DOUBLE, /**< more than 23 bits, double math */
+   AVX2_CHAN_SNORM_DOUBLE,
+   AVX2_CHAN_USCALED,
+   AVX2_CHAN_USCALED32,
+   AVX2_CHAN_SSCALED,
+   AVX2_CHAN_UINT,
+   AVX2_CHAN_SINT
+};
+
+enum avx2_output {
+   AVX2_OUTPUT_COPY,
+   AVX2_OUTPUT_FLOAT,      /**< 1 to 4 floats */
+   AVX2_OUTPUT_INT,        /**< 1 to 4 32-bit integers */
+   AVX2_OUTPUT_RGBA8,
+   AVX2_OUTPUT_BGRA8,
+   AVX2_OUTPUT_INSTANCE_ID,
+   AVX2_OUTPUT_INSTANCE_ID_FLOAT
+};
+
+
+/**
+ * Where to find and how to convert one output component.
+ */
+struct avx2_channel {
+   enum avx2_chan chan;
+   unsigned window;   /**< dword window, or byte offset for doubles */
+   unsigned shift;    /**< bit position within the window */
+   unsigned size;     /**< in bits */
+   float scale;
+   double dscale;
+};
+
+
+struct translate_avx2_element {
+   enum translate_element_type type;
+   enum avx2_output output;
+   unsigned nr_components;
+   unsigned copy_size;
+
+   unsigned buffer;
+   unsigned input_offset;
+   unsigned instance_divisor;
+   unsigned output_offset;
+
+   /* Dwords of the input read for each vertex.  Formats of less than four
+    * bytes are read with scalar loads instead, so that the gathers never go
+    * past the end of an attribute.
+    */
+   unsigned format_size;
+   unsigned nr_windows;
+   unsigned window_offset[4];
+   boolean small;
+
+   struct avx2_channel channel[4];
+
+   const uint8_t *input_ptr;
+   unsigned input_stride;
+   unsigned max_index;
+};
+
+
+struct translate_avx2 {
+   struct translate translate;
+
+   struct translate_avx2_element element[TRANSLATE_MAX_ATTRIBS];
+   unsigned nr_elements;
+};
+
+
+static inline struct translate_avx2 *
+translate_avx2(struct translate *translate)
+{
+   return (struct translate_avx2 *)translate;
+}
+
+
+/**
+ * Read one dword window of eight vertices.
+ */
+static inline TRANSLATE_AVX2 __m256i
+fetch_window(const struct translate_avx2_element *e,
+             const uint8_t *base, __m256i off_lo, __m256i off_hi,
+             unsigned window)
+{
+   const int *src = (const int *)(base + e->window_offset[window]);
+
+   if (e->small) {
+      uint64_t off[AVX2_WIDTH];
+      uint32_t data[AVX2_WIDTH];
+      unsigned j;
+
+      _mm256_storeu_si256((__m256i *)&off[0], off_lo);
+      _mm256_storeu_si256((__m256i *)&off[4], off_hi);
+      for (j = 0; j < AVX2_WIDTH; j++) {
+         data[j] = 0;
+         memcpy(&data[j], base + off[j], e->format_size);
+      }
+      return _mm256_loadu_si256((const __m256i *)data);
+   }
+
+   return _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm256_i64gather_epi32(src, off_lo, 1)),
+      _mm256_i64gather_epi32(src, off_hi, 1), 1);
+}
+
+
+static inline TRANSLATE_AVX2 __m256i
+extract_unsigned(__m256i raw, const struct avx2_channel *c)
+{
+   __m256i v = _mm256_srl_epi32(raw, _mm_cvtsi32_si128(c->shift));
+
+   if (c->size < 32)
+      v = _mm256_and_si256(v, _mm256_set1_epi32((1u << c->size) - 1));
+   return v;
+}
+
+
+static inline TRANSLATE_AVX2 __m256i
+extract_signed(__m256i raw, const struct avx2_channel *c)
+{
+   __m256i v = _mm256_sll_epi32(raw,
+                                _mm_cvtsi32_si128(32 - c->shift - c->size));
+   return _mm256_sra_epi32(v, _mm_cvtsi32_si128(32 - c->size));
+}
+
+
+/**
+ * Same as util_half_to_float().
+ */
+static inline TRANSLATE_AVX2 __m256
+half_to_float(__m256i h)
+{
+   const __m256 magic = _mm256_castsi256_ps(_mm256_set1_epi32(0xef << 23));
+   const __m256 infnan = _mm256_set1_ps(65536.0f);
+   __m256i bits = _mm256_slli_epi32(_mm256_and_si256(h,
+                                       _mm256_set1_epi32(0x7fff)), 13);
+   __m256 f = _mm256_mul_ps(_mm256_castsi256_ps(bits), magic);
+   __m256 special = _mm256_cmp_ps(f, infnan, _CMP_GE_OQ);
+
+   bits = _mm256_castps_si256(f);
+   bits = _mm256_or_si256(bits,
+                          _mm256_and_si256(_mm256_castps_si256(special),
+                                           _mm256_set1_epi32(0xff << 23)));
+   bits = _mm256_or_si256(bits,
+                          _mm256_slli_epi32(_mm256_and_si256(h,
+                                               _mm256_set1_epi32(0x8000)),
+                                            16));
+   return _mm256_castsi256_ps(bits);
+}
+
+
+/**
+ * (float)(v * scale) computed in double precision, v being signed or not.
+ */
+static inline TRANSLATE_AVX2 __m256
+scale_double(__m256i v, boolean sign, double scale)
+{
+   const __m256d dscale = _mm256_set1_pd(scale);
+   __m256d lo, hi;
+
+   if (sign) {
+      lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v));
+      hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1));
+   } else {
+      const __m256d bias = _mm256_set1_pd(2147483648.0);
+      v = _mm256_xor_si256(v, _mm256_set1_epi32(0x80000000));
+      lo = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), bias);
+      hi = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)),
+                         bias);
+   }
+
+   lo = _mm256_mul_pd(lo, dscale);
+   hi = _mm256_mul_pd(hi, dscale);
+   return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)),
+                               _mm256_cvtpd_ps(hi), 1);
+}
+
+
+/**
+ * Convert one channel of eight vertices.  Integer channels are returned
+ * as their bits.
+ */
+static inline TRANSLATE_AVX2 __m256
+convert_channel(const struct avx2_channel *c, const __m256i *raw,
+                const uint8_t *base, __m256i off_lo, __m256i off_hi)
+{
+   __m256i v;
+
+   switch (c->chan) {
+   case AVX2_CHAN_ZERO:
+      return _mm256_setzero_ps();
+   case AVX2_CHAN_ONE:
+      return _mm256_set1_ps(1.0f);
+   case AVX2_CHAN_ONE_INT:
+      return _mm256_castsi256_ps(_mm256_set1_epi32(1));
+   case AVX2_CHAN_FLOAT:
+      return _mm256_castsi256_ps(raw[c->window]);
+   case AVX2_CHAN_HALF:
+      return half_to_float(extract_unsigned(raw[c->window], c));
+   case AVX2_CHAN_DOUBLE: {
+      const double *src = (const double *)(base + c->window);
+      __m128 lo = _mm256_cvtpd_ps(_mm256_i64gather_pd(src, off_lo, 1));
+      __m128 hi = _mm256_cvtpd_ps(_mm256_i64gather_pd(src, off_hi, 1));
+      return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+   }
+   case AVX2_CHAN_UNORM:
+      v = extract_unsigned(raw[c->window], c);
+      return _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(c->scale));
+   case AVX2_CHAN_SNORM:
+      v = extract_signed(raw[c->window], c);
+      return _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(c->scale));
+   case AVX2_CHAN_UNORM_DOUBLE:
+      return scale_double(extract_unsigned(raw[c->window], c), FALSE,
+                          c->dscale);
+   case AVX2_CHAN_SNORM_DOUBLE:
+      return scale_double(extract_signed(raw[c->window], c), TRUE,
+                          c->dscale);
+   case AVX2_CHAN_USCALED:
+      return _mm256_cvtepi32_ps(extract_unsigned(raw[c->window], c));
+   case AVX2_CHAN_USCALED32: {
+      /* Both halves convert exactly, so the sum is rounded once. */
+      __m256 hi, lo;
+      v = raw[c->window];
+      hi = _mm256_cvtepi32_ps(_mm256_srli_epi32(v, 16));
+      lo = _mm256_cvtepi32_ps(_mm256_and_si256(v,
+                                               _mm256_set1_epi32(0xffff)));
+      return _mm256_add_ps(_mm256_mul_ps(hi, _mm256_set1_ps(65536.0f)), lo);
+   }
+   case AVX2_CHAN_SSCALED:
+      return _mm256_cvtepi32_ps(extract_signed(raw[c->window], c));
+   case AVX2_CHAN_UINT:
+      return _mm256_castsi256_ps(extract_unsigned(raw[c->window], c));
+   case AVX2_CHAN_SINT:
+      return _mm256_castsi256_ps(extract_signed(raw[c->window], c));
+   }
+
+   assert(0);
+   return _mm256_setzero_ps();
+}
+
+
+/**
+ * Store 'num' vertices of up to four 32-bit components, given in SoA form.
+ */
+static inline TRANSLATE_AVX2 void
+store_components(const struct translate_avx2_element *e, const __m256 *c,
+                 unsigned num, uint8_t *dst, unsigned stride)
+{
+   const __m128i mask = _mm_cmpgt_epi32(_mm_set1_epi32(e->nr_components),
+                                        _mm_setr_epi32(0, 1, 2, 3));
+   __m256 t0 = _mm256_unpacklo_ps(c[0], c[1]);
+   __m256 t1 = _mm256_unpackhi_ps(c[0], c[1]);
+   __m256 t2 = _mm256_unpacklo_ps(c[2], c[3]);
+   __m256 t3 = _mm256_unpackhi_ps(c[2], c[3]);
+   __m256 v[4];
+   unsigned j;
+
+   v[0] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+   v[1] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+   v[2] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+   v[3] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+   for (j = 0; j < num; j++) {
+      __m128 vert = j < 4 ? _mm256_castps256_ps128(v[j]) :
+                            _mm256_extractf128_ps(v[j - 4], 1);
+      float *out = (float *)(dst + j * stride);
+
+      if (e->nr_components == 4)
+         _mm_storeu_ps(out, vert);
+      else
+         _mm_maskstore_ps(out, mask, vert);
+   }
+}
+
+
+/**
+ * Same as TO_8_UNORM() in translate_generic.c.
+ */
+static inline TRANSLATE_AVX2 __m256i
+float_to_unorm8(__m256 f)
+{
+   __m256i v = _mm256_cvttps_epi32(_mm256_mul_ps(f, _mm256_set1_ps(255.0f)));
+   return _mm256_and_si256(v, _mm256_set1_epi32(0xff));
+}
+
+
+static inline TRANSLATE_AVX2 void
+store_unorm8(const struct translate_avx2_element *e, const __m256 *c,
+             unsigned num, uint8_t *dst, unsigned stride)
+{
+   const unsigned r = e->output == AVX2_OUTPUT_BGRA8 ? 2 : 0;
+   uint32_t data[AVX2_WIDTH];
+   __m256i v;
+   unsigned j;
+
+   v = _mm256_or_si256(
+      _mm256_or_si256(_mm256_slli_epi32(float_to_unorm8(c[0]), 8 * r),
+                      _mm256_slli_epi32(float_to_unorm8(c[1]), 8)),
+      _mm256_or_si256(_mm256_slli_epi32(float_to_unorm8(c[2]), 16 - 8 * r),
+                      _mm256_slli_epi32(float_to_unorm8(c[3]), 24)));
+   _mm256_storeu_si256((__m256i *)data, v);
+
+   for (j = 0; j < num; j++)
+      memcpy(dst + j * stride, &data[j], 4);
+}
+
+
+/**
+ * Translate the vertices given by the first 'num' indices of 'elts'.
+ */
+static ALWAYS_INLINE TRANSLATE_AVX2 void
+avx2_run_block(struct translate_avx2 *p,
+               __m256i elts,
+               unsigned num,
+               unsigned start_instance,
+               unsigned instance_id,
+               uint8_t *vert)
+{
+   const unsigned stride = p->translate.key.output_stride;
+   unsigned attr, i, j;
+
+   for (attr = 0; attr < p->nr_elements; attr++) {
+      const struct translate_avx2_element *e = &p->element[attr];
+      uint8_t *dst = vert + e->output_offset;
+      const uint8_t *base = e->input_ptr;
+      __m256i off_lo, off_hi;
+      __m256i raw[4];
+      __m256 c[4];
+
+      if (e->type == TRANSLATE_ELEMENT_INSTANCE_ID) {
+         float f = (float)instance_id;
+
+         for (j = 0; j < num; j++) {
+            if (e->output == AVX2_OUTPUT_INSTANCE_ID_FLOAT)
+               memcpy(dst + j * stride, &f, 4);
+            else
+               memcpy(dst + j * stride, &instance_id, 4);
+         }
+         continue;
+      }
+
+      if (e->instance_divisor) {
+         /* Not clamped, like in the other implementations. */
+         unsigned index = start_instance + instance_id / e->instance_divisor;
+         base += (ptrdiff_t)e->input_stride * index;
+         off_lo = off_hi = _mm256_setzero_si256();
+      } else {
+         const __m256i s = _mm256_set1_epi64x(e->input_stride);
+         __m256i index = _mm256_min_epu32(elts,
+                                          _mm256_set1_epi32(e->max_index));
+
+         off_lo = _mm256_mul_epu32(
+            _mm256_cvtepu32_epi64(_mm256_castsi256_si128(index)), s);
+         off_hi = _mm256_mul_epu32(
+            _mm256_cvtepu32_epi64(_mm256_extracti128_si256(index, 1)), s);
+      }
+
+      if (e->output == AVX2_OUTPUT_COPY) {
+         uint64_t off[AVX2_WIDTH];
+
+         _mm256_storeu_si256((__m256i *)&off[0], off_lo);
+         _mm256_storeu_si256((__m256i *)&off[4], off_hi);
+         for (j = 0; j < num; j++)
+            memcpy(dst + j * stride, base + off[j], e->copy_size);
+         continue;
+      }
+
+      for (i = 0; i < e->nr_windows; i++)
+         raw[i] = fetch_window(e, base, off_lo, off_hi, i);
+
+      for (i = 0; i < 4; i++)
+         c[i] = convert_channel(&e->channel[i], raw, base, off_lo, off_hi);
+
+      if (e->output == AVX2_OUTPUT_RGBA8 || e->output == AVX2_OUTPUT_BGRA8)
+         store_unorm8(e, c, num, dst, stride);
+      else
+         store_components(e, c, num, dst, stride);
+   }
+}
+
+
+static inline TRANSLATE_AVX2 __m256i
+lane_index(void)
+{
+   return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+}
+
+
+/**
+ * Indices of a partial block, padded with the first one.
+ */
+static inline TRANSLATE_AVX2 __m256i
+pad_elts(uint32_t *elts, unsigned num)
+{
+   unsigned k;
+
+   for (k = num; k < AVX2_WIDTH; k++)
+      elts[k] = elts[0];
+   return _mm256_loadu_si256((const __m256i *)elts);
+}
+
+
+static void PIPE_CDECL TRANSLATE_AVX2
+avx2_run_elts(struct translate *translate,
+              const unsigned *elts,
+              unsigned count,
+              unsigned start_instance,
+              unsigned instance_id,
+              void *output_buffer)
+{
+   struct translate_avx2 *p = translate_avx2(translate);
+   const unsigned stride = translate->key.output_stride;
+   uint8_t *vert = output_buffer;
+   unsigned i;
+
+   for (i = 0; i < count; i += AVX2_WIDTH) {
+      const unsigned num = MIN2(AVX2_WIDTH, count - i);
+      __m256i v;
+
+      if (num == AVX2_WIDTH) {
+         v = _mm256_loadu_si256((const __m256i *)(elts + i));
+      } else {
+         uint32_t tmp[AVX2_WIDTH];
+         unsigned k;
+
+         for (k = 0; k < num; k++)
+            tmp[k] = elts[i + k];
+         v = pad_elts(tmp, num);
+      }
+
+      avx2_run_block(p, v, num, start_instance, instance_id,
+                     vert + i * stride);
+   }
+}
+
+
+static void PIPE_CDECL TRANSLATE_AVX2
+avx2_run_elts16(struct translate *translate,
+                const uint16_t *elts,
+                unsigned count,
+                unsigned start_instance,
+                unsigned instance_id,
+                void *output_buffer)
+{
+   struct translate_avx2 *p = translate_avx2(translate);
+   const unsigned stride = translate->key.output_stride;
+   uint8_t *vert = output_buffer;
+   unsigned i;
+
+   for (i = 0; i < count; i += AVX2_WIDTH) {
+      const unsigned num = MIN2(AVX2_WIDTH, count - i);
+      __m256i v;
+
+      if (num == AVX2_WIDTH) {
+         v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(elts + i)));
+      } else {
+         uint32_t tmp[AVX2_WIDTH];
+         unsigned k;
+
+         for (k = 0; k < num; k++)
+            tmp[k] = elts[i + k];
+         v = pad_elts(tmp, num);
+      }
+
+      avx2_run_block(p, v, num, start_instance, instance_id,
+                     vert + i * stride);
+   }
+}
+
+
+static void PIPE_CDECL TRANSLATE_AVX2
+avx2_run_elts8(struct translate *translate,
+               const uint8_t *elts,
+               unsigned count,
+               unsigned start_instance,
+               unsigned instance_id,
+               void *output_buffer)
+{
+   struct translate_avx2 *p = translate_avx2(translate);
+   const unsigned stride = translate->key.output_stride;
+   uint8_t *vert = output_buffer;
+   unsigned i;
+
+   for (i = 0; i < count; i += AVX2_WIDTH) {
+      const unsigned num = MIN2(AVX2_WIDTH, count - i);
+      __m256i v;
+
+      if (num == AVX2_WIDTH) {
+         v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(elts + i)));
+      } else {
+         uint32_t tmp[AVX2_WIDTH];
+         unsigned k;
+
+         for (k = 0; k < num; k++)
+            tmp[k] = elts[i + k];
+         v = pad_elts(tmp, num);
+      }
+
+      avx2_run_block(p, v, num, start_instance, instance_id,
+                     vert + i * stride);
+   }
+}
+
+
+static void PIPE_CDECL TRANSLATE_AVX2
+avx2_run(struct translate *translate,
+         unsigned start,
+         unsigned count,
+         unsigned start_instance,
+         unsigned instance_id,
+         void *output_buffer)
+{
+   struct translate_avx2 *p = translate_avx2(translate);
+   const unsigned stride = translate->key.output_stride;
+   uint8_t *vert = output_buffer;
+   unsigned i;
+
+   for (i = 0; i < count; i += AVX2_WIDTH) {
+      const unsigned num = MIN2(AVX2_WIDTH, count - i);
+      __m256i v = _mm256_add_epi32(_mm256_set1_epi32(start + i),
+                                   lane_index());
+
+      avx2_run_block(p, v, num, start_instance, instance_id,
+                     vert + i * stride);
+   }
+}
+
+
+static void
+avx2_set_buffer(struct translate *translate,
+                unsigned buf,
+                const void *ptr,
+                unsigned stride,
+                unsigned max_index)
+{
+   struct translate_avx2 *p = translate_avx2(translate);
+   unsigned i;
+
+   for (i = 0; i < p->nr_elements; i++) {
+      if (p->element[i].buffer == buf) {
+         p->element[i].input_ptr = ((const uint8_t *)ptr +
+                                    p->element[i].input_offset);
+         p->element[i].input_stride = stride;
+         p->element[i].max_index = max_index;
+      }
+   }
+}
+
+
+static void
+avx2_release(struct translate *translate)
+{
+   FREE(translate);
+}
+
+
+/**
+ * Find the dword window holding an input channel, adding it if needed.
+ */
+static unsigned
+get_window(struct translate_avx2_element *e, unsigned byte_offset,
+           unsigned *shift)
+{
+   unsigned offset = MIN2(byte_offset & ~3, e->format_size - 4);
+   unsigned i;
+
+   *shift += (byte_offset - offset) * 8;
+
+   for (i = 0; i < e->nr_windows; i++) {
+      if (e->window_offset[i] == offset)
+         return i;
+   }
+
+   e->window_offset[e->nr_windows] = offset;
+   return e->nr_windows++;
+}
+
+
+/**
+ * Set up the conversion of an input channel, as done by the u_format
+ * fetch functions.
+ */
+static boolean
+init_channel(struct translate_avx2_element *e,
+             const struct util_format_description *desc,
+             unsigned swizzle,
+             struct avx2_channel *c)
+{
+   const struct util_format_channel_description *chan;
+   boolean pure = desc->channel[0].pure_integer;
+
+   memset(c, 0, sizeof *c);
+
+   if (swizzle == PIPE_SWIZZLE_0 || swizzle == PIPE_SWIZZLE_NONE) {
+      c->chan = AVX2_CHAN_ZERO;
+      return TRUE;
+   }
+   if (swizzle == PIPE_SWIZZLE_1) {
+      c->chan = pure ? AVX2_CHAN_ONE_INT : AVX2_CHAN_ONE;
+      return TRUE;
+   }
+   if (swizzle >= desc->nr_channels)
+      return FALSE;
+
+   chan = &desc->channel[swizzle];
+   c->size = chan->size;
+
+   if (chan->type == UTIL_FORMAT_TYPE_FLOAT && chan->size == 64) {
+      if (chan->shift % 64)
+         return FALSE;
+      c->chan = AVX2_CHAN_DOUBLE;
+      c->window = chan->shift / 8;
+      return TRUE;
+   }
+
+   if (chan->size > 32)
+      return FALSE;
+
+   /* Channels of packed formats are extracted from the whole dword, the
+    * ones of array formats from the dword around them.
+    */
+   if (desc->block.bits <= 32) {
+      c->shift = chan->shift;
+      c->window = e->small ? 0 : get_window(e, 0, &c->shift);
+   } else {
+      if (chan->shift % chan->size || chan->size % 8)
+         return FALSE;
+      c->shift = 0;
+      c->window = get_window(e, chan->shift / 8, &c->shift);
+   }
+
+   switch (chan->type) {
+   case UTIL_FORMAT_TYPE_FLOAT:
+      if (chan->size == 32)
+         c->chan = AVX2_CHAN_FLOAT;
+      else if (chan->size == 16)
+         c->chan = AVX2_CHAN_HALF;
+      else
+         return FALSE;
+      break;
+   case UTIL_FORMAT_TYPE_UNSIGNED:
+   case UTIL_FORMAT_TYPE_SIGNED: {
+      const boolean sign = chan->type == UTIL_FORMAT_TYPE_SIGNED;
+      const unsigned one = sign ? (1u << (chan->size - 1)) - 1 :
+                                  (unsigned)((1ull << chan->size) - 1);
+
+      if (chan->pure_integer) {
+         c->chan = sign ? AVX2_CHAN_SINT : AVX2_CHAN_UINT;
+      } else if (chan->normalized) {
+         if (chan->size <= 23) {
+            c->chan = sign ? AVX2_CHAN_SNORM : AVX2_CHAN_UNORM;
+            c->scale = 1.0f / (float)one;
+         } else {
+            c->chan = sign ? AVX2_CHAN_SNORM_DOUBLE : AVX2_CHAN_UNORM_DOUBLE;
+            c->dscale = 1.0 / (double)one;
+         }
+      } else if (sign) {
+         c->chan = AVX2_CHAN_SSCALED;
+      } else {
+         c->chan = chan->size == 32 ? AVX2_CHAN_USCALED32 : AVX2_CHAN_USCALED;
+      }
+      break;
+   }
+   case UTIL_FORMAT_TYPE_FIXED:
+      if (chan->size != 32)
+         return FALSE;
+      c->chan = AVX2_CHAN_SNORM_DOUBLE;
+      c->dscale = 1.0 / 0x10000;
+      break;
+   default:
+      return FALSE;
+   }
+
+   /* The extraction of a channel needs its dword window in whole. */
+   if (c->shift + c->size > 32)
+      return FALSE;
+
+   return TRUE;
+}
+
+
+static boolean
+is_32bit_output(const struct util_format_description *desc,
+                enum util_format_type type, boolean pure)
+{
+   unsigned i;
+
+   if (desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       desc->nr_channels > 4)
+      return FALSE;
+
+   for (i = 0; i < desc->nr_channels; i++) {
+      if (desc->channel[i].type != type ||
+          desc->channel[i].size != 32 ||
+          desc->channel[i].pure_integer != pure ||
+          desc->channel[i].shift != 32 * i ||
+          desc->swizzle[i] != i)
+         return FALSE;
+   }
+   return TRUE;
+}
+
+
+static boolean
+init_element(struct translate_avx2_element *e,
+             const struct translate_element *key)
+{
+   const struct util_format_description *in =
+      util_format_description(key->input_format);
+   const struct util_format_description *out =
+      util_format_description(key->output_format);
+   unsigned i;
+
+   e->type = key->type;
+   e->buffer = key->input_buffer;
+   e->input_offset = key->input_offset;
+   e->instance_divisor = key->instance_divisor;
+   e->output_offset = key->output_offset;
+
+   if (e->type == TRANSLATE_ELEMENT_INSTANCE_ID) {
+      if (key->output_format == PIPE_FORMAT_R32_USCALED ||
+          key->output_format == PIPE_FORMAT_R32_SSCALED)
+         e->output = AVX2_OUTPUT_INSTANCE_ID;
+      else if (key->output_format == PIPE_FORMAT_R32_FLOAT)
+         e->output = AVX2_OUTPUT_INSTANCE_ID_FLOAT;
+      else
+         return FALSE;
+      return TRUE;
+   }
+
+   if (!in || !out ||
+       in->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       in->block.width != 1 || in->block.height != 1 ||
+       in->block.bits % 8)
+      return FALSE;
+
+   e->format_size = in->block.bits / 8;
+
+   if (key->input_format == key->output_format) {
+      e->output = AVX2_OUTPUT_COPY;
+      e->copy_size = e->format_size;
+      return TRUE;
+   }
+
+   if (in->colorspace != UTIL_FORMAT_COLORSPACE_RGB)
+      return FALSE;
+
+   if (in->channel[0].pure_integer) {
+      /* Only to integers of the same sign and at least as wide, as in
+       * translate_generic.
+       */
+      enum util_format_type type = in->channel[0].type;
+
+      if (!is_32bit_output(out, type, TRUE))
+         return FALSE;
+      for (i = 0; i < in->nr_channels; i++) {
+         if (in->channel[i].type != type)
+            return FALSE;
+      }
+      e->output = AVX2_OUTPUT_INT;
+      e->nr_components = out->nr_channels;
+   } else if (is_32bit_output(out, UTIL_FORMAT_TYPE_FLOAT, FALSE)) {
+      e->output = AVX2_OUTPUT_FLOAT;
+      e->nr_components = out->nr_channels;
+   } else if (key->output_format == PIPE_FORMAT_R8G8B8A8_UNORM) {
+      e->output = AVX2_OUTPUT_RGBA8;
+   } else if (key->output_format == PIPE_FORMAT_B8G8R8A8_UNORM) {
+      e->output = AVX2_OUTPUT_BGRA8;
+   } else {
+      return FALSE;
+   }
+
+   e->small = e->format_size < 4;
+
+   for (i = 0; i < 4; i++) {
+      if (!init_channel(e, in, in->swizzle[i], &e->channel[i]))
+         return FALSE;
+   }
+
+   if (e->small)
+      e->nr_windows = 1;
+
+   return TRUE;
+}
+
+
+struct translate *
+translate_avx2_create(const struct translate_key *key)
+{
+   struct translate_avx2 *p;
+   unsigned i;
+
+   util_cpu_detect();
+   if (!util_cpu_caps.has_avx2)
+      return NULL;
+
+   p = CALLOC_STRUCT(translate_avx2);
+   if (!p)
+      return NULL;
+
+   assert(key->nr_elements <= TRANSLATE_MAX_ATTRIBS);
+
+   p->translate.key = *key;
+   p->translate.release = avx2_release;
+   p->translate.set_buffer = avx2_set_buffer;
+   p->translate.run_elts = avx2_run_elts;
+   p->translate.run_elts16 = avx2_run_elts16;
+   p->translate.run_elts8 = avx2_run_elts8;
+   p->translate.run = avx2_run;
+
+   for (i = 0; i < key->nr_elements; i++) {
+      if (!init_element(&p->element[i], &key->element[i])) {
+         FREE(p);
+         return NULL;
+      }
+   }
+
+   p->nr_elements = key->nr_elements;
+
+   return &p->translate;
+}
+
+
+#else
+
+struct translate *
+translate_avx2_create(const struct translate_key *key)
+{
+   return NULL;
+}
+
+#endif
@@ -46,6 +46,7 @@
 #include "lp_surface.h"
 #include "lp_query.h"
 #include "lp_setup.h"
+#include "lp_state_fs.h"
 
 /* This is only safe if there's just one concurrent context */
 #ifdef PIPE_SUBSYSTEM_EMBEDDED
@@ -55,8 +56,14 @@
 static void llvmpipe_destroy( struct pipe_context *pipe )
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
+   struct lp_fs_variant_list_item *li;
    uint i, j;
 
+   /* Background compiles reference the context. */
+   foreach(li, &llvmpipe->fs_variants_list) {
+      util_queue_fence_wait(&li->base->ready);
+   }
+
    lp_print_counters();
 
    if (llvmpipe->blitter) {
@@ -148,6 +155,8 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    make_empty_list(&llvmpipe->fs_variants_list);
 
    make_empty_list(&llvmpipe->setup_variants_list);
+   if (!lp_init_setup_variants(llvmpipe))
+      goto fail;
 
 
    llvmpipe->pipe.screen = screen;
@@ -52,6 +52,7 @@ struct lp_blend_state;
 struct lp_setup_context;
 struct lp_setup_variant;
 struct lp_velems_state;
+struct hash_table;
 
 struct llvmpipe_context {
    struct pipe_context pipe;  /**< base class */
@@ -143,6 +144,7 @@ struct llvmpipe_context {
    unsigned nr_fs_instrs;
 
    struct lp_setup_variant_list_item setup_variants_list;
+   struct hash_table *setup_variants_ht;  /**< same variants, by key */
    unsigned nr_setup_variants;
 
    /** Conditional query object and mode */
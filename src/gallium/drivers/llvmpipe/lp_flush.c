@@ -37,6 +37,7 @@
 #include "draw/draw_context.h"
 #include "lp_flush.h"
 #include "lp_context.h"
+#include "lp_screen.h"
 #include "lp_setup.h"
 
 
@@ -112,6 +113,9 @@ llvmpipe_flush_resource(struct pipe_context *pipe,
    if ((referenced & LP_REFERENCED_FOR_WRITE) ||
        ((referenced & LP_REFERENCED_FOR_READ) && !read_only)) {
 
+      lp_screen_stat_add(llvmpipe_screen(pipe->screen),
+                         LP_STAT_FLUSHES_MAP, 1);
+
       if (cpu_access) {
          /*
           * Flush and wait.
@@ -35,8 +35,18 @@
 
 /**
  * Tile size (width and height). This needs to be a power of two.
+ *
+ * 32x32, 64x64 and 128x128 tiles are supported; the default can be
+ * overridden at build time (e.g. with -DTILE_ORDER=7).  Larger tiles
+ * reduce the binning overhead of big triangles, smaller ones balance
+ * the load better between the rasterizer threads and fit smaller caches.
  */
+#ifndef TILE_ORDER
 #define TILE_ORDER 6
+#endif
+#if TILE_ORDER < 5 || TILE_ORDER > 7
+#error "TILE_ORDER must be 5, 6 or 7"
+#endif
 #define TILE_SIZE (1 << TILE_ORDER)
 
 
@@ -61,7 +71,12 @@
 #define LP_MAX_WIDTH  (1 << (LP_MAX_TEXTURE_LEVELS - 1))
 
 
-#define LP_MAX_THREADS 16
+/**
+ * Max number of rasterizer threads.  Per-thread state is allocated
+ * according to the actual number of threads, so this is only a sanity
+ * limit for LP_NUM_THREADS / the number of CPUs.
+ */
+#define LP_MAX_THREADS 128
 
 
 /**
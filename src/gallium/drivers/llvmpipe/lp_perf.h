@@ -34,6 +34,7 @@
 #define LP_PERF_H
 
 #include "pipe/p_compiler.h"
+#include "util/u_atomic.h"
 
 /**
  * Various counters
@@ -58,8 +59,11 @@ struct lp_counters
    unsigned nr_non_empty_4;
    unsigned nr_llvm_compiles;
    int64_t llvm_compile_time;  /**< total, in microseconds */
+   unsigned nr_llvm_cache_hits;    /**< variants loaded from the disk cache */
+   unsigned nr_llvm_cache_misses;
 
    unsigned nr_color_tile_clear;
+   unsigned nr_tile_clear_elided;  /**< tiles which already held the value */
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
 };
@@ -79,6 +83,16 @@ extern struct lp_counters lp_count;
 #define LP_COUNT_GET(counter) 0
 #endif
 
+/** As above, for counters also updated by the shader compile threads */
+#ifdef DEBUG
+#define LP_COUNT_ATOMIC(counter) p_atomic_inc(&lp_count.counter)
+#define LP_COUNT_ADD_ATOMIC(counter, incr) \
+   p_atomic_add(&lp_count.counter, (incr))
+#else
+#define LP_COUNT_ATOMIC(counter)
+#define LP_COUNT_ADD_ATOMIC(counter, incr) (void)(incr)
+#endif
+
 
 extern void
 lp_reset_counters(void);
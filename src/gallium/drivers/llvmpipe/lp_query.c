@@ -53,14 +53,21 @@ llvmpipe_create_query(struct pipe_context *pipe,
                       unsigned type,
                       unsigned index)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   unsigned num_threads = MAX2(1, screen->num_threads);
    struct llvmpipe_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          (type >= LP_QUERY_FIRST && type < LP_QUERY_LAST));
 
-   pq = CALLOC_STRUCT( llvmpipe_query );
+   /* The per-thread start/end counters are stored right after the query */
+   pq = CALLOC_VARIANT_LENGTH_STRUCT(llvmpipe_query,
+                                     2 * num_threads * sizeof(uint64_t));
 
    if (pq) {
       pq->type = type;
+      pq->start = (uint64_t *) (pq + 1);
+      pq->end = pq->start + num_threads;
    }
 
    return (struct pipe_query *) pq;
@@ -89,6 +96,40 @@ llvmpipe_destroy_query(struct pipe_context *pipe, struct pipe_query *q)
 }
 
 
+/**
+ * Result of a driver specific query.  Counters fed by the rasterizer are
+ * only accounted once a scene has been rasterized, so they lag behind by
+ * whatever scenes are still in flight.
+ */
+static uint64_t
+lp_query_driver_result(const struct llvmpipe_query *pq)
+{
+   const uint64_t *stats = pq->screen_stats;
+   uint64_t busy, idle, flushes;
+
+   switch (pq->type) {
+   case LP_QUERY_RAST_IMBALANCE:
+      busy = stats[LP_STAT_RAST_TIME];
+      idle = stats[LP_STAT_RAST_IDLE_TIME];
+      return busy + idle ? idle * 100 / (busy + idle) : 0;
+   case LP_QUERY_FLUSHES_OTHER:
+      flushes = stats[LP_STAT_FLUSHES_FB] +
+                stats[LP_STAT_FLUSHES_FULL] +
+                stats[LP_STAT_FLUSHES_MAP];
+      return stats[LP_STAT_SCENES] > flushes ?
+             stats[LP_STAT_SCENES] - flushes : 0;
+   case LP_QUERY_FIRST + LP_STAT_BINNING_TIME:
+   case LP_QUERY_FIRST + LP_STAT_RAST_TIME:
+   case LP_QUERY_FIRST + LP_STAT_RAST_IDLE_TIME:
+   case LP_QUERY_FIRST + LP_STAT_FS_COMPILE_TIME:
+      /* reported in microseconds */
+      return stats[pq->type - LP_QUERY_FIRST] / 1000;
+   default:
+      return stats[pq->type - LP_QUERY_FIRST];
+   }
+}
+
+
 static boolean
 llvmpipe_get_query_result(struct pipe_context *pipe, 
                           struct pipe_query *q,
@@ -101,6 +142,11 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
    uint64_t *result = (uint64_t *)vresult;
    int i;
 
+   if (pq->type >= LP_QUERY_FIRST) {
+      *result = lp_query_driver_result(pq);
+      return TRUE;
+   }
+
    if (pq->fence) {
       /* only have a fence if there was a scene */
       if (!lp_fence_signalled(pq->fence)) {
@@ -190,7 +236,19 @@ static boolean
 llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   unsigned num_threads = MAX2(1, screen->num_threads);
    struct llvmpipe_query *pq = llvmpipe_query(q);
+   unsigned i;
+
+   /* Driver queries just sample the screen counters, there is nothing
+    * to bin.
+    */
+   if (pq->type >= LP_QUERY_FIRST) {
+      for (i = 0; i < LP_STAT_COUNT; i++)
+         pq->screen_stats[i] = p_atomic_read(&screen->stats[i]);
+      return true;
+   }
 
    /* Check if the query is already in the scene.  If so, we need to
     * flush the scene now.  Real apps shouldn't re-use a query in a
@@ -201,8 +259,8 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    }
 
 
-   memset(pq->start, 0, sizeof(pq->start));
-   memset(pq->end, 0, sizeof(pq->end));
+   memset(pq->start, 0, num_threads * sizeof(pq->start[0]));
+   memset(pq->end, 0, num_threads * sizeof(pq->end[0]));
    lp_setup_begin_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -249,6 +307,16 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (pq->type >= LP_QUERY_FIRST) {
+      struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+      unsigned i;
+
+      for (i = 0; i < LP_STAT_COUNT; i++)
+         pq->screen_stats[i] = p_atomic_read(&screen->stats[i]) -
+                               pq->screen_stats[i];
+      return true;
+   }
+
    lp_setup_end_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -36,20 +36,34 @@
 #include <limits.h>
 #include "os/os_thread.h"
 #include "lp_limits.h"
+#include "lp_screen.h"
 
 
 struct llvmpipe_context;
 
 
+/**
+ * Driver specific queries.  The first LP_STAT_COUNT map directly onto the
+ * screen counters (see enum lp_stat), the rest are derived from them.
+ */
+#define LP_QUERY_FIRST            PIPE_QUERY_DRIVER_SPECIFIC
+#define LP_QUERY_RAST_IMBALANCE   (LP_QUERY_FIRST + LP_STAT_COUNT)
+#define LP_QUERY_FLUSHES_OTHER    (LP_QUERY_FIRST + LP_STAT_COUNT + 1)
+#define LP_QUERY_LAST             (LP_QUERY_FIRST + LP_STAT_COUNT + 2)
+
+
 struct llvmpipe_query {
-   uint64_t start[LP_MAX_THREADS];  /* start count value for each thread */
-   uint64_t end[LP_MAX_THREADS];    /* end count value for each thread */
+   uint64_t *start;                 /* start count value for each thread */
+   uint64_t *end;                   /* end count value for each thread */
    struct lp_fence *fence;          /* fence from last scene this was binned in */
    unsigned type;                   /* PIPE_QUERY_* */
    unsigned num_primitives_generated;
    unsigned num_primitives_written;
 
    struct pipe_query_data_pipeline_statistics stats;
+
+   /** Screen counters at begin_query, replaced by the delta at end_query */
+   uint64_t screen_stats[LP_STAT_COUNT];
 };
 
 
@@ -33,6 +33,7 @@
 #include "util/u_pack_color.h"
 #include "util/u_string.h"
 #include "util/u_thread.h"
+#include "util/u_cpu_detect.h"
 
 #include "util/os_time.h"
 
@@ -45,8 +46,10 @@
 #include "lp_rast.h"
 #include "lp_rast_priv.h"
 #include "gallivm/lp_bld_format.h"
+#include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_debug.h"
 #include "lp_scene.h"
+#include "lp_screen.h"
 #include "lp_tex_sample.h"
 
 
@@ -70,16 +73,50 @@ lp_rast_begin( struct lp_rasterizer *rast,
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   lp_scene_bin_iter_begin( scene, rast->bin_order );
 }
 
 
+/**
+ * Finish rasterizing a scene.
+ * Called once per scene by one thread, after all threads are done with
+ * the scene's bins.  Only the framebuffer is unmapped here; the rest of
+ * the scene is released by the setup module when it recycles the scene.
+ */
 static void
 lp_rast_end( struct lp_rasterizer *rast )
 {
-   lp_scene_end_rasterization( rast->curr_scene );
+   struct lp_scene *scene = rast->curr_scene;
+   struct llvmpipe_screen *screen = llvmpipe_screen(scene->pipe->screen);
+   unsigned num_tasks = MAX2(rast->num_threads, 1);
+   uint64_t busy = 0, max_busy = 0;
+   unsigned bins = 0;
+   unsigned i;
+
+   /* Accumulate the per-thread counters.  The difference between the
+    * slowest thread and each of the others is time a thread sat at the
+    * barrier, i.e. what the bin distribution cost us.
+    */
+   for (i = 0; i < num_tasks; i++) {
+      busy += rast->tasks[i].busy_time;
+      max_busy = MAX2(max_busy, (uint64_t)rast->tasks[i].busy_time);
+      bins += rast->tasks[i].bins_done;
+   }
+   lp_screen_stat_add(screen, LP_STAT_BINS, bins);
+   lp_screen_stat_add(screen, LP_STAT_RAST_TIME, busy);
+   lp_screen_stat_add(screen, LP_STAT_RAST_IDLE_TIME,
+                      num_tasks * max_busy - busy);
+
+   lp_scene_end_rasterization( scene );
 
    rast->curr_scene = NULL;
+
+   /* The scene may be reused as soon as this is signalled, so this must
+    * be the last time we touch it.
+    */
+   if (scene->fence) {
+      lp_fence_signal(scene->fence);
+   }
 }
 
 
@@ -109,48 +146,46 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
    task->thread_data.vis_counter = 0;
    task->thread_data.ps_invocations = 0;
 
+   task->pending_clears = 0;
+   task->tile_touched = FALSE;
+
    for (i = 0; i < task->scene->fb.nr_cbufs; i++) {
       if (task->scene->fb.cbufs[i]) {
          task->color_tiles[i] = scene->cbufs[i].map +
                                 scene->cbufs[i].stride * task->y +
                                 scene->cbufs[i].format_bytes * task->x;
+         task->color_tile_clear[i] = scene->cbufs[i].tile_clear ?
+            &scene->cbufs[i].tile_clear[y * scene->tiles_x + x] : NULL;
       }
    }
    if (task->scene->fb.zsbuf) {
       task->depth_tile = scene->zsbuf.map +
                          scene->zsbuf.stride * task->y +
                          scene->zsbuf.format_bytes * task->x;
+      task->depth_tile_clear = scene->zsbuf.tile_clear ?
+         &scene->zsbuf.tile_clear[y * scene->tiles_x + x] : NULL;
    }
 }
 
 
 /**
- * Clear the rasterizer's current color tile.
- * This is a bin command called during bin processing.
- * Clear commands always clear all bound layers.
+ * Fill the current color tile with a clear value.
+ * Clears always clear all bound layers.
  */
 static void
-lp_rast_clear_color(struct lp_rasterizer_task *task,
-                    const union lp_rast_cmd_arg arg)
+lp_rast_fill_color(struct lp_rasterizer_task *task,
+                   unsigned cbuf,
+                   union util_color *uc)
 {
    const struct lp_scene *scene = task->scene;
-   unsigned cbuf = arg.clear_rb->cbuf;
-   union util_color uc;
-   enum pipe_format format;
-
-   /* we never bin clear commands for non-existing buffers */
-   assert(cbuf < scene->fb.nr_cbufs);
-   assert(scene->fb.cbufs[cbuf]);
-
-   format = scene->fb.cbufs[cbuf]->format;
-   uc = arg.clear_rb->color_val;
+   enum pipe_format format = scene->fb.cbufs[cbuf]->format;
 
    /*
     * this is pretty rough since we have target format (bunch of bytes...) here.
     * dump it as raw 4 dwords.
     */
    LP_DBG(DEBUG_RAST, "%s clear value (target format %d) raw 0x%x,0x%x,0x%x,0x%x\n",
-          __FUNCTION__, format, uc.ui[0], uc.ui[1], uc.ui[2], uc.ui[3]);
+          __FUNCTION__, format, uc->ui[0], uc->ui[1], uc->ui[2], uc->ui[3]);
 
 
    util_fill_box(scene->cbufs[cbuf].map,
@@ -163,7 +198,7 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
                  task->width,
                  task->height,
                  scene->fb_max_layer + 1,
-                 &uc);
+                 uc);
 
    /* this will increase for each rb which probably doesn't mean much */
    LP_COUNT(nr_color_tile_clear);
@@ -171,17 +206,39 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
 
 
 /**
- * Clear the rasterizer's current z/stencil tile.
+ * Clear the rasterizer's current color tile.
  * This is a bin command called during bin processing.
- * Clear commands always clear all bound layers.
+ *
+ * The clear is only recorded here, and written out by
+ * lp_rast_write_clears() before the first command drawing to the tile,
+ * or at the end of the tile.  Tiles which already hold the clear value
+ * are then not written at all.
  */
 static void
-lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
-                       const union lp_rast_cmd_arg arg)
+lp_rast_clear_color(struct lp_rasterizer_task *task,
+                    const union lp_rast_cmd_arg arg)
+{
+   unsigned cbuf = arg.clear_rb->cbuf;
+
+   /* we never bin clear commands for non-existing buffers */
+   assert(cbuf < task->scene->fb.nr_cbufs);
+   assert(task->scene->fb.cbufs[cbuf]);
+
+   task->clear_color[cbuf] = arg.clear_rb->color_val;
+   task->pending_clears |= 1 << cbuf;
+}
+
+
+/**
+ * Fill the masked bits of the current z/stencil tile with a clear value.
+ * Clears always clear all bound layers.
+ */
+static void
+lp_rast_fill_zstencil(struct lp_rasterizer_task *task,
+                      uint64_t clear_value64,
+                      uint64_t clear_mask64)
 {
    const struct lp_scene *scene = task->scene;
-   uint64_t clear_value64 = arg.clear_zstencil.value;
-   uint64_t clear_mask64 = arg.clear_zstencil.mask;
    uint32_t clear_value = (uint32_t) clear_value64;
    uint32_t clear_mask = (uint32_t) clear_mask64;
    const unsigned height = task->height;
@@ -285,6 +342,143 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Clear the rasterizer's current z/stencil tile.
+ * This is a bin command called during bin processing.
+ * Like color clears, this is only recorded, and successive masked clears
+ * are merged.
+ */
+static void
+lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
+                       const union lp_rast_cmd_arg arg)
+{
+   uint64_t value = arg.clear_zstencil.value & arg.clear_zstencil.mask;
+   uint64_t mask = arg.clear_zstencil.mask;
+
+   if (!task->scene->fb.zsbuf)
+      return;
+
+   if (task->pending_clears & LP_RAST_CLEAR_ZS) {
+      task->clear_zsvalue = (task->clear_zsvalue & ~mask) | value;
+      task->clear_zsmask |= mask;
+   }
+   else {
+      task->clear_zsvalue = value;
+      task->clear_zsmask = mask;
+      task->pending_clears |= LP_RAST_CLEAR_ZS;
+   }
+}
+
+
+/**
+ * Write out the pending clears of the current tile, skipping those the
+ * tile is known to hold already.
+ * \param end_of_tile  nothing else will touch the tile in this scene, so
+ *                     a discarded z/stencil buffer needn't be cleared
+ */
+static void
+lp_rast_write_clears(struct lp_rasterizer_task *task,
+                     boolean end_of_tile)
+{
+   const struct lp_scene *scene = task->scene;
+   unsigned pending = task->pending_clears;
+
+   task->pending_clears = 0;
+
+   if (pending & LP_RAST_CLEAR_ZS) {
+      struct llvmpipe_tile_clear *tc = task->depth_tile_clear;
+      uint64_t value = task->clear_zsvalue;
+      uint64_t mask = task->clear_zsmask;
+
+      pending &= ~LP_RAST_CLEAR_ZS;
+
+      if (end_of_tile && scene->zsbuf_discard) {
+         /* The contents are undefined from here on, and the tile still
+          * holds whatever the clear state says it does.
+          */
+      }
+      else if (tc && tc->valid &&
+               (mask & ~tc->zsmask) == 0 &&
+               (tc->value[0] & mask) == value) {
+         LP_COUNT(nr_tile_clear_elided);
+      }
+      else {
+         lp_rast_fill_zstencil(task, value, mask);
+
+         if (tc) {
+            if (tc->valid) {
+               tc->value[0] = (tc->value[0] & ~mask) | value;
+               tc->zsmask |= mask;
+            }
+            else {
+               tc->value[0] = value;
+               tc->zsmask = mask;
+               tc->valid = TRUE;
+            }
+         }
+      }
+   }
+
+   while (pending) {
+      unsigned cbuf = u_bit_scan(&pending);
+      struct llvmpipe_tile_clear *tc = task->color_tile_clear[cbuf];
+      union util_color *uc = &task->clear_color[cbuf];
+      unsigned bytes = scene->cbufs[cbuf].format_bytes;
+
+      assert(bytes <= sizeof tc->value);
+
+      if (tc && tc->valid && memcmp(tc->value, uc, bytes) == 0) {
+         LP_COUNT(nr_tile_clear_elided);
+         continue;
+      }
+
+      lp_rast_fill_color(task, cbuf, uc);
+
+      if (tc) {
+         memcpy(tc->value, uc, bytes);
+         tc->valid = TRUE;
+      }
+   }
+}
+
+
+/**
+ * Called before executing a command which may write to the current tile:
+ * writes out the pending clears, and forgets what the tile holds.
+ */
+static void
+lp_rast_tile_touch(struct lp_rasterizer_task *task)
+{
+   unsigned i;
+
+   if (task->pending_clears)
+      lp_rast_write_clears(task, FALSE);
+
+   for (i = 0; i < task->scene->fb.nr_cbufs; i++) {
+      if (task->scene->fb.cbufs[i] && task->color_tile_clear[i])
+         task->color_tile_clear[i]->valid = FALSE;
+   }
+   if (task->scene->fb.zsbuf && task->depth_tile_clear)
+      task->depth_tile_clear->valid = FALSE;
+
+   task->tile_touched = TRUE;
+}
+
+
+/**
+ * Whether a bin command may write to the framebuffer.
+ */
+static inline boolean
+lp_rast_cmd_writes_tile(unsigned cmd)
+{
+   return cmd != LP_RAST_OP_CLEAR_COLOR &&
+          cmd != LP_RAST_OP_CLEAR_ZSTENCIL &&
+          cmd != LP_RAST_OP_BEGIN_QUERY &&
+          cmd != LP_RAST_OP_END_QUERY &&
+          cmd != LP_RAST_OP_SET_STATE;
+}
+
+
 
 /**
  * Run the shader on all blocks in a tile.  This is used when a tile is
@@ -316,7 +510,7 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    }
    variant = state->variant;
 
-   /* render the whole 64x64 tile in 4x4 chunks */
+   /* render the whole tile in 4x4 chunks */
    for (y = 0; y < task->height; y += 4){
       for (x = 0; x < task->width; x += 4) {
          uint8_t *color[PIPE_MAX_COLOR_BUFS];
@@ -535,6 +729,9 @@ lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg)
 {
    task->state = arg.state;
+
+   /* The fragment shader may still be compiling in the background. */
+   util_queue_fence_wait(&task->state->variant->ready);
 }
 
 
@@ -547,6 +744,9 @@ lp_rast_tile_end(struct lp_rasterizer_task *task)
 {
    unsigned i;
 
+   if (task->pending_clears)
+      lp_rast_write_clears(task, TRUE);
+
    for (i = 0; i < task->scene->num_active_queries; ++i) {
       lp_rast_end_query(task, lp_rast_arg_query(task->scene->active_queries[i]));
    }
@@ -605,7 +805,13 @@ do_rasterize_bin(struct lp_rasterizer_task *task,
 
    for (block = bin->head; block; block = block->next) {
       for (k = 0; k < block->count; k++) {
-         dispatch[block->cmd[k]]( task, block->arg[k] );
+         const unsigned cmd = block->cmd[k];
+
+         if ((task->pending_clears || !task->tile_touched) &&
+             lp_rast_cmd_writes_tile(cmd))
+            lp_rast_tile_touch(task);
+
+         dispatch[cmd]( task, block->arg[k] );
       }
    }
 }
@@ -640,20 +846,6 @@ rasterize_bin(struct lp_rasterizer_task *task,
 }
 
 
-/* An empty bin is one that just loads the contents of the tile and
- * stores them again unchanged.  This typically happens when bins have
- * been flushed for some reason in the middle of a frame, or when
- * incremental updates are being made to a render target.
- * 
- * Try to avoid doing pointless work in this case.
- */
-static boolean
-is_empty_bin( const struct cmd_bin *bin )
-{
-   return bin->head == NULL;
-}
-
-
 /**
  * Rasterize/execute all bins within a scene.
  * Called per thread.
@@ -662,7 +854,10 @@ static void
 rasterize_scene(struct lp_rasterizer_task *task,
                 struct lp_scene *scene)
 {
+   int64_t t0 = os_time_get_nano();
+
    task->scene = scene;
+   task->bins_done = 0;
 
    /* Clear the cache tags. This should not always be necessary but
       simpler for now. */
@@ -676,15 +871,17 @@ rasterize_scene(struct lp_rasterizer_task *task,
 #endif
 
    if (!task->rast->no_rast) {
-      /* loop over scene bins, rasterize each */
+      /* loop over scene bins, rasterize each (empty bins are skipped
+       * by the iterator)
+       */
       {
          struct cmd_bin *bin;
          int i, j;
 
          assert(scene);
          while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
-            if (!is_empty_bin( bin ))
-               rasterize_bin(task, bin, i, j);
+            rasterize_bin(task, bin, i, j);
+            task->bins_done++;
          }
       }
    }
@@ -704,11 +901,8 @@ rasterize_scene(struct lp_rasterizer_task *task,
    }
 #endif
 
-   if (scene->fence) {
-      lp_fence_signal(scene->fence);
-   }
-
    task->scene = NULL;
+   task->busy_time = os_time_get_nano() - t0;
 }
 
 
@@ -737,8 +931,6 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
       lp_rast_end( rast );
 
       util_fpstate_set(fpstate);
-
-      rast->curr_scene = NULL;
    }
    else {
       /* threaded rendering! */
@@ -756,29 +948,14 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 }
 
 
-void
-lp_rast_finish( struct lp_rasterizer *rast )
-{
-   if (rast->num_threads == 0) {
-      /* nothing to do */
-   }
-   else {
-      int i;
-
-      /* wait for work to complete */
-      for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_wait(&rast->tasks[i].work_done);
-      }
-   }
-}
-
-
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
  *   1. wait for work
  *   2. do work
- *   3. signal that we're done
+ *
+ * Completion of a scene is signalled through the scene's fence, by
+ * thread[0] in lp_rast_end().
  */
 static int
 thread_function(void *init_data)
@@ -831,17 +1008,12 @@ thread_function(void *init_data)
       /* wait for all threads to finish with this scene */
       util_barrier_wait( &rast->barrier );
 
-      /* XXX: shouldn't be necessary:
-       */
       if (task->thread_index == 0) {
          lp_rast_end( rast );
       }
 
-      /* signal done with work */
       if (debug)
          debug_printf("thread %d done working\n", task->thread_index);
-
-      pipe_semaphore_signal(&task->work_done);
    }
 
 #ifdef _WIN32
@@ -871,6 +1043,23 @@ create_rast_threads(struct lp_rasterizer *rast)
 
 
 
+/**
+ * Parse the LP_BIN_ORDER environment variable.
+ */
+static enum lp_bin_order
+get_bin_order(void)
+{
+   const char *order = debug_get_option("LP_BIN_ORDER", "row");
+
+   if (strcmp(order, "cost") == 0)
+      return LP_BIN_ORDER_COST;
+   if (strcmp(order, "morton") == 0)
+      return LP_BIN_ORDER_MORTON;
+
+   return LP_BIN_ORDER_ROW;
+}
+
+
 /**
  * Create new lp_rasterizer.  If num_threads is zero, don't create any
  * new threads, do rendering synchronously.
@@ -887,11 +1076,36 @@ lp_rast_create( unsigned num_threads )
       goto no_rast;
    }
 
+#ifdef LP_RAST_HAVE_AVX512
+   /* Same switch as the 16-wide fragment shaders: zmm code only runs when
+    * 512-bit vectors were asked for with LP_NATIVE_VECTOR_WIDTH.
+    */
+   if (util_cpu_caps.has_avx512f && lp_native_vector_width >= 512) {
+      dispatch[LP_RAST_OP_TRIANGLE_32_3_4] = lp_rast_triangle_32_3_4_avx512;
+      dispatch[LP_RAST_OP_TRIANGLE_32_3_16] = lp_rast_triangle_32_3_16_avx512;
+   }
+#endif
+
    rast->full_scenes = lp_scene_queue_create();
    if (!rast->full_scenes) {
       goto no_full_scenes;
    }
 
+   /* Per-thread state is sized by the actual thread count, so that
+    * large thread counts don't cost anything on small machines.
+    */
+   rast->tasks = CALLOC(MAX2(1, num_threads), sizeof *rast->tasks);
+   if (!rast->tasks) {
+      goto no_tasks;
+   }
+
+   if (num_threads > 0) {
+      rast->threads = CALLOC(num_threads, sizeof *rast->threads);
+      if (!rast->threads) {
+         goto no_thread_data_cache;
+      }
+   }
+
    for (i = 0; i < MAX2(1, num_threads); i++) {
       struct lp_rasterizer_task *task = &rast->tasks[i];
       task->rast = rast;
@@ -906,6 +1120,7 @@ lp_rast_create( unsigned num_threads )
    rast->num_threads = num_threads;
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
+   rast->bin_order = get_bin_order();
 
    create_rast_threads(rast);
 
@@ -919,12 +1134,15 @@ lp_rast_create( unsigned num_threads )
    return rast;
 
 no_thread_data_cache:
-   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+   for (i = 0; i < MAX2(1, num_threads); i++) {
       if (rast->tasks[i].thread_data.cache) {
          align_free(rast->tasks[i].thread_data.cache);
       }
    }
 
+   FREE(rast->threads);
+   FREE(rast->tasks);
+no_tasks:
    lp_scene_queue_destroy(rast->full_scenes);
 no_full_scenes:
    FREE(rast);
@@ -975,6 +1193,8 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
 
    lp_scene_queue_destroy(rast->full_scenes);
 
+   FREE(rast->threads);
+   FREE(rast->tasks);
    FREE(rast);
 }
 
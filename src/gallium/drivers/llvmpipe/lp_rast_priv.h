@@ -42,6 +42,9 @@
 #define TILE_VECTOR_HEIGHT 4
 #define TILE_VECTOR_WIDTH 4
 
+/** lp_rasterizer_task::pending_clears bit of the z/stencil buffer */
+#define LP_RAST_CLEAR_ZS (1 << PIPE_MAX_COLOR_BUFS)
+
 /* If we crash in a jitted function, we can examine jit_line and jit_state
  * to get some info.  This is not thread-safe, however.
  */
@@ -91,12 +94,32 @@ struct lp_rasterizer_task
    uint8_t *color_tiles[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth_tile;
 
+   /** Clear state of the current tile in the tracked surfaces, or NULL */
+   struct llvmpipe_tile_clear *color_tile_clear[PIPE_MAX_COLOR_BUFS];
+   struct llvmpipe_tile_clear *depth_tile_clear;
+
+   /**
+    * Clears binned for the current tile which haven't been written to the
+    * framebuffer yet (1 << cbuf, LP_RAST_CLEAR_ZS), see lp_rast_clear_color.
+    */
+   unsigned pending_clears;
+   union util_color clear_color[PIPE_MAX_COLOR_BUFS];
+   uint64_t clear_zsvalue;
+   uint64_t clear_zsmask;
+
+   /** Whether a command writing the tile has been executed yet */
+   boolean tile_touched;
+
    /** "back" pointer */
    struct lp_rasterizer *rast;
 
    /** "my" index */
    unsigned thread_index;
 
+   /** Time spent rasterizing the current scene and bins done, for stats */
+   int64_t busy_time;
+   unsigned bins_done;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
 
@@ -114,6 +137,7 @@ struct lp_rasterizer
 {
    boolean exit_flag;
    boolean no_rast;  /**< For debugging/profiling */
+   enum lp_bin_order bin_order;  /**< order in which bins are rasterized */
 
    /** The incoming queue of scenes ready to rasterize */
    struct lp_scene_queue *full_scenes;
@@ -121,11 +145,11 @@ struct lp_rasterizer
    /** The scene currently being rasterized by the threads */
    struct lp_scene *curr_scene;
 
-   /** A task object for each rasterization thread */
-   struct lp_rasterizer_task tasks[LP_MAX_THREADS];
+   /** A task object for each rasterization thread (at least one) */
+   struct lp_rasterizer_task *tasks;
 
    unsigned num_threads;
-   thrd_t threads[LP_MAX_THREADS];
+   thrd_t *threads;
 
    /** For synchronizing the rasterization threads */
    util_barrier barrier;
@@ -331,6 +355,18 @@ void lp_rast_triangle_32_3_16( struct lp_rasterizer_task *,
 void lp_rast_triangle_32_4_16( struct lp_rasterizer_task *, 
                             const union lp_rast_cmd_arg );
 
+/* AVX-512 variants of the 32-bit 3-plane kernels, picked at runtime. */
+#if defined(PIPE_ARCH_SSE) && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define LP_RAST_HAVE_AVX512 1
+
+void lp_rast_triangle_32_3_4_avx512(struct lp_rasterizer_task *,
+                                    const union lp_rast_cmd_arg );
+
+void lp_rast_triangle_32_3_16_avx512(struct lp_rasterizer_task *,
+                                     const union lp_rast_cmd_arg );
+#endif
+
 void
 lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg);
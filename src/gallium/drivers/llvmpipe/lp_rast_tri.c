@@ -35,6 +35,19 @@
 #include "lp_perf.h"
 #include "lp_rast_priv.h"
 
+
+/**
+ * The triangle rasterizer evaluates 64x64 blocks as 4x4 grids of 16x16
+ * blocks.  With 32x32 tiles, only the top-left 2x2 of them are in the
+ * tile; 128x128 tiles are split into four 64x64 blocks.
+ */
+#if TILE_SIZE == 32
+#define LP_TILE_BLOCK16_MASK 0x0033
+#else
+#define LP_TILE_BLOCK16_MASK 0xffff
+#endif
+
+
 /**
  * Shade all pixels in a 4x4 block.
  */
@@ -432,6 +445,166 @@ lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
    }
 }
 
+#ifdef LP_RAST_HAVE_AVX512
+
+#include <immintrin.h>
+
+/*
+ * AVX-512 versions of the above.  A 4x4 block of pixels fits in a single
+ * zmm register, so the edge functions of a whole block (or of the sixteen
+ * 4x4 blocks of a 16x16 block) are evaluated with one add per plane and
+ * the coverage mask comes straight out of a compare, without the
+ * pack/movemask dance.  These are only installed in the dispatch table
+ * when util_cpu_caps reports avx512f and 512-bit vectors were asked for,
+ * see lp_rast_create().
+ */
+
+#define LP_AVX512 __attribute__((target("avx512f")))
+
+static inline LP_AVX512 __m512i
+lp_avx512_lane_x(void)
+{
+   return _mm512_setr_epi32(0, 1, 2, 3, 0, 1, 2, 3,
+                            0, 1, 2, 3, 0, 1, 2, 3);
+}
+
+static inline LP_AVX512 __m512i
+lp_avx512_lane_y(void)
+{
+   return _mm512_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1,
+                            2, 2, 2, 2, 3, 3, 3, 3);
+}
+
+/**
+ * Set up the per-plane edge function values at (x, y), already biased
+ * so that a negative value means outside, plus the per-pixel offsets
+ * within a 4x4 block.
+ */
+static inline LP_AVX512 void
+setup_planes_avx512(const struct lp_rast_plane *plane,
+                    int x, int y,
+                    int c[NR_PLANES],
+                    int dcdx[NR_PLANES],
+                    int dcdy[NR_PLANES],
+                    __m512i span[NR_PLANES])
+{
+   const __m512i lane_x = lp_avx512_lane_x();
+   const __m512i lane_y = lp_avx512_lane_y();
+   unsigned p;
+
+   for (p = 0; p < NR_PLANES; p++) {
+      dcdx[p] = -plane[p].dcdx;
+      dcdy[p] = plane[p].dcdy;
+      c[p] = (int)plane[p].c + dcdx[p] * x + dcdy[p] * y - 1;
+
+      span[p] = _mm512_add_epi32(
+         _mm512_mullo_epi32(lane_x, _mm512_set1_epi32(dcdx[p])),
+         _mm512_mullo_epi32(lane_y, _mm512_set1_epi32(dcdy[p])));
+   }
+}
+
+/**
+ * Mask of the pixels of the 4x4 block whose edge function values are
+ * given by c + span, which are outside any of the planes.
+ */
+static inline LP_AVX512 unsigned
+outside_mask_avx512(const int c[NR_PLANES], const __m512i span[NR_PLANES])
+{
+   __m512i cpix = _mm512_add_epi32(_mm512_set1_epi32(c[0]), span[0]);
+   unsigned p;
+
+   for (p = 1; p < NR_PLANES; p++) {
+      cpix = _mm512_or_si512(cpix,
+                             _mm512_add_epi32(_mm512_set1_epi32(c[p]), span[p]));
+   }
+
+   return _mm512_cmplt_epi32_mask(cpix, _mm512_setzero_si512());
+}
+
+LP_AVX512 void
+lp_rast_triangle_32_3_16_avx512(struct lp_rasterizer_task *task,
+                                const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   int x = (arg.triangle.plane_mask & 0xff) + task->x;
+   int y = (arg.triangle.plane_mask >> 8) + task->y;
+
+   const __m512i lane_x = lp_avx512_lane_x();
+   const __m512i lane_y = lp_avx512_lane_y();
+   int c[NR_PLANES], dcdx[NR_PLANES], dcdy[NR_PLANES];
+   __m512i span[NR_PLANES];
+   __m512i cblock[NR_PLANES];
+   int32_t cblock_mem[NR_PLANES][16] __attribute__((aligned(64)));
+   unsigned inside = 0xffff;
+   unsigned p;
+
+   setup_planes_avx512(plane, x, y, c, dcdx, dcdy, span);
+
+   /* Trivially reject the 4x4 blocks which are entirely outside one of
+    * the planes, all sixteen at once.
+    */
+   for (p = 0; p < NR_PLANES; p++) {
+      int eo = MAX2(dcdy[p], 0) + MAX2(dcdx[p], 0);
+      __m512i rej4 = _mm512_set1_epi32(eo * 4 + 1);
+
+      cblock[p] = _mm512_add_epi32(
+         _mm512_set1_epi32(c[p]),
+         _mm512_slli_epi32(_mm512_add_epi32(
+            _mm512_mullo_epi32(lane_x, _mm512_set1_epi32(dcdx[p])),
+            _mm512_mullo_epi32(lane_y, _mm512_set1_epi32(dcdy[p]))), 2));
+
+      inside &= ~_mm512_cmplt_epi32_mask(_mm512_add_epi32(cblock[p], rej4),
+                                         _mm512_setzero_si512());
+
+      _mm512_store_si512((void *)cblock_mem[p], cblock[p]);
+   }
+
+   while (inside) {
+      int k = u_bit_scan(&inside);
+      int cb[NR_PLANES];
+      unsigned mask;
+
+      for (p = 0; p < NR_PLANES; p++)
+         cb[p] = cblock_mem[p][k];
+
+      mask = outside_mask_avx512(cb, span);
+      if (mask != 0xffff)
+         lp_rast_shade_quads_mask(task,
+                                  &tri->inputs,
+                                  x + 4 * (k & 3),
+                                  y + 4 * (k >> 2),
+                                  0xffff & ~mask);
+   }
+}
+
+LP_AVX512 void
+lp_rast_triangle_32_3_4_avx512(struct lp_rasterizer_task *task,
+                               const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   int x = (arg.triangle.plane_mask & 0xff) + task->x;
+   int y = (arg.triangle.plane_mask >> 8) + task->y;
+   int c[NR_PLANES], dcdx[NR_PLANES], dcdy[NR_PLANES];
+   __m512i span[NR_PLANES];
+   unsigned mask;
+
+   setup_planes_avx512(plane, x, y, c, dcdx, dcdy, span);
+
+   mask = outside_mask_avx512(c, span);
+   if (mask != 0xffff)
+      lp_rast_shade_quads_mask(task,
+                               &tri->inputs,
+                               x,
+                               y,
+                               0xffff & ~mask);
+}
+
+#undef LP_AVX512
+
+#endif /* LP_RAST_HAVE_AVX512 */
+
 #undef NR_PLANES
 
 #else
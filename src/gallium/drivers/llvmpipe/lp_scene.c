@@ -31,6 +31,7 @@
 #include "util/u_inlines.h"
 #include "util/simple_list.h"
 #include "util/u_format.h"
+#include "util/u_atomic.h"
 #include "lp_scene.h"
 #include "lp_fence.h"
 #include "lp_debug.h"
@@ -62,8 +63,6 @@ lp_scene_create( struct pipe_context *pipe )
    scene->data.head =
       CALLOC_STRUCT(data_block);
 
-   (void) mtx_init(&scene->mutex, mtx_plain);
-
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
    {
@@ -90,7 +89,6 @@ void
 lp_scene_destroy(struct lp_scene *scene)
 {
    lp_fence_reference(&scene->fence, NULL);
-   mtx_destroy(&scene->mutex);
    assert(scene->data.head->next == NULL);
    FREE(scene->data.head);
    FREE(scene);
@@ -146,6 +144,36 @@ lp_scene_bin_reset(struct lp_scene *scene, unsigned x, unsigned y)
 }
 
 
+/**
+ * The per-tile clear state to use for a surface, if the scene's tiles map
+ * 1:1 onto the tracked tiles of the resource (so a cleared scene tile
+ * covers the whole resource tile).  Clears cover all layers, so
+ * layered framebuffers aren't tracked.
+ *
+ * An untracked scene may still write to the tracked level 0 / layer 0,
+ * without invalidating the records of the tiles it touches, so the
+ * records of the resource are dropped then.
+ */
+static struct llvmpipe_tile_clear *
+lp_scene_surface_tile_clear(const struct lp_scene *scene,
+                            const struct pipe_surface *surf)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(surf->texture);
+
+   if (surf->u.tex.level != 0 ||
+       surf->u.tex.first_layer != 0 ||
+       scene->fb_max_layer != 0 ||
+       scene->fb.width != lpr->base.width0 ||
+       scene->fb.height != lpr->base.height0) {
+      if (surf->u.tex.level == 0 && surf->u.tex.first_layer == 0)
+         llvmpipe_resource_forget_clears(lpr);
+      return NULL;
+   }
+
+   return lpr->tile_clear;
+}
+
+
 void
 lp_scene_begin_rasterization(struct lp_scene *scene)
 {
@@ -161,6 +189,7 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
          scene->cbufs[i].stride = 0;
          scene->cbufs[i].layer_stride = 0;
          scene->cbufs[i].map = NULL;
+         scene->cbufs[i].tile_clear = NULL;
          continue;
       }
 
@@ -175,6 +204,7 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
                                                      cbuf->u.tex.first_layer,
                                                      LP_TEX_USAGE_READ_WRITE);
          scene->cbufs[i].format_bytes = util_format_get_blocksize(cbuf->format);
+         scene->cbufs[i].tile_clear = lp_scene_surface_tile_clear(scene, cbuf);
       }
       else {
          struct llvmpipe_resource *lpr = llvmpipe_resource(cbuf->texture);
@@ -184,6 +214,7 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
          scene->cbufs[i].map = lpr->data;
          scene->cbufs[i].map += cbuf->u.buf.first_element * pixstride;
          scene->cbufs[i].format_bytes = util_format_get_blocksize(cbuf->format);
+         scene->cbufs[i].tile_clear = NULL;
       }
    }
 
@@ -197,6 +228,7 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
                                                zsbuf->u.tex.first_layer,
                                                LP_TEX_USAGE_READ_WRITE);
       scene->zsbuf.format_bytes = util_format_get_blocksize(zsbuf->format);
+      scene->zsbuf.tile_clear = lp_scene_surface_tile_clear(scene, zsbuf);
    }
 }
 
@@ -204,12 +236,13 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
 
 
 /**
- * Free all the temporary data in a scene.
+ * Unmap the framebuffer surfaces mapped by lp_scene_begin_rasterization().
+ * Called by the rasterizer once all bins of the scene have been executed.
  */
 void
 lp_scene_end_rasterization(struct lp_scene *scene )
 {
-   int i, j;
+   int i;
 
    /* Unmap color buffers */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
@@ -232,6 +265,21 @@ lp_scene_end_rasterization(struct lp_scene *scene )
                               zsbuf->u.tex.first_layer);
       scene->zsbuf.map = NULL;
    }
+}
+
+
+/**
+ * Free all the temporary data in a scene, so that it can be binned
+ * into again.  Called by the setup module once the scene's fence has
+ * signalled (or if the scene never got rasterized).
+ */
+void
+lp_scene_reset(struct lp_scene *scene)
+{
+   int i, j;
+
+   /* In case the scene failed before or during rasterization */
+   lp_scene_end_rasterization(scene);
 
    /* Reset all command lists:
     */
@@ -449,61 +497,134 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 
 
 
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
+/** Number of commands in a bin, used as a rough estimate of its cost */
+static unsigned
+bin_cost(const struct cmd_bin *bin)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
-   }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
+   const struct cmd_block *block;
+   unsigned cost = 0;
+
+   for (block = bin->head; block; block = block->next)
+      cost += block->count;
+
+   return cost;
+}
+
+
+/** qsort callback: most expensive bins first, then row-major */
+static int
+compare_bin_cost(const void *a, const void *b)
+{
+   const struct bin_ref *ref_a = (const struct bin_ref *) a;
+   const struct bin_ref *ref_b = (const struct bin_ref *) b;
+
+   if (ref_a->cost != ref_b->cost)
+      return ref_a->cost > ref_b->cost ? -1 : 1;
+   if (ref_a->y != ref_b->y)
+      return ref_a->y < ref_b->y ? -1 : 1;
+   return ref_a->x < ref_b->x ? -1 : (ref_a->x > ref_b->x);
+}
+
+
+/** Interleave the bits of x and y, x in the even bits */
+static inline unsigned
+morton_code(unsigned x, unsigned y)
+{
+   unsigned code = 0;
+   unsigned i;
+
+   for (i = 0; i < 16; i++) {
+      code |= ((x >> i) & 1) << (2 * i);
+      code |= ((y >> i) & 1) << (2 * i + 1);
    }
-   return TRUE;
+
+   return code;
 }
 
 
+/** qsort callback: bins in Z-order, see LP_BIN_ORDER_MORTON */
+static int
+compare_bin_morton(const void *a, const void *b)
+{
+   const struct bin_ref *ref_a = (const struct bin_ref *) a;
+   const struct bin_ref *ref_b = (const struct bin_ref *) b;
+
+   return ref_a->cost < ref_b->cost ? -1 : (ref_a->cost > ref_b->cost);
+}
+
+
+/**
+ * Build the list of bins to be handed out by lp_scene_bin_iter_next().
+ *
+ * Empty bins are skipped here, so the threads never fetch them.  This
+ * is called by a single thread before the other rasterizer threads are
+ * released, so no locking is needed.
+ */
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene )
+lp_scene_bin_iter_begin( struct lp_scene *scene, enum lp_bin_order order )
 {
-   scene->curr_x = scene->curr_y = -1;
+   unsigned x, y, n = 0;
+
+   for (y = 0; y < scene->tiles_y; y++) {
+      for (x = 0; x < scene->tiles_x; x++) {
+         const struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
+         if (bin->head) {
+            struct bin_ref *ref = &scene->bin_list[n++];
+            ref->x = x;
+            ref->y = y;
+            switch (order) {
+            case LP_BIN_ORDER_COST:
+               ref->cost = bin_cost(bin);
+               break;
+            case LP_BIN_ORDER_MORTON:
+               /* not a cost, but the sort key */
+               ref->cost = morton_code(x, y);
+               break;
+            default:
+               ref->cost = 0;
+               break;
+            }
+         }
+      }
+   }
+
+   if (n > 1) {
+      if (order == LP_BIN_ORDER_COST)
+         qsort(scene->bin_list, n, sizeof scene->bin_list[0],
+               compare_bin_cost);
+      else if (order == LP_BIN_ORDER_MORTON)
+         qsort(scene->bin_list, n, sizeof scene->bin_list[0],
+               compare_bin_morton);
+   }
+
+   scene->num_queued_bins = n;
+   scene->curr_bin = 0;
 }
 
 
 /**
  * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
  * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * of work (a bin) to work on.  Bins are claimed with a single atomic
+ * increment of lp_scene::curr_bin, so the threads never contend on a
+ * lock here.
  */
 struct cmd_bin *
 lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
 {
-   struct cmd_bin *bin = NULL;
-
-   mtx_lock(&scene->mutex);
+   unsigned i = p_atomic_inc_return(&scene->curr_bin) - 1;
+   const struct bin_ref *ref;
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   }
-   else if (!next_bin(scene)) {
+   if (i >= scene->num_queued_bins) {
       /* no more bins left */
-      goto end;
+      return NULL;
    }
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
-
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   mtx_unlock(&scene->mutex);
-   return bin;
+   ref = &scene->bin_list[i];
+   *x = ref->x;
+   *y = ref->y;
+   /*printf("return bin at %d, %d\n", *x, *y);*/
+   return lp_scene_get_bin(scene, ref->x, ref->y);
 }
 
 
@@ -545,6 +666,7 @@ void lp_scene_begin_binning(struct lp_scene *scene,
       max_layer = MIN2(max_layer, zsbuf->u.tex.last_layer - zsbuf->u.tex.first_layer);
    }
    scene->fb_max_layer = max_layer;
+   scene->zsbuf_discard = FALSE;
 }
 
 
@@ -117,6 +117,27 @@ struct data_block_list {
 
 struct resource_ref;
 
+
+/**
+ * Order in which the rasterizer threads pick up the bins of a scene.
+ */
+enum lp_bin_order {
+   LP_BIN_ORDER_ROW,     /**< row-major, top-left to bottom-right */
+   LP_BIN_ORDER_COST,    /**< bins with the most commands first */
+   LP_BIN_ORDER_MORTON,  /**< Z-order curve, neighbours stay close in time */
+};
+
+
+/**
+ * Position of a non-empty bin, plus its estimated cost, as queued up
+ * for the rasterizer threads by lp_scene_bin_iter_begin().
+ */
+struct bin_ref {
+   uint16_t x, y;
+   unsigned cost;  /**< or the Z-order index, with LP_BIN_ORDER_MORTON */
+};
+
+
 /**
  * All bins and bin data are contained here.
  * Per-bin data goes into the 'tile' bins.
@@ -143,8 +164,15 @@ struct lp_scene {
       unsigned stride;
       unsigned layer_stride;
       unsigned format_bytes;
+      /** per-tile clear state of the surface, NULL if not tracked */
+      struct llvmpipe_tile_clear *tile_clear;
    } zsbuf, cbufs[PIPE_MAX_COLOR_BUFS];
 
+   /* The depth/stencil contents are undefined after this scene, so
+    * pending clears of the zsbuf need not be written at the end of a tile.
+    */
+   boolean zsbuf_discard;
+
    /* The amount of layers in the fb (minimum of all attachments) */
    unsigned fb_max_layer;
 
@@ -172,8 +200,10 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   mtx_t mutex;
+   /** Non-empty bins, in the order they are handed out to the threads */
+   struct bin_ref bin_list[TILES_X * TILES_Y];
+   unsigned num_queued_bins;
+   int curr_bin;  /**< next bin_list entry, advanced atomically */
 
    struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
@@ -378,7 +408,7 @@ lp_scene_get_num_bins( const struct lp_scene *scene )
 
 
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene );
+lp_scene_bin_iter_begin( struct lp_scene *scene, enum lp_bin_order order );
 
 struct cmd_bin *
 lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
@@ -403,6 +433,9 @@ lp_scene_begin_rasterization(struct lp_scene *scene);
 void
 lp_scene_end_rasterization(struct lp_scene *scene);
 
+void
+lp_scene_reset(struct lp_scene *scene);
+
 
 
 
@@ -32,10 +32,16 @@
 #include "util/u_format.h"
 #include "util/u_string.h"
 #include "util/u_format_s3tc.h"
+#include "util/disk_cache.h"
+#include "util/mesa-sha1.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 #include "draw/draw_context.h"
 #include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_debug.h"
+
+#include <llvm-c/ExecutionEngine.h>
 
 #include "os/os_misc.h"
 #include "util/os_time.h"
@@ -48,6 +54,8 @@
 #include "lp_public.h"
 #include "lp_limits.h"
 #include "lp_rast.h"
+#include "lp_perf.h"
+#include "lp_query.h"
 
 #include "state_tracker/sw_winsys.h"
 
@@ -564,10 +572,164 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
 
    assert(texture->dt);
-   if (texture->dt)
+   if (texture->dt) {
+      /* Scenes are rasterized asynchronously, make sure the ones
+       * rendering to the display target are done.
+       */
+      llvmpipe_screen_wait_rast_idle(screen, FALSE);
       winsys->displaytarget_display(winsys, texture->dt, context_private, sub_box);
+   }
+}
+
+
+/**
+ * Wait until all the scenes queued so far, by any context, have been
+ * rasterized.  Scenes are rasterized in queue order, so it is enough to
+ * wait for the last one.
+ * \return FALSE if it would have blocked but do_not_block was set.
+ */
+boolean
+llvmpipe_screen_wait_rast_idle(struct llvmpipe_screen *screen,
+                               boolean do_not_block)
+{
+   struct lp_fence *fence = NULL;
+   boolean idle = TRUE;
+
+   mtx_lock(&screen->rast_mutex);
+   lp_fence_reference(&fence, screen->last_fence);
+   mtx_unlock(&screen->rast_mutex);
+
+   if (fence) {
+      if (!lp_fence_signalled(fence)) {
+         if (do_not_block)
+            idle = FALSE;
+         else
+            lp_fence_wait(fence);
+      }
+      lp_fence_reference(&fence, NULL);
+   }
+
+   return idle;
 }
 
+static void
+lp_disk_cache_create(struct llvmpipe_screen *screen)
+{
+   uint32_t mesa_timestamp, llvm_timestamp;
+   struct mesa_sha1 ctx;
+   unsigned char sha1[20];
+   char cpu_id[20 * 2 + 1];
+   char timestamp_str[128];
+   unsigned codegen_flags;
+
+   /* Don't use the cache when dumping the generated code. */
+   if (gallivm_debug & (GALLIVM_DEBUG_IR | GALLIVM_DEBUG_ASM |
+                        GALLIVM_DEBUG_DUMP_BC))
+      return;
+
+   if (!disk_cache_get_function_timestamp(lp_disk_cache_create,
+                                          &mesa_timestamp) ||
+       !disk_cache_get_function_timestamp(LLVMLinkInMCJIT,
+                                          &llvm_timestamp))
+      return;
+
+   /* The generated code depends on the host CPU features, the native
+    * vector width, the LP_PERF flags and the GALLIVM_DEBUG flags which
+    * change code generation too.
+    */
+   codegen_flags = gallivm_debug & (GALLIVM_DEBUG_NO_OPT |
+                                    GALLIVM_DEBUG_NO_BRILINEAR |
+                                    GALLIVM_DEBUG_NO_RHO_APPROX |
+                                    GALLIVM_DEBUG_NO_QUAD_LOD);
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, &util_cpu_caps, sizeof util_cpu_caps);
+   _mesa_sha1_update(&ctx, &lp_native_vector_width,
+                     sizeof lp_native_vector_width);
+   _mesa_sha1_update(&ctx, &LP_PERF, sizeof LP_PERF);
+   _mesa_sha1_update(&ctx, &codegen_flags, sizeof codegen_flags);
+   _mesa_sha1_final(&ctx, sha1);
+   disk_cache_format_hex_id(cpu_id, sha1, 20 * 2);
+
+   util_snprintf(timestamp_str, sizeof timestamp_str, "%u_%u_%s",
+                 mesa_timestamp, llvm_timestamp, cpu_id);
+
+   screen->disk_shader_cache = disk_cache_create("llvmpipe", timestamp_str, 0);
+}
+
+
+/**
+ * Compute the disk cache key of a shader variant from the shader's IR
+ * and the variant key.
+ */
+void
+lp_disk_cache_compute_key(struct llvmpipe_screen *screen,
+                          const void *ir, size_t ir_size,
+                          const void *variant_key, size_t variant_key_size,
+                          unsigned char cache_key_out[20])
+{
+   struct mesa_sha1 ctx;
+   unsigned char sha1[20];
+
+   if (!screen->disk_shader_cache)
+      return;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, ir, ir_size);
+   _mesa_sha1_update(&ctx, variant_key, variant_key_size);
+   _mesa_sha1_final(&ctx, sha1);
+
+   disk_cache_compute_key(screen->disk_shader_cache, sha1, sizeof sha1,
+                          cache_key_out);
+}
+
+
+/**
+ * Look up the machine code of a shader variant.  On a hit, cache->data
+ * holds the code, to be freed by the caller once it has been loaded.
+ */
+void
+lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cache,
+                          const unsigned char cache_key[20])
+{
+   size_t binary_size;
+   uint8_t *buffer;
+
+   if (!screen->disk_shader_cache)
+      return;
+
+   buffer = disk_cache_get(screen->disk_shader_cache, cache_key, &binary_size);
+   if (!buffer) {
+      LP_COUNT_ATOMIC(nr_llvm_cache_misses);
+      lp_screen_stat_add(screen, LP_STAT_CACHE_MISSES, 1);
+      return;
+   }
+
+   cache->data = buffer;
+   cache->data_size = binary_size;
+   LP_COUNT_ATOMIC(nr_llvm_cache_hits);
+   lp_screen_stat_add(screen, LP_STAT_CACHE_HITS, 1);
+}
+
+
+/**
+ * Store the machine code generated for a shader variant, unless it can't
+ * be reused by another process.
+ */
+void
+lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                            struct lp_cached_code *cache,
+                            const unsigned char cache_key[20])
+{
+   if (!screen->disk_shader_cache || !cache->data_size || cache->dont_cache)
+      return;
+
+   disk_cache_put(screen->disk_shader_cache, cache_key,
+                  cache->data, cache->data_size, NULL);
+}
+
+
 static void
 llvmpipe_destroy_screen( struct pipe_screen *_screen )
 {
@@ -577,6 +739,13 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
+   if (screen->num_compile_threads)
+      util_queue_destroy(&screen->compile_queue);
+
+   lp_fence_reference(&screen->last_fence, NULL);
+
+   disk_cache_destroy(screen->disk_shader_cache);
+
    lp_jit_screen_cleanup(screen);
 
    if(winsys->destroy)
@@ -629,6 +798,74 @@ llvmpipe_get_timestamp(struct pipe_screen *_screen)
    return os_time_get_nano();
 }
 
+static int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+#define QUERY(NAME, STAT, UNITS, RESULT) \
+   {NAME, STAT, {0}, UNITS, PIPE_DRIVER_QUERY_RESULT_TYPE_##RESULT, 0, 0x0}
+
+   static const struct pipe_driver_query_info queries[] = {
+      QUERY("lp-scenes", LP_QUERY_FIRST + LP_STAT_SCENES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64, AVERAGE),
+      QUERY("lp-bins", LP_QUERY_FIRST + LP_STAT_BINS,
+            PIPE_DRIVER_QUERY_TYPE_UINT64, AVERAGE),
+      QUERY("lp-binning-time", LP_QUERY_FIRST + LP_STAT_BINNING_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS, AVERAGE),
+      QUERY("lp-rast-time", LP_QUERY_FIRST + LP_STAT_RAST_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS, AVERAGE),
+      QUERY("lp-rast-idle-time", LP_QUERY_FIRST + LP_STAT_RAST_IDLE_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS, AVERAGE),
+      QUERY("lp-rast-imbalance", LP_QUERY_RAST_IMBALANCE,
+            PIPE_DRIVER_QUERY_TYPE_PERCENTAGE, AVERAGE),
+      QUERY("lp-flushes-fb", LP_QUERY_FIRST + LP_STAT_FLUSHES_FB,
+            PIPE_DRIVER_QUERY_TYPE_UINT64, AVERAGE),
+      QUERY("lp-flushes-full", LP_QUERY_FIRST + LP_STAT_FLUSHES_FULL,
+            PIPE_DRIVER_QUERY_TYPE_UINT64, AVERAGE),
+      QUERY("lp-flushes-map", LP_QUERY_FIRST + LP_STAT_FLUSHES_MAP,
+            PIPE_DRIVER_QUERY_TYPE_UINT64, AVERAGE),
+      QUERY("lp-flushes-other", LP_QUERY_FLUSHES_OTHER,
+            PIPE_DRIVER_QUERY_TYPE_UINT64, AVERAGE),
+      QUERY("lp-fs-compiles", LP_QUERY_FIRST + LP_STAT_FS_COMPILES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64, CUMULATIVE),
+      QUERY("lp-fs-compile-time", LP_QUERY_FIRST + LP_STAT_FS_COMPILE_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS, CUMULATIVE),
+      QUERY("lp-shader-cache-hits", LP_QUERY_FIRST + LP_STAT_CACHE_HITS,
+            PIPE_DRIVER_QUERY_TYPE_UINT64, CUMULATIVE),
+      QUERY("lp-shader-cache-misses", LP_QUERY_FIRST + LP_STAT_CACHE_MISSES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64, CUMULATIVE),
+   };
+
+#undef QUERY
+
+   if (!info)
+      return ARRAY_SIZE(queries);
+
+   if (index >= ARRAY_SIZE(queries))
+      return 0;
+
+   *info = queries[index];
+   return 1;
+}
+
+static int
+llvmpipe_get_driver_query_group_info(struct pipe_screen *screen,
+                                     unsigned index,
+                                     struct pipe_driver_query_group_info *info)
+{
+   if (!info)
+      return 1;
+
+   if (index != 0)
+      return 0;
+
+   info->name = "llvmpipe";
+   info->max_active_queries = LP_QUERY_LAST - LP_QUERY_FIRST;
+   info->num_queries = llvmpipe_get_driver_query_info(screen, 0, NULL);
+   return 1;
+}
+
 /**
  * Create a new pipe_screen object
  * Note: we're not presently subclassing pipe_screen (no llvmpipe_screen).
@@ -673,6 +910,9 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.fence_finish = llvmpipe_fence_finish;
 
    screen->base.get_timestamp = llvmpipe_get_timestamp;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
+   screen->base.get_driver_query_group_info =
+      llvmpipe_get_driver_query_group_info;
 
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
@@ -691,5 +931,23 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    }
    (void) mtx_init(&screen->rast_mutex, mtx_plain);
 
+   screen->num_compile_threads = util_cpu_caps.nr_cpus > 1 ? 2 : 0;
+#ifdef PIPE_SUBSYSTEM_EMBEDDED
+   /* Variants compiled in the background need their own LLVM context,
+    * while embedded builds share the global one.
+    */
+   screen->num_compile_threads = 0;
+#else
+   screen->num_compile_threads = debug_get_num_option("LP_NUM_COMPILE_THREADS",
+                                                      screen->num_compile_threads);
+#endif
+   if (screen->num_compile_threads &&
+       !util_queue_init(&screen->compile_queue, "llvmpipe_cc", 64,
+                        screen->num_compile_threads,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL))
+      screen->num_compile_threads = 0;
+
+   lp_disk_cache_create(screen);
+
    return &screen->base;
 }
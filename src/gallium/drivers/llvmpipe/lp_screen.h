@@ -37,10 +37,37 @@
 #include "pipe/p_screen.h"
 #include "pipe/p_defines.h"
 #include "os/os_thread.h"
+#include "util/u_queue.h"
+#include "util/u_atomic.h"
 #include "gallivm/lp_bld.h"
 
 
 struct sw_winsys;
+struct lp_fence;
+struct lp_cached_code;
+struct disk_cache;
+
+
+/**
+ * Screen-wide counters behind the driver specific queries (see
+ * llvmpipe_get_driver_query_info()).  Times are in nanoseconds.
+ */
+enum lp_stat
+{
+   LP_STAT_SCENES,            /**< scenes rasterized */
+   LP_STAT_BINS,              /**< non-empty bins rasterized */
+   LP_STAT_BINNING_TIME,      /**< time spent binning primitives */
+   LP_STAT_RAST_TIME,         /**< time the rasterizer threads were busy */
+   LP_STAT_RAST_IDLE_TIME,    /**< time threads waited for the slowest one */
+   LP_STAT_FLUSHES_FB,        /**< scenes flushed by framebuffer changes */
+   LP_STAT_FLUSHES_FULL,      /**< scenes flushed for lack of memory */
+   LP_STAT_FLUSHES_MAP,       /**< scenes flushed to access a resource */
+   LP_STAT_FS_COMPILES,       /**< fragment shader variants compiled */
+   LP_STAT_FS_COMPILE_TIME,
+   LP_STAT_CACHE_HITS,        /**< variants found in the disk cache */
+   LP_STAT_CACHE_MISSES,
+   LP_STAT_COUNT
+};
 
 
 struct llvmpipe_screen
@@ -51,12 +78,25 @@ struct llvmpipe_screen
 
    unsigned num_threads;
 
+   /** Threads compiling fragment shader variants, 0 to compile them inline */
+   unsigned num_compile_threads;
+   struct util_queue compile_queue;
+
    /* Increments whenever textures are modified.  Contexts can track this.
     */
    unsigned timestamp;
 
    struct lp_rasterizer *rast;
    mtx_t rast_mutex;
+
+   /** Fence of the last scene queued by any context (under rast_mutex) */
+   struct lp_fence *last_fence;
+
+   /** On-disk cache of the machine code of shader variants */
+   struct disk_cache *disk_shader_cache;
+
+   /** Updated atomically, from any thread */
+   uint64_t stats[LP_STAT_COUNT];
 };
 
 
@@ -69,5 +109,33 @@ llvmpipe_screen( struct pipe_screen *pipe )
 }
 
 
+static inline void
+lp_screen_stat_add(struct llvmpipe_screen *screen, enum lp_stat stat,
+                   uint64_t value)
+{
+   p_atomic_add(&screen->stats[stat], value);
+}
+
+
+boolean
+llvmpipe_screen_wait_rast_idle(struct llvmpipe_screen *screen,
+                               boolean do_not_block);
+
+void
+lp_disk_cache_compute_key(struct llvmpipe_screen *screen,
+                          const void *ir, size_t ir_size,
+                          const void *variant_key, size_t variant_key_size,
+                          unsigned char cache_key_out[20]);
+
+void
+lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cache,
+                          const unsigned char cache_key[20]);
+
+void
+lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                            struct lp_cached_code *cache,
+                            const unsigned char cache_key[20]);
+
 
 #endif /* LP_SCREEN_H */
@@ -75,11 +75,15 @@ lp_setup_get_empty_scene(struct lp_setup_context *setup)
    setup->scene = setup->scenes[setup->scene_idx];
 
    if (setup->scene->fence) {
+      /* The scene was queued for rasterization earlier: wait until the
+       * rasterizer is done with it and release the resources it holds.
+       */
       if (LP_DEBUG & DEBUG_SETUP)
          debug_printf("%s: wait for scene %d\n",
                       __FUNCTION__, setup->scene->fence->id);
 
       lp_fence_wait(setup->scene->fence);
+      lp_scene_reset(setup->scene);
    }
 
    lp_scene_begin_binning(setup->scene, &setup->fb);
@@ -154,6 +158,10 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    struct lp_scene *scene = setup->scene;
    struct llvmpipe_screen *screen = llvmpipe_screen(scene->pipe->screen);
 
+   lp_screen_stat_add(screen, LP_STAT_SCENES, 1);
+   lp_screen_stat_add(screen, LP_STAT_BINNING_TIME, setup->binning_time);
+   setup->binning_time = 0;
+
    scene->num_active_queries = setup->active_binned_queries;
    memcpy(scene->active_queries, setup->active_queries,
           scene->num_active_queries * sizeof(scene->active_queries[0]));
@@ -165,23 +173,16 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    if (setup->last_fence)
       setup->last_fence->issued = TRUE;
 
-   mtx_lock(&screen->rast_mutex);
-
-   /* FIXME: We enqueue the scene then wait on the rasterizer to finish.
-    * This means we never actually run any vertex stuff in parallel to
-    * rasterization (not in the same context at least) which is what the
-    * multiple scenes per setup is about - when we get a new empty scene
-    * any old one is already empty again because we waited here for
-    * raster tasks to be finished. Ideally, we shouldn't need to wait here
-    * and rely on fences elsewhere when waiting is necessary.
-    * Certainly, lp_scene_end_rasterization() would need to be deferred too
-    * and there's probably other bits why this doesn't actually work.
+   /* Don't wait for the rasterizer here, so that binning of the next
+    * scene overlaps with rasterization of this one.  The scene is only
+    * recycled (see lp_setup_get_empty_scene()) once its fence signals,
+    * and anything needing the results waits on the fence.
     */
+   mtx_lock(&screen->rast_mutex);
+   lp_fence_reference(&screen->last_fence, scene->fence);
    lp_rast_queue_scene(screen->rast, scene);
-   lp_rast_finish(screen->rast);
    mtx_unlock(&screen->rast_mutex);
 
-   lp_scene_end_rasterization(setup->scene);
    lp_setup_reset( setup );
 
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
@@ -199,9 +200,9 @@ begin_binning( struct lp_setup_context *setup )
    assert(scene);
    assert(scene->fence == NULL);
 
-   /* Always create a fence:
+   /* Always create a fence.  It is signalled once, by lp_rast_end():
     */
-   scene->fence = lp_fence_create(MAX2(1, setup->num_threads));
+   scene->fence = lp_fence_create(1);
    if (!scene->fence)
       return FALSE;
 
@@ -342,7 +343,7 @@ set_scene_state( struct lp_setup_context *setup,
 
 fail:
    if (setup->scene) {
-      lp_scene_end_rasterization(setup->scene);
+      lp_scene_reset(setup->scene);
       setup->scene = NULL;
    }
 
@@ -371,6 +372,10 @@ lp_setup_bind_framebuffer( struct lp_setup_context *setup,
 {
    LP_DBG(DEBUG_SETUP, "%s\n", __FUNCTION__);
 
+   if (setup->state != SETUP_FLUSHED)
+      lp_screen_stat_add(llvmpipe_screen(setup->pipe->screen),
+                         LP_STAT_FLUSHES_FB, 1);
+
    /* Flush any old scene.
     */
    set_scene_state( setup, SETUP_FLUSHED, __FUNCTION__ );
@@ -392,6 +397,30 @@ lp_setup_bind_framebuffer( struct lp_setup_context *setup,
 }
 
 
+/**
+ * The contents of the bound z/stencil buffer are no longer needed once the
+ * current scene is done (e.g. after an EGL swap), so tiles which only got
+ * a depth/stencil clear needn't be written.  Any later clear or draw
+ * brings the contents back to life, see lp_setup_keep_zsbuf().
+ */
+void
+lp_setup_discard_zsbuf( struct lp_setup_context *setup )
+{
+   LP_DBG(DEBUG_SETUP, "%s\n", __FUNCTION__);
+
+   if (setup->scene && setup->fb.zsbuf)
+      setup->scene->zsbuf_discard = TRUE;
+}
+
+
+static inline void
+lp_setup_keep_zsbuf( struct lp_setup_context *setup )
+{
+   if (setup->scene)
+      setup->scene->zsbuf_discard = FALSE;
+}
+
+
 /*
  * Try to clear one color buffer of the attached fb, either by binning a clear
  * command or queuing up the clear for later (when binning is started).
@@ -542,6 +571,8 @@ lp_setup_clear( struct lp_setup_context *setup,
 {
    unsigned i;
 
+   lp_setup_keep_zsbuf(setup);
+
    /*
     * Note any of these (max 9) clears could fail (but at most there should
     * be just one failure!). This avoids doing the previous succeeded
@@ -551,6 +582,8 @@ lp_setup_clear( struct lp_setup_context *setup,
    if (flags & PIPE_CLEAR_DEPTHSTENCIL) {
       unsigned flagszs = flags & PIPE_CLEAR_DEPTHSTENCIL;
       if (!lp_setup_try_clear_zs(setup, depth, stencil, flagszs)) {
+         lp_screen_stat_add(llvmpipe_screen(setup->pipe->screen),
+                            LP_STAT_FLUSHES_FULL, 1);
          lp_setup_flush(setup, NULL, __FUNCTION__);
 
          if (!lp_setup_try_clear_zs(setup, depth, stencil, flagszs))
@@ -563,6 +596,8 @@ lp_setup_clear( struct lp_setup_context *setup,
       for (i = 0; i < setup->fb.nr_cbufs; i++) {
          if ((flags & (1 << (2 + i))) && setup->fb.cbufs[i]) {
             if (!lp_setup_try_clear_color_buffer(setup, color, i)) {
+               lp_screen_stat_add(llvmpipe_screen(setup->pipe->screen),
+                                  LP_STAT_FLUSHES_FULL, 1);
                lp_setup_flush(setup, NULL, __FUNCTION__);
 
                if (!lp_setup_try_clear_color_buffer(setup, color, i))
@@ -983,11 +1018,26 @@ lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
       return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
 
-   /* check textures referenced by the scene */
+   /* check the scenes which are being built or still in flight */
    for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
-      if (lp_scene_is_resource_referenced(setup->scenes[i], texture)) {
-         return LP_REFERENCED_FOR_READ;
+      struct lp_scene *scene = setup->scenes[i];
+      unsigned j;
+
+      /* Finished scenes keep their references until they are recycled,
+       * but they don't need to be flushed or waited on anymore.
+       */
+      if (scene->fence && lp_fence_signalled(scene->fence))
+         continue;
+
+      for (j = 0; j < scene->fb.nr_cbufs; j++) {
+         if (scene->fb.cbufs[j] && scene->fb.cbufs[j]->texture == texture)
+            return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
       }
+      if (scene->fb.zsbuf && scene->fb.zsbuf->texture == texture)
+         return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+
+      if (lp_scene_is_resource_referenced(scene, texture))
+         return LP_REFERENCED_FOR_READ;
    }
 
    return LP_UNREFERENCED;
@@ -1194,6 +1244,9 @@ boolean
 lp_setup_update_state( struct lp_setup_context *setup,
                        boolean update_scene )
 {
+   if (update_scene)
+      lp_setup_keep_zsbuf(setup);
+
    /* Some of the 'draw' pipeline stages may have changed some driver state.
     * Make sure we've processed those state changes before anything else.
     *
@@ -1249,6 +1302,9 @@ lp_setup_update_state( struct lp_setup_context *setup,
        * Cannot call lp_setup_flush_and_restart() directly here
        * because of potential recursion.
        */
+      lp_screen_stat_add(llvmpipe_screen(setup->pipe->screen),
+                         LP_STAT_FLUSHES_FULL, 1);
+
       if (!set_scene_state(setup, SETUP_FLUSHED, __FUNCTION__))
          return FALSE;
 
@@ -1292,6 +1348,7 @@ lp_setup_destroy( struct lp_setup_context *setup )
       if (scene->fence)
          lp_fence_wait(scene->fence);
 
+      lp_scene_reset(scene);
       lp_scene_destroy(scene);
    }
 
@@ -1496,6 +1553,9 @@ lp_setup_flush_and_restart(struct lp_setup_context *setup)
 
    assert(setup->state == SETUP_ACTIVE);
 
+   lp_screen_stat_add(llvmpipe_screen(setup->pipe->screen),
+                      LP_STAT_FLUSHES_FULL, 1);
+
    if (!set_scene_state(setup, SETUP_FLUSHED, __FUNCTION__))
       return FALSE;
    
@@ -72,6 +72,9 @@ void
 lp_setup_bind_framebuffer( struct lp_setup_context *setup,
                            const struct pipe_framebuffer_state *fb );
 
+void
+lp_setup_discard_zsbuf( struct lp_setup_context *setup );
+
 void 
 lp_setup_set_triangle_state( struct lp_setup_context *setup,
                              unsigned cullmode,
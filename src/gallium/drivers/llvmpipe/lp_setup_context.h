@@ -54,9 +54,11 @@
 struct lp_setup_variant;
 
 
-/** Max number of scenes */
-/* XXX: make multiple scenes per context work, see lp_setup_rasterize_scene */
-#define MAX_SCENES 1
+/**
+ * Max number of scenes per context.  While the rasterizer threads work
+ * on one scene the setup module can bin the next ones.
+ */
+#define MAX_SCENES 4
 
 
 
@@ -128,6 +130,9 @@ struct lp_setup_context
       SETUP_CLEARED,    /**< scene exists but has only clears */
       SETUP_ACTIVE      /**< scene exists and has at least one draw/query */
    } state;
+
+   /** Time spent binning into the current scene, in nanoseconds */
+   uint64_t binning_time;
    
    struct {
       const struct lp_rast_state *stored; /**< what's in the scene */
@@ -794,8 +794,8 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
    {
       int ix0 = bbox->x0 / TILE_SIZE;
       int iy0 = bbox->y0 / TILE_SIZE;
-      unsigned px = bbox->x0 & 63 & ~3;
-      unsigned py = bbox->y0 & 63 & ~3;
+      unsigned px = bbox->x0 & (TILE_SIZE - 1) & ~3;
+      unsigned py = bbox->y0 & (TILE_SIZE - 1) & ~3;
 
       assert(iy0 == bbox->y1 / TILE_SIZE &&
 	     ix0 == bbox->x1 / TILE_SIZE);
@@ -66,8 +66,10 @@
 #include "util/u_dump.h"
 #include "util/u_string.h"
 #include "util/simple_list.h"
+#include "util/hash_table.h"
 #include "util/u_dual_blend.h"
 #include "util/os_time.h"
+#include "util/u_atomic.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
 #include "tgsi/tgsi_dump.h"
@@ -102,6 +104,7 @@
 #include "lp_flush.h"
 #include "lp_state_fs.h"
 #include "lp_rast.h"
+#include "lp_screen.h"
 
 
 /** Fragment shader number (for debugging) */
@@ -2486,8 +2489,11 @@ generate_fragment(struct llvmpipe_context *lp,
 
    blend_vec_type = lp_build_vec_type(gallivm, blend_type);
 
-   util_snprintf(func_name, sizeof(func_name), "fs%u_variant%u_%s",
-                 shader->no, variant->no, partial_mask ? "partial" : "whole");
+   /* The name must not depend on the shader or variant numbers, as the
+    * machine code may be loaded from the disk cache by another process.
+    */
+   util_snprintf(func_name, sizeof(func_name), "fs_variant_%s",
+                 partial_mask ? "partial" : "whole");
 
    arg_types[0] = variant->jit_context_ptr_type;       /* context */
    arg_types[1] = int32_type;                          /* x */
@@ -2807,15 +2813,103 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 }
 
 
+/**
+ * Build and compile the code of a fragment shader variant.
+ * Runs on the screen's compile queue, unless compiling synchronously.
+ */
+static void
+compile_variant(void *job, int thread_index)
+{
+   struct lp_fragment_shader_variant *variant = job;
+   struct lp_fragment_shader *shader = variant->shader;
+   struct llvmpipe_context *lp = variant->lp;
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   unsigned char cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   boolean needs_caching;
+   int64_t t0, t1;
+
+   t0 = os_time_get();
+
+   lp_disk_cache_compute_key(screen, shader->base.tokens,
+                             tgsi_num_tokens(shader->base.tokens) *
+                                sizeof(struct tgsi_token),
+                             &variant->key, shader->variant_key_size,
+                             cache_key);
+   lp_disk_cache_find_shader(screen, &cached, cache_key);
+   needs_caching = !cached.data_size;
+   variant->gallivm->cache = &cached;
+
+   lp_jit_init_types(variant);
+   
+   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
+      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
+
+   if (variant->jit_function[RAST_WHOLE] == NULL) {
+      if (variant->opaque) {
+         /* Specialized shader, which doesn't need to read the color buffer. */
+         generate_fragment(lp, shader, variant, RAST_WHOLE);
+      }
+   }
+
+   /*
+    * Compile everything
+    */
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+
+   if (variant->function[RAST_EDGE_TEST]) {
+      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
+            gallivm_jit_function(variant->gallivm,
+                                 variant->function[RAST_EDGE_TEST]);
+   }
+
+   if (variant->function[RAST_WHOLE]) {
+         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+               gallivm_jit_function(variant->gallivm,
+                                    variant->function[RAST_WHOLE]);
+   } else if (!variant->jit_function[RAST_WHOLE]) {
+      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+   }
+
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, &cached, cache_key);
+
+   gallivm_free_ir(variant->gallivm);
+   free(cached.data);
+
+   /* Only the generated code is left, which doesn't need the context. */
+   if (variant->context) {
+      LLVMContextDispose(variant->context);
+      variant->context = NULL;
+   }
+
+   /* Other variants may be compiling concurrently. */
+   p_atomic_add(&lp->nr_fs_instrs, variant->nr_instrs);
+
+   t1 = os_time_get();
+   LP_COUNT_ADD_ATOMIC(llvm_compile_time, t1 - t0);
+   LP_COUNT_ADD_ATOMIC(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+   lp_screen_stat_add(screen, LP_STAT_FS_COMPILES, 1);
+   lp_screen_stat_add(screen, LP_STAT_FS_COMPILE_TIME, (t1 - t0) * 1000);
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
+ *
+ * The variant is returned immediately when compiling in the background;
+ * its ready fence must be waited on before calling its jit functions.
  */
 static struct lp_fragment_shader_variant *
 generate_variant(struct llvmpipe_context *lp,
                  struct lp_fragment_shader *shader,
                  const struct lp_fragment_shader_variant_key *key)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct lp_fragment_shader_variant *variant;
    const struct util_format_description *cbuf0_format_desc = NULL;
    boolean fullcolormask;
@@ -2828,12 +2922,26 @@ generate_variant(struct llvmpipe_context *lp,
    util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
                  shader->no, shader->variants_created);
 
-   variant->gallivm = gallivm_create(module_name, lp->context);
+   /* LLVM contexts can't be used by several threads at once. */
+   if (screen->num_compile_threads) {
+      variant->context = LLVMContextCreate();
+      if (!variant->context) {
+         FREE(variant);
+         return NULL;
+      }
+   }
+
+   variant->gallivm = gallivm_create(module_name,
+                                     variant->context ? variant->context
+                                                      : lp->context);
    if (!variant->gallivm) {
+      if (variant->context)
+         LLVMContextDispose(variant->context);
       FREE(variant);
       return NULL;
    }
 
+   variant->lp = lp;
    variant->shader = shader;
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
@@ -2866,43 +2974,37 @@ generate_variant(struct llvmpipe_context *lp,
       lp_debug_fs_variant(variant);
    }
 
-   lp_jit_init_types(variant);
-   
-   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
-
-   if (variant->jit_function[RAST_WHOLE] == NULL) {
-      if (variant->opaque) {
-         /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
-      }
-   }
+   util_queue_fence_init(&variant->ready);
 
    /*
-    * Compile everything
+    * Setup and binning only need the key and the opaque flag, so the draw
+    * can go ahead while the code is being compiled.  The rasterizer threads
+    * wait for it before shading (see lp_rast_set_state).
     */
+   if (screen->num_compile_threads) {
+      util_queue_add_job(&screen->compile_queue, variant, &variant->ready,
+                         compile_variant, NULL);
+   } else {
+      compile_variant(variant, 0);
+   }
 
-   gallivm_compile_module(variant->gallivm);
+   return variant;
+}
 
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
 
-   if (variant->function[RAST_EDGE_TEST]) {
-      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
-            gallivm_jit_function(variant->gallivm,
-                                 variant->function[RAST_EDGE_TEST]);
-   }
+static uint32_t
+fs_variant_key_hash(const void *key)
+{
+   return _mesa_hash_data(key, lp_fs_variant_key_size(key));
+}
 
-   if (variant->function[RAST_WHOLE]) {
-         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-               gallivm_jit_function(variant->gallivm,
-                                    variant->function[RAST_WHOLE]);
-   } else if (!variant->jit_function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
-   }
 
-   gallivm_free_ir(variant->gallivm);
+static bool
+fs_variant_key_equal(const void *a, const void *b)
+{
+   size_t size = lp_fs_variant_key_size(a);
 
-   return variant;
+   return size == lp_fs_variant_key_size(b) && memcmp(a, b, size) == 0;
 }
 
 
@@ -2923,6 +3025,13 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
    shader->no = fs_no++;
    make_empty_list(&shader->variants);
 
+   shader->variants_ht = _mesa_hash_table_create(NULL, fs_variant_key_hash,
+                                                 fs_variant_key_equal);
+   if (!shader->variants_ht) {
+      FREE(shader);
+      return NULL;
+   }
+
    /* get/save the summary info for this shader */
    lp_build_tgsi_info(templ->tokens, &shader->info);
 
@@ -2931,6 +3040,7 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
 
    shader->draw_data = draw_create_fragment_shader(llvmpipe->draw, templ);
    if (shader->draw_data == NULL) {
+      _mesa_hash_table_destroy(shader->variants_ht, NULL);
       FREE((void *) shader->base.tokens);
       FREE(shader);
       return NULL;
@@ -3027,6 +3137,9 @@ void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant)
 {
+   /* The variant may still be compiling. */
+   util_queue_fence_wait(&variant->ready);
+
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       debug_printf("llvmpipe: del fs #%u var %u v created %u v cached %u "
                    "v total cached %u inst %u total inst %u\n",
@@ -3036,16 +3149,21 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants, variant->nr_instrs, lp->nr_fs_instrs);
    }
 
+   util_queue_fence_destroy(&variant->ready);
+
    gallivm_destroy(variant->gallivm);
 
-   /* remove from shader's list */
+   /* remove from shader's list and table */
    remove_from_list(&variant->list_item_local);
+   _mesa_hash_table_remove(variant->shader->variants_ht,
+                           _mesa_hash_table_search(variant->shader->variants_ht,
+                                                   &variant->key));
    variant->shader->variants_cached--;
 
    /* remove from context's list */
    remove_from_list(&variant->list_item_global);
    lp->nr_fs_variants--;
-   lp->nr_fs_instrs -= variant->nr_instrs;
+   p_atomic_add(&lp->nr_fs_instrs, -(int)variant->nr_instrs);
 
    FREE(variant);
 }
@@ -3079,6 +3197,7 @@ llvmpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
    draw_delete_fragment_shader(llvmpipe->draw, shader->draw_data);
 
    assert(shader->variants_cached == 0);
+   _mesa_hash_table_destroy(shader->variants_ht, NULL);
    FREE((void *) shader->base.tokens);
    FREE(shader);
 }
@@ -3369,19 +3488,18 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    struct lp_fragment_shader *shader = lp->fs;
    struct lp_fragment_shader_variant_key key;
    struct lp_fragment_shader_variant *variant = NULL;
-   struct lp_fs_variant_list_item *li;
+   struct hash_entry *entry;
+   uint32_t key_hash;
 
    make_variant_key(lp, shader, &key);
+   assert(lp_fs_variant_key_size(&key) == shader->variant_key_size);
 
-   /* Search the variants for one which matches the key */
-   li = first_elem(&shader->variants);
-   while(!at_end(&shader->variants, li)) {
-      if(memcmp(&li->base->key, &key, shader->variant_key_size) == 0) {
-         variant = li->base;
-         break;
-      }
-      li = next_elem(li);
-   }
+   /* Look up the variant which matches the key */
+   key_hash = fs_variant_key_hash(&key);
+   entry = _mesa_hash_table_search_pre_hashed(shader->variants_ht,
+                                              key_hash, &key);
+   if (entry)
+      variant = entry->data;
 
    if (variant) {
       /* Move this variant to the head of the list to implement LRU
@@ -3391,7 +3509,6 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    }
    else {
       /* variant not found, create it now */
-      int64_t t0, t1, dt;
       unsigned i;
       unsigned variants_to_cull;
 
@@ -3447,19 +3564,17 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       /*
        * Generate the new variant.
        */
-      t0 = os_time_get();
       variant = generate_variant(lp, shader, &key);
-      t1 = os_time_get();
-      dt = t1 - t0;
-      LP_COUNT_ADD(llvm_compile_time, dt);
-      LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
 
-      /* Put the new variant into the list */
+      /* Put the new variant into the list.  Its instructions are added to
+       * lp->nr_fs_instrs once compiled.
+       */
       if (variant) {
          insert_at_head(&shader->variants, &variant->list_item_local);
+         _mesa_hash_table_insert_pre_hashed(shader->variants_ht, key_hash,
+                                            &variant->key, variant);
          insert_at_head(&lp->fs_variants_list, &variant->list_item_global);
          lp->nr_fs_variants++;
-         lp->nr_fs_instrs += variant->nr_instrs;
          shader->variants_cached++;
       }
    }
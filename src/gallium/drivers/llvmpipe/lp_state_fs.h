@@ -32,6 +32,8 @@
 
 #include "pipe/p_compiler.h"
 #include "pipe/p_state.h"
+#include "util/u_memory.h" /* for Offset */
+#include "util/u_queue.h" /* for util_queue_fence */
 #include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
@@ -40,6 +42,8 @@
 
 struct tgsi_token;
 struct lp_fragment_shader;
+struct llvmpipe_context;
+struct hash_table;
 
 
 /** Indexes into jit_function[] array */
@@ -85,6 +89,18 @@ struct lp_fragment_shader_variant_key
 };
 
 
+/**
+ * Size of the meaningful part of the key, which is the same for all the
+ * variants of a shader (see lp_fragment_shader::variant_key_size).
+ */
+static inline size_t
+lp_fs_variant_key_size(const struct lp_fragment_shader_variant_key *key)
+{
+   return Offset(struct lp_fragment_shader_variant_key,
+                 state[MAX2(key->nr_samplers, key->nr_sampler_views)]);
+}
+
+
 /** doubly-linked list item */
 struct lp_fs_variant_list_item
 {
@@ -112,6 +128,14 @@ struct lp_fragment_shader_variant
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
+   /** Signalled once jit_function[] are ready, see LP_NUM_COMPILE_THREADS */
+   struct util_queue_fence ready;
+
+   /** Private LLVM context when compiled in the background, or NULL */
+   LLVMContextRef context;
+
+   struct llvmpipe_context *lp;
+
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
 
@@ -129,6 +153,9 @@ struct lp_fragment_shader
 
    struct lp_fs_variant_list_item variants;
 
+   /** The same variants, indexed by key */
+   struct hash_table *variants_ht;
+
    struct draw_fragment_shader *draw_data;
 
    /* For debugging/profiling purposes */
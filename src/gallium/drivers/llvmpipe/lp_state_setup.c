@@ -29,6 +29,7 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/simple_list.h"
+#include "util/hash_table.h"
 #include "util/os_time.h"
 #include "gallivm/lp_bld_arit.h"
 #include "gallivm/lp_bld_bitarit.h"
@@ -707,10 +708,14 @@ static struct lp_setup_variant *
 generate_setup_variant(struct lp_setup_variant_key *key,
                        struct llvmpipe_context *lp)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct lp_setup_variant *variant = NULL;
    struct gallivm_state *gallivm;
    struct lp_setup_args args;
-   char func_name[64];
+   char module_name[64];
+   unsigned char cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   boolean needs_caching;
    LLVMTypeRef vec4f_type;
    LLVMTypeRef func_type;
    LLVMTypeRef arg_types[7];
@@ -727,10 +732,10 @@ generate_setup_variant(struct lp_setup_variant_key *key,
 
    variant->no = setup_no++;
 
-   util_snprintf(func_name, sizeof(func_name), "setup_variant_%u",
+   util_snprintf(module_name, sizeof(module_name), "setup_variant_%u",
                  variant->no);
 
-   variant->gallivm = gallivm = gallivm_create(func_name, lp->context);
+   variant->gallivm = gallivm = gallivm_create(module_name, lp->context);
    if (!variant->gallivm) {
       goto fail;
    }
@@ -744,6 +749,11 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    memcpy(&variant->key, key, key->size);
    variant->list_item_global.base = variant;
 
+   lp_disk_cache_compute_key(screen, NULL, 0, key, key->size, cache_key);
+   lp_disk_cache_find_shader(screen, &cached, cache_key);
+   needs_caching = !cached.data_size;
+   gallivm->cache = &cached;
+
    /* Currently always deal with full 4-wide vertex attributes from
     * the vertices.
     */
@@ -761,7 +771,11 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    func_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
                                 arg_types, ARRAY_SIZE(arg_types), 0);
 
-   variant->function = LLVMAddFunction(gallivm->module, func_name, func_type);
+   /* Same name for all variants, for the machine code to be reusable from
+    * the disk cache.
+    */
+   variant->function = LLVMAddFunction(gallivm->module, "setup_variant",
+                                       func_type);
    if (!variant->function)
       goto fail;
 
@@ -805,7 +819,11 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    if (!variant->jit_function)
       goto fail;
 
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, &cached, cache_key);
+
    gallivm_free_ir(variant->gallivm);
+   free(cached.data);
 
    /*
     * Update timing information:
@@ -825,6 +843,7 @@ fail:
       }
       FREE(variant);
    }
+   free(cached.data);
 
    return NULL;
 }
@@ -882,6 +901,33 @@ lp_make_setup_variant_key(struct llvmpipe_context *lp,
 }
 
 
+static uint32_t
+setup_variant_key_hash(const void *key)
+{
+   return _mesa_hash_data(key, ((const struct lp_setup_variant_key *)key)->size);
+}
+
+
+static bool
+setup_variant_key_equal(const void *a, const void *b)
+{
+   const struct lp_setup_variant_key *key_a = a;
+   const struct lp_setup_variant_key *key_b = b;
+
+   return key_a->size == key_b->size && memcmp(a, b, key_a->size) == 0;
+}
+
+
+boolean
+lp_init_setup_variants(struct llvmpipe_context *lp)
+{
+   lp->setup_variants_ht = _mesa_hash_table_create(NULL,
+                                                   setup_variant_key_hash,
+                                                   setup_variant_key_equal);
+   return lp->setup_variants_ht != NULL;
+}
+
+
 static void
 remove_setup_variant(struct llvmpipe_context *lp,
                      struct lp_setup_variant *variant)
@@ -896,6 +942,9 @@ remove_setup_variant(struct llvmpipe_context *lp,
    }
 
    remove_from_list(&variant->list_item_global);
+   _mesa_hash_table_remove(lp->setup_variants_ht,
+                           _mesa_hash_table_search(lp->setup_variants_ht,
+                                                   &variant->key));
    lp->nr_setup_variants--;
    FREE(variant);
 }
@@ -941,17 +990,16 @@ llvmpipe_update_setup(struct llvmpipe_context *lp)
 {
    struct lp_setup_variant_key *key = &lp->setup_variant.key;
    struct lp_setup_variant *variant = NULL;
-   struct lp_setup_variant_list_item *li;
+   struct hash_entry *entry;
+   uint32_t key_hash;
 
    lp_make_setup_variant_key(lp, key);
 
-   foreach(li, &lp->setup_variants_list) {
-      if(li->base->key.size == key->size &&
-         memcmp(&li->base->key, key, key->size) == 0) {
-         variant = li->base;
-         break;
-      }
-   }
+   key_hash = setup_variant_key_hash(key);
+   entry = _mesa_hash_table_search_pre_hashed(lp->setup_variants_ht,
+                                              key_hash, key);
+   if (entry)
+      variant = entry->data;
 
    if (variant) {
       move_to_head(&lp->setup_variants_list, &variant->list_item_global);
@@ -964,6 +1012,8 @@ llvmpipe_update_setup(struct llvmpipe_context *lp)
       variant = generate_setup_variant(key, lp);
       if (variant) {
          insert_at_head(&lp->setup_variants_list, &variant->list_item_global);
+         _mesa_hash_table_insert_pre_hashed(lp->setup_variants_ht, key_hash,
+                                            &variant->key, variant);
          lp->nr_setup_variants++;
       }
    }
@@ -981,6 +1031,9 @@ lp_delete_setup_variants(struct llvmpipe_context *lp)
       remove_setup_variant(lp, li->base);
       li = next;
    }
+
+   _mesa_hash_table_destroy(lp->setup_variants_ht, NULL);
+   lp->setup_variants_ht = NULL;
 }
 
 void
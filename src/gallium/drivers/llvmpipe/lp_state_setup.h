@@ -73,6 +73,7 @@ struct lp_setup_variant {
    unsigned no;
 };
 
+boolean lp_init_setup_variants(struct llvmpipe_context *lp);
 void lp_delete_setup_variants(struct llvmpipe_context *lp);
 
 void
@@ -124,6 +124,23 @@ lp_flush_resource(struct pipe_context *ctx, struct pipe_resource *resource)
 }
 
 
+/**
+ * Only used as a hint: the state trackers invalidate the depth/stencil
+ * buffer after swapbuffers, which lets us skip writing back its clears.
+ */
+static void
+llvmpipe_invalidate_resource(struct pipe_context *pipe,
+                             struct pipe_resource *resource)
+{
+   struct llvmpipe_context *lp = llvmpipe_context(pipe);
+
+   if (lp->framebuffer.zsbuf &&
+       lp->framebuffer.zsbuf->texture == resource) {
+      lp_setup_discard_zsbuf(lp->setup);
+   }
+}
+
+
 static struct pipe_surface *
 llvmpipe_create_surface(struct pipe_context *pipe,
                         struct pipe_resource *pt,
@@ -236,4 +253,5 @@ llvmpipe_init_surface_functions(struct llvmpipe_context *lp)
    lp->pipe.resource_copy_region = lp_resource_copy;
    lp->pipe.blit = lp_blit;
    lp->pipe.flush_resource = lp_flush_resource;
+   lp->pipe.invalidate_resource = llvmpipe_invalidate_resource;
 }
@@ -291,6 +291,17 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
       memset(lpr->data, 0, bytes);
    }
 
+   if (llvmpipe_resource_is_texture(&lpr->base) &&
+       (lpr->base.bind & (PIPE_BIND_RENDER_TARGET |
+                          PIPE_BIND_DEPTH_STENCIL)) &&
+       !(lpr->base.bind & PIPE_BIND_SHARED)) {
+      lpr->tiles_x = align(lpr->base.width0, TILE_SIZE) / TILE_SIZE;
+      lpr->tiles_y = align(lpr->base.height0, TILE_SIZE) / TILE_SIZE;
+      lpr->tile_clear = CALLOC(lpr->tiles_x * lpr->tiles_y,
+                               sizeof *lpr->tile_clear);
+      /* Not fatal, the tiles just always get cleared. */
+   }
+
    lpr->id = id_counter++;
 
 #ifdef DEBUG
@@ -337,6 +348,8 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
       align_free(lpr->data);
    }
 
+   FREE(lpr->tile_clear);
+
 #ifdef DEBUG
    if (lpr->next)
       remove_from_list(lpr);
@@ -423,6 +436,20 @@ llvmpipe_resource_unmap(struct pipe_resource *resource,
 }
 
 
+/**
+ * Drop the per-tile clear state of a resource, after it was written by
+ * something other than the rasterizer.
+ */
+void
+llvmpipe_resource_forget_clears(struct llvmpipe_resource *lpr)
+{
+   if (lpr->tile_clear) {
+      memset(lpr->tile_clear, 0,
+             lpr->tiles_x * lpr->tiles_y * sizeof *lpr->tile_clear);
+   }
+}
+
+
 void *
 llvmpipe_resource_data(struct pipe_resource *resource)
 {
@@ -544,6 +571,16 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
          assert(do_not_block);
          return NULL;
       }
+
+      /* Scenes queued by other contexts may still be rendering to it, or
+       * sampling from it while we are about to write it.
+       */
+      if (((resource->bind & (PIPE_BIND_RENDER_TARGET |
+                              PIPE_BIND_DEPTH_STENCIL)) ||
+           ((resource->bind & PIPE_BIND_SAMPLER_VIEW) && !read_only)) &&
+          !llvmpipe_screen_wait_rast_idle(screen, do_not_block)) {
+         return NULL;
+      }
    }
 
    /* Check if we're mapping a current constant buffer */
@@ -609,6 +646,9 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
       /* Do something to notify sharing contexts of a texture change.
        */
       screen->timestamp++;
+
+      /* The tiles no longer hold what they were cleared to. */
+      llvmpipe_resource_forget_clears(lpr);
    }
 
    map +=
@@ -49,6 +49,19 @@ struct llvmpipe_context;
 struct sw_displaytarget;
 
 
+/**
+ * What a TILE_SIZE x TILE_SIZE tile of level 0 / layer 0 of a render
+ * target is known to contain.  Lets the rasterizer skip clearing tiles
+ * which still hold the value they were last cleared to.
+ */
+struct llvmpipe_tile_clear
+{
+   uint64_t value[2];   /**< clear value, packed in the surface format */
+   uint64_t zsmask;     /**< z/stencil bits of value the tile holds */
+   boolean valid;       /**< the whole tile holds value */
+};
+
+
 /**
  * llvmpipe subclass of pipe_resource.  A texture, drawing surface,
  * vertex buffer, const buffer, etc.
@@ -85,6 +98,14 @@ struct llvmpipe_resource
     */
    void *data;
 
+   /**
+    * Per-tile clear state of render targets, tiles_x * tiles_y entries,
+    * or NULL when not tracked (e.g. for shared resources).  Written by
+    * the rasterizer threads, each of which owns the tiles it renders.
+    */
+   struct llvmpipe_tile_clear *tile_clear;
+   unsigned tiles_x, tiles_y;
+
    boolean userBuffer;  /** Is this a user-space buffer? */
    unsigned timestamp;
 
@@ -211,6 +232,10 @@ void *
 llvmpipe_resource_data(struct pipe_resource *resource);
 
 
+void
+llvmpipe_resource_forget_clears(struct llvmpipe_resource *lpr);
+
+
 unsigned
 llvmpipe_resource_size(const struct pipe_resource *resource);
 
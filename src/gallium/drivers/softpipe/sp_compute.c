@@ -35,10 +35,14 @@
 #include "sp_tex_tile_cache.h"
 #include "tgsi/tgsi_parse.h"
 
+/**
+ * Prepare a machine to run the threads first_thread to
+ * first_thread + num_threads - 1 of a block, one per lane.
+ */
 static void
 cs_prepare(const struct sp_compute_shader *cs,
            struct tgsi_exec_machine *machine,
-           int w, int h, int d,
+           int first_thread, int num_threads,
            int g_w, int g_h, int g_d,
            int b_w, int b_h, int b_d,
            struct tgsi_sampler *sampler,
@@ -53,18 +57,22 @@ cs_prepare(const struct sp_compute_shader *cs,
                                  cs->tokens,
                                  sampler, image, buffer);
 
+   /* The spare lanes repeat the last thread, with their stores masked out */
+   machine->NonHelperMask = (1 << num_threads) - 1;
+
    if (machine->SysSemanticToIndex[TGSI_SEMANTIC_THREAD_ID] != -1) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_THREAD_ID];
-      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-         machine->SystemValue[i].xyzw[0].i[j] = w;
-         machine->SystemValue[i].xyzw[1].i[j] = h;
-         machine->SystemValue[i].xyzw[2].i[j] = d;
+      for (j = 0; j < machine->NumLanes; j++) {
+         int idx = first_thread + MIN2(j, num_threads - 1);
+         machine->SystemValue[i].xyzw[0].i[j] = idx % b_w;
+         machine->SystemValue[i].xyzw[1].i[j] = (idx / b_w) % b_h;
+         machine->SystemValue[i].xyzw[2].i[j] = idx / (b_w * b_h);
       }
    }
 
    if (machine->SysSemanticToIndex[TGSI_SEMANTIC_GRID_SIZE] != -1) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_GRID_SIZE];
-      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+      for (j = 0; j < machine->NumLanes; j++) {
          machine->SystemValue[i].xyzw[0].i[j] = g_w;
          machine->SystemValue[i].xyzw[1].i[j] = g_h;
          machine->SystemValue[i].xyzw[2].i[j] = g_d;
@@ -73,7 +81,7 @@ cs_prepare(const struct sp_compute_shader *cs,
 
    if (machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_SIZE] != -1) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_SIZE];
-      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+      for (j = 0; j < machine->NumLanes; j++) {
          machine->SystemValue[i].xyzw[0].i[j] = b_w;
          machine->SystemValue[i].xyzw[1].i[j] = b_h;
          machine->SystemValue[i].xyzw[2].i[j] = b_d;
@@ -90,13 +98,12 @@ cs_run(const struct sp_compute_shader *cs,
       if (machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_ID] != -1) {
          unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_ID];
          int j;
-         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         for (j = 0; j < machine->NumLanes; j++) {
             machine->SystemValue[i].xyzw[0].i[j] = g_w;
             machine->SystemValue[i].xyzw[1].i[j] = g_h;
             machine->SystemValue[i].xyzw[2].i[j] = g_d;
          }
       }
-      machine->NonHelperMask = (1 << 1) - 1;
    }
 
    tgsi_exec_machine_run(machine, restart ? machine->pc : 0);
@@ -108,7 +115,7 @@ cs_run(const struct sp_compute_shader *cs,
 
 static void
 run_workgroup(const struct sp_compute_shader *cs,
-              int g_w, int g_h, int g_d, int num_threads,
+              int g_w, int g_h, int g_d, int num_machines,
               struct tgsi_exec_machine **machines)
 {
    int i;
@@ -116,7 +123,7 @@ run_workgroup(const struct sp_compute_shader *cs,
 
    do {
       grp_hit_barrier = false;
-      for (i = 0; i < num_threads; i++) {
+      for (i = 0; i < num_machines; i++) {
          grp_hit_barrier |= cs_run(cs, g_w, g_h, g_d, machines[i], restart_threads);
       }
       restart_threads = false;
@@ -170,10 +177,10 @@ softpipe_launch_grid(struct pipe_context *context,
 {
    struct softpipe_context *softpipe = softpipe_context(context);
    struct sp_compute_shader *cs = softpipe->cs;
-   int num_threads_in_group;
+   int num_threads_in_group, num_machines;
    struct tgsi_exec_machine **machines;
    int bwidth, bheight, bdepth;
-   int w, h, d, i;
+   int i;
    int g_w, g_h, g_d;
    uint32_t grid_size[3] = {0};
    void *local_mem = NULL;
@@ -190,44 +197,44 @@ softpipe_launch_grid(struct pipe_context *context,
       local_mem = CALLOC(1, cs->shader.req_local_mem);
    }
 
-   machines = CALLOC(sizeof(struct tgsi_exec_machine *), num_threads_in_group);
+   /* each machine runs TGSI_EXEC_MAX_LANES threads of the block */
+   num_machines = DIV_ROUND_UP(num_threads_in_group, TGSI_EXEC_MAX_LANES);
+   machines = CALLOC(sizeof(struct tgsi_exec_machine *), num_machines);
    if (!machines) {
       FREE(local_mem);
       return;
    }
 
    /* initialise machines + GRID_SIZE + THREAD_ID  + BLOCK_SIZE */
-   for (d = 0; d < bdepth; d++) {
-      for (h = 0; h < bheight; h++) {
-         for (w = 0; w < bwidth; w++) {
-            int idx = w + (h * bwidth) + (d * bheight * bwidth);
-            machines[idx] = tgsi_exec_machine_create(PIPE_SHADER_COMPUTE);
-
-            machines[idx]->LocalMem = local_mem;
-            machines[idx]->LocalMemSize = cs->shader.req_local_mem;
-            cs_prepare(cs, machines[idx],
-                       w, h, d,
-                       grid_size[0], grid_size[1], grid_size[2],
-                       bwidth, bheight, bdepth,
-                       (struct tgsi_sampler *)softpipe->tgsi.sampler[PIPE_SHADER_COMPUTE],
-                       (struct tgsi_image *)softpipe->tgsi.image[PIPE_SHADER_COMPUTE],
-                       (struct tgsi_buffer *)softpipe->tgsi.buffer[PIPE_SHADER_COMPUTE]);
-            tgsi_exec_set_constant_buffers(machines[idx], PIPE_MAX_CONSTANT_BUFFERS,
-                                           softpipe->mapped_constants[PIPE_SHADER_COMPUTE],
-                                           softpipe->const_buffer_size[PIPE_SHADER_COMPUTE]);
-         }
-      }
+   for (i = 0; i < num_machines; i++) {
+      int first_thread = i * TGSI_EXEC_MAX_LANES;
+
+      machines[i] = tgsi_exec_machine_create_wide(PIPE_SHADER_COMPUTE);
+
+      machines[i]->LocalMem = local_mem;
+      machines[i]->LocalMemSize = cs->shader.req_local_mem;
+      cs_prepare(cs, machines[i],
+                 first_thread,
+                 MIN2(TGSI_EXEC_MAX_LANES, num_threads_in_group - first_thread),
+                 grid_size[0], grid_size[1], grid_size[2],
+                 bwidth, bheight, bdepth,
+                 (struct tgsi_sampler *)softpipe->tgsi.sampler[PIPE_SHADER_COMPUTE],
+                 (struct tgsi_image *)softpipe->tgsi.image[PIPE_SHADER_COMPUTE],
+                 (struct tgsi_buffer *)softpipe->tgsi.buffer[PIPE_SHADER_COMPUTE]);
+      tgsi_exec_set_constant_buffers(machines[i], PIPE_MAX_CONSTANT_BUFFERS,
+                                     softpipe->mapped_constants[PIPE_SHADER_COMPUTE],
+                                     softpipe->const_buffer_size[PIPE_SHADER_COMPUTE]);
    }
 
    for (g_d = 0; g_d < grid_size[2]; g_d++) {
       for (g_h = 0; g_h < grid_size[1]; g_h++) {
          for (g_w = 0; g_w < grid_size[0]; g_w++) {
-            run_workgroup(cs, g_w, g_h, g_d, num_threads_in_group, machines);
+            run_workgroup(cs, g_w, g_h, g_d, num_machines, machines);
          }
       }
    }
 
-   for (i = 0; i < num_threads_in_group; i++) {
+   for (i = 0; i < num_machines; i++) {
       cs_delete(cs, machines[i]);
       tgsi_exec_machine_destroy(machines[i]);
    }
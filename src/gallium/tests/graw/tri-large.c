@@ -1,10 +1,15 @@
 /* Display a huge triangle on a 8192x8192 canvas.
  * This demo has no dependencies on any utility code,
  * just the graw interface and gallium.
+ *
+ * With "-b <frames>", the triangle is drawn that many times and the
+ * fill rate is printed, to compare driver configurations (e.g. llvmpipe's
+ * tile size or LP_BIN_ORDER).
  */
 
 #include "graw_util.h"
 #include "util/u_debug.h"
+#include "util/os_time.h"
 
 #include <stdio.h>
 
@@ -20,6 +25,7 @@ struct vertex {
 };
 
 static boolean FlatShade = FALSE;
+static int BenchFrames = 0;
 
 
 static struct vertex vertices[3] =
@@ -102,6 +108,37 @@ static void set_fragment_shader( void )
 }
 
 
+static void benchmark( void )
+{
+   union pipe_color_union clear_color = { {1,0,1,1} };
+   struct pipe_fence_handle *fence = NULL;
+   int64_t start, end;
+   double secs;
+   int i;
+
+   start = os_time_get();
+
+   for (i = 0; i < BenchFrames; i++) {
+      info.ctx->clear(info.ctx, PIPE_CLEAR_COLOR, &clear_color, 0, 0);
+      util_draw_arrays(info.ctx, PIPE_PRIM_TRIANGLES, 0, 3);
+      info.ctx->flush(info.ctx, NULL, 0);
+   }
+
+   info.ctx->flush(info.ctx, &fence, 0);
+   info.screen->fence_finish(info.screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+   info.screen->fence_reference(info.screen, &fence, NULL);
+
+   end = os_time_get();
+   secs = (end - start) / 1000000.0;
+
+   /* The triangle covers half of the surface. */
+   printf("%s: %d frames in %.3f s, %.2f frames/s, %.1f Mpixels/s\n",
+          info.screen->get_name(info.screen), BenchFrames, secs,
+          BenchFrames / secs,
+          BenchFrames * (WIDTH * (double)HEIGHT / 2) / secs / 1000000.0);
+}
+
+
 static void draw( void )
 {
    union pipe_color_union clear_color = { {1,0,1,1} };
@@ -156,6 +193,10 @@ static void args(int argc, char *argv[])
          FlatShade = TRUE;
          i++;
       }
+      else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+         BenchFrames = atoi(argv[i + 1]);
+         i += 2;
+      }
       else {
          printf("Invalid arg %s\n", argv[i]);
          exit(1);
@@ -168,6 +209,11 @@ int main( int argc, char *argv[] )
    args(argc, argv);
    init();
 
+   if (BenchFrames > 0) {
+      benchmark();
+      return 0;
+   }
+
    graw_set_display_func( draw );
    graw_main_loop();
    return 0;
@@ -0,0 +1,390 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/* Not a test, measures how many vertices per second the driver transforms.
+ *
+ * Usage: vertex-throughput [grid_size [frames]]
+ *
+ * Draws a grid_size x grid_size (512 by default) indexed triangle mesh with
+ * positions and normals, transformed by a matrix and lit by three
+ * directional lights in the vertex shader, frames (20 by default) times.
+ * The triangles are small, so with software drivers the time goes into
+ * vertex processing rather than rasterization.  DRAW_THREADS controls how
+ * many threads the draw module uses for the vertex shader.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WIDTH 300
+#define HEIGHT 300
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* util_draw_init_info */
+#include "util/u_draw.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_fragment_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* tgsi_text_translate */
+#include "tgsi/tgsi_text.h"
+/* os_time_get_nano */
+#include "util/os_time.h"
+/* to get a hardware pipe driver */
+#include "pipe-loader/pipe_loader.h"
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+	struct pipe_framebuffer_state framebuffer;
+	struct pipe_vertex_element velem[2];
+	struct pipe_vertex_buffer vbuffer;
+
+	void *vs;
+	void *fs;
+
+	union pipe_color_union clear_color;
+
+	unsigned grid_size;
+	unsigned num_indices;
+
+	struct pipe_resource *vbuf;
+	struct pipe_resource *ibuf;
+	struct pipe_resource *cbuf;
+	struct pipe_resource *target;
+};
+
+static void init_mesh(struct program *p)
+{
+	unsigned n = p->grid_size;
+	float (*vertices)[2][3] = MALLOC(n * n * sizeof(*vertices));
+	unsigned *indices = MALLOC((n - 1) * (n - 1) * 6 * sizeof(unsigned));
+	unsigned x, y, i = 0;
+
+	/* a wavy sheet covering the viewport */
+	for (y = 0; y < n; y++) {
+		for (x = 0; x < n; x++) {
+			float fx = 2.0f * x / (n - 1) - 1.0f;
+			float fy = 2.0f * y / (n - 1) - 1.0f;
+			float dx = 0.1f * cosf(8.0f * fx);
+			float dy = 0.1f * cosf(8.0f * fy);
+			float len = sqrtf(dx * dx + dy * dy + 1.0f);
+
+			vertices[y * n + x][0][0] = fx;
+			vertices[y * n + x][0][1] = fy;
+			vertices[y * n + x][0][2] = 0.1f * (sinf(8.0f * fx) + sinf(8.0f * fy));
+			vertices[y * n + x][1][0] = -dx / len;
+			vertices[y * n + x][1][1] = -dy / len;
+			vertices[y * n + x][1][2] = 1.0f / len;
+		}
+	}
+
+	for (y = 0; y < n - 1; y++) {
+		for (x = 0; x < n - 1; x++) {
+			unsigned v = y * n + x;
+
+			indices[i++] = v;
+			indices[i++] = v + 1;
+			indices[i++] = v + n;
+			indices[i++] = v + 1;
+			indices[i++] = v + n + 1;
+			indices[i++] = v + n;
+		}
+	}
+	p->num_indices = i;
+
+	p->vbuf = pipe_buffer_create(p->screen, PIPE_BIND_VERTEX_BUFFER,
+				     PIPE_USAGE_DEFAULT, n * n * sizeof(*vertices));
+	pipe_buffer_write(p->pipe, p->vbuf, 0, n * n * sizeof(*vertices), vertices);
+
+	p->ibuf = pipe_buffer_create(p->screen, PIPE_BIND_INDEX_BUFFER,
+				     PIPE_USAGE_DEFAULT, i * sizeof(unsigned));
+	pipe_buffer_write(p->pipe, p->ibuf, 0, i * sizeof(unsigned), indices);
+
+	FREE(vertices);
+	FREE(indices);
+}
+
+static void init_prog(struct program *p)
+{
+	struct pipe_surface surf_tmpl;
+	int ret;
+
+	/* find a hardware device */
+	ret = pipe_loader_probe(&p->dev, 1);
+	assert(ret);
+
+	/* init a pipe screen */
+	p->screen = pipe_loader_create_screen(p->dev);
+	assert(p->screen);
+
+	/* create the pipe driver context and cso context */
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe, 0);
+
+	/* set clear color */
+	p->clear_color.f[0] = 0.3;
+	p->clear_color.f[1] = 0.1;
+	p->clear_color.f[2] = 0.3;
+	p->clear_color.f[3] = 1.0;
+
+	init_mesh(p);
+
+	/* constants: a rotation around x and the three light directions */
+	{
+		const float c = 0.8f, s = 0.6f;
+		float constants[7][4] = {
+			{ 1.0f, 0.0f, 0.0f, 0.0f },
+			{ 0.0f, c, -s, 0.0f },
+			{ 0.0f, 0.5f * s, 0.5f * c, 0.5f },
+			{ 0.0f, 0.0f, 0.0f, 1.0f },
+			{ 0.0f, 0.0f, 1.0f, 0.0f },
+			{ 0.6f, 0.0f, 0.8f, 0.0f },
+			{ 0.0f, -0.6f, 0.8f, 0.0f },
+		};
+
+		p->cbuf = pipe_buffer_create(p->screen, PIPE_BIND_CONSTANT_BUFFER,
+					     PIPE_USAGE_DEFAULT, sizeof(constants));
+		pipe_buffer_write(p->pipe, p->cbuf, 0, sizeof(constants), constants);
+	}
+
+	/* render target texture */
+	{
+		struct pipe_resource tmplt;
+		memset(&tmplt, 0, sizeof(tmplt));
+		tmplt.target = PIPE_TEXTURE_2D;
+		tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM; /* All drivers support this */
+		tmplt.width0 = WIDTH;
+		tmplt.height0 = HEIGHT;
+		tmplt.depth0 = 1;
+		tmplt.array_size = 1;
+		tmplt.last_level = 0;
+		tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+		p->target = p->screen->resource_create(p->screen, &tmplt);
+	}
+
+	/* disabled blending/masking */
+	memset(&p->blend, 0, sizeof(p->blend));
+	p->blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+	/* no-op depth/stencil/alpha */
+	memset(&p->depthstencil, 0, sizeof(p->depthstencil));
+
+	/* rasterizer */
+	memset(&p->rasterizer, 0, sizeof(p->rasterizer));
+	p->rasterizer.cull_face = PIPE_FACE_NONE;
+	p->rasterizer.half_pixel_center = 1;
+	p->rasterizer.bottom_edge_rule = 1;
+	p->rasterizer.depth_clip = 1;
+
+	surf_tmpl.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	surf_tmpl.u.tex.level = 0;
+	surf_tmpl.u.tex.first_layer = 0;
+	surf_tmpl.u.tex.last_layer = 0;
+	/* drawing destination */
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = WIDTH;
+	p->framebuffer.height = HEIGHT;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	/* viewport */
+	p->viewport.scale[0] = (float)WIDTH / 2.0f;
+	p->viewport.scale[1] = (float)HEIGHT / 2.0f;
+	p->viewport.scale[2] = 0.5f;
+	p->viewport.translate[0] = (float)WIDTH / 2.0f;
+	p->viewport.translate[1] = (float)HEIGHT / 2.0f;
+	p->viewport.translate[2] = 0.5f;
+
+	/* vertex elements state */
+	memset(p->velem, 0, sizeof(p->velem));
+	p->velem[0].src_offset = 0 * 3 * sizeof(float); /* position */
+	p->velem[0].vertex_buffer_index = 0;
+	p->velem[0].src_format = PIPE_FORMAT_R32G32B32_FLOAT;
+
+	p->velem[1].src_offset = 1 * 3 * sizeof(float); /* normal */
+	p->velem[1].vertex_buffer_index = 0;
+	p->velem[1].src_format = PIPE_FORMAT_R32G32B32_FLOAT;
+
+	memset(&p->vbuffer, 0, sizeof(p->vbuffer));
+	p->vbuffer.stride = 2 * 3 * sizeof(float);
+	p->vbuffer.buffer.resource = p->vbuf;
+
+	/* vertex shader */
+	{
+		static const char text[] =
+			"VERT\n"
+			"DCL IN[0]\n"
+			"DCL IN[1]\n"
+			"DCL OUT[0], POSITION\n"
+			"DCL OUT[1], COLOR\n"
+			"DCL CONST[0..6]\n"
+			"DCL TEMP[0]\n"
+			"IMM[0] FLT32 { 0.0, 0.1, 1.0, 0.3 }\n"
+			"DP4 OUT[0].x, IN[0], CONST[0]\n"
+			"DP4 OUT[0].y, IN[0], CONST[1]\n"
+			"DP4 OUT[0].z, IN[0], CONST[2]\n"
+			"DP4 OUT[0].w, IN[0], CONST[3]\n"
+			"DP3 TEMP[0].x, IN[1], CONST[4]\n"
+			"DP3 TEMP[0].y, IN[1], CONST[5]\n"
+			"DP3 TEMP[0].z, IN[1], CONST[6]\n"
+			"MAX TEMP[0].xyz, TEMP[0], IMM[0].xxxx\n"
+			"MUL TEMP[0].xyz, TEMP[0], IMM[0].wwww\n"
+			"ADD TEMP[0].x, TEMP[0].xxxx, TEMP[0].yyyy\n"
+			"ADD TEMP[0].x, TEMP[0].xxxx, TEMP[0].zzzz\n"
+			"ADD OUT[1].xyz, TEMP[0].xxxx, IMM[0].yyyy\n"
+			"MOV OUT[1].w, IMM[0].zzzz\n"
+			"END\n";
+		struct tgsi_token tokens[1000];
+		struct pipe_shader_state state;
+
+		ret = tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens));
+		assert(ret);
+		pipe_shader_state_from_tgsi(&state, tokens);
+		p->vs = p->pipe->create_vs_state(p->pipe, &state);
+	}
+
+	/* fragment shader */
+	p->fs = util_make_fragment_passthrough_shader(p->pipe,
+                    TGSI_SEMANTIC_COLOR, TGSI_INTERPOLATE_PERSPECTIVE, TRUE);
+}
+
+static void close_prog(struct program *p)
+{
+	cso_destroy_context(p->cso);
+
+	p->pipe->delete_vs_state(p->pipe, p->vs);
+	p->pipe->delete_fs_state(p->pipe, p->fs);
+
+	pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+	pipe_resource_reference(&p->target, NULL);
+	pipe_resource_reference(&p->cbuf, NULL);
+	pipe_resource_reference(&p->ibuf, NULL);
+	pipe_resource_reference(&p->vbuf, NULL);
+
+	p->pipe->destroy(p->pipe);
+	p->screen->destroy(p->screen);
+	pipe_loader_release(&p->dev, 1);
+
+	FREE(p);
+}
+
+static void draw(struct program *p)
+{
+	struct pipe_draw_info info;
+
+	/* clear the render target */
+	p->pipe->clear(p->pipe, PIPE_CLEAR_COLOR, &p->clear_color, 0, 0);
+
+	util_draw_init_info(&info);
+	info.index_size = 4;
+	info.mode = PIPE_PRIM_TRIANGLES;
+	info.count = p->num_indices;
+	info.max_index = p->grid_size * p->grid_size - 1;
+	info.index.resource = p->ibuf;
+
+	p->pipe->draw_vbo(p->pipe, &info);
+}
+
+static void finish(struct program *p)
+{
+	struct pipe_fence_handle *fence = NULL;
+
+	p->pipe->flush(p->pipe, &fence, 0);
+	p->screen->fence_finish(p->screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+	p->screen->fence_reference(p->screen, &fence, NULL);
+}
+
+int main(int argc, char** argv)
+{
+	struct program *p = CALLOC_STRUCT(program);
+	unsigned frames = argc > 2 ? atoi(argv[2]) : 20;
+	unsigned num_vertices;
+	int64_t start, end;
+	unsigned i;
+
+	p->grid_size = argc > 1 ? atoi(argv[1]) : 512;
+	if (p->grid_size < 2 || frames == 0)
+		return EXIT_FAILURE;
+	num_vertices = p->grid_size * p->grid_size;
+
+	init_prog(p);
+
+	/* set the state once, every frame is the same draw */
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+	cso_set_blend(p->cso, &p->blend);
+	cso_set_depth_stencil_alpha(p->cso, &p->depthstencil);
+	cso_set_rasterizer(p->cso, &p->rasterizer);
+	cso_set_viewport(p->cso, &p->viewport);
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+	cso_set_vertex_elements(p->cso, 2, p->velem);
+	cso_set_vertex_buffers(p->cso, 0, 1, &p->vbuffer);
+	cso_set_constant_buffer_resource(p->cso, PIPE_SHADER_VERTEX, 0, p->cbuf);
+
+	/* compile the shaders outside of the measurement */
+	draw(p);
+	finish(p);
+
+	start = os_time_get_nano();
+	for (i = 0; i < frames; i++)
+		draw(p);
+	finish(p);
+	end = os_time_get_nano();
+
+	printf("%u vertices, %u triangles, %u frames: %.2f ms, "
+	       "%.2f Mvertices/s\n", num_vertices, p->num_indices / 3, frames,
+	       (end - start) / 1000000.0,
+	       (double)num_vertices * frames * 1000.0 / (end - start));
+
+	close_prog(p);
+
+	return 0;
+}
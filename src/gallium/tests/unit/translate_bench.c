@@ -0,0 +1,191 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Vertex translation throughput of the translate implementations, for the
+ * kind of vertex layouts draw module fetches.  Implementations which don't
+ * handle a layout are reported as n/a.
+ */
+
+#include <stdio.h>
+#include "translate/translate.h"
+#include "util/u_memory.h"
+#include "util/u_format.h"
+#include "util/u_cpu_detect.h"
+#include "util/os_time.h"
+
+
+#define NUM_VERTS 4096
+#define NUM_ITERATIONS 500
+
+
+struct bench_layout {
+   const char *name;
+   unsigned nr_elements;
+   enum pipe_format input[3];
+   enum pipe_format output[3];
+};
+
+
+static const struct bench_layout layouts[] = {
+   { "position",
+     1,
+     { PIPE_FORMAT_R32G32B32_FLOAT },
+     { PIPE_FORMAT_R32G32B32A32_FLOAT } },
+   { "position+normal+texcoord",
+     3,
+     { PIPE_FORMAT_R32G32B32_FLOAT, PIPE_FORMAT_R32G32B32_FLOAT,
+       PIPE_FORMAT_R32G32_FLOAT },
+     { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT,
+       PIPE_FORMAT_R32G32B32A32_FLOAT } },
+   { "half position+unorm8 color",
+     2,
+     { PIPE_FORMAT_R16G16B16A16_FLOAT, PIPE_FORMAT_R8G8B8A8_UNORM },
+     { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT } },
+   { "packed normal+snorm16 texcoord",
+     2,
+     { PIPE_FORMAT_R10G10B10A2_SNORM, PIPE_FORMAT_R16G16_SNORM },
+     { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R32G32_FLOAT } },
+   { "float color to unorm8",
+     1,
+     { PIPE_FORMAT_R32G32B32A32_FLOAT },
+     { PIPE_FORMAT_B8G8R8A8_UNORM } },
+   /* Straight copies, as emitted by draw for vbuf drivers. */
+   { "copy float4",
+     1,
+     { PIPE_FORMAT_R32G32B32A32_FLOAT },
+     { PIPE_FORMAT_R32G32B32A32_FLOAT } },
+   { "copy float4+float4+float2",
+     3,
+     { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT,
+       PIPE_FORMAT_R32G32_FLOAT },
+     { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT,
+       PIPE_FORMAT_R32G32_FLOAT } },
+   { "copy unorm8 color",
+     1,
+     { PIPE_FORMAT_B8G8R8A8_UNORM },
+     { PIPE_FORMAT_B8G8R8A8_UNORM } },
+};
+
+
+static double
+bench(struct translate *(*create_fn)(const struct translate_key *key),
+      const struct bench_layout *layout,
+      const uint8_t *input, unsigned input_stride,
+      const unsigned *elts, void *output)
+{
+   struct translate_key key;
+   struct translate *translate;
+   unsigned offset = 0;
+   unsigned i;
+   int64_t start, end;
+
+   memset(&key, 0, sizeof key);
+   key.nr_elements = layout->nr_elements;
+   for (i = 0; i < layout->nr_elements; i++) {
+      key.element[i].type = TRANSLATE_ELEMENT_NORMAL;
+      key.element[i].input_format = layout->input[i];
+      key.element[i].output_format = layout->output[i];
+      key.element[i].input_buffer = 0;
+      key.element[i].input_offset = 16 * i;
+      key.element[i].output_offset = offset;
+      offset += util_format_get_blocksize(layout->output[i]);
+   }
+   key.output_stride = offset;
+
+   translate = create_fn(&key);
+   if (!translate)
+      return 0.0;
+
+   translate->set_buffer(translate, 0, input, input_stride, NUM_VERTS - 1);
+
+   start = os_time_get_nano();
+   for (i = 0; i < NUM_ITERATIONS; i++)
+      translate->run_elts(translate, elts, NUM_VERTS, 0, 0, output);
+   end = os_time_get_nano();
+
+   translate->release(translate);
+
+   return (double)NUM_VERTS * NUM_ITERATIONS * 1000.0 / (end - start);
+}
+
+
+static void
+print_rate(double rate)
+{
+   if (rate > 0.0)
+      printf(" %10.1f", rate);
+   else
+      printf(" %10s", "n/a");
+}
+
+
+int main(int argc, char** argv)
+{
+   const unsigned input_stride = 48;
+   uint8_t *input;
+   unsigned *elts;
+   void *output;
+   unsigned i;
+
+   util_cpu_detect();
+
+   input = align_malloc(NUM_VERTS * input_stride, 64);
+   elts = align_malloc(NUM_VERTS * sizeof *elts, 64);
+   output = align_malloc(NUM_VERTS * 3 * 16, 64);
+
+   srand(4359025);
+
+   /* Small positive values, so that floats and halves are ordinary numbers. */
+   for (i = 0; i < NUM_VERTS * input_stride; ++i)
+      input[i] = rand() & 0x3f;
+
+   /* Mostly sequential indices, as in a triangle strip. */
+   for (i = 0; i < NUM_VERTS; ++i)
+      elts[i] = (i / 3 + i % 3) % NUM_VERTS;
+
+   printf("%-32s %10s %10s %10s\n", "Mverts/s", "generic", "sse2", "avx2");
+
+   for (i = 0; i < ARRAY_SIZE(layouts); ++i) {
+      double generic = bench(translate_generic_create, &layouts[i],
+                             input, input_stride, elts, output);
+      double sse2 = bench(translate_sse2_create, &layouts[i],
+                          input, input_stride, elts, output);
+      double avx2 = bench(translate_avx2_create, &layouts[i],
+                          input, input_stride, elts, output);
+
+      printf("%-32s", layouts[i].name);
+      print_rate(generic);
+      print_rate(sse2);
+      print_rate(avx2);
+      printf("\n");
+   }
+
+   align_free(output);
+   align_free(elts);
+   align_free(input);
+
+   return 0;
+}
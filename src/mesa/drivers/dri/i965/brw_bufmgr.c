@@ -128,18 +128,6 @@ static int bo_set_tiling_internal(struct brw_bo *bo, uint32_t tiling_mode,
 
 static void bo_free(struct brw_bo *bo);
 
-static uint32_t
-key_hash_uint(const void *key)
-{
-   return _mesa_hash_data(key, 4);
-}
-
-static bool
-key_uint_equal(const void *a, const void *b)
-{
-   return *((unsigned *) a) == *((unsigned *) b);
-}
-
 static struct brw_bo *
 hash_find_bo(struct hash_table *ht, unsigned int key)
 {
@@ -1455,9 +1443,9 @@ brw_bufmgr_init(struct gen_device_info *devinfo, int fd)
    init_cache_buckets(bufmgr);
 
    bufmgr->name_table =
-      _mesa_hash_table_create(NULL, key_hash_uint, key_uint_equal);
+      _mesa_hash_table_create(NULL, _mesa_hash_u32, _mesa_key_u32_equal);
    bufmgr->handle_table =
-      _mesa_hash_table_create(NULL, key_hash_uint, key_uint_equal);
+      _mesa_hash_table_create(NULL, _mesa_hash_u32, _mesa_key_u32_equal);
 
    return bufmgr;
 }
@@ -304,6 +304,119 @@ fail:
    return false;
 }
 
+static bool
+linked_from_cache(struct gl_program *prog)
+{
+   return prog && prog->sh.data &&
+          prog->sh.data->LinkStatus == LINKING_SKIPPED;
+}
+
+/**
+ * Start loading the binaries of the render programs that have just been
+ * bound, if their shader program came from the cache and they aren't in the
+ * program cache yet.  brw_upload_programs() then finds them already read
+ * and uncompressed, instead of loading one stage after the other.
+ *
+ * The fragment key can still change with the VUE map of the stages before
+ * it, in which case its prefetch is just wasted.
+ */
+void
+brw_disk_cache_prefetch_render_programs(struct brw_context *brw)
+{
+   struct disk_cache *cache = brw->ctx.Cache;
+   cache_key keys[MESA_SHADER_FRAGMENT + 1];
+   unsigned num_keys = 0;
+
+   if (cache == NULL || (brw->ctx._Shader->Flags & GLSL_CACHE_FALLBACK))
+      return;
+
+   if (!brw_state_dirty(brw, 0,
+                        BRW_NEW_VERTEX_PROGRAM |
+                        BRW_NEW_TESS_PROGRAMS |
+                        BRW_NEW_GEOMETRY_PROGRAM |
+                        BRW_NEW_FRAGMENT_PROGRAM))
+      return;
+
+   struct gl_program *prog =
+      brw->ctx._Shader->CurrentProgram[MESA_SHADER_VERTEX];
+   if (linked_from_cache(prog)) {
+      struct brw_vs_prog_key vs_key;
+      brw_vs_populate_key(brw, &vs_key);
+
+      if (!brw_search_cache(&brw->cache, BRW_CACHE_VS_PROG,
+                            &vs_key, sizeof(vs_key),
+                            &brw->vs.base.prog_offset,
+                            &brw->vs.base.prog_data)) {
+         vs_key.program_string_id = 0;
+         gen_shader_sha1(brw, prog, MESA_SHADER_VERTEX, &vs_key,
+                         keys[num_keys++]);
+      }
+   }
+
+   prog = brw->ctx._Shader->CurrentProgram[MESA_SHADER_TESS_CTRL];
+   if (linked_from_cache(prog)) {
+      struct brw_tcs_prog_key tcs_key;
+      brw_tcs_populate_key(brw, &tcs_key);
+
+      if (!brw_search_cache(&brw->cache, BRW_CACHE_TCS_PROG,
+                            &tcs_key, sizeof(tcs_key),
+                            &brw->tcs.base.prog_offset,
+                            &brw->tcs.base.prog_data)) {
+         tcs_key.program_string_id = 0;
+         gen_shader_sha1(brw, prog, MESA_SHADER_TESS_CTRL, &tcs_key,
+                         keys[num_keys++]);
+      }
+   }
+
+   prog = brw->ctx._Shader->CurrentProgram[MESA_SHADER_TESS_EVAL];
+   if (linked_from_cache(prog)) {
+      struct brw_tes_prog_key tes_key;
+      brw_tes_populate_key(brw, &tes_key);
+
+      if (!brw_search_cache(&brw->cache, BRW_CACHE_TES_PROG,
+                            &tes_key, sizeof(tes_key),
+                            &brw->tes.base.prog_offset,
+                            &brw->tes.base.prog_data)) {
+         tes_key.program_string_id = 0;
+         gen_shader_sha1(brw, prog, MESA_SHADER_TESS_EVAL, &tes_key,
+                         keys[num_keys++]);
+      }
+   }
+
+   prog = brw->ctx._Shader->CurrentProgram[MESA_SHADER_GEOMETRY];
+   if (linked_from_cache(prog)) {
+      struct brw_gs_prog_key gs_key;
+      brw_gs_populate_key(brw, &gs_key);
+
+      if (!brw_search_cache(&brw->cache, BRW_CACHE_GS_PROG,
+                            &gs_key, sizeof(gs_key),
+                            &brw->gs.base.prog_offset,
+                            &brw->gs.base.prog_data)) {
+         gs_key.program_string_id = 0;
+         gen_shader_sha1(brw, prog, MESA_SHADER_GEOMETRY, &gs_key,
+                         keys[num_keys++]);
+      }
+   }
+
+   prog = brw->ctx._Shader->CurrentProgram[MESA_SHADER_FRAGMENT];
+   if (linked_from_cache(prog)) {
+      struct brw_wm_prog_key wm_key;
+      brw_wm_populate_key(brw, &wm_key);
+
+      if (!brw_search_cache(&brw->cache, BRW_CACHE_FS_PROG,
+                            &wm_key, sizeof(wm_key),
+                            &brw->wm.base.prog_offset,
+                            &brw->wm.base.prog_data)) {
+         wm_key.program_string_id = 0;
+         gen_shader_sha1(brw, prog, MESA_SHADER_FRAGMENT, &wm_key,
+                         keys[num_keys++]);
+      }
+   }
+
+   if (num_keys > 0)
+      disk_cache_prefetch(cache, keys, num_keys);
+}
+
 static void
 write_program_data(struct brw_context *brw, struct gl_program *prog,
                    void *key, struct brw_stage_prog_data *prog_data,
@@ -277,6 +277,9 @@ st_destroy_context_priv(struct st_context *st, bool destroy_pipe)
 
    cso_destroy_context(st->cso_context);
 
+   if (util_queue_is_initialized(&st->link_queue))
+      util_queue_destroy(&st->link_queue);
+
    if (st->pipe && destroy_pipe)
       st->pipe->destroy(st->pipe);
 
@@ -34,6 +34,7 @@
 #include "state_tracker/st_atom.h"
 #include "util/u_inlines.h"
 #include "util/list.h"
+#include "util/u_queue.h"
 #include "vbo/vbo.h"
 
 
@@ -295,6 +296,11 @@ struct st_context
 
    /* Winsys buffers */
    struct list_head winsys_buffers;
+
+   /* Worker threads optimizing the NIR of the stages of a program in
+    * parallel at link time, created on the first link needing them.
+    */
+   struct util_queue link_queue;
 };
 
 
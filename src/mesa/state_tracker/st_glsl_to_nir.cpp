@@ -47,6 +47,9 @@
 #include "compiler/glsl/ir.h"
 #include "compiler/glsl/string_to_uint_map.h"
 
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
+
 
 static int
 type_size(const struct glsl_type *type)
@@ -383,6 +386,17 @@ st_glsl_to_nir(struct st_context *st, struct gl_program *prog,
       nir->info.next_stage = MESA_SHADER_FRAGMENT;
    }
 
+   return nir;
+}
+
+/* Rest of the first third.  It only touches the NIR of the stage, so it can
+ * run on st_context::link_queue.
+ */
+static void
+st_nir_preprocess(nir_shader *nir)
+{
+   const nir_shader_compiler_options *options = nir->options;
+
    nir_variable_mode mask =
       (nir_variable_mode) (nir_var_shader_in | nir_var_shader_out);
    nir_remove_dead_variables(nir, mask);
@@ -404,8 +418,6 @@ st_glsl_to_nir(struct st_context *st, struct gl_program *prog,
    NIR_PASS_V(nir, nir_lower_var_copies);
 
    st_nir_opts(nir);
-
-   return nir;
 }
 
 /* Second third of converting glsl_to_nir. This creates uniforms, gathers
@@ -548,7 +560,10 @@ set_st_program(struct gl_program *prog,
    }
 }
 
-static void
+/* Returns whether the NIR was just created, and so still needs
+ * st_nir_preprocess().
+ */
+static bool
 st_nir_get_mesa_program(struct gl_context *ctx,
                         struct gl_shader_program *shader_program,
                         struct gl_linked_shader *shader)
@@ -578,23 +593,100 @@ st_nir_get_mesa_program(struct gl_context *ctx,
    prog->ExternalSamplersUsed = gl_external_samplers(prog);
    _mesa_update_shader_textures_used(shader_program, prog);
 
+   bool created = prog->nir == NULL;
    nir_shader *nir = st_glsl_to_nir(st, prog, shader_program, shader->Stage);
 
    set_st_program(prog, shader_program, nir);
    prog->nir = nir;
+
+   return created;
+}
+
+/**
+ * Stage of a program being linked.  The NIR work that doesn't involve the
+ * other stages runs as jobs on st_context::link_queue, one at a time per
+ * stage: fence has to be waited for before touching nir again.
+ */
+struct st_link_job {
+   nir_shader *nir;
+   struct util_queue_fence fence;
+   bool preprocess;
+   nir_variable_mode scalar_io_mask;
+   int64_t time; /* spent in jobs, in nanoseconds */
+};
+
+static void
+st_nir_early_job(void *data, int thread_index)
+{
+   struct st_link_job *job = (struct st_link_job *)data;
+   int64_t start = os_time_get_nano();
+
+   if (job->preprocess)
+      st_nir_preprocess(job->nir);
+
+   NIR_PASS_V(job->nir, nir_lower_io_to_scalar_early, job->scalar_io_mask);
+   st_nir_opts(job->nir);
+
+   job->time += os_time_get_nano() - start;
+}
+
+static void
+st_nir_opts_job(void *data, int thread_index)
+{
+   struct st_link_job *job = (struct st_link_job *)data;
+   int64_t start = os_time_get_nano();
+
+   st_nir_opts(job->nir);
+
+   job->time += os_time_get_nano() - start;
+}
+
+static void
+st_link_add_job(struct st_context *st, struct st_link_job *job,
+                util_queue_execute_func execute)
+{
+   if (util_queue_is_initialized(&st->link_queue)) {
+      util_queue_add_job(&st->link_queue, job, &job->fence, execute, NULL);
+   } else {
+      execute(job, 0);
+   }
 }
 
+/* A thread per stage of a graphics pipeline at most, the application
+ * thread keeps converting the next stages from GLSL IR meanwhile.
+ */
 static void
-st_nir_link_shaders(nir_shader **producer, nir_shader **consumer)
+st_init_link_queue(struct st_context *st)
 {
-   nir_lower_io_arrays_to_elements(*producer, *consumer);
+   if (util_queue_is_initialized(&st->link_queue))
+      return;
+
+   util_cpu_detect();
+   if (util_cpu_caps.nr_cpus <= 1)
+      return;
+
+   util_queue_init(&st->link_queue, "st_link", MESA_SHADER_STAGES,
+                   MIN2(util_cpu_caps.nr_cpus, MESA_SHADER_STAGES - 1), 0);
+}
+
+static void
+st_nir_link_shaders(struct st_context *st, struct st_link_job *producer_job,
+                    struct st_link_job *consumer_job)
+{
+   nir_shader *producer = producer_job->nir;
+   nir_shader *consumer = consumer_job->nir;
+
+   util_queue_fence_wait(&producer_job->fence);
+   util_queue_fence_wait(&consumer_job->fence);
 
-   NIR_PASS_V(*producer, nir_remove_dead_variables, nir_var_shader_out);
-   NIR_PASS_V(*consumer, nir_remove_dead_variables, nir_var_shader_in);
+   nir_lower_io_arrays_to_elements(producer, consumer);
 
-   if (nir_remove_unused_varyings(*producer, *consumer)) {
-      NIR_PASS_V(*producer, nir_lower_global_vars_to_local);
-      NIR_PASS_V(*consumer, nir_lower_global_vars_to_local);
+   NIR_PASS_V(producer, nir_remove_dead_variables, nir_var_shader_out);
+   NIR_PASS_V(consumer, nir_remove_dead_variables, nir_var_shader_in);
+
+   if (nir_remove_unused_varyings(producer, consumer)) {
+      NIR_PASS_V(producer, nir_lower_global_vars_to_local);
+      NIR_PASS_V(consumer, nir_lower_global_vars_to_local);
 
       /* The backend might not be able to handle indirects on
        * temporaries so we need to lower indirects on any of the
@@ -609,11 +701,14 @@ st_nir_link_shaders(nir_shader **producer, nir_shader **consumer)
        */
       nir_variable_mode indirect_mask = nir_var_local;
 
-      NIR_PASS_V(*producer, nir_lower_indirect_derefs, indirect_mask);
-      NIR_PASS_V(*consumer, nir_lower_indirect_derefs, indirect_mask);
+      NIR_PASS_V(producer, nir_lower_indirect_derefs, indirect_mask);
+      NIR_PASS_V(consumer, nir_lower_indirect_derefs, indirect_mask);
 
-      st_nir_opts(*producer);
-      st_nir_opts(*consumer);
+      /* The consumer is done, while the producer gets linked with the
+       * stage before it once optimized.
+       */
+      st_link_add_job(st, producer_job, st_nir_opts_job);
+      st_link_add_job(st, consumer_job, st_nir_opts_job);
    }
 }
 
@@ -624,6 +719,8 @@ st_link_nir(struct gl_context *ctx,
             struct gl_shader_program *shader_program)
 {
    struct st_context *st = st_context(ctx);
+   struct st_link_job jobs[MESA_SHADER_STAGES];
+   int64_t start = os_time_get_nano();
 
    /* Determine first and last stage. */
    unsigned first = MESA_SHADER_STAGES;
@@ -636,12 +733,16 @@ st_link_nir(struct gl_context *ctx,
       last = i;
    }
 
+   if (first != last)
+      st_init_link_queue(st);
+
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
       struct gl_linked_shader *shader = shader_program->_LinkedShaders[i];
       if (shader == NULL)
          continue;
 
-      st_nir_get_mesa_program(ctx, shader_program, shader);
+      jobs[i].preprocess = st_nir_get_mesa_program(ctx, shader_program,
+                                                   shader);
 
       nir_variable_mode mask = (nir_variable_mode) 0;
       if (i != first)
@@ -650,9 +751,11 @@ st_link_nir(struct gl_context *ctx,
       if (i != last)
          mask = (nir_variable_mode)(mask | nir_var_shader_out);
 
-      nir_shader *nir = shader->Program->nir;
-      NIR_PASS_V(nir, nir_lower_io_to_scalar_early, mask);
-      st_nir_opts(nir);
+      jobs[i].nir = shader->Program->nir;
+      jobs[i].scalar_io_mask = mask;
+      jobs[i].time = 0;
+      util_queue_fence_init(&jobs[i].fence);
+      st_link_add_job(st, &jobs[i], st_nir_early_job);
    }
 
    /* Linking the stages in the opposite order (from fragment to vertex)
@@ -666,11 +769,18 @@ st_link_nir(struct gl_context *ctx,
       if (shader == NULL)
          continue;
 
-      st_nir_link_shaders(&shader->Program->nir,
-                          &shader_program->_LinkedShaders[next]->Program->nir);
+      st_nir_link_shaders(st, &jobs[i], &jobs[next]);
       next = i;
    }
 
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (shader_program->_LinkedShaders[i] == NULL)
+         continue;
+
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+
    int prev = -1;
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
       struct gl_linked_shader *shader = shader_program->_LinkedShaders[i];
@@ -737,6 +847,19 @@ st_link_nir(struct gl_context *ctx,
       }
    }
 
+   if (ctx->_Shader->Flags & GLSL_LINK_TIME) {
+      _mesa_log("NIR linking of program %d: %.3f ms, stage jobs:",
+                shader_program->Name,
+                (os_time_get_nano() - start) / 1000000.0);
+      for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+         if (shader_program->_LinkedShaders[i]) {
+            _mesa_log(" %s %.3f ms", _mesa_shader_stage_to_abbrev(i),
+                      jobs[i].time / 1000000.0);
+         }
+      }
+      _mesa_log("\n");
+   }
+
    return true;
 }
 
@@ -38,9 +38,14 @@
 #include <errno.h>
 #include <dirent.h>
 #include "zlib.h"
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 #include "util/crc32.h"
 #include "util/debug.h"
+#include "util/hash_table.h"
+#include "util/list.h"
 #include "util/rand_xor.h"
 #include "util/u_atomic.h"
 #include "util/u_queue.h"
@@ -72,7 +77,96 @@
  * - There is no strict requirement that cache versions be backwards
  *   compatible but effort should be taken to limit disruption where possible.
  */
-#define CACHE_VERSION 1
+#define CACHE_VERSION 2
+
+/* How the contents of a cache entry are compressed, recorded in the entry
+ * so that caches written by builds with a different default stay usable.
+ */
+enum cache_codec {
+   CACHE_CODEC_ZLIB = 1,
+   CACHE_CODEC_ZSTD = 2,
+};
+
+/* zstd decompresses several times faster than zlib, at a similar ratio, and
+ * decompression is what we pay for on every cache hit.
+ */
+#ifdef HAVE_ZSTD
+#define CACHE_CODEC_DEFAULT CACHE_CODEC_ZSTD
+#define CACHE_ZSTD_LEVEL 3
+#else
+#define CACHE_CODEC_DEFAULT CACHE_CODEC_ZLIB
+#endif
+
+/* The pack file backend stores every cache item, (in exactly the format of
+ * a cache file of the multi-file backend), as a record appended to
+ * "pack.<generation>". Records are located through "pack_index", an
+ * open-addressed hash table of pack_index_entry that is mmapped shared by
+ * all processes using the cache.
+ *
+ * All accesses to the index and pack file happen with an exclusive flock
+ * held on the index. Records carry their key and the cache item its CRC, so
+ * an index entry that doesn't match what's in the pack file, (after a crash
+ * in the middle of an update), reads as a cache miss and is dropped.
+ */
+#define PACK_INDEX_MAGIC   0x5844494d /* "MIDX" */
+#define PACK_RECORD_MAGIC  0x4345524d /* "MREC" */
+#define PACK_VERSION 1
+
+/* Number of slots in the index, and the number of entries we allow before
+ * evicting, (to keep the probe sequences short).
+ */
+#define PACK_INDEX_SLOTS (1 << 16)
+#define PACK_INDEX_MAX_ENTRIES (PACK_INDEX_SLOTS / 2)
+
+/* The pack file is rewritten without its dead records once they make up
+ * more than half of it, (and it is larger than this).
+ */
+#define PACK_COMPACT_MIN_SIZE (4 * 1024 * 1024)
+
+/* pack_index_entry::size of a slot whose entry was removed */
+#define PACK_SLOT_DELETED UINT32_MAX
+
+struct pack_index_header {
+   uint32_t magic;
+   uint32_t version;
+
+   /* Pack file currently in use, bumped by compaction */
+   uint32_t generation;
+
+   uint32_t num_slots;
+   uint32_t num_entries;
+   uint32_t num_deleted;
+
+   /* Bytes of the pack file holding complete records. Anything past this
+    * was left by an interrupted write and gets overwritten.
+    */
+   uint64_t pack_size;
+
+   /* Bytes of the pack file still referenced by the index */
+   uint64_t live_size;
+
+   /* Incremented on every access, for LRU eviction */
+   uint64_t lru_clock;
+};
+
+struct pack_index_entry {
+   cache_key key;
+
+   /* Size of the record, 0 for a free slot or PACK_SLOT_DELETED */
+   uint32_t size;
+
+   uint64_t offset;
+   uint64_t last_used;
+};
+
+struct pack_record_header {
+   uint32_t magic;
+
+   /* Size of the cache item following the header */
+   uint32_t size;
+
+   cache_key key;
+};
 
 struct disk_cache {
    /* The path to the cache directory. */
@@ -104,6 +198,25 @@ struct disk_cache {
 
    disk_cache_put_cb blob_put_cb;
    disk_cache_get_cb blob_get_cb;
+
+   /* Pack file backend, pack_index is NULL when it's not in use. */
+   struct pack_index_header *pack_index;
+   size_t pack_index_size;
+   int pack_index_fd;
+
+   /* The pack file we have open, and its generation */
+   int pack_fd;
+   uint32_t pack_generation;
+
+   /* The index flock is per process, this serializes our own threads */
+   mtx_t pack_mutex;
+
+   /* Entries being loaded by disk_cache_prefetch(), by key, and from the
+    * oldest to the most recent prefetch.
+    */
+   struct hash_table *prefetched;
+   struct list_head prefetched_list;
+   mtx_t prefetch_mutex;
 };
 
 struct disk_cache_put_job {
@@ -122,6 +235,28 @@ struct disk_cache_put_job {
    struct cache_item_metadata cache_item_metadata;
 };
 
+struct disk_cache_prefetch_job {
+   struct util_queue_fence fence;
+
+   struct list_head link;
+
+   struct disk_cache *cache;
+
+   cache_key key;
+
+   /* The uncompressed entry, (or NULL if it isn't in the cache), once the
+    * fence is signalled.
+    */
+   void *data;
+   size_t size;
+};
+
+/* Upper bound on the number of entries loaded ahead of disk_cache_get(), so
+ * that a bad guess can't pin an unbounded amount of memory.  Once it's
+ * reached, the oldest loaded entries make room for the new ones.
+ */
+#define CACHE_MAX_PREFETCHED 256
+
 /* Create a directory named 'path' if it does not already exist.
  *
  * Returns: 0 if path already exists as a directory or if created.
@@ -182,6 +317,91 @@ concatenate_and_mkdir(void *ctx, const char *path, const char *name)
       return NULL;
 }
 
+/* Open, (or create), the index of the pack file backend and map it.
+ *
+ * Returns false if the index can't be set up, in which case the cache
+ * falls back to one file per entry.
+ */
+static bool
+pack_init(struct disk_cache *cache, void *ctx)
+{
+   struct pack_index_header header;
+   struct stat sb;
+   size_t size;
+   char *path;
+   void *index;
+   int fd;
+
+   path = ralloc_asprintf(ctx, "%s/pack_index", cache->path);
+   if (path == NULL)
+      return false;
+
+   fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   if (fd == -1)
+      return false;
+
+   if (flock(fd, LOCK_EX) == -1)
+      goto fail;
+
+   if (fstat(fd, &sb) == -1)
+      goto fail;
+
+   /* A new index, (or one we don't understand), starts out empty. Records
+    * already in the pack file are simply overwritten.
+    */
+   size = sizeof(header) + PACK_INDEX_SLOTS * sizeof(struct pack_index_entry);
+   if (sb.st_size != size ||
+       pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+       header.magic != PACK_INDEX_MAGIC ||
+       header.version != PACK_VERSION ||
+       header.num_slots != PACK_INDEX_SLOTS) {
+      memset(&header, 0, sizeof(header));
+      header.magic = PACK_INDEX_MAGIC;
+      header.version = PACK_VERSION;
+      header.num_slots = PACK_INDEX_SLOTS;
+
+      if (ftruncate(fd, 0) == -1 || ftruncate(fd, size) == -1)
+         goto fail;
+
+      if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header))
+         goto fail;
+   }
+
+   index = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (index == MAP_FAILED)
+      goto fail;
+
+   flock(fd, LOCK_UN);
+
+   cache->pack_index = index;
+   cache->pack_index_size = size;
+   cache->pack_index_fd = fd;
+   cache->pack_fd = -1;
+   mtx_init(&cache->pack_mutex, mtx_plain);
+
+   return true;
+
+ fail:
+   close(fd);
+   return false;
+}
+
+static uint32_t
+cache_key_hash(const void *key)
+{
+   uint32_t hash;
+
+   /* Keys are SHA-1 hashes already. */
+   memcpy(&hash, key, sizeof(hash));
+   return hash;
+}
+
+static bool
+cache_key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, CACHE_KEY_SIZE) == 0;
+}
+
 #define DRV_KEY_CPY(_dst, _src, _src_size) \
 do {                                       \
    memcpy(_dst, _src, _src_size);          \
@@ -189,8 +409,8 @@ do {                                       \
 } while (0);
 
 struct disk_cache *
-disk_cache_create(const char *gpu_name, const char *timestamp,
-                  uint64_t driver_flags)
+disk_cache_type_create(const char *gpu_name, const char *timestamp,
+                       uint64_t driver_flags, enum disk_cache_type type)
 {
    void *local;
    struct disk_cache *cache = NULL;
@@ -335,6 +555,14 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
    cache->size = (uint64_t *) cache->index_mmap;
    cache->stored_keys = cache->index_mmap + sizeof(uint64_t);
 
+   if (type == DISK_CACHE_DEFAULT) {
+      type = env_var_as_boolean("MESA_GLSL_CACHE_PACK", false) ?
+             DISK_CACHE_PACK_FILE : DISK_CACHE_MULTI_FILE;
+   }
+
+   if (type == DISK_CACHE_PACK_FILE)
+      pack_init(cache, local);
+
    max_size = 0;
 
    max_size_str = getenv("MESA_GLSL_CACHE_MAX_SIZE");
@@ -380,6 +608,11 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
                    UTIL_QUEUE_INIT_RESIZE_IF_FULL |
                    UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY);
 
+   cache->prefetched = _mesa_hash_table_create(cache, cache_key_hash,
+                                               cache_key_equal);
+   list_inithead(&cache->prefetched_list);
+   mtx_init(&cache->prefetch_mutex, mtx_plain);
+
    cache->path_init_failed = false;
 
  path_fail:
@@ -431,17 +664,52 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
    return NULL;
 }
 
+struct disk_cache *
+disk_cache_create(const char *gpu_name, const char *timestamp,
+                  uint64_t driver_flags)
+{
+   return disk_cache_type_create(gpu_name, timestamp, driver_flags,
+                                 DISK_CACHE_DEFAULT);
+}
+
 void
 disk_cache_destroy(struct disk_cache *cache)
 {
+   struct hash_entry *entry;
+
    if (cache && !cache->path_init_failed) {
       util_queue_destroy(&cache->cache_queue);
       munmap(cache->index_mmap, cache->index_mmap_size);
+
+      /* Prefetches nobody asked for, (jobs the queue didn't get to are
+       * dropped by util_queue_destroy()).
+       */
+      hash_table_foreach(cache->prefetched, entry) {
+         struct disk_cache_prefetch_job *pf_job = entry->data;
+         free(pf_job->data);
+         free(pf_job);
+      }
+      mtx_destroy(&cache->prefetch_mutex);
+
+      if (cache->pack_index) {
+         munmap(cache->pack_index, cache->pack_index_size);
+         close(cache->pack_index_fd);
+         if (cache->pack_fd != -1)
+            close(cache->pack_fd);
+         mtx_destroy(&cache->pack_mutex);
+      }
    }
 
    ralloc_free(cache);
 }
 
+void
+disk_cache_wait_for_idle(struct disk_cache *cache)
+{
+   if (!cache->path_init_failed)
+      util_queue_finish(&cache->cache_queue);
+}
+
 /* Return a filename within the cache's directory corresponding to 'key'. The
  * returned filename is ralloced with 'cache' as the parent context.
  *
@@ -666,28 +934,6 @@ evict_lru_item(struct disk_cache *cache)
       p_atomic_add(cache->size, - (uint64_t)size);
 }
 
-void
-disk_cache_remove(struct disk_cache *cache, const cache_key key)
-{
-   struct stat sb;
-
-   char *filename = get_cache_file(cache, key);
-   if (filename == NULL) {
-      return;
-   }
-
-   if (stat(filename, &sb) == -1) {
-      free(filename);
-      return;
-   }
-
-   unlink(filename);
-   free(filename);
-
-   if (sb.st_blocks)
-      p_atomic_add(cache->size, - (uint64_t)sb.st_blocks * 512);
-}
-
 static ssize_t
 read_all(int fd, void *buf, size_t count)
 {
@@ -718,73 +964,34 @@ write_all(int fd, const void *buf, size_t count)
    return done;
 }
 
-/* From the zlib docs:
- *    "If the memory is available, buffers sizes on the order of 128K or 256K
- *    bytes should be used."
- */
-#define BUFSIZE 256 * 1024
-
-/**
- * Compresses cache entry in memory and writes it to disk. Returns the size
- * of the data written to disk.
- */
-static size_t
-deflate_and_write_to_disk(const void *in_data, size_t in_data_size, int dest,
-                          const char *filename)
+static ssize_t
+pread_all(int fd, void *buf, size_t count, off_t offset)
 {
-   unsigned char out[BUFSIZE];
-
-   /* allocate deflate state */
-   z_stream strm;
-   strm.zalloc = Z_NULL;
-   strm.zfree = Z_NULL;
-   strm.opaque = Z_NULL;
-   strm.next_in = (uint8_t *) in_data;
-   strm.avail_in = in_data_size;
-
-   int ret = deflateInit(&strm, Z_BEST_COMPRESSION);
-   if (ret != Z_OK)
-       return 0;
-
-   /* compress until end of in_data */
-   size_t compressed_size = 0;
-   int flush;
-   do {
-      int remaining = in_data_size - BUFSIZE;
-      flush = remaining > 0 ? Z_NO_FLUSH : Z_FINISH;
-      in_data_size -= BUFSIZE;
-
-      /* Run deflate() on input until the output buffer is not full (which
-       * means there is no more data to deflate).
-       */
-      do {
-         strm.avail_out = BUFSIZE;
-         strm.next_out = out;
-
-         ret = deflate(&strm, flush);    /* no bad return value */
-         assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
-
-         size_t have = BUFSIZE - strm.avail_out;
-         compressed_size += have;
-
-         ssize_t written = write_all(dest, out, have);
-         if (written == -1) {
-            (void)deflateEnd(&strm);
-            return 0;
-         }
-      } while (strm.avail_out == 0);
-
-      /* all input should be used */
-      assert(strm.avail_in == 0);
+   char *in = buf;
+   ssize_t read_ret;
+   size_t done;
 
-   } while (flush != Z_FINISH);
+   for (done = 0; done < count; done += read_ret) {
+      read_ret = pread(fd, in + done, count - done, offset + done);
+      if (read_ret == -1 || read_ret == 0)
+         return -1;
+   }
+   return done;
+}
 
-   /* stream should be complete */
-   assert(ret == Z_STREAM_END);
+static ssize_t
+pwrite_all(int fd, const void *buf, size_t count, off_t offset)
+{
+   const char *out = buf;
+   ssize_t written;
+   size_t done;
 
-   /* clean up and return */
-   (void)deflateEnd(&strm);
-   return compressed_size;
+   for (done = 0; done < count; done += written) {
+      written = pwrite(fd, out + done, count - done, offset + done);
+      if (written == -1)
+         return -1;
+   }
+   return done;
 }
 
 static struct disk_cache_put_job *
@@ -846,136 +1053,565 @@ destroy_put_job(void *job, int thread_index)
 struct cache_entry_file_data {
    uint32_t crc32;
    uint32_t uncompressed_size;
+   uint32_t codec;   /* enum cache_codec */
 };
 
-static void
-cache_put(void *job, int thread_index)
+static size_t
+compress_bound(enum cache_codec codec, size_t size)
 {
-   assert(job);
-
-   int fd = -1, fd_final = -1, err, ret;
-   unsigned i = 0;
-   char *filename = NULL, *filename_tmp = NULL;
-   struct disk_cache_put_job *dc_job = (struct disk_cache_put_job *) job;
-
-   filename = get_cache_file(dc_job->cache, dc_job->key);
-   if (filename == NULL)
-      goto done;
-
-   /* If the cache is too large, evict something else first. */
-   while (*dc_job->cache->size + dc_job->size > dc_job->cache->max_size &&
-          i < 8) {
-      evict_lru_item(dc_job->cache);
-      i++;
+   switch (codec) {
+#ifdef HAVE_ZSTD
+   case CACHE_CODEC_ZSTD:
+      return ZSTD_compressBound(size);
+#endif
+   default:
+      return compressBound(size);
    }
+}
 
-   /* Write to a temporary file to allow for an atomic rename to the
-    * final destination filename, (to prevent any readers from seeing
-    * a partially written file).
-    */
-   if (asprintf(&filename_tmp, "%s.tmp", filename) == -1)
-      goto done;
-
-   fd = open(filename_tmp, O_WRONLY | O_CLOEXEC | O_CREAT, 0644);
-
-   /* Make the two-character subdirectory within the cache as needed. */
-   if (fd == -1) {
-      if (errno != ENOENT)
-         goto done;
+/**
+ * Compresses cache entry into \out_data, (which must hold at least
+ * compress_bound() bytes). Returns the compressed size, or 0 on failure.
+ */
+static size_t
+compress_cache_data(enum cache_codec codec, const void *in_data,
+                    size_t in_data_size, uint8_t *out_data,
+                    size_t out_data_size)
+{
+   switch (codec) {
+#ifdef HAVE_ZSTD
+   case CACHE_CODEC_ZSTD: {
+      size_t ret = ZSTD_compress(out_data, out_data_size, in_data,
+                                 in_data_size, CACHE_ZSTD_LEVEL);
+      return ZSTD_isError(ret) ? 0 : ret;
+   }
+#endif
+   case CACHE_CODEC_ZLIB: {
+      uLongf compressed_size = out_data_size;
+      if (compress2(out_data, &compressed_size, in_data, in_data_size,
+                    Z_BEST_COMPRESSION) != Z_OK)
+         return 0;
+      return compressed_size;
+   }
+   default:
+      return 0;
+   }
+}
 
-      make_cache_file_directory(dc_job->cache, dc_job->key);
+/**
+ * Build the contents of a cache item, (what gets written to a cache file
+ * or pack record), from a put job. Returns a malloc'ed buffer.
+ */
+static uint8_t *
+create_cache_item(struct disk_cache_put_job *dc_job, size_t *item_size)
+{
+   struct disk_cache *cache = dc_job->cache;
+   struct cache_item_metadata *md = &dc_job->cache_item_metadata;
+   struct cache_entry_file_data cf_data;
+   size_t header_size, compressed_size;
+   uint8_t *item, *ptr;
 
-      fd = open(filename_tmp, O_WRONLY | O_CLOEXEC | O_CREAT, 0644);
-      if (fd == -1)
-         goto done;
-   }
+   header_size = cache->driver_keys_blob_size + sizeof(uint32_t) +
+                 sizeof(cf_data);
+   if (md->type == CACHE_ITEM_TYPE_GLSL)
+      header_size += sizeof(uint32_t) + md->num_keys * sizeof(cache_key);
 
-   /* With the temporary file open, we take an exclusive flock on
-    * it. If the flock fails, then another process still has the file
-    * open with the flock held. So just let that file be responsible
-    * for writing the file.
-    */
-   err = flock(fd, LOCK_EX | LOCK_NB);
-   if (err == -1)
-      goto done;
+   compressed_size = compress_bound(CACHE_CODEC_DEFAULT, dc_job->size);
 
-   /* Now that we have the lock on the open temporary file, we can
-    * check to see if the destination file already exists. If so,
-    * another process won the race between when we saw that the file
-    * didn't exist and now. In this case, we don't do anything more,
-    * (to ensure the size accounting of the cache doesn't get off).
-    */
-   fd_final = open(filename, O_RDONLY | O_CLOEXEC);
-   if (fd_final != -1) {
-      unlink(filename_tmp);
-      goto done;
-   }
+   item = malloc(header_size + compressed_size);
+   if (item == NULL)
+      return NULL;
 
-   /* OK, we're now on the hook to write out a file that we know is
-    * not in the cache, and is also not being written out to the cache
-    * by some other process.
-    */
+   ptr = item;
 
    /* Write the driver_keys_blob, this can be used find information about the
     * mesa version that produced the entry or deal with hash collisions,
     * should that ever become a real problem.
     */
-   ret = write_all(fd, dc_job->cache->driver_keys_blob,
-                   dc_job->cache->driver_keys_blob_size);
-   if (ret == -1) {
-      unlink(filename_tmp);
-      goto done;
-   }
+   DRV_KEY_CPY(ptr, cache->driver_keys_blob, cache->driver_keys_blob_size)
 
    /* Write the cache item metadata. This data can be used to deal with
     * hash collisions, as well as providing useful information to 3rd party
     * tools reading the cache files.
     */
-   ret = write_all(fd, &dc_job->cache_item_metadata.type,
-                   sizeof(uint32_t));
-   if (ret == -1) {
-      unlink(filename_tmp);
-      goto done;
+   DRV_KEY_CPY(ptr, &md->type, sizeof(uint32_t))
+   if (md->type == CACHE_ITEM_TYPE_GLSL) {
+      DRV_KEY_CPY(ptr, &md->num_keys, sizeof(uint32_t))
+      DRV_KEY_CPY(ptr, md->keys, md->num_keys * sizeof(cache_key))
+   }
+
+   /* Create CRC of the data. We will read this when restoring the cache and
+    * use it to check for corruption.
+    */
+   cf_data.crc32 = util_hash_crc32(dc_job->data, dc_job->size);
+   cf_data.uncompressed_size = dc_job->size;
+   cf_data.codec = CACHE_CODEC_DEFAULT;
+   DRV_KEY_CPY(ptr, &cf_data, sizeof(cf_data))
+
+   /* And finally the compressed contents. */
+   compressed_size = compress_cache_data(cf_data.codec, dc_job->data,
+                                         dc_job->size, ptr, compressed_size);
+   if (compressed_size == 0) {
+      free(item);
+      return NULL;
+   }
+
+   *item_size = header_size + compressed_size;
+   return item;
+}
+
+static inline struct pack_index_entry *
+pack_index_entries(struct disk_cache *cache)
+{
+   return (struct pack_index_entry *) (cache->pack_index + 1);
+}
+
+static inline bool
+pack_entry_is_live(const struct pack_index_entry *entry)
+{
+   return entry->size != 0 && entry->size != PACK_SLOT_DELETED;
+}
+
+/* Make sure the pack file of the current generation is the one we have
+ * open, (another process may have compacted the cache since we last
+ * looked).
+ */
+static bool
+pack_open_current(struct disk_cache *cache)
+{
+   uint32_t generation = cache->pack_index->generation;
+   char *filename;
+
+   if (cache->pack_fd != -1 && cache->pack_generation == generation)
+      return true;
+
+   if (cache->pack_fd != -1)
+      close(cache->pack_fd);
+
+   if (asprintf(&filename, "%s/pack.%u", cache->path, generation) == -1) {
+      cache->pack_fd = -1;
+      return false;
+   }
+
+   cache->pack_fd = open(filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   cache->pack_generation = generation;
+   free(filename);
+
+   return cache->pack_fd != -1;
+}
+
+static bool
+pack_lock(struct disk_cache *cache)
+{
+   mtx_lock(&cache->pack_mutex);
+
+   if (flock(cache->pack_index_fd, LOCK_EX) == -1) {
+      mtx_unlock(&cache->pack_mutex);
+      return false;
+   }
+
+   if (!pack_open_current(cache)) {
+      flock(cache->pack_index_fd, LOCK_UN);
+      mtx_unlock(&cache->pack_mutex);
+      return false;
+   }
+
+   return true;
+}
+
+static void
+pack_unlock(struct disk_cache *cache)
+{
+   flock(cache->pack_index_fd, LOCK_UN);
+   mtx_unlock(&cache->pack_mutex);
+}
+
+/* Find the entry for \key in the index. With \insert, return the slot to
+ * store \key in if it isn't there, (NULL only if the index is full).
+ */
+static struct pack_index_entry *
+pack_index_lookup(struct pack_index_entry *entries, const cache_key key,
+                  bool insert)
+{
+   struct pack_index_entry *deleted = NULL;
+   uint32_t hash;
+   unsigned n;
+
+   /* Keys are SHA-1 hashes, any of their bits will do. */
+   memcpy(&hash, key, sizeof(hash));
+
+   for (n = 0; n < PACK_INDEX_SLOTS; n++) {
+      struct pack_index_entry *entry =
+         &entries[(hash + n) & (PACK_INDEX_SLOTS - 1)];
+
+      if (entry->size == 0)
+         return insert ? (deleted ? deleted : entry) : NULL;
+
+      if (entry->size == PACK_SLOT_DELETED) {
+         if (!deleted)
+            deleted = entry;
+         continue;
+      }
+
+      if (memcmp(entry->key, key, CACHE_KEY_SIZE) == 0)
+         return entry;
+   }
+
+   return insert ? deleted : NULL;
+}
+
+static void
+pack_index_remove(struct disk_cache *cache, struct pack_index_entry *entry)
+{
+   struct pack_index_header *hdr = cache->pack_index;
+
+   hdr->live_size -= entry->size;
+   hdr->num_entries--;
+   hdr->num_deleted++;
+   entry->size = PACK_SLOT_DELETED;
+}
+
+static int
+compare_last_used(const void *a, const void *b)
+{
+   const struct pack_index_entry *ea = *(const struct pack_index_entry **) a;
+   const struct pack_index_entry *eb = *(const struct pack_index_entry **) b;
+
+   return ea->last_used < eb->last_used ? -1 : ea->last_used > eb->last_used;
+}
+
+/* Evict the least recently used entries until a record of \needed bytes
+ * fits in the cache.
+ */
+static void
+pack_evict(struct disk_cache *cache, uint64_t needed)
+{
+   struct pack_index_header *hdr = cache->pack_index;
+   struct pack_index_entry *entries = pack_index_entries(cache);
+   struct pack_index_entry **lru;
+   uint64_t target_size;
+   unsigned target_entries, num_live, i;
+
+   if (hdr->live_size + needed <= cache->max_size &&
+       hdr->num_entries < PACK_INDEX_MAX_ENTRIES)
+      return;
+
+   /* Make some headroom, so that a full cache doesn't end up sorting the
+    * whole index for every put.
+    */
+   target_size = cache->max_size - cache->max_size / 8;
+   target_entries = PACK_INDEX_MAX_ENTRIES - PACK_INDEX_MAX_ENTRIES / 8;
+
+   lru = malloc(hdr->num_entries * sizeof(*lru));
+   if (lru == NULL)
+      return;
+
+   num_live = 0;
+   for (i = 0; i < PACK_INDEX_SLOTS && num_live < hdr->num_entries; i++) {
+      if (pack_entry_is_live(&entries[i]))
+         lru[num_live++] = &entries[i];
+   }
+
+   qsort(lru, num_live, sizeof(*lru), compare_last_used);
+
+   for (i = 0; i < num_live; i++) {
+      if (hdr->live_size + needed <= target_size &&
+          hdr->num_entries < target_entries)
+         break;
+
+      pack_index_remove(cache, lru[i]);
+   }
+
+   free(lru);
+}
+
+static int
+compare_offset(const void *a, const void *b)
+{
+   const struct pack_index_entry *ea = a;
+   const struct pack_index_entry *eb = b;
+
+   return ea->offset < eb->offset ? -1 : ea->offset > eb->offset;
+}
+
+/* Rebuild the index without deleted slots, and if the pack file is mostly
+ * dead records, rewrite it into a new generation holding only the live
+ * ones.
+ *
+ * The new pack file is complete and on disk before the index refers to it,
+ * and the generation is only bumped once all entries point into it. Being
+ * interrupted in between leaves entries that don't match their records,
+ * which are handled like any other corrupt entry.
+ */
+static void
+pack_compact(struct disk_cache *cache)
+{
+   struct pack_index_header *hdr = cache->pack_index;
+   struct pack_index_entry *entries = pack_index_entries(cache);
+   struct pack_index_entry *live;
+   uint32_t generation = hdr->generation;
+   uint64_t offset = 0;
+   uint8_t *buf = NULL;
+   size_t buf_size = 0;
+   unsigned num_live, i;
+   char *filename = NULL;
+   int fd = -1;
+   bool repack;
+
+   repack = hdr->pack_size > PACK_COMPACT_MIN_SIZE &&
+            hdr->pack_size > 2 * hdr->live_size;
+
+   if (!repack && hdr->num_entries + hdr->num_deleted <
+                  PACK_INDEX_SLOTS - PACK_INDEX_SLOTS / 4)
+      return;
+
+   live = malloc(hdr->num_entries * sizeof(*live));
+   if (live == NULL)
+      return;
+
+   num_live = 0;
+   for (i = 0; i < PACK_INDEX_SLOTS && num_live < hdr->num_entries; i++) {
+      if (pack_entry_is_live(&entries[i]))
+         live[num_live++] = entries[i];
    }
 
-   if (dc_job->cache_item_metadata.type == CACHE_ITEM_TYPE_GLSL) {
-      ret = write_all(fd, &dc_job->cache_item_metadata.num_keys,
-                      sizeof(uint32_t));
-      if (ret == -1) {
-         unlink(filename_tmp);
+   if (repack) {
+      if (asprintf(&filename, "%s/pack.%u", cache->path,
+                   generation + 1) == -1)
+         goto done;
+
+      fd = open(filename, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if (fd == -1)
          goto done;
+
+      /* Copy in pack order, so we read the old pack file sequentially. */
+      qsort(live, num_live, sizeof(*live), compare_offset);
+
+      for (i = 0; i < num_live; i++) {
+         if (live[i].size > buf_size) {
+            uint8_t *tmp = realloc(buf, live[i].size);
+            if (tmp == NULL)
+               goto done;
+            buf = tmp;
+            buf_size = live[i].size;
+         }
+
+         if (pread_all(cache->pack_fd, buf, live[i].size,
+                       live[i].offset) == -1 ||
+             pwrite_all(fd, buf, live[i].size, offset) == -1)
+            goto done;
+
+         live[i].offset = offset;
+         offset += live[i].size;
       }
 
-      ret = write_all(fd, dc_job->cache_item_metadata.keys[0],
-                      dc_job->cache_item_metadata.num_keys *
-                      sizeof(cache_key));
-      if (ret == -1) {
-         unlink(filename_tmp);
+      if (fsync(fd) == -1)
          goto done;
+   }
+
+   memset(entries, 0, PACK_INDEX_SLOTS * sizeof(*entries));
+   for (i = 0; i < num_live; i++)
+      *pack_index_lookup(entries, live[i].key, true) = live[i];
+   hdr->num_deleted = 0;
+
+   if (repack) {
+      char *old_filename;
+
+      hdr->pack_size = offset;
+      hdr->generation = generation + 1;
+      msync(hdr, cache->pack_index_size, MS_SYNC);
+
+      if (asprintf(&old_filename, "%s/pack.%u", cache->path,
+                   generation) != -1) {
+         unlink(old_filename);
+         free(old_filename);
       }
+
+      close(cache->pack_fd);
+      cache->pack_fd = fd;
+      cache->pack_generation = generation + 1;
+      fd = -1;
    }
 
-   /* Create CRC of the data. We will read this when restoring the cache and
-    * use it to check for corruption.
+ done:
+   if (fd != -1) {
+      unlink(filename);
+      close(fd);
+   }
+   free(filename);
+   free(buf);
+   free(live);
+}
+
+static void
+cache_put_pack(struct disk_cache_put_job *dc_job, const uint8_t *item,
+               size_t item_size)
+{
+   struct disk_cache *cache = dc_job->cache;
+   struct pack_index_header *hdr = cache->pack_index;
+   struct pack_index_entry *entry;
+   struct pack_record_header record;
+   uint64_t record_size = sizeof(record) + item_size;
+   uint64_t offset;
+
+   if (record_size >= PACK_SLOT_DELETED)
+      return;
+
+   record.magic = PACK_RECORD_MAGIC;
+   record.size = item_size;
+   memcpy(record.key, dc_job->key, CACHE_KEY_SIZE);
+
+   if (!pack_lock(cache))
+      return;
+
+   /* Another thread or process may have beaten us to it. */
+   if (pack_index_lookup(pack_index_entries(cache), dc_job->key, false))
+      goto done;
+
+   pack_evict(cache, record_size);
+   pack_compact(cache);
+
+   /* Append the record, and only then make the index point at it. */
+   offset = hdr->pack_size;
+   if (pwrite_all(cache->pack_fd, &record, sizeof(record), offset) == -1 ||
+       pwrite_all(cache->pack_fd, item, item_size,
+                  offset + sizeof(record)) == -1)
+      goto done;
+
+   entry = pack_index_lookup(pack_index_entries(cache), dc_job->key, true);
+   if (entry == NULL)
+      goto done;
+
+   if (entry->size == PACK_SLOT_DELETED)
+      hdr->num_deleted--;
+
+   memcpy(entry->key, dc_job->key, CACHE_KEY_SIZE);
+   entry->offset = offset;
+   entry->last_used = ++hdr->lru_clock;
+   entry->size = record_size;
+
+   hdr->pack_size = offset + record_size;
+   hdr->live_size += record_size;
+   hdr->num_entries++;
+
+ done:
+   pack_unlock(cache);
+}
+
+/* Read the record for \key from the pack file. Returns a malloc'ed buffer
+ * holding the record header followed by the cache item.
+ */
+static uint8_t *
+pack_read_record(struct disk_cache *cache, const cache_key key,
+                 size_t *item_size)
+{
+   struct pack_index_entry *entry;
+   struct pack_record_header *record;
+   uint8_t *buf = NULL;
+
+   if (!pack_lock(cache))
+      return NULL;
+
+   entry = pack_index_lookup(pack_index_entries(cache), key, false);
+   if (entry == NULL)
+      goto done;
+
+   buf = malloc(entry->size);
+   if (buf == NULL)
+      goto done;
+
+   record = (struct pack_record_header *) buf;
+   if (entry->size < sizeof(*record) ||
+       pread_all(cache->pack_fd, buf, entry->size, entry->offset) == -1 ||
+       record->magic != PACK_RECORD_MAGIC ||
+       record->size != entry->size - sizeof(*record) ||
+       memcmp(record->key, key, CACHE_KEY_SIZE) != 0) {
+      /* Left behind by a crash, forget about it. */
+      pack_index_remove(cache, entry);
+      free(buf);
+      buf = NULL;
+      goto done;
+   }
+
+   entry->last_used = ++cache->pack_index->lru_clock;
+   *item_size = record->size;
+
+ done:
+   pack_unlock(cache);
+   return buf;
+}
+
+static void
+cache_put_file(struct disk_cache_put_job *dc_job, const uint8_t *item,
+               size_t item_size)
+{
+   int fd = -1, fd_final = -1, err, ret;
+   unsigned i = 0;
+   char *filename = NULL, *filename_tmp = NULL;
+
+   filename = get_cache_file(dc_job->cache, dc_job->key);
+   if (filename == NULL)
+      goto done;
+
+   /* If the cache is too large, evict something else first. */
+   while (*dc_job->cache->size + dc_job->size > dc_job->cache->max_size &&
+          i < 8) {
+      evict_lru_item(dc_job->cache);
+      i++;
+   }
+
+   /* Write to a temporary file to allow for an atomic rename to the
+    * final destination filename, (to prevent any readers from seeing
+    * a partially written file).
     */
-   struct cache_entry_file_data cf_data;
-   cf_data.crc32 = util_hash_crc32(dc_job->data, dc_job->size);
-   cf_data.uncompressed_size = dc_job->size;
+   if (asprintf(&filename_tmp, "%s.tmp", filename) == -1)
+      goto done;
 
-   size_t cf_data_size = sizeof(cf_data);
-   ret = write_all(fd, &cf_data, cf_data_size);
-   if (ret == -1) {
+   fd = open(filename_tmp, O_WRONLY | O_CLOEXEC | O_CREAT, 0644);
+
+   /* Make the two-character subdirectory within the cache as needed. */
+   if (fd == -1) {
+      if (errno != ENOENT)
+         goto done;
+
+      make_cache_file_directory(dc_job->cache, dc_job->key);
+
+      fd = open(filename_tmp, O_WRONLY | O_CLOEXEC | O_CREAT, 0644);
+      if (fd == -1)
+         goto done;
+   }
+
+   /* With the temporary file open, we take an exclusive flock on
+    * it. If the flock fails, then another process still has the file
+    * open with the flock held. So just let that file be responsible
+    * for writing the file.
+    */
+   err = flock(fd, LOCK_EX | LOCK_NB);
+   if (err == -1)
+      goto done;
+
+   /* Now that we have the lock on the open temporary file, we can
+    * check to see if the destination file already exists. If so,
+    * another process won the race between when we saw that the file
+    * didn't exist and now. In this case, we don't do anything more,
+    * (to ensure the size accounting of the cache doesn't get off).
+    */
+   fd_final = open(filename, O_RDONLY | O_CLOEXEC);
+   if (fd_final != -1) {
       unlink(filename_tmp);
       goto done;
    }
 
-   /* Now, finally, write out the contents to the temporary file, then
-    * rename them atomically to the destination filename, and also
-    * perform an atomic increment of the total cache size.
+   /* OK, we're now on the hook to write out a file that we know is
+    * not in the cache, and is also not being written out to the cache
+    * by some other process.
+    *
+    * Write out the contents to the temporary file, then rename them
+    * atomically to the destination filename, and also perform an atomic
+    * increment of the total cache size.
     */
-   size_t file_size = deflate_and_write_to_disk(dc_job->data, dc_job->size,
-                                                fd, filename_tmp);
-   if (file_size == 0) {
+   ret = write_all(fd, item, item_size);
+   if (ret == -1) {
       unlink(filename_tmp);
       goto done;
    }
@@ -1006,6 +1642,27 @@ cache_put(void *job, int thread_index)
    free(filename);
 }
 
+static void
+cache_put(void *job, int thread_index)
+{
+   assert(job);
+
+   struct disk_cache_put_job *dc_job = (struct disk_cache_put_job *) job;
+   size_t item_size;
+   uint8_t *item;
+
+   item = create_cache_item(dc_job, &item_size);
+   if (item == NULL)
+      return;
+
+   if (dc_job->cache->pack_index)
+      cache_put_pack(dc_job, item, item_size);
+   else
+      cache_put_file(dc_job, item, item_size);
+
+   free(item);
+}
+
 void
 disk_cache_put(struct disk_cache *cache, const cache_key key,
                const void *data, size_t size,
@@ -1029,6 +1686,79 @@ disk_cache_put(struct disk_cache *cache, const cache_key key,
    }
 }
 
+/* Take the prefetch of \key, if there is one, out of the table. It may
+ * still be queued or running.
+ */
+static struct disk_cache_prefetch_job *
+take_prefetched(struct disk_cache *cache, const cache_key key)
+{
+   struct disk_cache_prefetch_job *pf_job = NULL;
+   struct hash_entry *entry;
+
+   mtx_lock(&cache->prefetch_mutex);
+
+   entry = _mesa_hash_table_search(cache->prefetched, key);
+   if (entry) {
+      pf_job = entry->data;
+      _mesa_hash_table_remove(cache->prefetched, entry);
+      list_del(&pf_job->link);
+   }
+
+   mtx_unlock(&cache->prefetch_mutex);
+
+   return pf_job;
+}
+
+void
+disk_cache_remove(struct disk_cache *cache, const cache_key key)
+{
+   struct disk_cache_prefetch_job *pf_job;
+   struct stat sb;
+
+   if (cache->path_init_failed)
+      return;
+
+   /* Don't hand out a prefetched copy of what's being removed, and don't
+    * load it if that hasn't started yet.
+    */
+   pf_job = take_prefetched(cache, key);
+   if (pf_job) {
+      util_queue_drop_job(&cache->cache_queue, &pf_job->fence);
+      free(pf_job->data);
+      free(pf_job);
+   }
+
+   if (cache->pack_index) {
+      struct pack_index_entry *entry;
+
+      if (!pack_lock(cache))
+         return;
+
+      entry = pack_index_lookup(pack_index_entries(cache), key, false);
+      if (entry)
+         pack_index_remove(cache, entry);
+
+      pack_unlock(cache);
+      return;
+   }
+
+   char *filename = get_cache_file(cache, key);
+   if (filename == NULL) {
+      return;
+   }
+
+   if (stat(filename, &sb) == -1) {
+      free(filename);
+      return;
+   }
+
+   unlink(filename);
+   free(filename);
+
+   if (sb.st_blocks)
+      p_atomic_add(cache->size, - (uint64_t)sb.st_blocks * 512);
+}
+
 /**
  * Decompresses cache entry, returns true if successful.
  */
@@ -1068,39 +1798,132 @@ inflate_cache_data(uint8_t *in_data, size_t in_data_size,
    return true;
 }
 
-void *
-disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+/**
+ * Decompresses cache entry written with \codec, returns true if successful.
+ * Entries using a codec this build doesn't support are treated as misses.
+ */
+static bool
+decompress_cache_data(enum cache_codec codec,
+                      uint8_t *in_data, size_t in_data_size,
+                      uint8_t *out_data, size_t out_data_size)
+{
+   switch (codec) {
+#ifdef HAVE_ZSTD
+   case CACHE_CODEC_ZSTD: {
+      size_t ret = ZSTD_decompress(out_data, out_data_size,
+                                   in_data, in_data_size);
+      return !ZSTD_isError(ret) && ret == out_data_size;
+   }
+#endif
+   case CACHE_CODEC_ZLIB:
+      return inflate_cache_data(in_data, in_data_size,
+                                out_data, out_data_size);
+   default:
+      return false;
+   }
+}
+
+/**
+ * Validate a cache item, (see create_cache_item()), and return its
+ * uncompressed contents as a malloc'ed buffer.
+ */
+static uint8_t *
+parse_cache_item(struct disk_cache *cache, uint8_t *item, size_t item_size,
+                 size_t *size)
+{
+   size_t ck_size = cache->driver_keys_blob_size;
+   struct cache_entry_file_data cf_data;
+   uint8_t *uncompressed_data;
+   uint8_t *ptr = item, *end = item + item_size;
+   uint32_t md_type;
+
+   if (item_size < ck_size + sizeof(md_type))
+      return NULL;
+
+   /* Check for extremely unlikely hash collisions */
+   if (memcmp(cache->driver_keys_blob, ptr, ck_size) != 0) {
+      assert(!"Mesa cache keys mismatch!");
+      return NULL;
+   }
+   ptr += ck_size;
+
+   memcpy(&md_type, ptr, sizeof(md_type));
+   ptr += sizeof(md_type);
+
+   if (md_type == CACHE_ITEM_TYPE_GLSL) {
+      uint32_t num_keys;
+
+      if (end - ptr < sizeof(num_keys))
+         return NULL;
+
+      memcpy(&num_keys, ptr, sizeof(num_keys));
+      ptr += sizeof(num_keys);
+
+      /* The cache item metadata is currently just used for distributing
+       * precompiled shaders, they are not used by Mesa so just skip them for
+       * now.
+       * TODO: pass the metadata back to the caller and do some basic
+       * validation.
+       */
+      if ((end - ptr) / sizeof(cache_key) < num_keys)
+         return NULL;
+
+      ptr += num_keys * sizeof(cache_key);
+   }
+
+   /* Load the CRC that was created when the file was written. */
+   if (end - ptr < sizeof(cf_data))
+      return NULL;
+
+   memcpy(&cf_data, ptr, sizeof(cf_data));
+   ptr += sizeof(cf_data);
+
+   /* Uncompress the cache data */
+   uncompressed_data = malloc(cf_data.uncompressed_size);
+   if (uncompressed_data == NULL)
+      return NULL;
+
+   if (!decompress_cache_data(cf_data.codec, ptr, end - ptr,
+                              uncompressed_data, cf_data.uncompressed_size))
+      goto fail;
+
+   /* Check the data for corruption */
+   if (cf_data.crc32 != util_hash_crc32(uncompressed_data,
+                                        cf_data.uncompressed_size))
+      goto fail;
+
+   if (size)
+      *size = cf_data.uncompressed_size;
+
+   return uncompressed_data;
+
+ fail:
+   free(uncompressed_data);
+   return NULL;
+}
+
+static void *
+load_cache_entry(struct disk_cache *cache, const cache_key key, size_t *size)
 {
    int fd = -1, ret;
    struct stat sb;
    char *filename = NULL;
    uint8_t *data = NULL;
    uint8_t *uncompressed_data = NULL;
-   uint8_t *file_header = NULL;
 
-   if (size)
-      *size = 0;
+   if (cache->pack_index) {
+      size_t item_size;
 
-   if (cache->blob_get_cb) {
-      /* This is what Android EGL defines as the maxValueSize in egl_cache_t
-       * class implementation.
-       */
-      const signed long max_blob_size = 64 * 1024;
-      void *blob = malloc(max_blob_size);
-      if (!blob)
+      data = pack_read_record(cache, key, &item_size);
+      if (data == NULL)
          return NULL;
 
-      signed long bytes =
-         cache->blob_get_cb(key, CACHE_KEY_SIZE, blob, max_blob_size);
-
-      if (!bytes) {
-         free(blob);
-         return NULL;
-      }
+      uncompressed_data =
+         parse_cache_item(cache, data + sizeof(struct pack_record_header),
+                          item_size, size);
+      free(data);
 
-      if (size)
-         *size = bytes;
-      return blob;
+      return uncompressed_data;
    }
 
    filename = get_cache_file(cache, key);
@@ -1118,97 +1941,147 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    if (data == NULL)
       goto fail;
 
-   size_t ck_size = cache->driver_keys_blob_size;
-   file_header = malloc(ck_size);
-   if (!file_header)
+   ret = read_all(fd, data, sb.st_size);
+   if (ret == -1)
       goto fail;
 
-   if (sb.st_size < ck_size)
-      goto fail;
+   uncompressed_data = parse_cache_item(cache, data, sb.st_size, size);
 
-   ret = read_all(fd, file_header, ck_size);
-   if (ret == -1)
-      goto fail;
+ fail:
+   free(data);
+   free(filename);
+   if (fd != -1)
+      close(fd);
 
-   /* Check for extremely unlikely hash collisions */
-   if (memcmp(cache->driver_keys_blob, file_header, ck_size) != 0) {
-      assert(!"Mesa cache keys mismatch!");
-      goto fail;
+   return uncompressed_data;
+}
+
+static void
+cache_prefetch(void *job, int thread_index)
+{
+   struct disk_cache_prefetch_job *pf_job =
+      (struct disk_cache_prefetch_job *) job;
+
+   pf_job->data = load_cache_entry(pf_job->cache, pf_job->key,
+                                   &pf_job->size);
+}
+
+/* Drop the oldest prefetch that has been loaded but not asked for.
+ * Returns false if they are all still queued or running.
+ *
+ * Called with prefetch_mutex held.
+ */
+static bool
+evict_prefetched(struct disk_cache *cache)
+{
+   list_for_each_entry(struct disk_cache_prefetch_job, pf_job,
+                       &cache->prefetched_list, link) {
+      if (!util_queue_fence_is_signalled(&pf_job->fence))
+         continue;
+
+      _mesa_hash_table_remove(cache->prefetched,
+                              _mesa_hash_table_search(cache->prefetched,
+                                                      pf_job->key));
+      list_del(&pf_job->link);
+      free(pf_job->data);
+      free(pf_job);
+      return true;
    }
 
-   size_t cache_item_md_size = sizeof(uint32_t);
-   uint32_t md_type;
-   ret = read_all(fd, &md_type, cache_item_md_size);
-   if (ret == -1)
-      goto fail;
+   return false;
+}
 
-   if (md_type == CACHE_ITEM_TYPE_GLSL) {
-      uint32_t num_keys;
-      cache_item_md_size += sizeof(uint32_t);
-      ret = read_all(fd, &num_keys, sizeof(uint32_t));
-      if (ret == -1)
-         goto fail;
+void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys)
+{
+   unsigned i;
 
-      /* The cache item metadata is currently just used for distributing
-       * precompiled shaders, they are not used by Mesa so just skip them for
-       * now.
-       * TODO: pass the metadata back to the caller and do some basic
-       * validation.
+   if (cache->blob_get_cb || cache->path_init_failed)
+      return;
+
+   mtx_lock(&cache->prefetch_mutex);
+
+   for (i = 0; i < num_keys; i++) {
+      struct disk_cache_prefetch_job *pf_job;
+
+      if (_mesa_hash_table_search(cache->prefetched, keys[i]))
+         continue;
+
+      if (cache->prefetched->entries >= CACHE_MAX_PREFETCHED &&
+          !evict_prefetched(cache))
+         break;
+
+      pf_job = calloc(1, sizeof(*pf_job));
+      if (pf_job == NULL)
+         break;
+
+      pf_job->cache = cache;
+      memcpy(pf_job->key, keys[i], CACHE_KEY_SIZE);
+      util_queue_fence_init(&pf_job->fence);
+
+      /* Someone is going to wait for the entry, so go ahead of the
+       * queued writes.
        */
-      cache_item_md_size += num_keys * sizeof(cache_key);
-      ret = lseek(fd, num_keys * sizeof(cache_key), SEEK_CUR);
-      if (ret == -1)
-         goto fail;
+      _mesa_hash_table_insert(cache->prefetched, pf_job->key, pf_job);
+      list_addtail(&pf_job->link, &cache->prefetched_list);
+      util_queue_add_job_ex(&cache->cache_queue, pf_job, &pf_job->fence,
+                            cache_prefetch, NULL, UTIL_QUEUE_PRIORITY_HIGH,
+                            NULL, NULL, 0);
    }
 
-   /* Load the CRC that was created when the file was written. */
-   struct cache_entry_file_data cf_data;
-   size_t cf_data_size = sizeof(cf_data);
-   ret = read_all(fd, &cf_data, cf_data_size);
-   if (ret == -1)
-      goto fail;
+   mtx_unlock(&cache->prefetch_mutex);
+}
 
-   /* Load the actual cache data. */
-   size_t cache_data_size =
-      sb.st_size - cf_data_size - ck_size - cache_item_md_size;
-   ret = read_all(fd, data, cache_data_size);
-   if (ret == -1)
-      goto fail;
+void *
+disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   struct disk_cache_prefetch_job *pf_job;
 
-   /* Uncompress the cache data */
-   uncompressed_data = malloc(cf_data.uncompressed_size);
-   if (!inflate_cache_data(data, cache_data_size, uncompressed_data,
-                           cf_data.uncompressed_size))
-      goto fail;
+   if (size)
+      *size = 0;
 
-   /* Check the data for corruption */
-   if (cf_data.crc32 != util_hash_crc32(uncompressed_data,
-                                        cf_data.uncompressed_size))
-      goto fail;
+   if (cache->blob_get_cb) {
+      /* This is what Android EGL defines as the maxValueSize in egl_cache_t
+       * class implementation.
+       */
+      const signed long max_blob_size = 64 * 1024;
+      void *blob = malloc(max_blob_size);
+      if (!blob)
+         return NULL;
 
-   free(data);
-   free(filename);
-   free(file_header);
-   close(fd);
+      signed long bytes =
+         cache->blob_get_cb(key, CACHE_KEY_SIZE, blob, max_blob_size);
 
-   if (size)
-      *size = cf_data.uncompressed_size;
+      if (!bytes) {
+         free(blob);
+         return NULL;
+      }
 
-   return uncompressed_data;
+      if (size)
+         *size = bytes;
+      return blob;
+   }
 
- fail:
-   if (data)
-      free(data);
-   if (uncompressed_data)
-      free(uncompressed_data);
-   if (filename)
-      free(filename);
-   if (file_header)
-      free(file_header);
-   if (fd != -1)
-      close(fd);
+   if (cache->path_init_failed)
+      return NULL;
 
-   return NULL;
+   pf_job = take_prefetched(cache, key);
+   if (pf_job) {
+      util_queue_fence_wait(&pf_job->fence);
+
+      void *data = pf_job->data;
+
+      if (data && size)
+         *size = pf_job->size;
+      free(pf_job);
+
+      /* A miss may have been stored since the prefetch, look again. */
+      if (data)
+         return data;
+   }
+
+   return load_cache_entry(cache, key, size);
 }
 
 void
@@ -73,6 +73,18 @@ struct cache_item_metadata {
 
 struct disk_cache;
 
+/**
+ * How the cache entries are stored within the cache directory.
+ */
+enum disk_cache_type {
+   /** Picked by the MESA_GLSL_CACHE_PACK environment variable */
+   DISK_CACHE_DEFAULT,
+   /** One file per entry, in two-character subdirectories */
+   DISK_CACHE_MULTI_FILE,
+   /** All entries in a single append-only pack file plus an index */
+   DISK_CACHE_PACK_FILE,
+};
+
 static inline char *
 disk_cache_format_hex_id(char *buf, const uint8_t *hex_id, unsigned size)
 {
@@ -141,12 +153,29 @@ struct disk_cache *
 disk_cache_create(const char *gpu_name, const char *timestamp,
                   uint64_t driver_flags);
 
+/**
+ * Like disk_cache_create(), but with an explicit storage backend.
+ *
+ * The pack file backend keeps every entry in one file, so looking up an
+ * entry doesn't cost any open()/stat() calls, and evicts entries in true
+ * least-recently-used order.
+ */
+struct disk_cache *
+disk_cache_type_create(const char *gpu_name, const char *timestamp,
+                       uint64_t driver_flags, enum disk_cache_type type);
+
 /**
  * Destroy a cache object, (freeing all associated resources).
  */
 void
 disk_cache_destroy(struct disk_cache *cache);
 
+/**
+ * Wait until all items handed to disk_cache_put() have been written.
+ */
+void
+disk_cache_wait_for_idle(struct disk_cache *cache);
+
 /**
  * Remove the item in the cache under the name \key.
  */
@@ -183,6 +212,20 @@ disk_cache_put(struct disk_cache *cache, const cache_key key,
 void *
 disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size);
 
+/**
+ * Start loading the items stored under \keys in the background.
+ *
+ * Meant for items that are likely to be needed soon, such as the binaries
+ * of all the stages of a program linked from the cache: a later
+ * disk_cache_get() for one of them returns the already uncompressed copy,
+ * (or waits for it to be loaded).
+ * The number of outstanding prefetches is bounded: items that are never
+ * asked for are eventually dropped to make room for newer ones.
+ */
+void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys);
+
 /**
  * Store the name \key within the cache, (without any associated data).
  *
@@ -228,11 +271,24 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
    return NULL;
 }
 
+static inline struct disk_cache *
+disk_cache_type_create(const char *gpu_name, const char *timestamp,
+                       uint64_t driver_flags, enum disk_cache_type type)
+{
+   return NULL;
+}
+
 static inline void
 disk_cache_destroy(struct disk_cache *cache) {
    return;
 }
 
+static inline void
+disk_cache_wait_for_idle(struct disk_cache *cache)
+{
+   return;
+}
+
 static inline void
 disk_cache_put(struct disk_cache *cache, const cache_key key,
                const void *data, size_t size,
@@ -253,6 +309,13 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    return NULL;
 }
 
+static inline void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys)
+{
+   return;
+}
+
 static inline void
 disk_cache_put_key(struct disk_cache *cache, const cache_key key)
 {
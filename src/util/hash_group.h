@@ -0,0 +1,241 @@
+/*
+ * Copyright © 2026 The Mesa Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Control byte groups shared by hash_table.c and set.c.
+ *
+ * Every slot of the table has a control byte next to it.  A present entry
+ * stores the top 7 bits of its (mixed) hash, so that a probe can compare a
+ * whole group of slots against the key in a couple of instructions and only
+ * look at the entries whose byte matches.  Free slots use values with the
+ * top bit set:
+ *
+ *    EMPTY    0x80  never used since the last clear or rehash
+ *    DELETED  0xfe  tombstone left by a removal
+ *    SENTINEL 0xff  padding past the end of tables smaller than a group
+ *
+ * Groups are aligned to HASH_GROUP_WIDTH slots.  The table is probed one
+ * group at a time with a triangular sequence, which visits every group
+ * exactly once when the number of groups is a power of two.  A lookup can
+ * stop at the first group containing an EMPTY byte.
+ *
+ * This header is private to src/util.
+ */
+
+#ifndef HASH_GROUP_H
+#define HASH_GROUP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bitscan.h"
+#include "u_endian.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define HASH_CTRL_EMPTY    ((uint8_t)0x80)
+#define HASH_CTRL_DELETED  ((uint8_t)0xfe)
+#define HASH_CTRL_SENTINEL ((uint8_t)0xff)
+
+static inline bool
+hash_ctrl_is_full(uint8_t ctrl)
+{
+   return ctrl < 0x80;
+}
+
+/**
+ * Scrambles the user supplied hash.  Many callers use the identity or a
+ * few shifts of a pointer as their hash, which would otherwise put all of
+ * their entries in a handful of groups with the same control byte.
+ */
+static inline uint32_t
+hash_group_mix(uint32_t h)
+{
+   h ^= h >> 16;
+   h *= 0x85ebca6b;
+   h ^= h >> 13;
+   h *= 0xc2b2ae35;
+   h ^= h >> 16;
+   return h;
+}
+
+/** Control byte stored for a mixed hash. */
+static inline uint8_t
+hash_group_h2(uint32_t mixed)
+{
+   return mixed >> 25;
+}
+
+#ifdef __SSE2__
+
+#define HASH_GROUP_WIDTH 16
+
+typedef __m128i hash_group;
+typedef unsigned hash_group_mask;
+
+static inline hash_group
+hash_group_load(const uint8_t *ctrl)
+{
+   return _mm_loadu_si128((const __m128i *)ctrl);
+}
+
+static inline hash_group_mask
+hash_group_match(hash_group g, uint8_t h2)
+{
+   return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(h2)));
+}
+
+static inline hash_group_mask
+hash_group_match_empty(hash_group g)
+{
+   return _mm_movemask_epi8(_mm_cmpeq_epi8(g,
+                                           _mm_set1_epi8(HASH_CTRL_EMPTY)));
+}
+
+/* EMPTY and DELETED are the only values below SENTINEL as signed bytes. */
+static inline hash_group_mask
+hash_group_match_empty_or_deleted(hash_group g)
+{
+   return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(HASH_CTRL_SENTINEL),
+                                           g));
+}
+
+/** Returns the slot of the lowest match and clears it from the mask. */
+static inline unsigned
+hash_group_mask_next(hash_group_mask *mask)
+{
+   return u_bit_scan(mask);
+}
+
+static inline unsigned
+hash_group_mask_first(hash_group_mask mask)
+{
+   return ffs(mask) - 1;
+}
+
+#else
+
+/* Portable fallback working on 8 control bytes in a 64-bit word.  Each
+ * match sets the top bit of the matching byte.
+ */
+#define HASH_GROUP_WIDTH 8
+
+typedef uint64_t hash_group;
+typedef uint64_t hash_group_mask;
+
+#define HASH_GROUP_LSBS 0x0101010101010101ull
+#define HASH_GROUP_MSBS 0x8080808080808080ull
+
+static inline hash_group
+hash_group_load(const uint8_t *ctrl)
+{
+   uint64_t g;
+
+   memcpy(&g, ctrl, sizeof(g));
+#ifdef PIPE_ARCH_BIG_ENDIAN
+   g = __builtin_bswap64(g);
+#endif
+   return g;
+}
+
+/* This may report a false positive for a byte directly above a real match,
+ * which is harmless since the callers compare the full hash and key anyway.
+ */
+static inline hash_group_mask
+hash_group_match(hash_group g, uint8_t h2)
+{
+   uint64_t x = g ^ (HASH_GROUP_LSBS * h2);
+   return (x - HASH_GROUP_LSBS) & ~x & HASH_GROUP_MSBS;
+}
+
+/* EMPTY is the only value with bit 7 set and bit 1 clear. */
+static inline hash_group_mask
+hash_group_match_empty(hash_group g)
+{
+   return g & (~g << 6) & HASH_GROUP_MSBS;
+}
+
+/* EMPTY and DELETED are the only values with bit 7 set and bit 0 clear. */
+static inline hash_group_mask
+hash_group_match_empty_or_deleted(hash_group g)
+{
+   return g & (~g << 7) & HASH_GROUP_MSBS;
+}
+
+static inline unsigned
+hash_group_mask_next(hash_group_mask *mask)
+{
+   const unsigned i = (ffsll(*mask) - 1) >> 3;
+   *mask &= *mask - 1;
+   return i;
+}
+
+static inline unsigned
+hash_group_mask_first(hash_group_mask mask)
+{
+   return (ffsll(mask) - 1) >> 3;
+}
+
+#endif
+
+/** Number of control bytes to allocate for a table of the given size. */
+static inline uint32_t
+hash_group_ctrl_size(uint32_t size)
+{
+   return size < HASH_GROUP_WIDTH ? HASH_GROUP_WIDTH : size;
+}
+
+/** Mask applied to group indices while probing. */
+static inline uint32_t
+hash_group_index_mask(uint32_t size)
+{
+   return size < HASH_GROUP_WIDTH ? 0 : size / HASH_GROUP_WIDTH - 1;
+}
+
+/** Marks every slot EMPTY and the padding past the end as SENTINEL. */
+static inline void
+hash_group_ctrl_reset(uint8_t *ctrl, uint32_t size)
+{
+   memset(ctrl, HASH_CTRL_EMPTY, size);
+   if (size < HASH_GROUP_WIDTH)
+      memset(ctrl + size, HASH_CTRL_SENTINEL, HASH_GROUP_WIDTH - size);
+}
+
+/**
+ * Control byte to leave behind when removing the entry at @index.  If its
+ * group still has an EMPTY slot, no probe sequence ever continued past the
+ * group, so the slot can become EMPTY again instead of a tombstone.
+ */
+static inline uint8_t
+hash_group_removed_ctrl(const uint8_t *ctrl, uint32_t index)
+{
+   const uint8_t *group = ctrl + (index & ~(uint32_t)(HASH_GROUP_WIDTH - 1));
+
+   return hash_group_match_empty(hash_group_load(group)) ?
+          HASH_CTRL_EMPTY : HASH_CTRL_DELETED;
+}
+
+#endif /* HASH_GROUP_H */
@@ -33,9 +33,10 @@
  */
 
 /**
- * Implements an open-addressing, linear-reprobing hash table.
+ * Implements an open-addressing hash table probed a group of control bytes
+ * at a time, see hash_group.h.
  *
- * For more information, see:
+ * For more information on the original design, see:
  *
  * http://cgit.freedesktop.org/~anholt/hash_table/tree/README
  */
@@ -45,69 +46,95 @@
 #include <assert.h>
 
 #include "hash_table.h"
+#include "hash_group.h"
 #include "ralloc.h"
 #include "macros.h"
 #include "main/hash.h"
 
 static const uint32_t deleted_key_value;
 
+#define MIN_SIZE 8
+
+/* Keep the table at most 7/8 full, counting tombstones. */
+static uint32_t
+max_entries_for_size(uint32_t size)
+{
+   return size - size / 8;
+}
+
 /**
- * From Knuth -- a good choice for hash/rehash values is p, p-2 where
- * p and p-2 are both prime.  These tables are sized to have an extra 10%
- * free to avoid exponential performance degradation as the hash table fills
+ * Comparisons that the probe loops know how to do without calling through
+ * key_equals_function.
  */
-static const struct {
-   uint32_t max_entries, size, rehash;
-} hash_sizes[] = {
-   { 2,			5,		3	  },
-   { 4,			7,		5	  },
-   { 8,			13,		11	  },
-   { 16,		19,		17	  },
-   { 32,		43,		41        },
-   { 64,		73,		71        },
-   { 128,		151,		149       },
-   { 256,		283,		281       },
-   { 512,		571,		569       },
-   { 1024,		1153,		1151      },
-   { 2048,		2269,		2267      },
-   { 4096,		4519,		4517      },
-   { 8192,		9013,		9011      },
-   { 16384,		18043,		18041     },
-   { 32768,		36109,		36107     },
-   { 65536,		72091,		72089     },
-   { 131072,		144409,		144407    },
-   { 262144,		288361,		288359    },
-   { 524288,		576883,		576881    },
-   { 1048576,		1153459,	1153457   },
-   { 2097152,		2307163,	2307161   },
-   { 4194304,		4613893,	4613891   },
-   { 8388608,		9227641,	9227639   },
-   { 16777216,		18455029,	18455027  },
-   { 33554432,		36911011,	36911009  },
-   { 67108864,		73819861,	73819859  },
-   { 134217728,		147639589,	147639587 },
-   { 268435456,		295279081,	295279079 },
-   { 536870912,		590559793,	590559791 },
-   { 1073741824,	1181116273,	1181116271},
-   { 2147483648ul,	2362232233ul,	2362232231ul}
+enum key_kind {
+   KEY_GENERIC,
+   KEY_POINTER,
+   KEY_U32,
 };
 
-static int
-entry_is_free(const struct hash_entry *entry)
+static inline enum key_kind
+hash_table_key_kind(const struct hash_table *ht)
+{
+   if (ht->key_equals_function == _mesa_key_pointer_equal)
+      return KEY_POINTER;
+   if (ht->key_equals_function == _mesa_key_u32_equal)
+      return KEY_U32;
+   return KEY_GENERIC;
+}
+
+static ALWAYS_INLINE bool
+hash_table_keys_equal(const struct hash_table *ht, enum key_kind kind,
+                      const void *a, const void *b)
 {
-   return entry->key == NULL;
+   switch (kind) {
+   case KEY_POINTER:
+      return a == b;
+   case KEY_U32:
+      return *(const uint32_t *)a == *(const uint32_t *)b;
+   default:
+      return ht->key_equals_function(a, b);
+   }
 }
 
-static int
-entry_is_deleted(const struct hash_table *ht, struct hash_entry *entry)
+static inline uint32_t
+hash_table_hash_key(const struct hash_table *ht, const void *key)
 {
-   return entry->key == ht->deleted_key;
+   /* _mesa_hash_pointer() is inline, so this only catches the tables made
+    * by _mesa_pointer_hash_table_create().
+    */
+   if (ht->key_hash_function == _mesa_hash_pointer)
+      return _mesa_hash_pointer(key);
+   if (ht->key_hash_function == _mesa_hash_u32)
+      return _mesa_hash_u32(key);
+   return ht->key_hash_function(key);
 }
 
-static int
-entry_is_present(const struct hash_table *ht, struct hash_entry *entry)
+static bool
+hash_table_alloc(struct hash_table *ht, uint32_t size)
 {
-   return entry->key != NULL && entry->key != ht->deleted_key;
+   struct hash_entry *table;
+   uint8_t *ctrl;
+
+   table = ralloc_array(ht, struct hash_entry, size);
+   if (table == NULL)
+      return false;
+
+   ctrl = ralloc_array(ht, uint8_t, hash_group_ctrl_size(size));
+   if (ctrl == NULL) {
+      ralloc_free(table);
+      return false;
+   }
+
+   hash_group_ctrl_reset(ctrl, size);
+
+   ht->table = table;
+   ht->ctrl = ctrl;
+   ht->size = size;
+   ht->max_entries = max_entries_for_size(size);
+   ht->entries = 0;
+   ht->deleted_entries = 0;
+
+   return true;
 }
 
 struct hash_table *
@@ -122,18 +149,11 @@ _mesa_hash_table_create(void *mem_ctx,
    if (ht == NULL)
       return NULL;
 
-   ht->size_index = 0;
-   ht->size = hash_sizes[ht->size_index].size;
-   ht->rehash = hash_sizes[ht->size_index].rehash;
-   ht->max_entries = hash_sizes[ht->size_index].max_entries;
    ht->key_hash_function = key_hash_function;
    ht->key_equals_function = key_equals_function;
-   ht->table = rzalloc_array(ht, struct hash_entry, ht->size);
-   ht->entries = 0;
-   ht->deleted_entries = 0;
    ht->deleted_key = &deleted_key_value;
 
-   if (ht->table == NULL) {
+   if (!hash_table_alloc(ht, MIN_SIZE)) {
       ralloc_free(ht);
       return NULL;
    }
@@ -141,6 +161,17 @@ _mesa_hash_table_create(void *mem_ctx,
    return ht;
 }
 
+/**
+ * Creates a hash table keyed on pointer values, hashing and comparing the
+ * keys inline.
+ */
+struct hash_table *
+_mesa_pointer_hash_table_create(void *mem_ctx)
+{
+   return _mesa_hash_table_create(mem_ctx, _mesa_hash_pointer,
+                                  _mesa_key_pointer_equal);
+}
+
 struct hash_table *
 _mesa_hash_table_clone(struct hash_table *src, void *dst_mem_ctx)
 {
@@ -153,12 +184,14 @@ _mesa_hash_table_clone(struct hash_table *src, void *dst_mem_ctx)
    memcpy(ht, src, sizeof(struct hash_table));
 
    ht->table = ralloc_array(ht, struct hash_entry, ht->size);
-   if (ht->table == NULL) {
+   ht->ctrl = ralloc_array(ht, uint8_t, hash_group_ctrl_size(ht->size));
+   if (ht->table == NULL || ht->ctrl == NULL) {
       ralloc_free(ht);
       return NULL;
    }
 
    memcpy(ht->table, src->table, ht->size * sizeof(struct hash_entry));
+   memcpy(ht->ctrl, src->ctrl, hash_group_ctrl_size(ht->size));
 
    return ht;
 }
@@ -196,31 +229,25 @@ void
 _mesa_hash_table_clear(struct hash_table *ht,
                        void (*delete_function)(struct hash_entry *entry))
 {
-   struct hash_entry *entry;
-
-   for (entry = ht->table; entry != ht->table + ht->size; entry++) {
-      if (entry->key == NULL)
-         continue;
+   if (delete_function != NULL) {
+      struct hash_entry *entry;
 
-      if (delete_function != NULL && entry->key != ht->deleted_key)
+      hash_table_foreach(ht, entry) {
          delete_function(entry);
-
-      entry->key = NULL;
+      }
    }
 
+   hash_group_ctrl_reset(ht->ctrl, ht->size);
    ht->entries = 0;
    ht->deleted_entries = 0;
 }
 
 /** Sets the value of the key pointer used for deleted entries in the table.
  *
- * The assumption is that usually keys are actual pointers, so we use a
- * default value of a pointer to an arbitrary piece of storage in the library.
- * But in some cases a consumer wants to store some other sort of value in the
- * table, like a uint32_t, in which case that pointer may conflict with one of
- * their valid keys.  This lets that user select a safe value.
- *
- * This must be called before any keys are actually deleted from the table.
+ * Free slots are tracked by the control bytes, so any key value can be
+ * stored in the table.  The deleted key is only kept for the users that
+ * predate this, like the hash_table_u64 wrapper, which give it a meaning of
+ * their own.
  */
 void
 _mesa_hash_table_set_deleted_key(struct hash_table *ht, const void *deleted_key)
@@ -228,33 +255,51 @@ _mesa_hash_table_set_deleted_key(struct hash_table *ht, const void *deleted_key)
    ht->deleted_key = deleted_key;
 }
 
-static struct hash_entry *
-hash_table_search(struct hash_table *ht, uint32_t hash, const void *key)
+static ALWAYS_INLINE struct hash_entry *
+hash_table_search_kind(struct hash_table *ht, uint32_t hash, const void *key,
+                       enum key_kind kind)
 {
-   uint32_t start_hash_address = hash % ht->size;
-   uint32_t hash_address = start_hash_address;
-
-   do {
-      uint32_t double_hash;
-
-      struct hash_entry *entry = ht->table + hash_address;
-
-      if (entry_is_free(entry)) {
-         return NULL;
-      } else if (entry_is_present(ht, entry) && entry->hash == hash) {
-         if (ht->key_equals_function(key, entry->key)) {
+   const uint32_t mixed = hash_group_mix(hash);
+   const uint8_t h2 = hash_group_h2(mixed);
+   const uint32_t group_mask = hash_group_index_mask(ht->size);
+   uint32_t group = mixed & group_mask;
+
+   for (uint32_t i = 1; i <= group_mask + 1; i++) {
+      const uint32_t base = group * HASH_GROUP_WIDTH;
+      const hash_group g = hash_group_load(ht->ctrl + base);
+      hash_group_mask match = hash_group_match(g, h2);
+
+      while (match) {
+         struct hash_entry *entry =
+            ht->table + base + hash_group_mask_next(&match);
+
+         if (entry->hash == hash &&
+             hash_table_keys_equal(ht, kind, key, entry->key))
             return entry;
-         }
       }
 
-      double_hash = 1 + hash % ht->rehash;
+      if (hash_group_match_empty(g))
+         return NULL;
 
-      hash_address = (hash_address + double_hash) % ht->size;
-   } while (hash_address != start_hash_address);
+      group = (group + i) & group_mask;
+   }
 
    return NULL;
 }
 
+static struct hash_entry *
+hash_table_search(struct hash_table *ht, uint32_t hash, const void *key)
+{
+   switch (hash_table_key_kind(ht)) {
+   case KEY_POINTER:
+      return hash_table_search_kind(ht, hash, key, KEY_POINTER);
+   case KEY_U32:
+      return hash_table_search_kind(ht, hash, key, KEY_U32);
+   default:
+      return hash_table_search_kind(ht, hash, key, KEY_GENERIC);
+   }
+}
+
 /**
  * Finds a hash table entry with the given key and hash of that key.
  *
@@ -265,7 +310,7 @@ struct hash_entry *
 _mesa_hash_table_search(struct hash_table *ht, const void *key)
 {
    assert(ht->key_hash_function);
-   return hash_table_search(ht, ht->key_hash_function(key), key);
+   return hash_table_search(ht, hash_table_hash_key(ht, key), key);
 }
 
 struct hash_entry *
@@ -276,109 +321,124 @@ _mesa_hash_table_search_pre_hashed(struct hash_table *ht, uint32_t hash,
    return hash_table_search(ht, hash, key);
 }
 
-static struct hash_entry *
-hash_table_insert(struct hash_table *ht, uint32_t hash,
-                  const void *key, void *data);
+/**
+ * Returns the first free slot along the probe sequence of the hash.  The
+ * caller must make sure that the table isn't full.
+ */
+static uint32_t
+hash_table_find_free(const struct hash_table *ht, uint32_t mixed)
+{
+   const uint32_t group_mask = hash_group_index_mask(ht->size);
+   uint32_t group = mixed & group_mask;
+
+   for (uint32_t i = 1;; i++) {
+      const uint32_t base = group * HASH_GROUP_WIDTH;
+      hash_group_mask free =
+         hash_group_match_empty_or_deleted(hash_group_load(ht->ctrl + base));
+
+      if (free)
+         return base + hash_group_mask_first(free);
+
+      group = (group + i) & group_mask;
+   }
+}
 
 static void
-_mesa_hash_table_rehash(struct hash_table *ht, unsigned new_size_index)
+hash_table_rehash(struct hash_table *ht, uint32_t new_size)
 {
    struct hash_table old_ht;
-   struct hash_entry *table, *entry;
 
-   if (new_size_index >= ARRAY_SIZE(hash_sizes))
+   if (new_size == 0)
       return;
 
-   table = rzalloc_array(ht, struct hash_entry,
-                         hash_sizes[new_size_index].size);
-   if (table == NULL)
+   old_ht = *ht;
+
+   if (!hash_table_alloc(ht, new_size))
       return;
 
-   old_ht = *ht;
+   /* The keys are known to be distinct, so skip the lookup. */
+   for (uint32_t i = 0; i < old_ht.size; i++) {
+      if (!hash_ctrl_is_full(old_ht.ctrl[i]))
+         continue;
 
-   ht->table = table;
-   ht->size_index = new_size_index;
-   ht->size = hash_sizes[ht->size_index].size;
-   ht->rehash = hash_sizes[ht->size_index].rehash;
-   ht->max_entries = hash_sizes[ht->size_index].max_entries;
-   ht->entries = 0;
-   ht->deleted_entries = 0;
+      const struct hash_entry *old_entry = old_ht.table + i;
+      const uint32_t mixed = hash_group_mix(old_entry->hash);
+      const uint32_t index = hash_table_find_free(ht, mixed);
 
-   hash_table_foreach(&old_ht, entry) {
-      hash_table_insert(ht, entry->hash, entry->key, entry->data);
+      ht->ctrl[index] = hash_group_h2(mixed);
+      ht->table[index] = *old_entry;
    }
+   ht->entries = old_ht.entries;
 
    ralloc_free(old_ht.table);
+   ralloc_free(old_ht.ctrl);
 }
 
-static struct hash_entry *
-hash_table_insert(struct hash_table *ht, uint32_t hash,
-                  const void *key, void *data)
+static ALWAYS_INLINE struct hash_entry *
+hash_table_insert_kind(struct hash_table *ht, uint32_t hash,
+                       const void *key, void *data, enum key_kind kind)
 {
-   uint32_t start_hash_address, hash_address;
-   struct hash_entry *available_entry = NULL;
+   struct hash_entry *entry;
+   uint32_t mixed, index;
 
    assert(key != NULL);
 
    if (ht->entries >= ht->max_entries) {
-      _mesa_hash_table_rehash(ht, ht->size_index + 1);
+      hash_table_rehash(ht, ht->size * 2);
    } else if (ht->deleted_entries + ht->entries >= ht->max_entries) {
-      _mesa_hash_table_rehash(ht, ht->size_index);
+      hash_table_rehash(ht, ht->size);
    }
 
-   start_hash_address = hash % ht->size;
-   hash_address = start_hash_address;
-   do {
-      struct hash_entry *entry = ht->table + hash_address;
-      uint32_t double_hash;
-
-      if (!entry_is_present(ht, entry)) {
-         /* Stash the first available entry we find */
-         if (available_entry == NULL)
-            available_entry = entry;
-         if (entry_is_free(entry))
-            break;
-      }
-
-      /* Implement replacement when another insert happens
-       * with a matching key.  This is a relatively common
-       * feature of hash tables, with the alternative
-       * generally being "insert the new value as well, and
-       * return it first when the key is searched for".
-       *
-       * Note that the hash table doesn't have a delete
-       * callback.  If freeing of old data pointers is
-       * required to avoid memory leaks, perform a search
-       * before inserting.
-       */
-      if (!entry_is_deleted(ht, entry) &&
-          entry->hash == hash &&
-          ht->key_equals_function(key, entry->key)) {
-         entry->key = key;
-         entry->data = data;
-         return entry;
-      }
-
+   /* We could hit this if a required resize failed. An unchecked-malloc
+    * application could ignore this result.
+    */
+   if (ht->deleted_entries + ht->entries >= ht->size)
+      return NULL;
 
-      double_hash = 1 + hash % ht->rehash;
+   /* Implement replacement when another insert happens
+    * with a matching key.  This is a relatively common
+    * feature of hash tables, with the alternative
+    * generally being "insert the new value as well, and
+    * return it first when the key is searched for".
+    *
+    * Note that the hash table doesn't have a delete
+    * callback.  If freeing of old data pointers is
+    * required to avoid memory leaks, perform a search
+    * before inserting.
+    */
+   entry = hash_table_search_kind(ht, hash, key, kind);
+   if (entry) {
+      entry->key = key;
+      entry->data = data;
+      return entry;
+   }
 
-      hash_address = (hash_address + double_hash) % ht->size;
-   } while (hash_address != start_hash_address);
+   mixed = hash_group_mix(hash);
+   index = hash_table_find_free(ht, mixed);
+   if (ht->ctrl[index] == HASH_CTRL_DELETED)
+      ht->deleted_entries--;
+   ht->ctrl[index] = hash_group_h2(mixed);
+
+   entry = ht->table + index;
+   entry->hash = hash;
+   entry->key = key;
+   entry->data = data;
+   ht->entries++;
+   return entry;
+}
 
-   if (available_entry) {
-      if (entry_is_deleted(ht, available_entry))
-         ht->deleted_entries--;
-      available_entry->hash = hash;
-      available_entry->key = key;
-      available_entry->data = data;
-      ht->entries++;
-      return available_entry;
+static struct hash_entry *
+hash_table_insert(struct hash_table *ht, uint32_t hash,
+                  const void *key, void *data)
+{
+   switch (hash_table_key_kind(ht)) {
+   case KEY_POINTER:
+      return hash_table_insert_kind(ht, hash, key, data, KEY_POINTER);
+   case KEY_U32:
+      return hash_table_insert_kind(ht, hash, key, data, KEY_U32);
+   default:
+      return hash_table_insert_kind(ht, hash, key, data, KEY_GENERIC);
    }
-
-   /* We could hit here if a required resize failed. An unchecked-malloc
-    * application could ignore this result.
-    */
-   return NULL;
 }
 
 /**
@@ -391,7 +451,7 @@ struct hash_entry *
 _mesa_hash_table_insert(struct hash_table *ht, const void *key, void *data)
 {
    assert(ht->key_hash_function);
-   return hash_table_insert(ht, ht->key_hash_function(key), key, data);
+   return hash_table_insert(ht, hash_table_hash_key(ht, key), key, data);
 }
 
 struct hash_entry *
@@ -412,12 +472,18 @@ void
 _mesa_hash_table_remove(struct hash_table *ht,
                         struct hash_entry *entry)
 {
+   uint32_t index;
+
    if (!entry)
       return;
 
-   entry->key = ht->deleted_key;
+   index = entry - ht->table;
+   assert(hash_ctrl_is_full(ht->ctrl[index]));
+
+   ht->ctrl[index] = hash_group_removed_ctrl(ht->ctrl, index);
+   if (ht->ctrl[index] == HASH_CTRL_DELETED)
+      ht->deleted_entries++;
    ht->entries--;
-   ht->deleted_entries++;
 }
 
 /**
@@ -430,15 +496,11 @@ struct hash_entry *
 _mesa_hash_table_next_entry(struct hash_table *ht,
                             struct hash_entry *entry)
 {
-   if (entry == NULL)
-      entry = ht->table;
-   else
-      entry = entry + 1;
+   uint32_t i = entry == NULL ? 0 : entry - ht->table + 1;
 
-   for (; entry != ht->table + ht->size; entry++) {
-      if (entry_is_present(ht, entry)) {
-         return entry;
-      }
+   for (; i < ht->size; i++) {
+      if (hash_ctrl_is_full(ht->ctrl[i]))
+         return ht->table + i;
    }
 
    return NULL;
@@ -456,21 +518,16 @@ struct hash_entry *
 _mesa_hash_table_random_entry(struct hash_table *ht,
                               bool (*predicate)(struct hash_entry *entry))
 {
-   struct hash_entry *entry;
-   uint32_t i = rand() % ht->size;
+   uint32_t start = rand() % ht->size;
 
    if (ht->entries == 0)
       return NULL;
 
-   for (entry = ht->table + i; entry != ht->table + ht->size; entry++) {
-      if (entry_is_present(ht, entry) &&
-          (!predicate || predicate(entry))) {
-         return entry;
-      }
-   }
+   for (uint32_t n = 0; n < ht->size; n++) {
+      uint32_t i = (start + n) & (ht->size - 1);
+      struct hash_entry *entry = ht->table + i;
 
-   for (entry = ht->table; entry != ht->table + i; entry++) {
-      if (entry_is_present(ht, entry) &&
+      if (hash_ctrl_is_full(ht->ctrl[i]) &&
           (!predicate || predicate(entry))) {
          return entry;
       }
@@ -527,6 +584,23 @@ _mesa_key_pointer_equal(const void *a, const void *b)
    return a == b;
 }
 
+/**
+ * Hash and compare functions for keys pointing to a uint32_t.  Tables using
+ * _mesa_key_u32_equal() compare the keys without calling through the
+ * function pointer.
+ */
+uint32_t
+_mesa_hash_u32(const void *key)
+{
+   return *(const uint32_t *)key * 0x9e3779b1u;
+}
+
+bool
+_mesa_key_u32_equal(const void *a, const void *b)
+{
+   return *(const uint32_t *)a == *(const uint32_t *)b;
+}
+
 /**
  * Hash table wrapper which supports 64-bit keys.
  *
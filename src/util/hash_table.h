@@ -44,15 +44,18 @@ struct hash_entry {
    void *data;
 };
 
+/**
+ * Open-addressing hash table with one control byte per entry, see
+ * hash_group.h.  The size is always a power of two.
+ */
 struct hash_table {
    struct hash_entry *table;
+   uint8_t *ctrl;
    uint32_t (*key_hash_function)(const void *key);
    bool (*key_equals_function)(const void *a, const void *b);
    const void *deleted_key;
    uint32_t size;
-   uint32_t rehash;
    uint32_t max_entries;
-   uint32_t size_index;
    uint32_t entries;
    uint32_t deleted_entries;
 };
@@ -63,6 +66,8 @@ _mesa_hash_table_create(void *mem_ctx,
                         bool (*key_equals_function)(const void *a,
                                                     const void *b));
 struct hash_table *
+_mesa_pointer_hash_table_create(void *mem_ctx);
+struct hash_table *
 _mesa_hash_table_clone(struct hash_table *src, void *dst_mem_ctx);
 void _mesa_hash_table_destroy(struct hash_table *ht,
                               void (*delete_function)(struct hash_entry *entry));
@@ -99,6 +104,8 @@ uint32_t _mesa_hash_data(const void *data, size_t size);
 uint32_t _mesa_hash_string(const void *key);
 bool _mesa_key_string_equal(const void *a, const void *b);
 bool _mesa_key_pointer_equal(const void *a, const void *b);
+uint32_t _mesa_hash_u32(const void *key);
+bool _mesa_key_u32_equal(const void *a, const void *b);
 
 static inline uint32_t _mesa_key_hash_string(const void *key)
 {
@@ -66,6 +66,9 @@ struct
    unsigned canary;
 #endif
 
+   /* ARENA_* flags, for blocks allocated out of an arena. */
+   unsigned flags;
+
    struct ralloc_header *parent;
 
    /* The first child (head of a linked list) */
@@ -83,6 +86,17 @@ typedef struct ralloc_header ralloc_header;
 static void unlink_block(ralloc_header *info);
 static void unsafe_free(ralloc_header *info);
 
+static struct ralloc_arena *arena_of(const ralloc_header *info);
+static ralloc_header *arena_alloc(struct ralloc_arena *arena, size_t size);
+static ralloc_header *arena_resize(ralloc_header *old, size_t size);
+static void arena_free(ralloc_header *info);
+static void arena_destroy(struct ralloc_arena *arena);
+
+/* The block was carved out of an arena buffer. */
+#define ARENA_BLOCK 0x1
+/* The block is the context that owns its arena. */
+#define ARENA_ROOT  0x2
+
 static ralloc_header *
 get_header(const void *ptr)
 {
@@ -115,17 +129,9 @@ ralloc_context(const void *ctx)
    return ralloc_size(ctx, 0);
 }
 
-void *
-ralloc_size(const void *ctx, size_t size)
+static void *
+init_block(ralloc_header *info, ralloc_header *parent)
 {
-   void *block = malloc(size + sizeof(ralloc_header));
-   ralloc_header *info;
-   ralloc_header *parent;
-
-   if (unlikely(block == NULL))
-      return NULL;
-
-   info = (ralloc_header *) block;
    /* measurements have shown that calloc is slower (because of
     * the multiplication overflow checking?), so clear things
     * manually
@@ -136,8 +142,6 @@ ralloc_size(const void *ctx, size_t size)
    info->next = NULL;
    info->destructor = NULL;
 
-   parent = ctx != NULL ? get_header(ctx) : NULL;
-
    add_child(parent, info);
 
 #ifdef DEBUG
@@ -147,6 +151,29 @@ ralloc_size(const void *ctx, size_t size)
    return PTR_FROM_HEADER(info);
 }
 
+void *
+ralloc_size(const void *ctx, size_t size)
+{
+   ralloc_header *parent = ctx != NULL ? get_header(ctx) : NULL;
+   struct ralloc_arena *arena = parent != NULL ? arena_of(parent) : NULL;
+   ralloc_header *info;
+
+   if (arena != NULL) {
+      info = arena_alloc(arena, size);
+      if (unlikely(info == NULL))
+         return NULL;
+
+      return init_block(info, parent);
+   }
+
+   info = malloc(size + sizeof(ralloc_header));
+   if (unlikely(info == NULL))
+      return NULL;
+
+   info->flags = 0;
+   return init_block(info, parent);
+}
+
 void *
 rzalloc_size(const void *ctx, size_t size)
 {
@@ -165,7 +192,10 @@ resize(void *ptr, size_t size)
    ralloc_header *child, *old, *info;
 
    old = get_header(ptr);
-   info = realloc(old, size + sizeof(ralloc_header));
+   if (old->flags & ARENA_BLOCK)
+      info = arena_resize(old, size);
+   else
+      info = realloc(old, size + sizeof(ralloc_header));
 
    if (info == NULL)
       return NULL;
@@ -273,7 +303,16 @@ unsafe_free(ralloc_header *info)
    if (info->destructor != NULL)
       info->destructor(PTR_FROM_HEADER(info));
 
-   free(info);
+   if (info->flags & ARENA_ROOT) {
+      struct ralloc_arena *arena = arena_of(info);
+
+      arena_free(info);
+      arena_destroy(arena);
+   } else if (info->flags & ARENA_BLOCK) {
+      arena_free(info);
+   } else {
+      free(info);
+   }
 }
 
 void
@@ -535,6 +574,273 @@ ralloc_vasprintf_rewrite_tail(char **str, size_t *start, const char *fmt,
    return true;
 }
 
+/***************************************************************************
+ * Arena allocator for many small allocations.
+ ***************************************************************************
+ *
+ * Arena blocks are complete ralloc blocks, so they can have children, be
+ * stolen, resized or freed one by one like any other.  They are carved out
+ * of big buffers owned by the arena instead of being malloc'd, and their
+ * flags record their size class and where they are in their buffer.
+ *
+ * Freed blocks go to a free list per size class, ARENA_ALIGN bytes apart,
+ * and are handed out again before the current buffer is used any further.
+ * Blocks bigger than the largest class get a buffer of their own, which is
+ * released along with them.
+ *
+ * Buffers count their allocated blocks.  When the arena context is freed,
+ * the buffers still holding blocks that were stolen by other contexts are
+ * left behind, and released with the last of their blocks.
+ */
+
+#define ALIGN_POT(x, y) (((x) + (y) - 1) & ~((y) - 1))
+
+/* As much as ralloc_header, which is aligned like malloc'd memory. */
+#define ARENA_ALIGN 16
+#define ARENA_NUM_CLASSES 64
+#define ARENA_MAX_CLASS_SIZE (ARENA_NUM_CLASSES * ARENA_ALIGN)
+#define ARENA_MIN_BUFSIZE 4096
+#define ARENA_MAX_BUFSIZE (64 * 1024)
+
+/* Size class, and offset of the block in its buffer, in ARENA_ALIGN units.
+ * Blocks with a buffer of their own are in no class.
+ */
+#define ARENA_CLASS_SHIFT 2
+#define ARENA_CLASS_MASK (0xff << ARENA_CLASS_SHIFT)
+#define ARENA_NO_CLASS 0xff
+#define ARENA_OFFSET_SHIFT 16
+
+struct arena_buffer {
+   struct ralloc_arena *arena;   /* NULL once the arena context is freed */
+   struct arena_buffer *prev;
+   struct arena_buffer *next;
+   size_t offset;                /* first unused byte in the buffer */
+   size_t size;
+   unsigned live;                /* blocks allocated and not freed */
+};
+
+struct ralloc_arena {
+   struct arena_buffer *buffers;
+   struct arena_buffer *current; /* the only buffer with unused space */
+   size_t next_buffer_size;
+
+   /* Free blocks by size class, linked through ralloc_header::next. */
+   ralloc_header *free[ARENA_NUM_CLASSES];
+};
+
+#define ARENA_BUFFER_HEADER_SIZE \
+   ALIGN_POT(sizeof(struct arena_buffer), ARENA_ALIGN)
+
+static inline unsigned
+arena_block_class(const ralloc_header *info)
+{
+   return (info->flags & ARENA_CLASS_MASK) >> ARENA_CLASS_SHIFT;
+}
+
+static inline struct arena_buffer *
+arena_block_buffer(const ralloc_header *info)
+{
+   size_t offset = (size_t) (info->flags >> ARENA_OFFSET_SHIFT) * ARENA_ALIGN;
+
+   return (struct arena_buffer *) ((char *) info - offset);
+}
+
+/* Size of the block, header included. */
+static size_t
+arena_block_size(const ralloc_header *info)
+{
+   unsigned size_class = arena_block_class(info);
+
+   if (size_class == ARENA_NO_CLASS)
+      return arena_block_buffer(info)->size - ARENA_BUFFER_HEADER_SIZE;
+
+   return (size_class + 1) * ARENA_ALIGN;
+}
+
+static struct ralloc_arena *
+arena_of(const ralloc_header *info)
+{
+   if (likely(!(info->flags & ARENA_BLOCK)))
+      return NULL;
+
+   return arena_block_buffer(info)->arena;
+}
+
+static struct arena_buffer *
+arena_buffer_create(struct ralloc_arena *arena, size_t size)
+{
+   struct arena_buffer *buffer = malloc(size);
+
+   if (unlikely(buffer == NULL))
+      return NULL;
+
+   buffer->arena = arena;
+   buffer->prev = NULL;
+   buffer->next = arena->buffers;
+   if (buffer->next != NULL)
+      buffer->next->prev = buffer;
+   arena->buffers = buffer;
+
+   buffer->offset = ARENA_BUFFER_HEADER_SIZE;
+   buffer->size = size;
+   buffer->live = 0;
+   return buffer;
+}
+
+static void
+arena_buffer_destroy(struct arena_buffer *buffer)
+{
+   struct ralloc_arena *arena = buffer->arena;
+
+   if (arena != NULL) {
+      if (arena->buffers == buffer)
+         arena->buffers = buffer->next;
+      if (arena->current == buffer)
+         arena->current = NULL;
+      if (buffer->prev != NULL)
+         buffer->prev->next = buffer->next;
+      if (buffer->next != NULL)
+         buffer->next->prev = buffer->prev;
+   }
+
+   free(buffer);
+}
+
+/* Returns a block with only its flags set. */
+static ralloc_header *
+arena_alloc(struct ralloc_arena *arena, size_t size)
+{
+   size_t full_size = ALIGN_POT(sizeof(ralloc_header) + size, ARENA_ALIGN);
+   struct arena_buffer *buffer;
+   ralloc_header *info;
+   unsigned size_class;
+
+   if (unlikely(full_size < size))
+      return NULL;
+
+   if (likely(full_size <= ARENA_MAX_CLASS_SIZE)) {
+      size_class = full_size / ARENA_ALIGN - 1;
+      info = arena->free[size_class];
+
+      if (info != NULL) {
+         arena->free[size_class] = info->next;
+         arena_block_buffer(info)->live++;
+         return info;
+      }
+
+      buffer = arena->current;
+      if (buffer == NULL || buffer->offset + full_size > buffer->size) {
+         buffer = arena_buffer_create(arena, arena->next_buffer_size);
+         if (unlikely(buffer == NULL))
+            return NULL;
+
+         arena->current = buffer;
+         if (arena->next_buffer_size < ARENA_MAX_BUFSIZE)
+            arena->next_buffer_size *= 2;
+      }
+   } else {
+      size_class = ARENA_NO_CLASS;
+      buffer = arena_buffer_create(arena,
+                                   ARENA_BUFFER_HEADER_SIZE + full_size);
+      if (unlikely(buffer == NULL))
+         return NULL;
+   }
+
+   info = (ralloc_header *) ((char *) buffer + buffer->offset);
+   info->flags = ARENA_BLOCK | size_class << ARENA_CLASS_SHIFT |
+                 (unsigned) (buffer->offset / ARENA_ALIGN) << ARENA_OFFSET_SHIFT;
+   buffer->offset += full_size;
+   buffer->live++;
+
+   return info;
+}
+
+/* Moves the block to a bigger one, the caller fixes up the links to it. */
+static ralloc_header *
+arena_resize(ralloc_header *old, size_t size)
+{
+   struct ralloc_arena *arena = arena_block_buffer(old)->arena;
+   size_t old_size = arena_block_size(old) - sizeof(ralloc_header);
+   ralloc_header *info;
+   unsigned flags;
+
+   if (size <= old_size)
+      return old;
+
+   /* Blocks left behind by their arena become regular ralloc blocks. */
+   if (arena != NULL) {
+      info = arena_alloc(arena, size);
+      if (unlikely(info == NULL))
+         return NULL;
+      flags = info->flags | (old->flags & ARENA_ROOT);
+   } else {
+      info = malloc(size + sizeof(ralloc_header));
+      if (unlikely(info == NULL))
+         return NULL;
+      flags = 0;
+   }
+
+   memcpy(info, old, sizeof(ralloc_header) + old_size);
+   info->flags = flags;
+   arena_free(old);
+   return info;
+}
+
+static void
+arena_free(ralloc_header *info)
+{
+   struct arena_buffer *buffer = arena_block_buffer(info);
+   struct ralloc_arena *arena = buffer->arena;
+   unsigned size_class = arena_block_class(info);
+
+   buffer->live--;
+
+   if (arena != NULL && size_class != ARENA_NO_CLASS) {
+      info->next = arena->free[size_class];
+      arena->free[size_class] = info;
+   } else if (buffer->live == 0) {
+      arena_buffer_destroy(buffer);
+   }
+}
+
+static void
+arena_destroy(struct ralloc_arena *arena)
+{
+   struct arena_buffer *buffer = arena->buffers;
+
+   while (buffer != NULL) {
+      struct arena_buffer *next = buffer->next;
+
+      buffer->arena = NULL;
+      if (buffer->live == 0)
+         free(buffer);
+      buffer = next;
+   }
+
+   free(arena);
+}
+
+void *
+ralloc_arena_size(const void *ctx, size_t size)
+{
+   struct ralloc_arena *arena = calloc(1, sizeof(struct ralloc_arena));
+   ralloc_header *info;
+
+   if (unlikely(arena == NULL))
+      return NULL;
+
+   arena->next_buffer_size = ARENA_MIN_BUFSIZE;
+
+   info = arena_alloc(arena, size);
+   if (unlikely(info == NULL)) {
+      free(arena);
+      return NULL;
+   }
+
+   info->flags |= ARENA_ROOT;
+   return init_block(info, ctx != NULL ? get_header(ctx) : NULL);
+}
+
 /***************************************************************************
  * Linear allocator for short-lived allocations.
  ***************************************************************************
@@ -553,8 +859,6 @@ ralloc_vasprintf_rewrite_tail(char **str, size_t *start, const char *fmt,
  * other buffers.
  */
 
-#define ALIGN_POT(x, y) (((x) + (y) - 1) & ~((y) - 1))
-
 #define MIN_LINEAR_BUFSIZE 2048
 #define SUBALLOC_ALIGNMENT sizeof(uintptr_t)
 #define LMAGIC 0x87b9c7d3
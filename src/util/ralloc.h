@@ -91,6 +91,23 @@ extern "C" {
  */
 void *ralloc_context(const void *ctx);
 
+/**
+ * Allocate a new ralloc context whose descendants come out of an arena.
+ *
+ * Everything allocated out of the returned pointer, or out of its
+ * descendants, is carved out of large buffers rather than malloc'd one
+ * block at a time.  The blocks can be freed, stolen and resized as usual:
+ * freed blocks are kept for later allocations of about the same size, and
+ * the buffers are released with the context, or with the last of their
+ * blocks if some were stolen by other contexts.
+ *
+ * Like the rest of a ralloc tree, an arena must not be used from several
+ * threads at once.
+ *
+ * \p size bytes are allocated for the context itself, as with ralloc_size.
+ */
+void *ralloc_arena_size(const void *ctx, size_t size) MALLOCLIKE;
+
 /**
  * Allocate memory chained off of the given context.
  *
@@ -75,6 +75,7 @@
 #include "ralloc.h"
 #include "main/imports.h"
 #include "main/macros.h"
+#include "util/bitscan.h"
 #include "util/bitset.h"
 #include "register_allocate.h"
 
@@ -120,65 +121,6 @@ struct ra_class {
    unsigned int *q;
 };
 
-struct ra_node {
-   /** @{
-    *
-    * List of which nodes this node interferes with.  This should be
-    * symmetric with the other node.
-    */
-   BITSET_WORD *adjacency;
-   unsigned int *adjacency_list;
-   unsigned int adjacency_list_size;
-   unsigned int adjacency_count;
-   /** @} */
-
-   unsigned int class;
-
-   /* Register, if assigned, or NO_REG. */
-   unsigned int reg;
-
-   /**
-    * Set when the node is in the trivially colorable stack.  When
-    * set, the adjacency to this node is ignored, to implement the
-    * "remove the edge from the graph" in simplification without
-    * having to actually modify the adjacency_list.
-    */
-   bool in_stack;
-
-   /**
-    * The q total, as defined in the Runeson/Nyström paper, for all the
-    * interfering nodes not in the stack.
-    */
-   unsigned int q_total;
-
-   /* For an implementation that needs register spilling, this is the
-    * approximate cost of spilling this node.
-    */
-   float spill_cost;
-};
-
-struct ra_graph {
-   struct ra_regs *regs;
-   /**
-    * the variables that need register allocation.
-    */
-   struct ra_node *nodes;
-   unsigned int count; /**< count of nodes. */
-
-   unsigned int *stack;
-   unsigned int stack_count;
-
-   /**
-    * Tracks the start of the set of optimistically-colored registers in the
-    * stack.
-    */
-   unsigned int stack_optimistic_start;
-
-   unsigned int (*select_reg_callback)(struct ra_graph *g, BITSET_WORD *regs,
-                                       void *data);
-   void *select_reg_callback_data;
-};
-
 /**
  * Creates a set of registers for the allocator.
  *
@@ -390,11 +332,309 @@ ra_set_finalize(struct ra_regs *regs, unsigned int **q_values)
    }
 }
 
+struct ra_node {
+   /** @{
+    *
+    * List of which nodes this node interferes with.  This should be
+    * symmetric with the other node.
+    */
+   unsigned int *adjacency_list;
+   unsigned int adjacency_list_size;
+   unsigned int adjacency_count;
+   /** @} */
+
+   unsigned int class;
+
+   /* Register, if assigned, or NO_REG. */
+   unsigned int reg;
+
+   /* Set when the register was forced with ra_set_node_reg(). */
+   bool forced_reg;
+
+   /* Set when the edges of the node are in the edge set of a sparse graph. */
+   bool edges_hashed;
+
+   /**
+    * Set when the node is in the trivially colorable stack.  When
+    * set, the adjacency to this node is ignored, to implement the
+    * "remove the edge from the graph" in simplification without
+    * having to actually modify the adjacency_list.
+    */
+   bool in_stack;
+
+   /**
+    * The q total, as defined in the Runeson/Nyström paper, for all the
+    * interfering nodes.  ra_simplify() works on a copy of it.
+    */
+   unsigned int q_total;
+
+   /* For an implementation that needs register spilling, this is the
+    * approximate cost of spilling this node.
+    */
+   float spill_cost;
+};
+
+/**
+ * Graphs with up to this many nodes keep a bitset of all the possible
+ * interferences for deduplicating them.  Bigger graphs, which tend to be
+ * sparse, look for one node in the adjacency list of the other instead.
+ */
+#define RA_DENSE_MAX_NODES 4096
+
+/**
+ * Scanning a short adjacency list is quicker than a hash lookup missing the
+ * cache, but not a long one: the edges of sparse graph nodes with more
+ * neighbors than this also go into a hash set.
+ */
+#define RA_MAX_SCANNED_NEIGHBORS 128
+
+#define RA_MIN_EDGE_BITS 6
+
+struct ra_graph {
+   struct ra_regs *regs;
+   /**
+    * the variables that need register allocation.
+    */
+   struct ra_node *nodes;
+   unsigned int count; /**< count of nodes. */
+   unsigned int alloc; /**< count of allocated nodes. */
+
+   /**
+    * Lower triangle of the adjacency matrix, see ra_edge_bit().  NULL for
+    * sparse graphs.
+    */
+   BITSET_WORD *adjacency;
+
+   /**
+    * Open-addressing set of the edges of sparse graphs with at least one
+    * node having edges_hashed set, see ra_edge_key().  Zero marks a free
+    * slot.
+    */
+   uint64_t *edges;
+   unsigned int edges_bits;
+   unsigned int edge_count;
+
+   unsigned int *stack;
+   unsigned int stack_count;
+
+   /**
+    * Tracks the start of the set of optimistically-colored registers in the
+    * stack.
+    */
+   unsigned int stack_optimistic_start;
+
+   unsigned int (*select_reg_callback)(struct ra_graph *g, BITSET_WORD *regs,
+                                       void *data);
+   void *select_reg_callback_data;
+};
+
+/** Working state of ra_simplify(). */
+struct ra_simplify_state {
+   /* q_total of each node, minus the nodes already in the stack. */
+   unsigned int *q_total;
+
+   /**
+    * Nodes that pass the pq test but aren't in the stack yet, along with
+    * one bit per non-zero word of it, so that the sweeps over the graph
+    * only visit the nodes they push.
+    */
+   BITSET_WORD *candidates;
+   BITSET_WORD *candidate_words;
+
+   /**
+    * Binary min-heap of the remaining nodes ordered by q_total, built the
+    * first time simplification gets stuck and an optimistic node has to be
+    * chosen.
+    */
+   unsigned int *heap;
+   unsigned int *heap_pos;
+   unsigned int heap_count;
+   bool heap_valid;
+};
+
+static unsigned int
+ra_edge_bit(unsigned int n1, unsigned int n2)
+{
+   unsigned int hi = MAX2(n1, n2), lo = MIN2(n1, n2);
+
+   return hi * (hi - 1) / 2 + lo;
+}
+
+static unsigned int
+ra_adjacency_words(unsigned int count)
+{
+   return MAX2(BITSET_WORDS(ra_edge_bit(count, 0)), 1);
+}
+
+static uint64_t
+ra_edge_key(unsigned int n1, unsigned int n2)
+{
+   /* The bigger node is never 0, so neither is the key. */
+   return ((uint64_t)MAX2(n1, n2) << 32) | MIN2(n1, n2);
+}
+
+static unsigned int
+ra_edge_slot(const struct ra_graph *g, uint64_t key)
+{
+   return (key * 0x9e3779b97f4a7c15ull) >> (64 - g->edges_bits);
+}
+
+/** Returns the slot holding the key, or the free slot it would go to. */
+static unsigned int
+ra_find_edge(const struct ra_graph *g, uint64_t key)
+{
+   unsigned int mask = (1u << g->edges_bits) - 1;
+   unsigned int i = ra_edge_slot(g, key);
+
+   while (g->edges[i] != 0 && g->edges[i] != key)
+      i = (i + 1) & mask;
+
+   return i;
+}
+
+static void
+ra_resize_edges(struct ra_graph *g, unsigned int bits)
+{
+   uint64_t *old_edges = g->edges;
+   unsigned int old_size = old_edges ? 1u << g->edges_bits : 0;
+
+   g->edges = rzalloc_array(g, uint64_t, 1u << bits);
+   g->edges_bits = bits;
+
+   for (unsigned int i = 0; i < old_size; i++) {
+      if (old_edges[i] != 0)
+         g->edges[ra_find_edge(g, old_edges[i])] = old_edges[i];
+   }
+
+   ralloc_free(old_edges);
+}
+
 static void
-ra_add_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
+ra_insert_edge(struct ra_graph *g, uint64_t key, unsigned int i)
+{
+   /* Keep the load factor under 1/2. */
+   if ((g->edge_count + 1) * 2 > 1u << g->edges_bits) {
+      ra_resize_edges(g, g->edges_bits + 1);
+      i = ra_find_edge(g, key);
+   }
+
+   g->edges[i] = key;
+   g->edge_count++;
+}
+
+static void
+ra_remove_edge(struct ra_graph *g, uint64_t key)
 {
-   BITSET_SET(g->nodes[n1].adjacency, n2);
+   unsigned int mask = (1u << g->edges_bits) - 1;
+   unsigned int i = ra_find_edge(g, key);
+   unsigned int j = i;
 
+   assert(g->edges[i] != 0);
+
+   /* Shift back the following keys that can't be found without the
+    * removed one, instead of leaving a tombstone.
+    */
+   for (;;) {
+      j = (j + 1) & mask;
+      if (g->edges[j] == 0)
+         break;
+
+      unsigned int k = ra_edge_slot(g, g->edges[j]);
+      if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+         g->edges[i] = g->edges[j];
+         i = j;
+      }
+   }
+
+   g->edges[i] = 0;
+   g->edge_count--;
+}
+
+static bool
+ra_edge_hashed(const struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   return g->nodes[n1].edges_hashed || g->nodes[n2].edges_hashed;
+}
+
+/**
+ * Adds the edge between the two nodes unless it is already there, returns
+ * whether it was added.  The adjacency lists are left to the caller.
+ */
+static bool
+ra_set_edge(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   if (g->adjacency) {
+      unsigned int bit = ra_edge_bit(n1, n2);
+
+      if (BITSET_TEST(g->adjacency, bit))
+         return false;
+      BITSET_SET(g->adjacency, bit);
+      return true;
+   }
+
+   if (ra_edge_hashed(g, n1, n2)) {
+      uint64_t key = ra_edge_key(n1, n2);
+      unsigned int i = ra_find_edge(g, key);
+
+      if (g->edges[i] == key)
+         return false;
+
+      ra_insert_edge(g, key, i);
+      return true;
+   }
+
+   if (g->nodes[n1].adjacency_count > g->nodes[n2].adjacency_count) {
+      unsigned int tmp = n1;
+      n1 = n2;
+      n2 = tmp;
+   }
+
+   for (unsigned int i = 0; i < g->nodes[n1].adjacency_count; i++) {
+      if (g->nodes[n1].adjacency_list[i] == n2)
+         return false;
+   }
+
+   return true;
+}
+
+static void
+ra_clear_edge(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   if (g->adjacency)
+      BITSET_CLEAR(g->adjacency, ra_edge_bit(n1, n2));
+   else if (ra_edge_hashed(g, n1, n2))
+      ra_remove_edge(g, ra_edge_key(n1, n2));
+}
+
+/**
+ * Moves the edges of a sparse graph node that got too many neighbors for
+ * scanning its adjacency list into the hash set.
+ */
+static void
+ra_update_edges_hashed(struct ra_graph *g, unsigned int n)
+{
+   struct ra_node *node = &g->nodes[n];
+
+   if (g->adjacency || node->edges_hashed ||
+       node->adjacency_count <= RA_MAX_SCANNED_NEIGHBORS)
+      return;
+
+   for (unsigned int i = 0; i < node->adjacency_count; i++) {
+      unsigned int n2 = node->adjacency_list[i];
+
+      /* Already there if the other node is hashed. */
+      if (!g->nodes[n2].edges_hashed) {
+         uint64_t key = ra_edge_key(n, n2);
+         ra_insert_edge(g, key, ra_find_edge(g, key));
+      }
+   }
+
+   node->edges_hashed = true;
+}
+
+static void
+ra_add_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
    assert(n1 != n2);
 
    int n1_class = g->nodes[n1].class;
@@ -403,7 +643,8 @@ ra_add_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
 
    if (g->nodes[n1].adjacency_count >=
        g->nodes[n1].adjacency_list_size) {
-      g->nodes[n1].adjacency_list_size *= 2;
+      g->nodes[n1].adjacency_list_size =
+         MAX2(g->nodes[n1].adjacency_list_size * 2, 4);
       g->nodes[n1].adjacency_list = reralloc(g, g->nodes[n1].adjacency_list,
                                              unsigned int,
                                              g->nodes[n1].adjacency_list_size);
@@ -413,33 +654,100 @@ ra_add_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
    g->nodes[n1].adjacency_count++;
 }
 
+static void
+ra_remove_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   struct ra_node *node = &g->nodes[n1];
+   int n1_class = node->class;
+   int n2_class = g->nodes[n2].class;
+
+   for (unsigned int i = 0; i < node->adjacency_count; i++) {
+      if (node->adjacency_list[i] == n2) {
+         node->adjacency_list[i] =
+            node->adjacency_list[--node->adjacency_count];
+         break;
+      }
+   }
+
+   assert(node->q_total >= g->regs->classes[n1_class]->q[n2_class]);
+   node->q_total -= g->regs->classes[n1_class]->q[n2_class];
+}
+
+static void
+ra_init_nodes(struct ra_graph *g, unsigned int start, unsigned int end)
+{
+   memset(&g->nodes[start], 0, (end - start) * sizeof(struct ra_node));
+
+   for (unsigned int i = start; i < end; i++)
+      g->nodes[i].reg = NO_REG;
+}
+
 struct ra_graph *
 ra_alloc_interference_graph(struct ra_regs *regs, unsigned int count)
 {
    struct ra_graph *g;
-   unsigned int i;
 
    g = rzalloc(NULL, struct ra_graph);
    g->regs = regs;
-   g->nodes = rzalloc_array(g, struct ra_node, count);
+   g->nodes = ralloc_array(g, struct ra_node, count);
    g->count = count;
+   g->alloc = count;
+   ra_init_nodes(g, 0, count);
 
    g->stack = rzalloc_array(g, unsigned int, count);
 
-   for (i = 0; i < count; i++) {
-      int bitset_count = BITSET_WORDS(count);
-      g->nodes[i].adjacency = rzalloc_array(g, BITSET_WORD, bitset_count);
+   if (count <= RA_DENSE_MAX_NODES) {
+      g->adjacency = rzalloc_array(g, BITSET_WORD, ra_adjacency_words(count));
+   } else {
+      ra_resize_edges(g, RA_MIN_EDGE_BITS);
+   }
 
-      g->nodes[i].adjacency_list_size = 4;
-      g->nodes[i].adjacency_list =
-         ralloc_array(g, unsigned int, g->nodes[i].adjacency_list_size);
-      g->nodes[i].adjacency_count = 0;
-      g->nodes[i].q_total = 0;
+   return g;
+}
 
-      g->nodes[i].reg = NO_REG;
+/**
+ * Grows the graph to the given number of nodes, keeping the existing nodes
+ * and their interferences.
+ *
+ * Together with ra_reset_node_interference() this lets a driver update the
+ * graph after spilling instead of building it again: the spilled node loses
+ * its interferences and the new nodes for the short lived fill and spill
+ * temporaries get added at the end.  ra_allocate() can be called again on
+ * the updated graph.
+ */
+void
+ra_resize_interference_graph(struct ra_graph *g, unsigned int count)
+{
+   assert(count >= g->count);
+
+   if (count > g->alloc) {
+      unsigned int alloc = MAX2(count, g->alloc * 2);
+
+      g->nodes = reralloc(g, g->nodes, struct ra_node, alloc);
+      g->stack = reralloc(g, g->stack, unsigned int, alloc);
+      g->alloc = alloc;
    }
 
-   return g;
+   ra_init_nodes(g, g->count, count);
+
+   if (g->adjacency && count > RA_DENSE_MAX_NODES) {
+      /* Switch to the sparse representation. */
+      ralloc_free(g->adjacency);
+      g->adjacency = NULL;
+      ra_resize_edges(g, RA_MIN_EDGE_BITS);
+
+      for (unsigned int n = 0; n < g->count; n++)
+         ra_update_edges_hashed(g, n);
+   } else if (g->adjacency) {
+      unsigned int old_words = ra_adjacency_words(g->count);
+      unsigned int new_words = ra_adjacency_words(count);
+
+      g->adjacency = reralloc(g, g->adjacency, BITSET_WORD, new_words);
+      memset(g->adjacency + old_words, 0,
+             (new_words - old_words) * sizeof(BITSET_WORD));
+   }
+
+   g->count = count;
 }
 
 void ra_set_select_reg_callback(struct ra_graph *g,
@@ -463,22 +771,187 @@ void
 ra_add_node_interference(struct ra_graph *g,
                          unsigned int n1, unsigned int n2)
 {
-   if (n1 != n2 && !BITSET_TEST(g->nodes[n1].adjacency, n2)) {
+   if (n1 != n2 && ra_set_edge(g, n1, n2)) {
       ra_add_node_adjacency(g, n1, n2);
       ra_add_node_adjacency(g, n2, n1);
+      ra_update_edges_hashed(g, n1);
+      ra_update_edges_hashed(g, n2);
+   }
+}
+
+/**
+ * Removes all the interferences of the given node, see
+ * ra_resize_interference_graph().
+ */
+void
+ra_reset_node_interference(struct ra_graph *g, unsigned int n)
+{
+   struct ra_node *node = &g->nodes[n];
+
+   for (unsigned int i = 0; i < node->adjacency_count; i++) {
+      unsigned int n2 = node->adjacency_list[i];
+
+      ra_clear_edge(g, n, n2);
+      ra_remove_node_adjacency(g, n2, n);
    }
+
+   node->adjacency_count = 0;
+   node->q_total = 0;
 }
 
 static bool
-pq_test(struct ra_graph *g, unsigned int n)
+pq_test(struct ra_graph *g, struct ra_simplify_state *s, unsigned int n)
 {
    int n_class = g->nodes[n].class;
 
-   return g->nodes[n].q_total < g->regs->classes[n_class]->p;
+   return s->q_total[n] < g->regs->classes[n_class]->p;
+}
+
+static void
+ra_set_candidate(struct ra_simplify_state *s, unsigned int n)
+{
+   BITSET_SET(s->candidates, n);
+   BITSET_SET(s->candidate_words, BITSET_BITWORD(n));
+}
+
+static void
+ra_clear_candidate(struct ra_simplify_state *s, unsigned int n)
+{
+   BITSET_CLEAR(s->candidates, n);
+   if (s->candidates[BITSET_BITWORD(n)] == 0)
+      BITSET_CLEAR(s->candidate_words, BITSET_BITWORD(n));
+}
+
+static BITSET_WORD
+ra_bits_up_to(BITSET_WORD word, unsigned int bit)
+{
+   return word & (~0u >> (BITSET_WORDBITS - 1 - bit));
+}
+
+/**
+ * Returns the highest numbered candidate below end, or -1 if there is
+ * none.
+ */
+static int
+ra_prev_candidate(const struct ra_simplify_state *s, unsigned int end)
+{
+   unsigned int w, sw;
+   BITSET_WORD bits;
+
+   if (end == 0)
+      return -1;
+
+   w = BITSET_BITWORD(end - 1);
+   bits = ra_bits_up_to(s->candidates[w], (end - 1) % BITSET_WORDBITS);
+   if (bits)
+      return w * BITSET_WORDBITS + util_last_bit(bits) - 1;
+
+   if (w == 0)
+      return -1;
+
+   sw = BITSET_BITWORD(w - 1);
+   bits = ra_bits_up_to(s->candidate_words[sw], (w - 1) % BITSET_WORDBITS);
+   while (!bits) {
+      if (sw == 0)
+         return -1;
+      bits = s->candidate_words[--sw];
+   }
+
+   w = sw * BITSET_WORDBITS + util_last_bit(bits) - 1;
+   return w * BITSET_WORDBITS + util_last_bit(s->candidates[w]) - 1;
+}
+
+/* The heap orders by q_total, then prefers the highest numbered node, which
+ * is the node the former linear search over the graph would find.
+ */
+static bool
+ra_heap_less(const struct ra_simplify_state *s, unsigned int a, unsigned int b)
+{
+   return s->q_total[a] < s->q_total[b] ||
+          (s->q_total[a] == s->q_total[b] && a > b);
+}
+
+static void
+ra_heap_swap(struct ra_simplify_state *s, unsigned int i, unsigned int j)
+{
+   unsigned int a = s->heap[i], b = s->heap[j];
+
+   s->heap[i] = b;
+   s->heap[j] = a;
+   s->heap_pos[b] = i;
+   s->heap_pos[a] = j;
+}
+
+static void
+ra_heap_up(struct ra_simplify_state *s, unsigned int i)
+{
+   while (i > 0 && ra_heap_less(s, s->heap[i], s->heap[(i - 1) / 2])) {
+      ra_heap_swap(s, i, (i - 1) / 2);
+      i = (i - 1) / 2;
+   }
+}
+
+static void
+ra_heap_down(struct ra_simplify_state *s, unsigned int i)
+{
+   for (;;) {
+      unsigned int best = i;
+      unsigned int l = 2 * i + 1, r = 2 * i + 2;
+
+      if (l < s->heap_count && ra_heap_less(s, s->heap[l], s->heap[best]))
+         best = l;
+      if (r < s->heap_count && ra_heap_less(s, s->heap[r], s->heap[best]))
+         best = r;
+      if (best == i)
+         return;
+
+      ra_heap_swap(s, i, best);
+      i = best;
+   }
+}
+
+static void
+ra_heap_remove(struct ra_simplify_state *s, unsigned int n)
+{
+   unsigned int i = s->heap_pos[n];
+
+   if (i == NO_REG)
+      return;
+
+   s->heap_pos[n] = NO_REG;
+   s->heap_count--;
+   if (i == s->heap_count)
+      return;
+
+   unsigned int moved = s->heap[s->heap_count];
+   s->heap[i] = moved;
+   s->heap_pos[moved] = i;
+   ra_heap_up(s, i);
+   ra_heap_down(s, s->heap_pos[moved]);
+}
+
+static void
+ra_heap_build(struct ra_graph *g, struct ra_simplify_state *s)
+{
+   s->heap_count = 0;
+   for (unsigned int i = 0; i < g->count; i++) {
+      if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG) {
+         s->heap_pos[i] = NO_REG;
+         continue;
+      }
+
+      s->heap_pos[i] = s->heap_count;
+      s->heap[s->heap_count++] = i;
+   }
+
+   for (unsigned int i = s->heap_count / 2; i-- > 0;)
+      ra_heap_down(s, i);
+
+   s->heap_valid = true;
 }
 
 static void
-decrement_q(struct ra_graph *g, unsigned int n)
+decrement_q(struct ra_graph *g, struct ra_simplify_state *s, unsigned int n)
 {
    unsigned int i;
    int n_class = g->nodes[n].class;
@@ -488,12 +961,32 @@ decrement_q(struct ra_graph *g, unsigned int n)
       unsigned int n2_class = g->nodes[n2].class;
 
       if (!g->nodes[n2].in_stack) {
-         assert(g->nodes[n2].q_total >= g->regs->classes[n2_class]->q[n_class]);
-         g->nodes[n2].q_total -= g->regs->classes[n2_class]->q[n_class];
+         assert(s->q_total[n2] >= g->regs->classes[n2_class]->q[n_class]);
+         s->q_total[n2] -= g->regs->classes[n2_class]->q[n_class];
+
+         if (g->nodes[n2].reg != NO_REG)
+            continue;
+
+         if (pq_test(g, s, n2))
+            ra_set_candidate(s, n2);
+         if (s->heap_valid && s->heap_pos[n2] != NO_REG)
+            ra_heap_up(s, s->heap_pos[n2]);
       }
    }
 }
 
+static void
+ra_push(struct ra_graph *g, struct ra_simplify_state *s, unsigned int n)
+{
+   ra_clear_candidate(s, n);
+   if (s->heap_valid)
+      ra_heap_remove(s, n);
+
+   g->nodes[n].in_stack = true;
+   g->stack[g->stack_count++] = n;
+   decrement_q(g, s, n);
+}
+
 /**
  * Simplifies the interference graph by pushing all
  * trivially-colorable nodes into a stack of nodes to be colored,
@@ -503,52 +996,64 @@ decrement_q(struct ra_graph *g, unsigned int n)
  * we optimistically choose a node and push it on the stack. We heuristically
  * push the node with the lowest total q value, since it has the fewest
  * neighbors and therefore is most likely to be allocated.
+ *
+ * Each pass goes from the highest to the lowest numbered node, but only
+ * visits the nodes passing the pq test, so the whole simplification is
+ * roughly linear in the size of the graph.
  */
 static void
 ra_simplify(struct ra_graph *g)
 {
-   bool progress = true;
+   struct ra_simplify_state s;
    unsigned int stack_optimistic_start = UINT_MAX;
-   int i;
-
-   while (progress) {
-      unsigned int best_optimistic_node = ~0;
-      unsigned int lowest_q_total = ~0;
-
-      progress = false;
-
-      for (i = g->count - 1; i >= 0; i--) {
-	 if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG)
-	    continue;
-
-	 if (pq_test(g, i)) {
-	    decrement_q(g, i);
-	    g->stack[g->stack_count] = i;
-	    g->stack_count++;
-	    g->nodes[i].in_stack = true;
-	    progress = true;
-	 } else {
-	    unsigned int new_q_total = g->nodes[i].q_total;
-	    if (new_q_total < lowest_q_total) {
-	       best_optimistic_node = i;
-	       lowest_q_total = new_q_total;
-	    }
-	 }
-      }
+   unsigned int words = BITSET_WORDS(g->count);
+   unsigned int i;
+
+   s.q_total = ralloc_array(g, unsigned int, g->count);
+   s.candidates = rzalloc_array(g, BITSET_WORD, words);
+   s.candidate_words = rzalloc_array(g, BITSET_WORD, BITSET_WORDS(words));
+   s.heap = ralloc_array(g, unsigned int, g->count);
+   s.heap_pos = ralloc_array(g, unsigned int, g->count);
+   s.heap_count = 0;
+   s.heap_valid = false;
 
-      if (!progress && best_optimistic_node != ~0U) {
-         if (stack_optimistic_start == UINT_MAX)
-            stack_optimistic_start = g->stack_count;
+   for (i = 0; i < g->count; i++) {
+      s.q_total[i] = g->nodes[i].q_total;
+
+      if (g->nodes[i].reg == NO_REG && pq_test(g, &s, i))
+         ra_set_candidate(&s, i);
+   }
 
-	 decrement_q(g, best_optimistic_node);
-	 g->stack[g->stack_count] = best_optimistic_node;
-	 g->stack_count++;
-	 g->nodes[best_optimistic_node].in_stack = true;
-	 progress = true;
+   for (;;) {
+      int n = ra_prev_candidate(&s, g->count);
+
+      if (n >= 0) {
+         do {
+            ra_push(g, &s, n);
+            n = ra_prev_candidate(&s, n);
+         } while (n >= 0);
+         continue;
       }
+
+      if (!s.heap_valid)
+         ra_heap_build(g, &s);
+
+      if (s.heap_count == 0)
+         break;
+
+      if (stack_optimistic_start == UINT_MAX)
+         stack_optimistic_start = g->stack_count;
+
+      ra_push(g, &s, s.heap[0]);
    }
 
    g->stack_optimistic_start = stack_optimistic_start;
+
+   ralloc_free(s.q_total);
+   ralloc_free(s.candidates);
+   ralloc_free(s.candidate_words);
+   ralloc_free(s.heap);
+   ralloc_free(s.heap_pos);
 }
 
 static bool
@@ -679,6 +1184,16 @@ ra_select(struct ra_graph *g)
 bool
 ra_allocate(struct ra_graph *g)
 {
+   /* Start over from the forced registers, in case the graph was updated
+    * after a failed allocation.
+    */
+   for (unsigned int i = 0; i < g->count; i++) {
+      if (!g->nodes[i].forced_reg)
+         g->nodes[i].reg = NO_REG;
+      g->nodes[i].in_stack = false;
+   }
+   g->stack_count = 0;
+
    ra_simplify(g);
    return ra_select(g);
 }
@@ -706,6 +1221,7 @@ void
 ra_set_node_reg(struct ra_graph *g, unsigned int n, unsigned int reg)
 {
    g->nodes[n].reg = reg;
+   g->nodes[n].forced_reg = reg != NO_REG;
    g->nodes[n].in_stack = false;
 }
 
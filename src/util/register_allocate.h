@@ -82,6 +82,8 @@ void ra_set_select_reg_callback(struct ra_graph *g,
                                 void *data);
 void ra_add_node_interference(struct ra_graph *g,
 			      unsigned int n1, unsigned int n2);
+void ra_resize_interference_graph(struct ra_graph *g, unsigned int count);
+void ra_reset_node_interference(struct ra_graph *g, unsigned int n);
 /** @} */
 
 /** @{ Graph-coloring register allocation */
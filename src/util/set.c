@@ -36,70 +36,93 @@
 #include <assert.h>
 
 #include "macros.h"
+#include "hash_group.h"
+#include "hash_table.h"
 #include "ralloc.h"
 #include "set.h"
 
-/*
- * From Knuth -- a good choice for hash/rehash values is p, p-2 where
- * p and p-2 are both prime.  These tables are sized to have an extra 10%
- * free to avoid exponential performance degradation as the hash table fills
- */
+#define MIN_SIZE 8
+
+/* Keep the set at most 7/8 full, counting tombstones. */
+static uint32_t
+max_entries_for_size(uint32_t size)
+{
+   return size - size / 8;
+}
 
-static const uint32_t deleted_key_value;
-static const void *deleted_key = &deleted_key_value;
-
-static const struct {
-   uint32_t max_entries, size, rehash;
-} hash_sizes[] = {
-   { 2,            5,            3            },
-   { 4,            7,            5            },
-   { 8,            13,           11           },
-   { 16,           19,           17           },
-   { 32,           43,           41           },
-   { 64,           73,           71           },
-   { 128,          151,          149          },
-   { 256,          283,          281          },
-   { 512,          571,          569          },
-   { 1024,         1153,         1151         },
-   { 2048,         2269,         2267         },
-   { 4096,         4519,         4517         },
-   { 8192,         9013,         9011         },
-   { 16384,        18043,        18041        },
-   { 32768,        36109,        36107        },
-   { 65536,        72091,        72089        },
-   { 131072,       144409,       144407       },
-   { 262144,       288361,       288359       },
-   { 524288,       576883,       576881       },
-   { 1048576,      1153459,      1153457      },
-   { 2097152,      2307163,      2307161      },
-   { 4194304,      4613893,      4613891      },
-   { 8388608,      9227641,      9227639      },
-   { 16777216,     18455029,     18455027     },
-   { 33554432,     36911011,     36911009     },
-   { 67108864,     73819861,     73819859     },
-   { 134217728,    147639589,    147639587    },
-   { 268435456,    295279081,    295279079    },
-   { 536870912,    590559793,    590559791    },
-   { 1073741824,   1181116273,   1181116271   },
-   { 2147483648ul, 2362232233ul, 2362232231ul }
+/**
+ * Comparisons that the probe loops know how to do without calling through
+ * key_equals_function.
+ */
+enum key_kind {
+   KEY_GENERIC,
+   KEY_POINTER,
+   KEY_U32,
 };
 
-static int
-entry_is_free(struct set_entry *entry)
+static inline enum key_kind
+set_key_kind(const struct set *ht)
 {
-   return entry->key == NULL;
+   if (ht->key_equals_function == _mesa_key_pointer_equal)
+      return KEY_POINTER;
+   if (ht->key_equals_function == _mesa_key_u32_equal)
+      return KEY_U32;
+   return KEY_GENERIC;
 }
 
-static int
-entry_is_deleted(struct set_entry *entry)
+static ALWAYS_INLINE bool
+set_keys_equal(const struct set *ht, enum key_kind kind,
+               const void *a, const void *b)
 {
-   return entry->key == deleted_key;
+   switch (kind) {
+   case KEY_POINTER:
+      return a == b;
+   case KEY_U32:
+      return *(const uint32_t *)a == *(const uint32_t *)b;
+   default:
+      return ht->key_equals_function(a, b);
+   }
 }
 
-static int
-entry_is_present(struct set_entry *entry)
+static inline uint32_t
+set_hash_key(const struct set *ht, const void *key)
 {
-   return entry->key != NULL && entry->key != deleted_key;
+   /* _mesa_hash_pointer() is inline, so this only catches the sets made by
+    * _mesa_pointer_set_create().
+    */
+   if (ht->key_hash_function == _mesa_hash_pointer)
+      return _mesa_hash_pointer(key);
+   if (ht->key_hash_function == _mesa_hash_u32)
+      return _mesa_hash_u32(key);
+   return ht->key_hash_function(key);
+}
+
+static bool
+set_alloc(struct set *ht, uint32_t size)
+{
+   struct set_entry *table;
+   uint8_t *ctrl;
+
+   table = ralloc_array(ht, struct set_entry, size);
+   if (table == NULL)
+      return false;
+
+   ctrl = ralloc_array(ht, uint8_t, hash_group_ctrl_size(size));
+   if (ctrl == NULL) {
+      ralloc_free(table);
+      return false;
+   }
+
+   hash_group_ctrl_reset(ctrl, size);
+
+   ht->table = table;
+   ht->ctrl = ctrl;
+   ht->size = size;
+   ht->max_entries = max_entries_for_size(size);
+   ht->entries = 0;
+   ht->deleted_entries = 0;
+
+   return true;
 }
 
 struct set *
@@ -114,17 +137,11 @@ _mesa_set_create(void *mem_ctx,
    if (ht == NULL)
       return NULL;
 
-   ht->size_index = 0;
-   ht->size = hash_sizes[ht->size_index].size;
-   ht->rehash = hash_sizes[ht->size_index].rehash;
-   ht->max_entries = hash_sizes[ht->size_index].max_entries;
+   ht->mem_ctx = mem_ctx;
    ht->key_hash_function = key_hash_function;
    ht->key_equals_function = key_equals_function;
-   ht->table = rzalloc_array(ht, struct set_entry, ht->size);
-   ht->entries = 0;
-   ht->deleted_entries = 0;
 
-   if (ht->table == NULL) {
+   if (!set_alloc(ht, MIN_SIZE)) {
       ralloc_free(ht);
       return NULL;
    }
@@ -132,6 +149,16 @@ _mesa_set_create(void *mem_ctx,
    return ht;
 }
 
+/**
+ * Creates a set of pointer values, hashing and comparing the keys inline.
+ */
+struct set *
+_mesa_pointer_set_create(void *mem_ctx)
+{
+   return _mesa_set_create(mem_ctx, _mesa_hash_pointer,
+                           _mesa_key_pointer_equal);
+}
+
 /**
  * Frees the given set.
  *
@@ -152,6 +179,7 @@ _mesa_set_destroy(struct set *ht, void (*delete_function)(struct set_entry *entr
       }
    }
    ralloc_free(ht->table);
+   ralloc_free(ht->ctrl);
    ralloc_free(ht);
 }
 
@@ -169,12 +197,13 @@ _mesa_set_clear(struct set *set, void (*delete_function)(struct set_entry *entry
    if (!set)
       return;
 
-   set_foreach (set, entry) {
-      if (delete_function)
+   if (delete_function) {
+      set_foreach (set, entry) {
          delete_function(entry);
-      entry->key = deleted_key;
+      }
    }
 
+   hash_group_ctrl_reset(set->ctrl, set->size);
    set->entries = set->deleted_entries = 0;
 }
 
@@ -183,38 +212,56 @@ _mesa_set_clear(struct set *set, void (*delete_function)(struct set_entry *entry
  *
  * Returns NULL if no entry is found.
  */
-static struct set_entry *
-set_search(const struct set *ht, uint32_t hash, const void *key)
+static ALWAYS_INLINE struct set_entry *
+set_search_kind(const struct set *ht, uint32_t hash, const void *key,
+                enum key_kind kind)
 {
-   uint32_t hash_address;
-
-   hash_address = hash % ht->size;
-   do {
-      uint32_t double_hash;
-
-      struct set_entry *entry = ht->table + hash_address;
-
-      if (entry_is_free(entry)) {
-         return NULL;
-      } else if (entry_is_present(entry) && entry->hash == hash) {
-         if (ht->key_equals_function(key, entry->key)) {
+   const uint32_t mixed = hash_group_mix(hash);
+   const uint8_t h2 = hash_group_h2(mixed);
+   const uint32_t group_mask = hash_group_index_mask(ht->size);
+   uint32_t group = mixed & group_mask;
+
+   for (uint32_t i = 1; i <= group_mask + 1; i++) {
+      const uint32_t base = group * HASH_GROUP_WIDTH;
+      const hash_group g = hash_group_load(ht->ctrl + base);
+      hash_group_mask match = hash_group_match(g, h2);
+
+      while (match) {
+         struct set_entry *entry =
+            ht->table + base + hash_group_mask_next(&match);
+
+         if (entry->hash == hash &&
+             set_keys_equal(ht, kind, key, entry->key))
             return entry;
-         }
       }
 
-      double_hash = 1 + hash % ht->rehash;
+      if (hash_group_match_empty(g))
+         return NULL;
 
-      hash_address = (hash_address + double_hash) % ht->size;
-   } while (hash_address != hash % ht->size);
+      group = (group + i) & group_mask;
+   }
 
    return NULL;
 }
 
+static struct set_entry *
+set_search(const struct set *ht, uint32_t hash, const void *key)
+{
+   switch (set_key_kind(ht)) {
+   case KEY_POINTER:
+      return set_search_kind(ht, hash, key, KEY_POINTER);
+   case KEY_U32:
+      return set_search_kind(ht, hash, key, KEY_U32);
+   default:
+      return set_search_kind(ht, hash, key, KEY_GENERIC);
+   }
+}
+
 struct set_entry *
 _mesa_set_search(const struct set *set, const void *key)
 {
    assert(set->key_hash_function);
-   return set_search(set, set->key_hash_function(key), key);
+   return set_search(set, set_hash_key(set, key), key);
 }
 
 struct set_entry *
@@ -226,38 +273,57 @@ _mesa_set_search_pre_hashed(const struct set *set, uint32_t hash,
    return set_search(set, hash, key);
 }
 
-static struct set_entry *
-set_add(struct set *ht, uint32_t hash, const void *key);
+/**
+ * Returns the first free slot along the probe sequence of the hash.  The
+ * caller must make sure that the set isn't full.
+ */
+static uint32_t
+set_find_free(const struct set *ht, uint32_t mixed)
+{
+   const uint32_t group_mask = hash_group_index_mask(ht->size);
+   uint32_t group = mixed & group_mask;
+
+   for (uint32_t i = 1;; i++) {
+      const uint32_t base = group * HASH_GROUP_WIDTH;
+      hash_group_mask free =
+         hash_group_match_empty_or_deleted(hash_group_load(ht->ctrl + base));
+
+      if (free)
+         return base + hash_group_mask_first(free);
+
+      group = (group + i) & group_mask;
+   }
+}
 
 static void
-set_rehash(struct set *ht, unsigned new_size_index)
+set_rehash(struct set *ht, uint32_t new_size)
 {
    struct set old_ht;
-   struct set_entry *table, *entry;
 
-   if (new_size_index >= ARRAY_SIZE(hash_sizes))
+   if (new_size == 0)
       return;
 
-   table = rzalloc_array(ht, struct set_entry,
-                         hash_sizes[new_size_index].size);
-   if (table == NULL)
+   old_ht = *ht;
+
+   if (!set_alloc(ht, new_size))
       return;
 
-   old_ht = *ht;
+   /* The keys are known to be distinct, so skip the lookup. */
+   for (uint32_t i = 0; i < old_ht.size; i++) {
+      if (!hash_ctrl_is_full(old_ht.ctrl[i]))
+         continue;
 
-   ht->table = table;
-   ht->size_index = new_size_index;
-   ht->size = hash_sizes[ht->size_index].size;
-   ht->rehash = hash_sizes[ht->size_index].rehash;
-   ht->max_entries = hash_sizes[ht->size_index].max_entries;
-   ht->entries = 0;
-   ht->deleted_entries = 0;
+      const struct set_entry *old_entry = old_ht.table + i;
+      const uint32_t mixed = hash_group_mix(old_entry->hash);
+      const uint32_t index = set_find_free(ht, mixed);
 
-   set_foreach(&old_ht, entry) {
-      set_add(ht, entry->hash, entry->key);
+      ht->ctrl[index] = hash_group_h2(mixed);
+      ht->table[index] = *old_entry;
    }
+   ht->entries = old_ht.entries;
 
    ralloc_free(old_ht.table);
+   ralloc_free(old_ht.ctrl);
 }
 
 /**
@@ -266,73 +332,72 @@ set_rehash(struct set *ht, unsigned new_size_index)
  * Note that insertion may rearrange the table on a resize or rehash,
  * so previously found hash_entries are no longer valid after this function.
  */
-static struct set_entry *
-set_add(struct set *ht, uint32_t hash, const void *key)
+static ALWAYS_INLINE struct set_entry *
+set_add_kind(struct set *ht, uint32_t hash, const void *key,
+             enum key_kind kind)
 {
-   uint32_t hash_address;
-   struct set_entry *available_entry = NULL;
+   struct set_entry *entry;
+   uint32_t mixed, index;
 
    if (ht->entries >= ht->max_entries) {
-      set_rehash(ht, ht->size_index + 1);
+      set_rehash(ht, ht->size * 2);
    } else if (ht->deleted_entries + ht->entries >= ht->max_entries) {
-      set_rehash(ht, ht->size_index);
+      set_rehash(ht, ht->size);
    }
 
-   hash_address = hash % ht->size;
-   do {
-      struct set_entry *entry = ht->table + hash_address;
-      uint32_t double_hash;
-
-      if (!entry_is_present(entry)) {
-         /* Stash the first available entry we find */
-         if (available_entry == NULL)
-            available_entry = entry;
-         if (entry_is_free(entry))
-            break;
-      }
-
-      /* Implement replacement when another insert happens
-       * with a matching key.  This is a relatively common
-       * feature of hash tables, with the alternative
-       * generally being "insert the new value as well, and
-       * return it first when the key is searched for".
-       *
-       * Note that the hash table doesn't have a delete callback.
-       * If freeing of old keys is required to avoid memory leaks,
-       * perform a search before inserting.
-       */
-      if (!entry_is_deleted(entry) &&
-          entry->hash == hash &&
-          ht->key_equals_function(key, entry->key)) {
-         entry->key = key;
-         return entry;
-      }
+   /* We could hit this if a required resize failed. An unchecked-malloc
+    * application could ignore this result.
+    */
+   if (ht->deleted_entries + ht->entries >= ht->size)
+      return NULL;
 
-      double_hash = 1 + hash % ht->rehash;
+   /* Implement replacement when another insert happens
+    * with a matching key.  This is a relatively common
+    * feature of hash tables, with the alternative
+    * generally being "insert the new value as well, and
+    * return it first when the key is searched for".
+    *
+    * Note that the hash table doesn't have a delete callback.
+    * If freeing of old keys is required to avoid memory leaks,
+    * perform a search before inserting.
+    */
+   entry = set_search_kind(ht, hash, key, kind);
+   if (entry) {
+      entry->key = key;
+      return entry;
+   }
 
-      hash_address = (hash_address + double_hash) % ht->size;
-   } while (hash_address != hash % ht->size);
+   mixed = hash_group_mix(hash);
+   index = set_find_free(ht, mixed);
+   if (ht->ctrl[index] == HASH_CTRL_DELETED)
+      ht->deleted_entries--;
+   ht->ctrl[index] = hash_group_h2(mixed);
+
+   entry = ht->table + index;
+   entry->hash = hash;
+   entry->key = key;
+   ht->entries++;
+   return entry;
+}
 
-   if (available_entry) {
-      if (entry_is_deleted(available_entry))
-         ht->deleted_entries--;
-      available_entry->hash = hash;
-      available_entry->key = key;
-      ht->entries++;
-      return available_entry;
+static struct set_entry *
+set_add(struct set *ht, uint32_t hash, const void *key)
+{
+   switch (set_key_kind(ht)) {
+   case KEY_POINTER:
+      return set_add_kind(ht, hash, key, KEY_POINTER);
+   case KEY_U32:
+      return set_add_kind(ht, hash, key, KEY_U32);
+   default:
+      return set_add_kind(ht, hash, key, KEY_GENERIC);
    }
-
-   /* We could hit here if a required resize failed. An unchecked-malloc
-    * application could ignore this result.
-    */
-   return NULL;
 }
 
 struct set_entry *
 _mesa_set_add(struct set *set, const void *key)
 {
    assert(set->key_hash_function);
-   return set_add(set, set->key_hash_function(key), key);
+   return set_add(set, set_hash_key(set, key), key);
 }
 
 struct set_entry *
@@ -352,12 +417,18 @@ _mesa_set_add_pre_hashed(struct set *set, uint32_t hash, const void *key)
 void
 _mesa_set_remove(struct set *ht, struct set_entry *entry)
 {
+   uint32_t index;
+
    if (!entry)
       return;
 
-   entry->key = deleted_key;
+   index = entry - ht->table;
+   assert(hash_ctrl_is_full(ht->ctrl[index]));
+
+   ht->ctrl[index] = hash_group_removed_ctrl(ht->ctrl, index);
+   if (ht->ctrl[index] == HASH_CTRL_DELETED)
+      ht->deleted_entries++;
    ht->entries--;
-   ht->deleted_entries++;
 }
 
 /**
@@ -369,15 +440,11 @@ _mesa_set_remove(struct set *ht, struct set_entry *entry)
 struct set_entry *
 _mesa_set_next_entry(const struct set *ht, struct set_entry *entry)
 {
-   if (entry == NULL)
-      entry = ht->table;
-   else
-      entry = entry + 1;
+   uint32_t i = entry == NULL ? 0 : entry - ht->table + 1;
 
-   for (; entry != ht->table + ht->size; entry++) {
-      if (entry_is_present(entry)) {
-         return entry;
-      }
+   for (; i < ht->size; i++) {
+      if (hash_ctrl_is_full(ht->ctrl[i]))
+         return ht->table + i;
    }
 
    return NULL;
@@ -387,21 +454,16 @@ struct set_entry *
 _mesa_set_random_entry(struct set *ht,
                        int (*predicate)(struct set_entry *entry))
 {
-   struct set_entry *entry;
-   uint32_t i = rand() % ht->size;
+   uint32_t start = rand() % ht->size;
 
    if (ht->entries == 0)
       return NULL;
 
-   for (entry = ht->table + i; entry != ht->table + ht->size; entry++) {
-      if (entry_is_present(entry) &&
-          (!predicate || predicate(entry))) {
-         return entry;
-      }
-   }
+   for (uint32_t n = 0; n < ht->size; n++) {
+      uint32_t i = (start + n) & (ht->size - 1);
+      struct set_entry *entry = ht->table + i;
 
-   for (entry = ht->table; entry != ht->table + i; entry++) {
-      if (entry_is_present(entry) &&
+      if (hash_ctrl_is_full(ht->ctrl[i]) &&
           (!predicate || predicate(entry))) {
          return entry;
       }
@@ -40,15 +40,18 @@ struct set_entry {
    const void *key;
 };
 
+/**
+ * Open-addressing set with one control byte per entry, see hash_group.h.
+ * The size is always a power of two.
+ */
 struct set {
    void *mem_ctx;
    struct set_entry *table;
+   uint8_t *ctrl;
    uint32_t (*key_hash_function)(const void *key);
    bool (*key_equals_function)(const void *a, const void *b);
    uint32_t size;
-   uint32_t rehash;
    uint32_t max_entries;
-   uint32_t size_index;
    uint32_t entries;
    uint32_t deleted_entries;
 };
@@ -58,6 +61,8 @@ _mesa_set_create(void *mem_ctx,
                  uint32_t (*key_hash_function)(const void *key),
                  bool (*key_equals_function)(const void *a,
                                              const void *b));
+struct set *
+_mesa_pointer_set_create(void *mem_ctx);
 void
 _mesa_set_destroy(struct set *set,
                   void (*delete_function)(struct set_entry *entry));
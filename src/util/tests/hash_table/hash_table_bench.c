@@ -0,0 +1,162 @@
+/*
+ * Copyright © 2026 The Mesa Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Not a test, replays hash table and set operations shaped like the ones
+ * the shader compilers do and reports the time per operation.
+ *
+ * The operation mix is synthesized rather than recorded: each "shader" is
+ * a number of instructions allocated from one array, which get cloned
+ * through a pointer remap table, collected into small per-block sets,
+ * tracked in a u32 keyed liveness table that is cleared per block, named
+ * through a string table and finally half removed while iterating, as dead
+ * code elimination would.
+ *
+ * Usage: hash_table_bench [num_shaders] [instructions_per_shader]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util/hash_table.h"
+#include "util/os_time.h"
+#include "util/ralloc.h"
+#include "util/set.h"
+
+struct instr {
+   uint32_t index;
+   char name[16];
+   uint64_t pad[4];
+};
+
+static uint64_t num_ops;
+static uintptr_t sink;
+
+static void
+run_shader(struct instr *instrs, unsigned num_instrs)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   struct hash_table *remap = _mesa_pointer_hash_table_create(mem_ctx);
+   struct hash_table *live =
+      _mesa_hash_table_create(mem_ctx, _mesa_hash_u32, _mesa_key_u32_equal);
+   struct hash_table *names =
+      _mesa_hash_table_create(mem_ctx, _mesa_key_hash_string,
+                              _mesa_key_string_equal);
+   struct set *visited = _mesa_pointer_set_create(mem_ctx);
+   struct hash_entry *entry;
+
+   /* Clone: every instruction is added once and looked up by each of its
+    * users, mostly close by.
+    */
+   for (unsigned i = 0; i < num_instrs; i++) {
+      _mesa_hash_table_insert(remap, &instrs[i], &instrs[num_instrs - i - 1]);
+      for (unsigned s = 1; s <= 3 && s * s <= i; s++) {
+         entry = _mesa_hash_table_search(remap, &instrs[i - s * s]);
+         sink += (uintptr_t)entry->data;
+      }
+      num_ops += 4;
+   }
+
+   /* Blocks of 1 to 32 instructions with a predecessor set each, plus a
+    * liveness table cleared at every block boundary.
+    */
+   for (unsigned i = 0; i < num_instrs;) {
+      unsigned block_size = 1 + (instrs[i].index * 7) % 32;
+      struct set *preds = _mesa_pointer_set_create(mem_ctx);
+
+      for (unsigned p = 0; p < 1 + block_size % 3; p++)
+         _mesa_set_add(preds, &instrs[(i + p * 17) % num_instrs]);
+      num_ops += 1 + block_size % 3;
+
+      _mesa_hash_table_clear(live, NULL);
+      for (unsigned j = i; j < i + block_size && j < num_instrs; j++) {
+         _mesa_hash_table_insert(live, &instrs[j].index, &instrs[j]);
+         if (j > i && _mesa_hash_table_search(live, &instrs[j - 1].index))
+            sink++;
+         if (_mesa_set_search(visited, &instrs[j]) == NULL)
+            _mesa_set_add(visited, &instrs[j]);
+         num_ops += 4;
+      }
+
+      _mesa_set_destroy(preds, NULL);
+      i += block_size;
+   }
+
+   /* Variable names, one in eight instructions declares one. */
+   for (unsigned i = 0; i < num_instrs; i += 8) {
+      _mesa_hash_table_insert(names, instrs[i].name, &instrs[i]);
+      num_ops++;
+   }
+   for (unsigned i = 0; i < num_instrs; i += 4) {
+      entry = _mesa_hash_table_search(names, instrs[i].name);
+      sink += entry != NULL;
+      num_ops++;
+   }
+
+   /* Dead code elimination. */
+   hash_table_foreach(remap, entry) {
+      if (((const struct instr *)entry->key)->index & 1)
+         _mesa_hash_table_remove(remap, entry);
+      num_ops++;
+   }
+   for (unsigned i = 0; i < num_instrs; i++) {
+      entry = _mesa_hash_table_search(remap, &instrs[i]);
+      sink += entry != NULL;
+   }
+   num_ops += num_instrs;
+
+   ralloc_free(mem_ctx);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_shaders = argc > 1 ? atoi(argv[1]) : 2000;
+   unsigned num_instrs = argc > 2 ? atoi(argv[2]) : 2000;
+   struct instr *instrs;
+   int64_t start, end;
+
+   if (num_instrs == 0)
+      return EXIT_FAILURE;
+
+   instrs = calloc(num_instrs, sizeof(*instrs));
+   if (!instrs)
+      return EXIT_FAILURE;
+
+   srand(1);
+   for (unsigned i = 0; i < num_instrs; i++) {
+      instrs[i].index = rand();
+      snprintf(instrs[i].name, sizeof(instrs[i].name), "ssa_%u", i);
+   }
+
+   start = os_time_get_nano();
+   for (unsigned i = 0; i < num_shaders; i++)
+      run_shader(instrs, num_instrs);
+   end = os_time_get_nano();
+
+   printf("%u shaders of %u instructions: %"PRIu64" operations, "
+          "%.2f ns/op\n", num_shaders, num_instrs, num_ops,
+          (double)(end - start) / num_ops);
+
+   free(instrs);
+   return sink == 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
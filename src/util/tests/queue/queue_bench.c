@@ -0,0 +1,135 @@
+/*
+ * Copyright © 2026 The Mesa Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Not a test, measures the util_queue throughput with trivial jobs and
+ * 1 to 64 threads adding them.
+ *
+ * Usage: queue_bench [num_worker_threads] [jobs_per_producer]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util/os_time.h"
+#include "util/u_queue.h"
+
+#define MAX_PRODUCERS 64
+
+struct bench_job {
+   struct util_queue_fence fence;
+};
+
+struct producer {
+   struct util_queue *queue;
+   struct bench_job *jobs;
+   unsigned num_jobs;
+   util_barrier *start;
+   thrd_t thread;
+};
+
+static unsigned executed;
+
+static void
+bench_execute(void *data, int thread_index)
+{
+   p_atomic_inc(&executed);
+}
+
+static int
+producer_func(void *data)
+{
+   struct producer *p = data;
+
+   util_barrier_wait(p->start);
+
+   for (unsigned i = 0; i < p->num_jobs; i++) {
+      util_queue_add_job(p->queue, &p->jobs[i], &p->jobs[i].fence,
+                         bench_execute, NULL);
+   }
+   return 0;
+}
+
+static double
+run(unsigned num_producers, unsigned num_threads, unsigned jobs_per_producer)
+{
+   struct util_queue queue;
+   struct producer producers[MAX_PRODUCERS];
+   util_barrier start;
+
+   if (!util_queue_init(&queue, "bench", 1024, num_threads, 0)) {
+      fprintf(stderr, "util_queue_init failed\n");
+      exit(EXIT_FAILURE);
+   }
+
+   util_barrier_init(&start, num_producers + 1);
+   executed = 0;
+
+   for (unsigned i = 0; i < num_producers; i++) {
+      producers[i].queue = &queue;
+      producers[i].num_jobs = jobs_per_producer;
+      producers[i].start = &start;
+      producers[i].jobs = calloc(jobs_per_producer, sizeof(struct bench_job));
+      for (unsigned j = 0; j < jobs_per_producer; j++)
+         util_queue_fence_init(&producers[i].jobs[j].fence);
+      producers[i].thread = u_thread_create(producer_func, &producers[i]);
+   }
+
+   util_barrier_wait(&start);
+   int64_t begin = os_time_get_nano();
+
+   for (unsigned i = 0; i < num_producers; i++)
+      thrd_join(producers[i].thread, NULL);
+   util_queue_finish(&queue);
+
+   int64_t end = os_time_get_nano();
+
+   if (executed != num_producers * jobs_per_producer)
+      fprintf(stderr, "only %u jobs executed\n", executed);
+
+   util_queue_destroy(&queue);
+   util_barrier_destroy(&start);
+   for (unsigned i = 0; i < num_producers; i++) {
+      for (unsigned j = 0; j < jobs_per_producer; j++)
+         util_queue_fence_destroy(&producers[i].jobs[j].fence);
+      free(producers[i].jobs);
+   }
+
+   return (double)num_producers * jobs_per_producer * 1000000000.0 /
+          (end - begin);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_threads = argc > 1 ? atoi(argv[1]) : 4;
+   unsigned jobs_per_producer = argc > 2 ? atoi(argv[2]) : 100000;
+
+   printf("%u worker threads, %u jobs per producer\n",
+          num_threads, jobs_per_producer);
+
+   for (unsigned n = 1; n <= MAX_PRODUCERS; n *= 2) {
+      printf("%2u producers: %10.0f jobs/s\n", n,
+             run(n, num_threads, jobs_per_producer));
+   }
+   return 0;
+}
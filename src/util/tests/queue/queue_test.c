@@ -0,0 +1,447 @@
+/*
+ * Copyright © 2026 The Mesa Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Tests for util_queue. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/u_queue.h"
+
+#define NUM_JOBS 10000
+
+static int failures;
+
+#define CHECK(cond) do {                                               \
+   if (!(cond)) {                                                      \
+      fprintf(stderr, "%s:%d: check failed: %s\n",                     \
+              __FILE__, __LINE__, #cond);                              \
+      failures++;                                                      \
+   }                                                                   \
+} while (0)
+
+struct counter_job {
+   struct util_queue_fence fence;
+   unsigned *counter;
+   unsigned *order;
+   unsigned index;
+   bool cleaned_up;
+};
+
+static void
+count_execute(void *data, int thread_index)
+{
+   struct counter_job *job = data;
+
+   if (job->order)
+      job->order[job->index] = p_atomic_inc_return(job->counter);
+   else
+      p_atomic_inc(job->counter);
+}
+
+static void
+count_cleanup(void *data, int thread_index)
+{
+   struct counter_job *job = data;
+
+   job->cleaned_up = true;
+}
+
+static struct counter_job *
+create_jobs(unsigned num, unsigned *counter, unsigned *order)
+{
+   struct counter_job *jobs = calloc(num, sizeof(*jobs));
+
+   for (unsigned i = 0; i < num; i++) {
+      util_queue_fence_init(&jobs[i].fence);
+      jobs[i].counter = counter;
+      jobs[i].order = order;
+      jobs[i].index = i;
+   }
+   return jobs;
+}
+
+static void
+destroy_jobs(struct counter_job *jobs, unsigned num)
+{
+   for (unsigned i = 0; i < num; i++)
+      util_queue_fence_destroy(&jobs[i].fence);
+   free(jobs);
+}
+
+/* Many jobs through a small ring, so that producers have to wait. */
+static void
+test_execute_all(unsigned max_jobs, unsigned num_threads, unsigned flags)
+{
+   struct util_queue queue;
+   unsigned counter = 0;
+   struct counter_job *jobs = create_jobs(NUM_JOBS, &counter, NULL);
+
+   CHECK(util_queue_init(&queue, "test", max_jobs, num_threads, flags));
+
+   for (unsigned i = 0; i < NUM_JOBS; i++) {
+      util_queue_add_job(&queue, &jobs[i], &jobs[i].fence, count_execute,
+                         count_cleanup);
+   }
+   util_queue_finish(&queue);
+   CHECK(counter == NUM_JOBS);
+
+   for (unsigned i = 0; i < NUM_JOBS; i++) {
+      CHECK(util_queue_fence_is_signalled(&jobs[i].fence));
+      CHECK(jobs[i].cleaned_up);
+   }
+
+   util_queue_destroy(&queue);
+   destroy_jobs(jobs, NUM_JOBS);
+}
+
+/* With a single thread, jobs are executed in order, also when they spill
+ * into the overflow list.
+ */
+static void
+test_order(unsigned flags)
+{
+   struct util_queue queue;
+   unsigned counter = 0;
+   unsigned *order = calloc(NUM_JOBS, sizeof(*order));
+   struct counter_job *jobs = create_jobs(NUM_JOBS, &counter, order);
+
+   CHECK(util_queue_init(&queue, "test", 8, 1, flags));
+
+   for (unsigned i = 0; i < NUM_JOBS; i++) {
+      util_queue_add_job(&queue, &jobs[i], &jobs[i].fence, count_execute,
+                         NULL);
+   }
+   util_queue_finish(&queue);
+
+   for (unsigned i = 0; i < NUM_JOBS; i++)
+      CHECK(order[i] == i + 1);
+
+   util_queue_destroy(&queue);
+   destroy_jobs(jobs, NUM_JOBS);
+   free(order);
+}
+
+static void
+block_execute(void *data, int thread_index)
+{
+   util_queue_fence_wait((struct util_queue_fence *)data);
+}
+
+static void
+test_drop(unsigned flags)
+{
+   struct util_queue queue;
+   struct util_queue_fence block, block_done;
+   unsigned counter = 0;
+   struct counter_job *jobs = create_jobs(16, &counter, NULL);
+
+   CHECK(util_queue_init(&queue, "test", 4, 1, flags));
+
+   /* Keep the thread busy until the other jobs have been dropped. */
+   util_queue_fence_init(&block);
+   util_queue_fence_init(&block_done);
+   util_queue_fence_reset(&block);
+   util_queue_add_job(&queue, &block, &block_done, block_execute, NULL);
+
+   /* Without UTIL_QUEUE_INIT_RESIZE_IF_FULL only 3 more jobs fit. */
+   unsigned num = flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL ? 16 : 3;
+   for (unsigned i = 0; i < num; i++) {
+      util_queue_add_job(&queue, &jobs[i], &jobs[i].fence, count_execute,
+                         count_cleanup);
+   }
+
+   for (unsigned i = 0; i < num; i += 2) {
+      util_queue_drop_job(&queue, &jobs[i].fence);
+      CHECK(util_queue_fence_is_signalled(&jobs[i].fence));
+      CHECK(jobs[i].cleaned_up);
+   }
+
+   util_queue_fence_signal(&block);
+   util_queue_finish(&queue);
+   CHECK(counter == num / 2);
+
+   util_queue_destroy(&queue);
+   util_queue_fence_destroy(&block);
+   util_queue_fence_destroy(&block_done);
+   destroy_jobs(jobs, 16);
+}
+
+struct spawn_job {
+   struct util_queue_fence fence;
+   struct util_queue *queue;
+   struct counter_job *children;
+   unsigned num_children;
+};
+
+static void
+spawn_execute(void *data, int thread_index)
+{
+   struct spawn_job *job = data;
+
+   for (unsigned i = 0; i < job->num_children; i++) {
+      util_queue_add_job_local(job->queue, thread_index, &job->children[i],
+                               &job->children[i].fence, count_execute, NULL);
+   }
+}
+
+/* Jobs added from within jobs to the threads' local queues are executed
+ * (or stolen) before util_queue_finish returns.
+ */
+static void
+test_local_queues(void)
+{
+   struct util_queue queue;
+   struct spawn_job spawners[8];
+   unsigned counter = 0;
+   unsigned num_children = NUM_JOBS / ARRAY_SIZE(spawners);
+
+   CHECK(util_queue_init(&queue, "test", 64, 4,
+                         UTIL_QUEUE_INIT_LOCAL_QUEUES));
+
+   for (unsigned i = 0; i < ARRAY_SIZE(spawners); i++) {
+      util_queue_fence_init(&spawners[i].fence);
+      spawners[i].queue = &queue;
+      spawners[i].children = create_jobs(num_children, &counter, NULL);
+      spawners[i].num_children = num_children;
+      util_queue_add_job(&queue, &spawners[i], &spawners[i].fence,
+                         spawn_execute, NULL);
+   }
+   util_queue_finish(&queue);
+   CHECK(counter == num_children * ARRAY_SIZE(spawners));
+
+   util_queue_destroy(&queue);
+   for (unsigned i = 0; i < ARRAY_SIZE(spawners); i++) {
+      util_queue_fence_destroy(&spawners[i].fence);
+      destroy_jobs(spawners[i].children, num_children);
+   }
+}
+
+/* Higher priority jobs are started first. */
+static void
+test_priorities(unsigned flags)
+{
+   struct util_queue queue;
+   struct util_queue_fence block, block_done;
+   unsigned counter = 0;
+   unsigned order[9];
+   struct counter_job *jobs = create_jobs(9, &counter, order);
+
+   CHECK(util_queue_init(&queue, "test", 4, 1, flags));
+
+   util_queue_fence_init(&block);
+   util_queue_fence_init(&block_done);
+   util_queue_fence_reset(&block);
+   util_queue_add_job(&queue, &block, &block_done, block_execute, NULL);
+
+   /* 3 jobs each, low priority first */
+   for (unsigned i = 0; i < 9; i++) {
+      enum util_queue_priority priority = UTIL_QUEUE_PRIORITY_LOW - i / 3;
+
+      util_queue_add_job_ex(&queue, &jobs[i], &jobs[i].fence, count_execute,
+                            NULL, priority, NULL, NULL, 0);
+   }
+
+   util_queue_fence_signal(&block);
+   util_queue_finish(&queue);
+
+   for (unsigned i = 0; i < 9; i++) {
+      unsigned expected = (2 - i / 3) * 3 + i % 3 + 1;
+      CHECK(order[i] == expected);
+   }
+
+   util_queue_destroy(&queue);
+   util_queue_fence_destroy(&block);
+   util_queue_fence_destroy(&block_done);
+   destroy_jobs(jobs, 9);
+}
+
+/* Jobs don't start before their dependencies are signalled, whether by
+ * another job of the queue or from outside.
+ */
+static void
+test_dependencies(void)
+{
+   struct util_queue queue;
+   struct util_queue_fence external;
+   unsigned counter = 0;
+   unsigned order[4];
+   struct counter_job *jobs = create_jobs(4, &counter, order);
+   struct util_queue_fence *deps[2];
+
+   CHECK(util_queue_init(&queue, "test", 8, 2, 0));
+
+   util_queue_fence_init(&external);
+   util_queue_fence_reset(&external);
+
+   /* 0 waits for the external fence, 1 for 0, 2 for 0 and 1, 3 for
+    * nothing.
+    */
+   deps[0] = &external;
+   util_queue_add_job_ex(&queue, &jobs[0], &jobs[0].fence, count_execute,
+                         NULL, UTIL_QUEUE_PRIORITY_NORMAL, NULL, deps, 1);
+   deps[0] = &jobs[0].fence;
+   util_queue_add_job_ex(&queue, &jobs[1], &jobs[1].fence, count_execute,
+                         NULL, UTIL_QUEUE_PRIORITY_NORMAL, NULL, deps, 1);
+   deps[1] = &jobs[1].fence;
+   util_queue_add_job_ex(&queue, &jobs[2], &jobs[2].fence, count_execute,
+                         NULL, UTIL_QUEUE_PRIORITY_HIGH, NULL, deps, 2);
+   util_queue_add_job_ex(&queue, &jobs[3], &jobs[3].fence, count_execute,
+                         NULL, UTIL_QUEUE_PRIORITY_LOW, NULL, NULL, 0);
+
+   util_queue_fence_wait(&jobs[3].fence);
+   CHECK(order[3] == 1);
+   CHECK(!util_queue_fence_is_signalled(&jobs[0].fence));
+
+   /* The threads have to notice this by polling. */
+   util_queue_fence_signal(&external);
+
+   util_queue_fence_wait(&jobs[2].fence);
+   CHECK(order[0] == 2);
+   CHECK(order[1] == 3);
+   CHECK(order[2] == 4);
+
+   /* util_queue_finish also waits for jobs waiting for dependencies. */
+   util_queue_fence_reset(&external);
+   deps[0] = &external;
+   util_queue_add_job_ex(&queue, &jobs[0], &jobs[0].fence, count_execute,
+                         NULL, UTIL_QUEUE_PRIORITY_NORMAL, NULL, deps, 1);
+   util_queue_fence_signal(&external);
+   util_queue_finish(&queue);
+   CHECK(counter == 5);
+
+   util_queue_destroy(&queue);
+   util_queue_fence_destroy(&external);
+   destroy_jobs(jobs, 4);
+}
+
+/* Dropping a group drops its queued and waiting jobs, but nothing else. */
+static void
+test_drop_group(unsigned flags)
+{
+   struct util_queue queue;
+   struct util_queue_fence block, block_done, external;
+   struct util_queue_group group;
+   unsigned counter = 0;
+   struct counter_job *jobs = create_jobs(12, &counter, NULL);
+   struct util_queue_fence *deps[1] = { &external };
+
+   CHECK(util_queue_init(&queue, "test", 4, 1, flags));
+   util_queue_group_init(&group);
+
+   util_queue_fence_init(&block);
+   util_queue_fence_init(&block_done);
+   util_queue_fence_init(&external);
+   util_queue_fence_reset(&block);
+   util_queue_fence_reset(&external);
+   util_queue_add_job_ex(&queue, &block, &block_done, block_execute, NULL,
+                         UTIL_QUEUE_PRIORITY_NORMAL, &group, NULL, 0);
+
+   /* 4 jobs per priority, every other job is in the group, every third one
+    * waits for the external fence.
+    */
+   for (unsigned i = 0; i < 12; i++) {
+      util_queue_add_job_ex(&queue, &jobs[i], &jobs[i].fence, count_execute,
+                            count_cleanup, i / 4, i % 2 ? NULL : &group,
+                            i % 3 ? NULL : deps, i % 3 ? 0 : 1);
+   }
+
+   /* The blocking job is in the group too, so it's waited for. */
+   util_queue_fence_signal(&block);
+   util_queue_drop_group(&queue, &group);
+   CHECK(group.num_jobs == 0);
+   CHECK(util_queue_fence_is_signalled(&block_done));
+
+   for (unsigned i = 0; i < 12; i += 2) {
+      CHECK(util_queue_fence_is_signalled(&jobs[i].fence));
+      CHECK(jobs[i].cleaned_up);
+   }
+
+   util_queue_fence_signal(&external);
+   util_queue_finish(&queue);
+   CHECK(counter == 6);
+
+   util_queue_destroy(&queue);
+   util_queue_fence_destroy(&block);
+   util_queue_fence_destroy(&block_done);
+   util_queue_fence_destroy(&external);
+   destroy_jobs(jobs, 12);
+}
+
+/* Destroying the queue signals the fences of jobs that didn't run. */
+static void
+test_destroy_pending(void)
+{
+   struct util_queue queue;
+   struct util_queue_fence block, block_done;
+   unsigned counter = 0;
+   struct counter_job *jobs = create_jobs(3, &counter, NULL);
+
+   CHECK(util_queue_init(&queue, "test", 4, 1, 0));
+
+   util_queue_fence_init(&block);
+   util_queue_fence_init(&block_done);
+   util_queue_fence_reset(&block);
+   util_queue_add_job(&queue, &block, &block_done, block_execute, NULL);
+   for (unsigned i = 0; i < 3; i++) {
+      util_queue_add_job(&queue, &jobs[i], &jobs[i].fence, count_execute,
+                         NULL);
+   }
+
+   util_queue_fence_signal(&block);
+   util_queue_destroy(&queue);
+
+   util_queue_fence_wait(&block_done);
+   for (unsigned i = 0; i < 3; i++)
+      CHECK(util_queue_fence_is_signalled(&jobs[i].fence));
+
+   util_queue_fence_destroy(&block);
+   util_queue_fence_destroy(&block_done);
+   destroy_jobs(jobs, 3);
+}
+
+int
+main(int argc, char **argv)
+{
+   (void) argc;
+   (void) argv;
+
+   test_execute_all(4, 1, 0);
+   test_execute_all(4, 8, 0);
+   test_execute_all(4, 8, UTIL_QUEUE_INIT_RESIZE_IF_FULL);
+   test_execute_all(1024, 4, UTIL_QUEUE_INIT_LOCAL_QUEUES);
+   test_order(0);
+   test_order(UTIL_QUEUE_INIT_RESIZE_IF_FULL);
+   test_drop(0);
+   test_drop(UTIL_QUEUE_INIT_RESIZE_IF_FULL);
+   test_local_queues();
+   test_priorities(0);
+   test_priorities(UTIL_QUEUE_INIT_RESIZE_IF_FULL);
+   test_dependencies();
+   test_drop_group(0);
+   test_drop_group(UTIL_QUEUE_INIT_RESIZE_IF_FULL);
+   test_destroy_pending();
+
+   return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
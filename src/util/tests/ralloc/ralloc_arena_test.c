@@ -0,0 +1,202 @@
+/*
+ * Copyright © 2026 The Mesa Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Tests for the ralloc arena contexts.  Running them under valgrind also
+ * checks that no buffer is leaked or released too early.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/ralloc.h"
+
+static int failures;
+
+#define CHECK(cond) do {                                               \
+   if (!(cond)) {                                                      \
+      fprintf(stderr, "%s:%d: check failed: %s\n",                     \
+              __FILE__, __LINE__, #cond);                              \
+      failures++;                                                      \
+   }                                                                   \
+} while (0)
+
+static unsigned destroyed;
+
+static void
+count_destructor(void *ptr)
+{
+   destroyed++;
+}
+
+/* Blocks and their children behave as usual, and freed blocks get used
+ * again for allocations of the same size.
+ */
+static void
+test_tree(void)
+{
+   void *arena = ralloc_arena_size(NULL, 64);
+   unsigned *blocks[1000];
+
+   for (unsigned i = 0; i < 1000; i++) {
+      blocks[i] = ralloc_array(arena, unsigned, 1 + i % 13);
+      for (unsigned j = 0; j < 1 + i % 13; j++)
+         blocks[i][j] = i;
+
+      char *name = ralloc_asprintf(blocks[i], "block %u", i);
+      ralloc_set_destructor(name, count_destructor);
+   }
+
+   for (unsigned i = 0; i < 1000; i++) {
+      CHECK(ralloc_parent(blocks[i]) == arena);
+      for (unsigned j = 0; j < 1 + i % 13; j++)
+         CHECK(blocks[i][j] == i);
+   }
+
+   destroyed = 0;
+   ralloc_free(blocks[500]);
+   CHECK(destroyed == 1);
+
+   unsigned *again = ralloc_array(arena, unsigned, 1 + 500 % 13);
+   CHECK(again == blocks[500]);
+
+   destroyed = 0;
+   ralloc_free(arena);
+   CHECK(destroyed == 999);
+}
+
+/* Growing a block keeps its data, its parent and its children. */
+static void
+test_resize(void)
+{
+   void *arena = ralloc_arena_size(NULL, 0);
+   void *parent = ralloc_context(arena);
+   char *str = ralloc_strdup(parent, "");
+   void *child = ralloc_context(str);
+   void *sibling = ralloc_context(parent);
+
+   for (unsigned i = 0; i < 500; i++)
+      ralloc_asprintf_append(&str, "%u,", i % 10);
+
+   CHECK(strlen(str) == 1000);
+   for (unsigned i = 0; i < 500; i++)
+      CHECK(str[2 * i] == '0' + i % 10 && str[2 * i + 1] == ',');
+
+   CHECK(ralloc_parent(str) == parent);
+   CHECK(ralloc_parent(child) == str);
+   CHECK(ralloc_parent(sibling) == parent);
+
+   /* Bigger than any size class. */
+   str = reralloc(parent, str, char, 100000);
+   str[99999] = 0;
+   CHECK(strlen(str) == 1000);
+   CHECK(ralloc_parent(child) == str);
+
+   ralloc_free(arena);
+}
+
+/* Blocks stolen by other contexts outlive their arena, and their new
+ * children are regular ralloc blocks.
+ */
+static void
+test_steal(void)
+{
+   void *ctx = ralloc_context(NULL);
+   void *arena = ralloc_arena_size(ctx, 16);
+   unsigned *small = ralloc_array(arena, unsigned, 4);
+   unsigned *big = ralloc_array(arena, unsigned, 10000);
+
+   for (unsigned i = 0; i < 4; i++)
+      small[i] = i;
+   big[9999] = 42;
+
+   ralloc_steal(ctx, small);
+   ralloc_steal(ctx, big);
+   ralloc_free(arena);
+
+   char *name = ralloc_strdup(small, "still there");
+   small = reralloc(ctx, small, unsigned, 1000);
+
+   for (unsigned i = 0; i < 4; i++)
+      CHECK(small[i] == i);
+   CHECK(big[9999] == 42);
+   CHECK(strcmp(name, "still there") == 0);
+
+   ralloc_free(ctx);
+}
+
+/* An arena can be adopted with the rest of its parent's children and freed
+ * with them, while the blocks stolen back survive.
+ */
+static void
+test_adopt(void)
+{
+   void *parent = ralloc_context(NULL);
+   void *arena = ralloc_arena_size(parent, 0);
+   void *rubbish = ralloc_context(NULL);
+   unsigned *keep = NULL;
+
+   for (unsigned i = 0; i < 100000; i++) {
+      unsigned *block = ralloc_array(arena, unsigned, 8);
+      block[0] = i;
+      if (i == 5000)
+         keep = block;
+   }
+
+   ralloc_adopt(rubbish, parent);
+   ralloc_steal(parent, keep);
+   ralloc_free(rubbish);
+
+   CHECK(ralloc_parent(keep) == parent);
+   CHECK(keep[0] == 5000);
+
+   ralloc_free(parent);
+}
+
+/* Arenas inside other arenas keep their own buffers. */
+static void
+test_nested(void)
+{
+   void *outer = ralloc_arena_size(NULL, 0);
+   void *inner = ralloc_arena_size(outer, 0);
+   unsigned *block = ralloc(inner, unsigned);
+
+   *block = 7;
+   ralloc_steal(outer, block);
+   ralloc_free(inner);
+   CHECK(*block == 7);
+
+   ralloc_free(outer);
+}
+
+int
+main(int argc, char **argv)
+{
+   test_tree();
+   test_resize();
+   test_steal();
+   test_adopt();
+   test_nested();
+
+   return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
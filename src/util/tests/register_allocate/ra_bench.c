@@ -0,0 +1,228 @@
+/*
+ * Copyright © 2026 The Mesa Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Not a test, measures building and coloring big interference graphs,
+ * spilling until the allocation succeeds.
+ *
+ * Usage: ra_bench [num_nodes [max_live]]
+ *        ra_bench -f graph.txt
+ *
+ * Without a file, the graph is the interference of num_nodes (20000 by
+ * default) random live ranges in straight line code, with max_live (41 by
+ * default) of them live at once at most, a quarter of them needing a
+ * register pair.  Graphs dumped from a compiler can be given as a text
+ * file instead, made of a "nodes <count>" line followed by
+ * "class <node> <0 or 1>" and "edge <node> <node>" lines, 1 being the
+ * pair class.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/os_time.h"
+#include "util/ralloc.h"
+#include "util/register_allocate.h"
+
+#define NUM_BASE_REGS 64
+#define NUM_REGS (NUM_BASE_REGS + NUM_BASE_REGS / 2)
+
+struct bench_graph {
+   unsigned count;
+   unsigned *classes;
+   unsigned (*edges)[2];
+   unsigned num_edges;
+};
+
+static void
+add_edge(struct bench_graph *b, unsigned n1, unsigned n2, unsigned *size)
+{
+   if (b->num_edges == *size) {
+      *size = *size ? *size * 2 : 1024;
+      b->edges = realloc(b->edges, *size * sizeof(*b->edges));
+   }
+   b->edges[b->num_edges][0] = n1;
+   b->edges[b->num_edges][1] = n2;
+   b->num_edges++;
+}
+
+static void
+make_graph(struct bench_graph *b, unsigned count, unsigned max_live)
+{
+   unsigned *active = calloc(max_live, sizeof(unsigned));
+   unsigned *ends = calloc(count, sizeof(unsigned));
+   unsigned num_active = 0, size = 0, ip = 0;
+
+   srand(1);
+
+   b->count = count;
+   b->classes = calloc(count, sizeof(unsigned));
+
+   for (unsigned n = 0; n < count; n++) {
+      /* Advance until the value fits. */
+      for (;;) {
+         unsigned j = 0;
+         for (unsigned i = 0; i < num_active; i++) {
+            if (ends[active[i]] > ip)
+               active[j++] = active[i];
+         }
+         num_active = j;
+         if (num_active < max_live)
+            break;
+         ip++;
+      }
+
+      b->classes[n] = rand() % 4 == 0;
+      ends[n] = ip + 1 + rand() % (2 * max_live);
+
+      for (unsigned i = 0; i < num_active; i++)
+         add_edge(b, active[i], n, &size);
+      active[num_active++] = n;
+
+      if (rand() % 2)
+         ip++;
+   }
+
+   free(active);
+   free(ends);
+}
+
+static bool
+read_graph(struct bench_graph *b, const char *filename)
+{
+   FILE *f = fopen(filename, "r");
+   char line[256];
+   unsigned size = 0;
+
+   if (!f)
+      return false;
+
+   memset(b, 0, sizeof(*b));
+   while (fgets(line, sizeof(line), f)) {
+      unsigned n1, n2;
+
+      if (sscanf(line, "nodes %u", &n1) == 1) {
+         b->count = n1;
+         b->classes = calloc(n1, sizeof(unsigned));
+      } else if (sscanf(line, "class %u %u", &n1, &n2) == 2 &&
+                 n1 < b->count) {
+         b->classes[n1] = n2 != 0;
+      } else if (sscanf(line, "edge %u %u", &n1, &n2) == 2 &&
+                 n1 < b->count && n2 < b->count) {
+         add_edge(b, n1, n2, &size);
+      }
+   }
+
+   fclose(f);
+   return b->count != 0;
+}
+
+static struct ra_regs *
+make_regs(unsigned *class_index)
+{
+   struct ra_regs *regs = ra_alloc_reg_set(NULL, NUM_REGS, true);
+
+   class_index[0] = ra_alloc_reg_class(regs);
+   class_index[1] = ra_alloc_reg_class(regs);
+
+   for (unsigned i = 0; i < NUM_BASE_REGS; i++)
+      ra_class_add_reg(regs, class_index[0], i);
+
+   for (unsigned i = 0; i < NUM_BASE_REGS / 2; i++) {
+      unsigned pair = NUM_BASE_REGS + i;
+
+      ra_class_add_reg(regs, class_index[1], pair);
+      ra_add_transitive_reg_conflict(regs, 2 * i, pair);
+      ra_add_transitive_reg_conflict(regs, 2 * i + 1, pair);
+   }
+
+   ra_set_finalize(regs, NULL);
+   return regs;
+}
+
+int
+main(int argc, char **argv)
+{
+   struct bench_graph b = { 0 };
+   struct ra_regs *regs;
+   struct ra_graph *g;
+   unsigned class_index[2];
+   unsigned spills = 0;
+   int64_t start, built, end;
+
+   if (argc > 2 && strcmp(argv[1], "-f") == 0) {
+      if (!read_graph(&b, argv[2])) {
+         fprintf(stderr, "couldn't read %s\n", argv[2]);
+         return EXIT_FAILURE;
+      }
+   } else {
+      unsigned count = argc > 1 ? atoi(argv[1]) : 20000;
+      unsigned max_live = argc > 2 ? atoi(argv[2]) : 41;
+
+      if (count == 0 || max_live == 0)
+         return EXIT_FAILURE;
+      make_graph(&b, count, max_live);
+   }
+
+   regs = make_regs(class_index);
+
+   start = os_time_get_nano();
+
+   g = ra_alloc_interference_graph(regs, b.count);
+   for (unsigned n = 0; n < b.count; n++) {
+      ra_set_node_class(g, n, class_index[b.classes[n]]);
+      ra_set_node_spill_cost(g, n, 1.0f + n % 7);
+   }
+   for (unsigned i = 0; i < b.num_edges; i++)
+      ra_add_node_interference(g, b.edges[i][0], b.edges[i][1]);
+
+   built = os_time_get_nano();
+
+   /* Spilled nodes just lose their interferences, as if their fills and
+    * spills were too short lived to matter.
+    */
+   while (!ra_allocate(g)) {
+      int node = ra_get_best_spill_node(g);
+
+      if (node < 0) {
+         fprintf(stderr, "nothing left to spill\n");
+         return EXIT_FAILURE;
+      }
+
+      ra_reset_node_interference(g, node);
+      ra_set_node_spill_cost(g, node, 0.0f);
+      spills++;
+   }
+
+   end = os_time_get_nano();
+
+   printf("%u nodes, %u edges: build %.2f ms, allocation %.2f ms, "
+          "%u spills\n", b.count, b.num_edges,
+          (built - start) / 1000000.0, (end - built) / 1000000.0, spills);
+
+   ralloc_free(g);
+   ralloc_free(regs);
+   free(b.classes);
+   free(b.edges);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,312 @@
+/*
+ * Copyright © 2026 The Mesa Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Tests for the graph coloring register allocator. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/ralloc.h"
+#include "util/register_allocate.h"
+
+/* 16 base registers followed by 8 aligned pairs of them. */
+#define NUM_BASE_REGS 16
+#define NUM_REGS (NUM_BASE_REGS + NUM_BASE_REGS / 2)
+
+static int failures;
+
+#define CHECK(cond) do {                                               \
+   if (!(cond)) {                                                      \
+      fprintf(stderr, "%s:%d: check failed: %s\n",                     \
+              __FILE__, __LINE__, #cond);                              \
+      failures++;                                                      \
+   }                                                                   \
+} while (0)
+
+struct test_graph {
+   struct ra_graph *g;
+   unsigned count;
+   unsigned *classes;
+   unsigned (*edges)[2];
+   unsigned num_edges;
+};
+
+static struct ra_regs *regs;
+static unsigned base_class, pair_class;
+
+static void
+setup_regs(void)
+{
+   regs = ra_alloc_reg_set(NULL, NUM_REGS, true);
+
+   base_class = ra_alloc_reg_class(regs);
+   pair_class = ra_alloc_reg_class(regs);
+
+   for (unsigned i = 0; i < NUM_BASE_REGS; i++)
+      ra_class_add_reg(regs, base_class, i);
+
+   for (unsigned i = 0; i < NUM_BASE_REGS / 2; i++) {
+      unsigned pair = NUM_BASE_REGS + i;
+
+      ra_class_add_reg(regs, pair_class, pair);
+      ra_add_transitive_reg_conflict(regs, 2 * i, pair);
+      ra_add_transitive_reg_conflict(regs, 2 * i + 1, pair);
+   }
+
+   ra_set_finalize(regs, NULL);
+}
+
+static bool
+regs_conflict(unsigned a, unsigned b)
+{
+   if (a == b)
+      return true;
+   if (a > b)
+      return regs_conflict(b, a);
+   if (b >= NUM_BASE_REGS && a < NUM_BASE_REGS)
+      return a / 2 == b - NUM_BASE_REGS;
+   return false;
+}
+
+/* p(B) and q(B, C) of the register set above. */
+static unsigned
+class_p(unsigned b)
+{
+   return b == base_class ? NUM_BASE_REGS : NUM_BASE_REGS / 2;
+}
+
+static unsigned
+class_q(unsigned b, unsigned c)
+{
+   return b == base_class && c == pair_class ? 2 : 1;
+}
+
+/**
+ * Builds a random graph of count nodes with interferences between nearby
+ * nodes.  Edges are only added while both nodes still pass the pq test, so
+ * the graph must be colorable without any optimistic choice.
+ */
+static void
+build_graph(struct test_graph *t, unsigned count, unsigned seed)
+{
+   unsigned *q_total = calloc(count, sizeof(unsigned));
+
+   srand(seed);
+
+   t->count = count;
+   t->g = ra_alloc_interference_graph(regs, count);
+   t->classes = calloc(count, sizeof(unsigned));
+   t->edges = calloc(count * 16, sizeof(*t->edges));
+   t->num_edges = 0;
+
+   for (unsigned n = 0; n < count; n++) {
+      t->classes[n] = rand() % 4 == 0 ? pair_class : base_class;
+      ra_set_node_class(t->g, n, t->classes[n]);
+   }
+
+   for (unsigned a = 0; a < count; a++) {
+      for (unsigned i = 0; i < 16; i++) {
+         unsigned b = a + 1 + rand() % 64;
+
+         if (b >= count)
+            continue;
+
+         unsigned qa = class_q(t->classes[a], t->classes[b]);
+         unsigned qb = class_q(t->classes[b], t->classes[a]);
+         if (q_total[a] + qa >= class_p(t->classes[a]) ||
+             q_total[b] + qb >= class_p(t->classes[b]))
+            continue;
+
+         q_total[a] += qa;
+         q_total[b] += qb;
+         ra_add_node_interference(t->g, a, b);
+         t->edges[t->num_edges][0] = a;
+         t->edges[t->num_edges][1] = b;
+         t->num_edges++;
+      }
+   }
+
+   free(q_total);
+}
+
+static void
+free_graph(struct test_graph *t)
+{
+   ralloc_free(t->g);
+   free(t->classes);
+   free(t->edges);
+}
+
+static void
+check_coloring(const struct test_graph *t)
+{
+   for (unsigned n = 0; n < t->count; n++) {
+      unsigned r = ra_get_node_reg(t->g, n);
+
+      CHECK(r < NUM_REGS);
+      CHECK((r >= NUM_BASE_REGS) == (t->classes[n] == pair_class));
+   }
+
+   for (unsigned i = 0; i < t->num_edges; i++) {
+      CHECK(!regs_conflict(ra_get_node_reg(t->g, t->edges[i][0]),
+                           ra_get_node_reg(t->g, t->edges[i][1])));
+   }
+}
+
+static void
+test_colorable(unsigned count)
+{
+   struct test_graph t;
+
+   build_graph(&t, count, count);
+   CHECK(ra_allocate(t.g));
+   check_coloring(&t);
+   free_graph(&t);
+}
+
+/* Allocating the same graph again gives the same registers. */
+static void
+test_reallocate(void)
+{
+   struct test_graph t;
+   unsigned *first;
+
+   build_graph(&t, 1000, 1);
+   first = calloc(t.count, sizeof(unsigned));
+
+   CHECK(ra_allocate(t.g));
+   for (unsigned n = 0; n < t.count; n++)
+      first[n] = ra_get_node_reg(t.g, n);
+
+   CHECK(ra_allocate(t.g));
+   for (unsigned n = 0; n < t.count; n++)
+      CHECK(ra_get_node_reg(t.g, n) == first[n]);
+
+   free(first);
+   free_graph(&t);
+}
+
+/* Forced registers are kept and avoided by their neighbors. */
+static void
+test_forced_regs(void)
+{
+   struct ra_graph *g = ra_alloc_interference_graph(regs, 3);
+
+   ra_set_node_class(g, 0, base_class);
+   ra_set_node_class(g, 1, base_class);
+   ra_set_node_class(g, 2, pair_class);
+   ra_add_node_interference(g, 0, 1);
+   ra_add_node_interference(g, 0, 2);
+   ra_add_node_interference(g, 1, 2);
+   ra_set_node_reg(g, 0, 0);
+
+   CHECK(ra_allocate(g));
+   CHECK(ra_get_node_reg(g, 0) == 0);
+   CHECK(ra_get_node_reg(g, 1) != 0);
+   CHECK(ra_get_node_reg(g, 2) != NUM_BASE_REGS);
+   CHECK(!regs_conflict(ra_get_node_reg(g, 1), ra_get_node_reg(g, 2)));
+
+   ralloc_free(g);
+}
+
+/**
+ * A clique of one node more than there are registers fails to allocate
+ * until a node gets spilled by dropping its interferences and handing its
+ * uses to new nodes, as a driver would after spilling.
+ */
+static void
+test_spill_update(unsigned extra_nodes)
+{
+   const unsigned count = NUM_BASE_REGS + 1;
+   struct ra_graph *g = ra_alloc_interference_graph(regs, count);
+   int spill;
+
+   for (unsigned a = 0; a < count; a++) {
+      ra_set_node_class(g, a, base_class);
+      ra_set_node_spill_cost(g, a, 1.0f + a);
+   }
+   for (unsigned a = 0; a < count; a++) {
+      for (unsigned b = a + 1; b < count; b++)
+         ra_add_node_interference(g, a, b);
+   }
+
+   CHECK(!ra_allocate(g));
+   spill = ra_get_best_spill_node(g);
+   CHECK(spill == 0);
+
+   ra_reset_node_interference(g, spill);
+   ra_set_node_spill_cost(g, spill, 0.0f);
+
+   /* The new nodes interfere with their neighbors in a chain, and the last
+    * one with all the clique but its last node.
+    */
+   const unsigned last = count + extra_nodes - 1;
+
+   ra_resize_interference_graph(g, count + extra_nodes);
+   for (unsigned n = count; n < count + extra_nodes; n++) {
+      ra_set_node_class(g, n, base_class);
+      if (n > count)
+         ra_add_node_interference(g, n - 1, n);
+   }
+   for (unsigned a = 1; a < count - 1; a++)
+      ra_add_node_interference(g, a, last);
+
+   CHECK(ra_allocate(g));
+   for (unsigned a = 1; a < count; a++) {
+      for (unsigned b = a + 1; b < count; b++)
+         CHECK(ra_get_node_reg(g, a) != ra_get_node_reg(g, b));
+      if (a < count - 1)
+         CHECK(ra_get_node_reg(g, a) != ra_get_node_reg(g, last));
+   }
+   for (unsigned n = count + 1; n <= last; n++)
+      CHECK(ra_get_node_reg(g, n - 1) != ra_get_node_reg(g, n));
+
+   ra_reset_node_interference(g, last);
+   ra_add_node_interference(g, 1, last);
+   CHECK(ra_allocate(g));
+   CHECK(ra_get_node_reg(g, 1) != ra_get_node_reg(g, last));
+
+   ralloc_free(g);
+}
+
+int
+main(int argc, char **argv)
+{
+   setup_regs();
+
+   test_colorable(1);
+   test_colorable(100);
+   test_colorable(2000);
+   /* Big enough for the sparse edge set. */
+   test_colorable(20000);
+   test_reallocate();
+   test_forced_regs();
+   test_spill_update(3);
+   /* Switches the graph to the sparse edge set. */
+   test_spill_update(5000);
+
+   ralloc_free(regs);
+
+   return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
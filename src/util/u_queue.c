@@ -221,6 +221,595 @@ util_queue_fence_destroy(struct util_queue_fence *fence)
 }
 #endif
 
+/****************************************************************************
+ * Sleeping and waking up
+ *
+ * Threads sleep until the 32-bit word at addr no longer holds val, or until
+ * abs_timeout (OS_TIMEOUT_INFINITE for no timeout).
+ */
+
+#ifdef UTIL_QUEUE_FENCE_FUTEX
+static void
+util_queue_sleep(struct util_queue *queue, uint32_t *addr, uint32_t val,
+                 int64_t abs_timeout)
+{
+   if (abs_timeout == (int64_t)OS_TIMEOUT_INFINITE) {
+      futex_wait(addr, val, NULL);
+   } else {
+      struct timespec ts;
+      ts.tv_sec = abs_timeout / (1000*1000*1000);
+      ts.tv_nsec = abs_timeout % (1000*1000*1000);
+      futex_wait(addr, val, &ts);
+   }
+}
+
+static void
+util_queue_wake(struct util_queue *queue, uint32_t *addr, int count)
+{
+   futex_wake(addr, count);
+}
+#else
+static void
+util_queue_sleep(struct util_queue *queue, uint32_t *addr, uint32_t val,
+                 int64_t abs_timeout)
+{
+   mtx_lock(&queue->lock);
+   while (p_atomic_read(addr) == val) {
+      if (abs_timeout == (int64_t)OS_TIMEOUT_INFINITE) {
+         cnd_wait(&queue->wake_cond, &queue->lock);
+      } else {
+         /* cnd_timedwait is relative to the TIME_UTC clock. */
+         int64_t rel = abs_timeout - os_time_get_nano();
+         struct timespec ts;
+
+         if (rel <= 0)
+            break;
+
+         timespec_get(&ts, TIME_UTC);
+         ts.tv_sec += rel / (1000*1000*1000);
+         ts.tv_nsec += rel % (1000*1000*1000);
+         if (ts.tv_nsec >= (1000*1000*1000)) {
+            ts.tv_sec++;
+            ts.tv_nsec -= (1000*1000*1000);
+         }
+
+         if (cnd_timedwait(&queue->wake_cond, &queue->lock, &ts) !=
+             thrd_success)
+            break;
+      }
+   }
+   mtx_unlock(&queue->lock);
+}
+
+static void
+util_queue_wake(struct util_queue *queue, uint32_t *addr, int count)
+{
+   mtx_lock(&queue->lock);
+   cnd_broadcast(&queue->wake_cond);
+   mtx_unlock(&queue->lock);
+}
+#endif
+
+static inline void
+util_queue_cpu_relax(void)
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+   __builtin_ia32_pause();
+#endif
+}
+
+static bool
+util_queue_counter_try_dec(uint32_t *counter)
+{
+   uint32_t n = p_atomic_read(counter);
+
+   while (n > 0) {
+      uint32_t old = p_atomic_cmpxchg(counter, n, n - 1);
+      if (old == n)
+         return true;
+      n = old;
+   }
+   return false;
+}
+
+#define UTIL_QUEUE_SPIN_COUNT 64
+
+/* Take one job from the num_queued semaphore, sleeping if there is none.
+ * Returns false if abs_timeout passed first.
+ */
+static bool
+util_queue_sem_wait(struct util_queue *queue, int64_t abs_timeout)
+{
+   for (unsigned i = 0; i < UTIL_QUEUE_SPIN_COUNT; i++) {
+      int32_t n = p_atomic_read(&queue->num_queued);
+
+      if (n > 0 && p_atomic_cmpxchg(&queue->num_queued, n, n - 1) == n)
+         return true;
+      util_queue_cpu_relax();
+   }
+
+   if (p_atomic_dec_return(&queue->num_queued) >= 0)
+      return true;
+
+   /* We are registered as a sleeper now, wait until a producer hands us
+    * a token.
+    */
+   while (1) {
+      if (util_queue_counter_try_dec(&queue->wake_tokens))
+         return true;
+
+      if (abs_timeout != (int64_t)OS_TIMEOUT_INFINITE &&
+          os_time_get_nano() >= abs_timeout) {
+         /* Unregister, unless a producer has already counted us as woken
+          * up. In that case a token is on its way.
+          */
+         int32_t n = p_atomic_read(&queue->num_queued);
+         while (n < 0) {
+            int32_t old = p_atomic_cmpxchg(&queue->num_queued, n, n + 1);
+            if (old == n)
+               return false;
+            n = old;
+         }
+         abs_timeout = OS_TIMEOUT_INFINITE;
+         continue;
+      }
+
+      util_queue_sleep(queue, &queue->wake_tokens, 0, abs_timeout);
+   }
+}
+
+static void
+util_queue_sem_post(struct util_queue *queue)
+{
+   if (p_atomic_inc_return(&queue->num_queued) <= 0) {
+      p_atomic_inc(&queue->wake_tokens);
+      util_queue_wake(queue, &queue->wake_tokens, 1);
+   }
+}
+
+/* Wake up a thread without giving it a job. */
+static void
+util_queue_wake_spurious(struct util_queue *queue)
+{
+   p_atomic_inc(&queue->num_spurious);
+   util_queue_sem_post(queue);
+}
+
+/****************************************************************************
+ * Lock-free job ring
+ *
+ * This is the bounded MPMC queue by Dmitry Vyukov. Every slot carries a
+ * sequence number which tells producers and consumers whether the slot is
+ * free for the position they've read:
+ *
+ *    seq == pos      the slot is free and can be written at position pos
+ *    seq == pos + 1  the slot holds the job added at position pos
+ *
+ * Producers and consumers claim a position with a compare-and-swap on
+ * enqueue_pos and dequeue_pos respectively, so there is no lock.
+ *
+ * Additionally, the owner of a queued job is decided by "claim": it holds
+ * the position at which the job was added until either a consumer or
+ * util_queue_drop_job claims the job by replacing it with pos + 1. pos + 1
+ * can never be a later position of the same slot, so a stale claim attempt
+ * always fails.
+ */
+
+/* Loading seq must be an acquire and storing it a release, so that the job
+ * is written before the slot is published and read after it's seen. That's
+ * what p_atomic_read/p_atomic_set do with the __atomic builtins. The __sync
+ * and MSVC versions are plain accesses, so use the compare-and-swap based
+ * operations there, which are full barriers.
+ */
+#if defined(USE_GCC_ATOMIC_BUILTINS)
+#define util_queue_seq_read(v) p_atomic_read(v)
+#define util_queue_seq_set(v, i) p_atomic_set(v, i)
+#else
+#define util_queue_seq_read(v) p_atomic_cmpxchg(v, 0, 0)
+#define util_queue_seq_set(v, i) (void) p_atomic_xchg(v, i)
+#endif
+
+struct util_queue_slot {
+   uint32_t seq;
+   uint32_t claim;
+   struct util_queue_job job;
+};
+
+static bool
+util_queue_ring_init(struct util_queue_ring *ring, unsigned size)
+{
+   memset(ring, 0, sizeof(*ring));
+   ring->slots = calloc(size, sizeof(*ring->slots));
+   if (!ring->slots)
+      return false;
+
+   ring->mask = size - 1;
+   for (unsigned i = 0; i < size; i++) {
+      ring->slots[i].seq = i;
+      ring->slots[i].claim = i + 1;
+   }
+   return true;
+}
+
+static void
+util_queue_ring_fini(struct util_queue_ring *ring)
+{
+   free(ring->slots);
+   ring->slots = NULL;
+}
+
+static bool
+util_queue_ring_push(struct util_queue_ring *ring,
+                     const struct util_queue_job *job)
+{
+   struct util_queue_slot *slot;
+   uint32_t pos = p_atomic_read(&ring->enqueue_pos);
+
+   while (1) {
+      slot = &ring->slots[pos & ring->mask];
+
+      int32_t dif = (int32_t)(util_queue_seq_read(&slot->seq) - pos);
+      if (dif == 0) {
+         uint32_t old = p_atomic_cmpxchg(&ring->enqueue_pos, pos, pos + 1);
+         if (old == pos)
+            break;
+         pos = old;
+      } else if (dif < 0) {
+         /* full */
+         return false;
+      } else {
+         pos = p_atomic_read(&ring->enqueue_pos);
+      }
+   }
+
+   slot->job = *job;
+   slot->claim = pos;
+   util_queue_seq_set(&slot->seq, pos + 1);
+   return true;
+}
+
+/* Take the oldest job from the ring. The returned job is a no-op (NULL job)
+ * if it was dropped by util_queue_drop_job.
+ */
+static bool
+util_queue_ring_pop(struct util_queue_ring *ring, struct util_queue_job *job)
+{
+   struct util_queue_slot *slot;
+   uint32_t pos = p_atomic_read(&ring->dequeue_pos);
+
+   while (1) {
+      slot = &ring->slots[pos & ring->mask];
+
+      int32_t dif = (int32_t)(util_queue_seq_read(&slot->seq) - (pos + 1));
+      if (dif == 0) {
+         uint32_t old = p_atomic_cmpxchg(&ring->dequeue_pos, pos, pos + 1);
+         if (old == pos)
+            break;
+         pos = old;
+      } else if (dif < 0) {
+         /* empty, or the job at pos is still being written */
+         return false;
+      } else {
+         pos = p_atomic_read(&ring->dequeue_pos);
+      }
+   }
+
+   *job = slot->job;
+   if (p_atomic_cmpxchg(&slot->claim, pos, pos + 1) != pos)
+      job->job = NULL;
+
+   /* This must be a full barrier, see util_queue_wait_for_space. */
+   p_atomic_xchg(&slot->seq, pos + ring->mask + 1);
+   return true;
+}
+
+/* Whether a job is dropped by util_queue_drop_job (fence != NULL) or
+ * util_queue_drop_group.
+ */
+static inline bool
+util_queue_job_matches(const struct util_queue_job *job,
+                       struct util_queue_fence *fence,
+                       struct util_queue_group *group)
+{
+   return job->job && (fence ? job->fence == fence : job->group == group);
+}
+
+static void
+util_queue_group_job_done(struct util_queue *queue,
+                          struct util_queue_group *group)
+{
+   if (group && p_atomic_dec_zero(&group->num_jobs))
+      util_queue_wake(queue, &group->num_jobs, INT_MAX);
+}
+
+static void
+util_queue_job_dropped(struct util_queue *queue, struct util_queue_job *job)
+{
+   if (job->cleanup)
+      job->cleanup(job->job, -1);
+   util_queue_fence_signal(job->fence);
+   util_queue_group_job_done(queue, job->group);
+}
+
+/* Claim matching queued jobs, leaving no-op jobs behind. With a fence, stop
+ * after the first one.
+ */
+static unsigned
+util_queue_ring_drop(struct util_queue *queue, struct util_queue_ring *ring,
+                     struct util_queue_fence *fence,
+                     struct util_queue_group *group)
+{
+   uint32_t end = p_atomic_read(&ring->enqueue_pos);
+   unsigned num_dropped = 0;
+
+   for (uint32_t pos = p_atomic_read(&ring->dequeue_pos); pos != end; pos++) {
+      struct util_queue_slot *slot = &ring->slots[pos & ring->mask];
+
+      if (util_queue_seq_read(&slot->seq) != pos + 1)
+         continue;
+
+      /* Copy the job before claiming it. A successful claim means the slot
+       * can't have been reused in the meantime, so the copy is valid.
+       */
+      struct util_queue_job copy = slot->job;
+      if (!util_queue_job_matches(&copy, fence, group))
+         continue;
+
+      if (p_atomic_cmpxchg(&slot->claim, pos, pos + 1) == pos) {
+         util_queue_job_dropped(queue, &copy);
+         num_dropped++;
+         if (fence)
+            break;
+      }
+   }
+   return num_dropped;
+}
+
+/****************************************************************************
+ * Overflow lists
+ *
+ * With UTIL_QUEUE_INIT_RESIZE_IF_FULL, once a job has gone to the overflow
+ * list, all following jobs of the same priority go there too until it's
+ * empty, and consumers only take jobs from it when the ring is empty. This
+ * keeps the jobs in order.
+ */
+
+static void
+util_queue_overflow_push(struct util_queue *queue,
+                         struct util_queue_overflow *overflow,
+                         const struct util_queue_job *job)
+{
+   mtx_lock(&queue->lock);
+   if (overflow->count == overflow->size) {
+      unsigned new_size = MAX2(overflow->size * 2, 8);
+      struct util_queue_job *jobs =
+         (struct util_queue_job*)calloc(new_size, sizeof(*jobs));
+      assert(jobs);
+
+      for (unsigned i = 0; i < overflow->count; i++)
+         jobs[i] = overflow->jobs[(overflow->read + i) % overflow->size];
+      free(overflow->jobs);
+      overflow->jobs = jobs;
+      overflow->size = new_size;
+      overflow->read = 0;
+   }
+
+   overflow->jobs[(overflow->read + overflow->count) % overflow->size] = *job;
+   p_atomic_inc(&overflow->count);
+   mtx_unlock(&queue->lock);
+}
+
+static bool
+util_queue_overflow_pop(struct util_queue *queue,
+                        struct util_queue_overflow *overflow,
+                        struct util_queue_job *job)
+{
+   bool found = false;
+
+   mtx_lock(&queue->lock);
+   if (overflow->count) {
+      *job = overflow->jobs[overflow->read];
+      overflow->read = (overflow->read + 1) % overflow->size;
+      p_atomic_dec(&overflow->count);
+      found = true;
+   }
+   mtx_unlock(&queue->lock);
+   return found;
+}
+
+/* Like util_queue_ring_drop. Dropped jobs stay in the list as no-op jobs. */
+static unsigned
+util_queue_overflow_drop(struct util_queue *queue,
+                         struct util_queue_overflow *overflow,
+                         struct util_queue_fence *fence,
+                         struct util_queue_group *group)
+{
+   unsigned num_dropped = 0;
+
+   if (!p_atomic_read(&overflow->count))
+      return 0;
+
+   /* Drop one job at a time, so that cleanup callbacks aren't called with
+    * the lock held.
+    */
+   while (1) {
+      struct util_queue_job job;
+      bool found = false;
+
+      mtx_lock(&queue->lock);
+      for (unsigned i = 0; i < overflow->count; i++) {
+         struct util_queue_job *ptr =
+            &overflow->jobs[(overflow->read + i) % overflow->size];
+
+         if (util_queue_job_matches(ptr, fence, group)) {
+            job = *ptr;
+            memset(ptr, 0, sizeof(*ptr));
+            found = true;
+            break;
+         }
+      }
+      mtx_unlock(&queue->lock);
+
+      if (!found)
+         break;
+
+      util_queue_job_dropped(queue, &job);
+      num_dropped++;
+      if (fence)
+         break;
+   }
+   return num_dropped;
+}
+
+/****************************************************************************
+ * Jobs waiting for dependencies
+ *
+ * Jobs whose dependencies aren't signalled yet are kept in a list until
+ * they are. The list is checked whenever a job of the queue completes,
+ * and periodically by an idle thread for fences signalled elsewhere.
+ */
+
+#define UTIL_QUEUE_WAITING_POLL_NS (1000 * 1000)
+
+struct util_queue_waiting_job {
+   struct util_queue_job job;
+   enum util_queue_priority priority;
+   struct util_queue_fence **deps;
+   unsigned num_deps;
+};
+
+static void util_queue_push_job(struct util_queue *queue,
+                                enum util_queue_priority priority,
+                                const struct util_queue_job *job,
+                                bool can_wait);
+
+static bool
+util_queue_deps_signalled(struct util_queue_waiting_job *wjob)
+{
+   /* Dependencies are signalled in any order, drop the ones that are. */
+   while (wjob->num_deps) {
+      if (!util_queue_fence_is_signalled(wjob->deps[wjob->num_deps - 1]))
+         return false;
+      wjob->num_deps--;
+   }
+   return true;
+}
+
+/* Move jobs whose dependencies are signalled to the rings. */
+static void
+util_queue_check_waiting(struct util_queue *queue)
+{
+   struct util_queue_waiting_job ready[16];
+   unsigned num_ready;
+
+   do {
+      if (!p_atomic_read(&queue->num_waiting))
+         return;
+
+      num_ready = 0;
+
+      mtx_lock(&queue->lock);
+      unsigned n = 0;
+      for (unsigned i = 0; i < queue->num_waiting; i++) {
+         struct util_queue_waiting_job *wjob = &queue->waiting[i];
+
+         if (num_ready < ARRAY_SIZE(ready) && util_queue_deps_signalled(wjob))
+            ready[num_ready++] = *wjob;
+         else
+            queue->waiting[n++] = *wjob;
+      }
+      p_atomic_set(&queue->num_waiting, n);
+      mtx_unlock(&queue->lock);
+
+      for (unsigned i = 0; i < num_ready; i++) {
+         free(ready[i].deps);
+         util_queue_push_job(queue, ready[i].priority, &ready[i].job, false);
+      }
+   } while (num_ready == ARRAY_SIZE(ready));
+}
+
+static void
+util_queue_add_waiting(struct util_queue *queue,
+                       enum util_queue_priority priority,
+                       const struct util_queue_job *job,
+                       struct util_queue_fence **deps,
+                       unsigned num_deps)
+{
+   struct util_queue_waiting_job wjob;
+
+   wjob.job = *job;
+   wjob.priority = priority;
+   wjob.deps = malloc(num_deps * sizeof(*deps));
+   assert(wjob.deps);
+   memcpy(wjob.deps, deps, num_deps * sizeof(*deps));
+   wjob.num_deps = num_deps;
+
+   mtx_lock(&queue->lock);
+   if (queue->num_waiting == queue->waiting_size) {
+      queue->waiting_size = MAX2(queue->waiting_size * 2, 8);
+      queue->waiting = realloc(queue->waiting,
+                               queue->waiting_size * sizeof(*queue->waiting));
+      assert(queue->waiting);
+   }
+   queue->waiting[queue->num_waiting] = wjob;
+   bool first = p_atomic_inc_return(&queue->num_waiting) == 1;
+   mtx_unlock(&queue->lock);
+
+   /* Make sure that a thread is awake to poll the dependencies. */
+   if (first)
+      util_queue_wake_spurious(queue);
+
+   /* The dependencies may have been signalled in the meantime. */
+   util_queue_check_waiting(queue);
+}
+
+/* Like util_queue_ring_drop. */
+static unsigned
+util_queue_waiting_drop(struct util_queue *queue,
+                        struct util_queue_fence *fence,
+                        struct util_queue_group *group,
+                        bool all)
+{
+   unsigned num_dropped = 0;
+
+   if (!p_atomic_read(&queue->num_waiting))
+      return 0;
+
+   while (1) {
+      struct util_queue_waiting_job wjob;
+      bool found = false;
+
+      mtx_lock(&queue->lock);
+      for (unsigned i = 0; i < queue->num_waiting; i++) {
+         if (all || util_queue_job_matches(&queue->waiting[i].job,
+                                           fence, group)) {
+            wjob = queue->waiting[i];
+            queue->waiting[i] = queue->waiting[queue->num_waiting - 1];
+            p_atomic_dec(&queue->num_waiting);
+            found = true;
+            break;
+         }
+      }
+      mtx_unlock(&queue->lock);
+
+      if (!found)
+         break;
+
+      free(wjob.deps);
+      if (all) {
+         /* the queue is being destroyed */
+         util_queue_fence_signal(wjob.job.fence);
+         util_queue_group_job_done(queue, wjob.job.group);
+      } else {
+         util_queue_job_dropped(queue, &wjob.job);
+      }
+      num_dropped++;
+      if (fence)
+         break;
+   }
+   return num_dropped;
+}
+
 /****************************************************************************
  * util_queue implementation
  */
@@ -230,6 +819,52 @@ struct thread_input {
    int thread_index;
 };
 
+/* Take any queued job, without blocking. Local jobs of the thread come
+ * first, then the shared rings by priority, then jobs stolen from other
+ * threads.
+ */
+static bool
+util_queue_try_get_job(struct util_queue *queue, int thread_index,
+                       struct util_queue_job *job)
+{
+   if (queue->local_rings && thread_index >= 0 &&
+       util_queue_ring_pop(&queue->local_rings[thread_index], job))
+      return true;
+
+   for (unsigned p = 0; p < UTIL_QUEUE_NUM_PRIORITIES; p++) {
+      struct util_queue_ring *ring = &queue->rings[p];
+
+      if (util_queue_ring_pop(ring, job)) {
+         /* Wake up waiting producers once half of the ring is free,
+          * instead of waking one for every free slot.
+          */
+         if (p_atomic_read(&queue->num_space_waiters) &&
+             p_atomic_read(&ring->enqueue_pos) -
+             p_atomic_read(&ring->dequeue_pos) <= ring->mask / 2) {
+            p_atomic_inc(&queue->space_seq);
+            util_queue_wake(queue, &queue->space_seq, INT_MAX);
+         }
+         return true;
+      }
+
+      if (p_atomic_read(&queue->overflow[p].count) &&
+          util_queue_overflow_pop(queue, &queue->overflow[p], job))
+         return true;
+   }
+
+   if (queue->local_rings) {
+      unsigned first = thread_index >= 0 ? thread_index + 1 : 0;
+
+      for (unsigned i = 0; i < queue->num_threads; i++) {
+         unsigned victim = (first + i) % queue->num_threads;
+
+         if (util_queue_ring_pop(&queue->local_rings[victim], job))
+            return true;
+      }
+   }
+   return false;
+}
+
 static int
 util_queue_thread_func(void *input)
 {
@@ -246,48 +881,81 @@ util_queue_thread_func(void *input)
 
    while (1) {
       struct util_queue_job job;
+      bool spurious = false;
 
-      mtx_lock(&queue->lock);
-      assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
+      /* Poll the dependencies of waiting jobs while idle. */
+      int64_t timeout = p_atomic_read(&queue->num_waiting) ?
+                        os_time_get_nano() + UTIL_QUEUE_WAITING_POLL_NS :
+                        (int64_t)OS_TIMEOUT_INFINITE;
 
-      /* wait if the queue is empty */
-      while (!queue->kill_threads && queue->num_queued == 0)
-         cnd_wait(&queue->has_queued_cond, &queue->lock);
+      if (!util_queue_sem_wait(queue, timeout)) {
+         util_queue_check_waiting(queue);
+         continue;
+      }
 
-      if (queue->kill_threads) {
-         mtx_unlock(&queue->lock);
-         break;
+      /* The semaphore guarantees that a job has been added, but its
+       * producer may still be writing it.
+       */
+      while (!p_atomic_read(&queue->kill_threads) &&
+             !util_queue_try_get_job(queue, thread_index, &job)) {
+         if (util_queue_counter_try_dec(&queue->num_spurious)) {
+            spurious = true;
+            break;
+         }
+         thrd_yield();
       }
 
-      job = queue->jobs[queue->read_idx];
-      memset(&queue->jobs[queue->read_idx], 0, sizeof(struct util_queue_job));
-      queue->read_idx = (queue->read_idx + 1) % queue->max_jobs;
+      if (p_atomic_read(&queue->kill_threads))
+         break;
 
-      queue->num_queued--;
-      cnd_signal(&queue->has_space_cond);
-      mtx_unlock(&queue->lock);
+      if (spurious) {
+         util_queue_check_waiting(queue);
+         continue;
+      }
 
       if (job.job) {
          job.execute(job.job, thread_index);
          util_queue_fence_signal(job.fence);
          if (job.cleanup)
             job.cleanup(job.job, thread_index);
+         util_queue_group_job_done(queue, job.group);
+
+         util_queue_check_waiting(queue);
       }
    }
+   return 0;
+}
 
-   /* signal remaining jobs before terminating */
-   mtx_lock(&queue->lock);
-   for (unsigned i = queue->read_idx; i != queue->write_idx;
-        i = (i + 1) % queue->max_jobs) {
-      if (queue->jobs[i].job) {
-         util_queue_fence_signal(queue->jobs[i].fence);
-         queue->jobs[i].job = NULL;
+/* Signal the fences of all remaining jobs after the threads have been
+ * killed.
+ */
+static void
+util_queue_signal_remaining(struct util_queue *queue)
+{
+   struct util_queue_job job;
+
+   util_queue_waiting_drop(queue, NULL, NULL, true);
+
+   while (util_queue_try_get_job(queue, -1, &job)) {
+      if (job.job) {
+         util_queue_fence_signal(job.fence);
+         util_queue_group_job_done(queue, job.group);
       }
    }
-   queue->read_idx = queue->write_idx;
-   queue->num_queued = 0;
-   mtx_unlock(&queue->lock);
-   return 0;
+}
+
+static void
+util_queue_free_rings(struct util_queue *queue, unsigned num_local_rings)
+{
+   if (queue->local_rings) {
+      for (unsigned i = 0; i < num_local_rings; i++)
+         util_queue_ring_fini(&queue->local_rings[i]);
+      free(queue->local_rings);
+   }
+   for (unsigned p = 0; p < UTIL_QUEUE_NUM_PRIORITIES; p++) {
+      util_queue_ring_fini(&queue->rings[p]);
+      free(queue->overflow[p].jobs);
+   }
 }
 
 bool
@@ -303,19 +971,32 @@ util_queue_init(struct util_queue *queue,
    queue->name = name;
    queue->flags = flags;
    queue->num_threads = num_threads;
-   queue->max_jobs = max_jobs;
 
-   queue->jobs = (struct util_queue_job*)
-                 calloc(max_jobs, sizeof(struct util_queue_job));
-   if (!queue->jobs)
-      goto fail;
+   /* The ring size must be a power of two. */
+   queue->max_jobs = 2;
+   while (queue->max_jobs < max_jobs)
+      queue->max_jobs *= 2;
 
    (void) mtx_init(&queue->lock, mtx_plain);
    (void) mtx_init(&queue->finish_lock, mtx_plain);
+   cnd_init(&queue->wake_cond);
+
+   for (i = 0; i < UTIL_QUEUE_NUM_PRIORITIES; i++) {
+      if (!util_queue_ring_init(&queue->rings[i], queue->max_jobs))
+         goto fail;
+   }
+
+   if (flags & UTIL_QUEUE_INIT_LOCAL_QUEUES) {
+      queue->local_rings = (struct util_queue_ring*)
+                           calloc(num_threads, sizeof(struct util_queue_ring));
+      if (!queue->local_rings)
+         goto fail;
 
-   queue->num_queued = 0;
-   cnd_init(&queue->has_queued_cond);
-   cnd_init(&queue->has_space_cond);
+      for (i = 0; i < num_threads; i++) {
+         if (!util_queue_ring_init(&queue->local_rings[i], queue->max_jobs))
+            goto fail;
+      }
+   }
 
    queue->threads = (thrd_t*) calloc(num_threads, sizeof(thrd_t));
    if (!queue->threads)
@@ -363,13 +1044,11 @@ util_queue_init(struct util_queue *queue,
 
 fail:
    free(queue->threads);
+   util_queue_free_rings(queue, num_threads);
+   cnd_destroy(&queue->wake_cond);
+   mtx_destroy(&queue->finish_lock);
+   mtx_destroy(&queue->lock);
 
-   if (queue->jobs) {
-      cnd_destroy(&queue->has_space_cond);
-      cnd_destroy(&queue->has_queued_cond);
-      mtx_destroy(&queue->lock);
-      free(queue->jobs);
-   }
    /* also util_queue_is_initialized can be used to check for success */
    memset(queue, 0, sizeof(*queue));
    return false;
@@ -381,30 +1060,91 @@ util_queue_killall_and_wait(struct util_queue *queue)
    unsigned i;
 
    /* Signal all threads to terminate. */
-   mtx_lock(&queue->lock);
-   queue->kill_threads = 1;
-   cnd_broadcast(&queue->has_queued_cond);
-   mtx_unlock(&queue->lock);
+   if (p_atomic_xchg(&queue->kill_threads, 1) == 0) {
+      for (i = 0; i < queue->num_threads; i++)
+         util_queue_sem_post(queue);
+   }
 
    for (i = 0; i < queue->num_threads; i++)
       thrd_join(queue->threads[i], NULL);
    queue->num_threads = 0;
+
+   util_queue_signal_remaining(queue);
 }
 
 void
 util_queue_destroy(struct util_queue *queue)
 {
+   unsigned num_threads = queue->num_threads;
+
    util_queue_killall_and_wait(queue);
    remove_from_atexit_list(queue);
 
-   cnd_destroy(&queue->has_space_cond);
-   cnd_destroy(&queue->has_queued_cond);
+   util_queue_free_rings(queue, num_threads);
+   cnd_destroy(&queue->wake_cond);
    mtx_destroy(&queue->finish_lock);
    mtx_destroy(&queue->lock);
-   free(queue->jobs);
+   free(queue->waiting);
    free(queue->threads);
 }
 
+/* Wait until the ring has a free slot and add the job. */
+static void
+util_queue_wait_for_space(struct util_queue *queue,
+                          struct util_queue_ring *ring,
+                          const struct util_queue_job *job)
+{
+   /* Consumers check num_space_waiters after freeing a slot. Both sides do
+    * an atomic read-modify-write before reading the other side's variable,
+    * so either we see the free slot or the consumer sees us waiting.
+    */
+   p_atomic_inc(&queue->num_space_waiters);
+   while (1) {
+      uint32_t seq = p_atomic_read(&queue->space_seq);
+
+      if (util_queue_ring_push(ring, job))
+         break;
+      util_queue_sleep(queue, &queue->space_seq, seq,
+                       (int64_t)OS_TIMEOUT_INFINITE);
+   }
+   p_atomic_dec(&queue->num_space_waiters);
+}
+
+/* Queue a job. The queue's own threads mustn't wait for space (can_wait),
+ * as all of them might end up waiting.
+ */
+static void
+util_queue_push_job(struct util_queue *queue,
+                    enum util_queue_priority priority,
+                    const struct util_queue_job *job,
+                    bool can_wait)
+{
+   struct util_queue_ring *ring = &queue->rings[priority];
+   struct util_queue_overflow *overflow = &queue->overflow[priority];
+
+   if (queue->flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL) {
+      /* If the queue is full, spill into the overflow list to avoid waiting
+       * for a free slot.
+       */
+      if (p_atomic_read(&overflow->count) ||
+          !util_queue_ring_push(ring, job))
+         util_queue_overflow_push(queue, overflow, job);
+   } else if (!util_queue_ring_push(ring, job)) {
+      if (can_wait)
+         util_queue_wait_for_space(queue, ring, job);
+      else
+         util_queue_overflow_push(queue, overflow, job);
+   }
+
+   util_queue_sem_post(queue);
+
+   /* If the threads were killed while we were adding the job, nobody is
+    * going to execute it.
+    */
+   if (unlikely(p_atomic_read(&queue->kill_threads)))
+      util_queue_signal_remaining(queue);
+}
+
 void
 util_queue_add_job(struct util_queue *queue,
                    void *job,
@@ -412,11 +1152,36 @@ util_queue_add_job(struct util_queue *queue,
                    util_queue_execute_func execute,
                    util_queue_execute_func cleanup)
 {
-   struct util_queue_job *ptr;
+   util_queue_add_job_ex(queue, job, fence, execute, cleanup,
+                         UTIL_QUEUE_PRIORITY_NORMAL, NULL, NULL, 0);
+}
 
-   mtx_lock(&queue->lock);
-   if (queue->kill_threads) {
-      mtx_unlock(&queue->lock);
+/**
+ * Add a job with a priority, a group and dependencies.
+ *
+ * The job isn't started before all fences in \p deps are signalled. They
+ * can be fences of jobs of any queue, or of anything else. The array is
+ * copied.
+ *
+ * \p group can be NULL. Otherwise, the job can be dropped together with
+ * the other jobs of the group by util_queue_drop_group.
+ */
+void
+util_queue_add_job_ex(struct util_queue *queue,
+                      void *job,
+                      struct util_queue_fence *fence,
+                      util_queue_execute_func execute,
+                      util_queue_execute_func cleanup,
+                      enum util_queue_priority priority,
+                      struct util_queue_group *group,
+                      struct util_queue_fence **deps,
+                      unsigned num_deps)
+{
+   struct util_queue_job ptr;
+
+   assert(priority < UTIL_QUEUE_NUM_PRIORITIES);
+
+   if (p_atomic_read(&queue->kill_threads)) {
       /* well no good option here, but any leaks will be
        * short-lived as things are shutting down..
        */
@@ -425,53 +1190,110 @@ util_queue_add_job(struct util_queue *queue,
 
    util_queue_fence_reset(fence);
 
-   assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
+   ptr.job = job;
+   ptr.fence = fence;
+   ptr.group = group;
+   ptr.execute = execute;
+   ptr.cleanup = cleanup;
 
-   if (queue->num_queued == queue->max_jobs) {
-      if (queue->flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL) {
-         /* If the queue is full, make it larger to avoid waiting for a free
-          * slot.
-          */
-         unsigned new_max_jobs = queue->max_jobs + 8;
-         struct util_queue_job *jobs =
-            (struct util_queue_job*)calloc(new_max_jobs,
-                                           sizeof(struct util_queue_job));
-         assert(jobs);
-
-         /* Copy all queued jobs into the new list. */
-         unsigned num_jobs = 0;
-         unsigned i = queue->read_idx;
-
-         do {
-            jobs[num_jobs++] = queue->jobs[i];
-            i = (i + 1) % queue->max_jobs;
-         } while (i != queue->write_idx);
-
-         assert(num_jobs == queue->num_queued);
-
-         free(queue->jobs);
-         queue->jobs = jobs;
-         queue->read_idx = 0;
-         queue->write_idx = num_jobs;
-         queue->max_jobs = new_max_jobs;
-      } else {
-         /* Wait until there is a free slot. */
-         while (queue->num_queued == queue->max_jobs)
-            cnd_wait(&queue->has_space_cond, &queue->lock);
+   if (group)
+      p_atomic_inc(&group->num_jobs);
+
+   for (unsigned i = 0; i < num_deps; i++) {
+      if (!util_queue_fence_is_signalled(deps[i])) {
+         util_queue_add_waiting(queue, priority, &ptr, deps + i,
+                                num_deps - i);
+         return;
       }
    }
 
-   ptr = &queue->jobs[queue->write_idx];
-   assert(ptr->job == NULL);
-   ptr->job = job;
-   ptr->fence = fence;
-   ptr->execute = execute;
-   ptr->cleanup = cleanup;
-   queue->write_idx = (queue->write_idx + 1) % queue->max_jobs;
+   util_queue_push_job(queue, priority, &ptr, true);
+}
 
-   queue->num_queued++;
-   cnd_signal(&queue->has_queued_cond);
-   mtx_unlock(&queue->lock);
+/**
+ * Add a job from within a job executed by the thread \p thread_index.
+ *
+ * With UTIL_QUEUE_INIT_LOCAL_QUEUES, the job is added to a queue owned by
+ * the thread, which executes its own jobs first. Idle threads steal jobs
+ * from the other threads' queues. If the local queue is full, the job is
+ * executed immediately. Without UTIL_QUEUE_INIT_LOCAL_QUEUES or with a
+ * negative \p thread_index, this is the same as util_queue_add_job.
+ */
+void
+util_queue_add_job_local(struct util_queue *queue,
+                         int thread_index,
+                         void *job,
+                         struct util_queue_fence *fence,
+                         util_queue_execute_func execute,
+                         util_queue_execute_func cleanup)
+{
+   struct util_queue_job ptr;
+
+   if (!queue->local_rings || thread_index < 0) {
+      util_queue_add_job(queue, job, fence, execute, cleanup);
+      return;
+   }
+
+   if (p_atomic_read(&queue->kill_threads))
+      return;
+
+   util_queue_fence_reset(fence);
+
+   ptr.job = job;
+   ptr.fence = fence;
+   ptr.group = NULL;
+   ptr.execute = execute;
+   ptr.cleanup = cleanup;
+
+   assert(thread_index < (int)queue->num_threads);
+   if (util_queue_ring_push(&queue->local_rings[thread_index], &ptr)) {
+      util_queue_sem_post(queue);
+      if (unlikely(p_atomic_read(&queue->kill_threads)))
+         util_queue_signal_remaining(queue);
+      return;
+   }
+
+   /* The local queue is full. Waiting for space could deadlock if all
+    * threads did it, so execute the job right away.
+    */
+   execute(job, thread_index);
+   util_queue_fence_signal(fence);
+   if (cleanup)
+      cleanup(job, thread_index);
+}
+
+static unsigned
+util_queue_drop(struct util_queue *queue, struct util_queue_fence *fence,
+                struct util_queue_group *group)
+{
+   unsigned num_dropped = 0;
+
+   /* Dropped jobs stay in the rings, the threads will treat them as no-op
+    * jobs.
+    */
+   for (unsigned p = 0; p < UTIL_QUEUE_NUM_PRIORITIES; p++) {
+      num_dropped += util_queue_ring_drop(queue, &queue->rings[p],
+                                          fence, group);
+      if (fence && num_dropped)
+         return num_dropped;
+
+      num_dropped += util_queue_overflow_drop(queue, &queue->overflow[p],
+                                              fence, group);
+      if (fence && num_dropped)
+         return num_dropped;
+   }
+
+   if (queue->local_rings) {
+      for (unsigned i = 0; i < queue->num_threads; i++) {
+         num_dropped += util_queue_ring_drop(queue, &queue->local_rings[i],
+                                             fence, group);
+         if (fence && num_dropped)
+            return num_dropped;
+      }
+   }
+
+   num_dropped += util_queue_waiting_drop(queue, fence, group, false);
+   return num_dropped;
 }
 
 /**
@@ -487,30 +1309,59 @@ util_queue_add_job(struct util_queue *queue,
 void
 util_queue_drop_job(struct util_queue *queue, struct util_queue_fence *fence)
 {
-   bool removed = false;
-
    if (util_queue_fence_is_signalled(fence))
       return;
 
-   mtx_lock(&queue->lock);
-   for (unsigned i = queue->read_idx; i != queue->write_idx;
-        i = (i + 1) % queue->max_jobs) {
-      if (queue->jobs[i].fence == fence) {
-         if (queue->jobs[i].cleanup)
-            queue->jobs[i].cleanup(queue->jobs[i].job, -1);
-
-         /* Just clear it. The threads will treat as a no-op job. */
-         memset(&queue->jobs[i], 0, sizeof(queue->jobs[i]));
-         removed = true;
-         break;
-      }
+   if (!util_queue_drop(queue, fence, NULL))
+      util_queue_fence_wait(fence);
+}
+
+/**
+ * Remove all queued jobs of \p group, including those waiting for their
+ * dependencies, and wait for the jobs of the group that have already started.
+ *
+ * The fences of all jobs of the group are signalled when the function
+ * returns. No jobs must be added to the group concurrently.
+ */
+void
+util_queue_drop_group(struct util_queue *queue,
+                      struct util_queue_group *group)
+{
+   uint32_t num_jobs;
+
+   if (!p_atomic_read(&group->num_jobs))
+      return;
+
+   util_queue_drop(queue, NULL, group);
+
+   while ((num_jobs = p_atomic_read(&group->num_jobs)) != 0) {
+      util_queue_sleep(queue, &group->num_jobs, num_jobs,
+                       (int64_t)OS_TIMEOUT_INFINITE);
    }
+}
+
+/* Wait for the jobs that are waiting for their dependencies. They aren't
+ * in the rings yet, so the barrier in util_queue_finish doesn't cover them.
+ */
+static void
+util_queue_wait_for_waiting(struct util_queue *queue)
+{
+   struct util_queue_fence **fences;
+   unsigned num_fences;
+
+   if (!p_atomic_read(&queue->num_waiting))
+      return;
+
+   mtx_lock(&queue->lock);
+   num_fences = queue->num_waiting;
+   fences = malloc(num_fences * sizeof(*fences));
+   for (unsigned i = 0; i < num_fences; i++)
+      fences[i] = queue->waiting[i].job.fence;
    mtx_unlock(&queue->lock);
 
-   if (removed)
-      util_queue_fence_signal(fence);
-   else
-      util_queue_fence_wait(fence);
+   for (unsigned i = 0; i < num_fences; i++)
+      util_queue_fence_wait(fences[i]);
+   free(fences);
 }
 
 static void
@@ -537,9 +1388,16 @@ util_queue_finish(struct util_queue *queue)
     */
    mtx_lock(&queue->finish_lock);
 
+   util_queue_wait_for_waiting(queue);
+
+   /* The barrier jobs have the lowest priority, so that they are started
+    * after all jobs added before.
+    */
    for (unsigned i = 0; i < queue->num_threads; ++i) {
       util_queue_fence_init(&fences[i]);
-      util_queue_add_job(queue, &barrier, &fences[i], util_queue_finish_execute, NULL);
+      util_queue_add_job_ex(queue, &barrier, &fences[i],
+                            util_queue_finish_execute, NULL,
+                            UTIL_QUEUE_PRIORITY_LOW, NULL, NULL, 0);
    }
 
    for (unsigned i = 0; i < queue->num_threads; ++i) {
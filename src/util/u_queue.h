@@ -28,6 +28,10 @@
  *
  * Jobs can be added from any thread. After that, the wait call can be used
  * to wait for completion of the job.
+ *
+ * Adding and taking jobs doesn't take a lock. Jobs are passed through a
+ * lock-free ring, and idle threads sleep on a futex (a mutex and a condition
+ * variable where futexes aren't available).
  */
 
 #ifndef U_QUEUE_H
@@ -48,6 +52,7 @@ extern "C" {
 
 #define UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY      (1 << 0)
 #define UTIL_QUEUE_INIT_RESIZE_IF_FULL            (1 << 1)
+#define UTIL_QUEUE_INIT_LOCAL_QUEUES              (1 << 2)
 
 #if defined(__GNUC__) && defined(HAVE_LINUX_FUTEX_H)
 #define UTIL_QUEUE_FENCE_FUTEX
@@ -190,28 +195,91 @@ util_queue_fence_wait_timeout(struct util_queue_fence *fence,
 
 typedef void (*util_queue_execute_func)(void *job, int thread_index);
 
+/* Jobs of a higher priority are started before any queued job of a lower
+ * priority. Jobs of the same priority are started in order.
+ */
+enum util_queue_priority {
+   UTIL_QUEUE_PRIORITY_HIGH,
+   UTIL_QUEUE_PRIORITY_NORMAL,
+   UTIL_QUEUE_PRIORITY_LOW,
+   UTIL_QUEUE_NUM_PRIORITIES,
+};
+
+/* A set of jobs that can be dropped together, see util_queue_drop_group.
+ * Put this into your context.
+ */
+struct util_queue_group {
+   uint32_t num_jobs; /* queued or executing */
+};
+
+static inline void
+util_queue_group_init(struct util_queue_group *group)
+{
+   group->num_jobs = 0;
+}
+
 struct util_queue_job {
    void *job;
    struct util_queue_fence *fence;
+   struct util_queue_group *group;
    util_queue_execute_func execute;
    util_queue_execute_func cleanup;
 };
 
+/* Bounded lock-free multi-producer/multi-consumer ring of jobs, see
+ * u_queue.c.  The size is a power of two.
+ */
+struct util_queue_ring {
+   struct util_queue_slot *slots;
+   unsigned mask;
+   /* keep the producer and consumer positions on separate cache lines */
+   uint32_t enqueue_pos;
+   char pad[60];
+   uint32_t dequeue_pos;
+};
+
+/* Jobs that didn't fit into a ring, protected by util_queue::lock. */
+struct util_queue_overflow {
+   struct util_queue_job *jobs;
+   unsigned size, read;
+   int count;
+};
+
 /* Put this into your context. */
 struct util_queue {
    const char *name;
    mtx_t finish_lock; /* only for util_queue_finish */
-   mtx_t lock;
-   cnd_t has_queued_cond;
-   cnd_t has_space_cond;
+   mtx_t lock; /* protects overflow and waiting (and sleeping without futexes) */
+   cnd_t wake_cond; /* only used without futexes */
    thrd_t *threads;
    unsigned flags;
-   int num_queued;
    unsigned num_threads;
    int kill_threads;
    int max_jobs;
-   int write_idx, read_idx; /* ring buffer pointers */
-   struct util_queue_job *jobs;
+   struct util_queue_ring rings[UTIL_QUEUE_NUM_PRIORITIES];
+   struct util_queue_ring *local_rings; /* UTIL_QUEUE_INIT_LOCAL_QUEUES */
+
+   /* Counting semaphore of queued jobs: the number of queued jobs minus
+    * the number of sleeping threads.  Sleeping threads are woken up by
+    * handing out wake_tokens.  num_spurious counts wake-ups without a job.
+    */
+   int32_t num_queued;
+   uint32_t wake_tokens;
+   uint32_t num_spurious;
+
+   /* Producers waiting for a free slot in a ring. */
+   uint32_t num_space_waiters;
+   uint32_t space_seq;
+
+   /* Jobs that didn't fit into the rings with UTIL_QUEUE_INIT_RESIZE_IF_FULL
+    * (or that were added by the threads themselves).
+    */
+   struct util_queue_overflow overflow[UTIL_QUEUE_NUM_PRIORITIES];
+
+   /* Jobs whose dependencies haven't been signalled yet, protected by lock */
+   struct util_queue_waiting_job *waiting;
+   unsigned waiting_size;
+   int num_waiting;
 
    /* for cleanup at exit(), protected by exit_mutex */
    struct list_head head;
@@ -230,8 +298,25 @@ void util_queue_add_job(struct util_queue *queue,
                         struct util_queue_fence *fence,
                         util_queue_execute_func execute,
                         util_queue_execute_func cleanup);
+void util_queue_add_job_ex(struct util_queue *queue,
+                           void *job,
+                           struct util_queue_fence *fence,
+                           util_queue_execute_func execute,
+                           util_queue_execute_func cleanup,
+                           enum util_queue_priority priority,
+                           struct util_queue_group *group,
+                           struct util_queue_fence **deps,
+                           unsigned num_deps);
+void util_queue_add_job_local(struct util_queue *queue,
+                              int thread_index,
+                              void *job,
+                              struct util_queue_fence *fence,
+                              util_queue_execute_func execute,
+                              util_queue_execute_func cleanup);
 void util_queue_drop_job(struct util_queue *queue,
                          struct util_queue_fence *fence);
+void util_queue_drop_group(struct util_queue *queue,
+                           struct util_queue_group *group);
 
 void util_queue_finish(struct util_queue *queue);
 